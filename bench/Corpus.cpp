@@ -0,0 +1,311 @@
+#include "Corpus.h"
+#include <SDL2/SDL_image.h>
+#include <algorithm>
+#include <archive.h>
+#include <archive_entry.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <jpeglib.h>
+#ifdef IMAGEVIEWER_HAVE_PNG
+#include <png.h>
+#endif
+#ifdef IMAGEVIEWER_HAVE_TIFF
+#include <tiffio.h>
+#endif
+#ifdef IMAGEVIEWER_BENCH_HAVE_WEBP
+#include <webp/encode.h>
+#endif
+
+namespace {
+
+// 固定的线性同余生成器，不依赖标准库实现
+struct Lcg {
+    uint32_t state;
+    uint32_t Next() {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    }
+};
+
+uint8_t Clamp(int value) {
+    return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+bool ReadFile(const std::string& path, std::vector<char>* data) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    data->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+} // namespace
+
+SDL_Surface* Corpus::MakeImage(int width, int height, uint32_t seed) {
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!surface) {
+        return nullptr;
+    }
+    Lcg lcg{seed};
+    // 随机色块让JPEG/PNG的压缩率接近照片，而不是纯渐变
+    struct Blob {
+        int x, y, radius;
+        int r, g, b;
+    };
+    std::vector<Blob> blobs(24);
+    for (Blob& blob : blobs) {
+        blob.x = static_cast<int>(lcg.Next() % static_cast<uint32_t>(width));
+        blob.y = static_cast<int>(lcg.Next() % static_cast<uint32_t>(height));
+        blob.radius = 1 + static_cast<int>(lcg.Next() % static_cast<uint32_t>(std::max(2, std::min(width, height) / 4)));
+        blob.r = static_cast<int>(lcg.Next() % 256);
+        blob.g = static_cast<int>(lcg.Next() % 256);
+        blob.b = static_cast<int>(lcg.Next() % 256);
+    }
+    for (int y = 0; y < height; ++y) {
+        Uint32* row = reinterpret_cast<Uint32*>(static_cast<Uint8*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch);
+        for (int x = 0; x < width; ++x) {
+            int r = x * 255 / width;
+            int g = y * 255 / height;
+            int b = 128;
+            for (const Blob& blob : blobs) {
+                int dx = x - blob.x;
+                int dy = y - blob.y;
+                if (dx * dx + dy * dy < blob.radius * blob.radius) {
+                    r = (r + blob.r) / 2;
+                    g = (g + blob.g) / 2;
+                    b = (b + blob.b) / 2;
+                }
+            }
+            int noise = static_cast<int>(lcg.Next() % 17) - 8;
+            row[x] = 0xFF000000u | (static_cast<Uint32>(Clamp(r + noise)) << 16) |
+                     (static_cast<Uint32>(Clamp(g + noise)) << 8) | Clamp(b + noise);
+        }
+    }
+    return surface;
+}
+
+bool Corpus::Generate(const std::string& directory, const std::vector<Size>& sizes, Size pageSize, int pages) {
+    files.clear();
+    std::error_code ec;
+    std::filesystem::create_directories(directory + "/pages", ec);
+    if (ec) {
+        std::cerr << "Unable to create corpus directory " << directory << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> formats = {"png", "jpeg", "jpeg-progressive"};
+#ifdef IMAGEVIEWER_HAVE_PNG
+    formats.push_back("png-interlaced");
+#endif
+#ifdef IMAGEVIEWER_BENCH_HAVE_WEBP
+    formats.push_back("webp");
+#endif
+#ifdef IMAGEVIEWER_HAVE_TIFF
+    formats.push_back("tiff");
+#endif
+    uint32_t seed = 1;
+    for (const Size& size : sizes) {
+        SDL_Surface* surface = MakeImage(size.width, size.height, seed++);
+        if (!surface) {
+            return false;
+        }
+        for (const std::string& format : formats) {
+            std::string extension = format.compare(0, 4, "jpeg") == 0 ? "jpg" : format.compare(0, 3, "png") == 0 ? "png" : format;
+            std::string path = directory + "/" + format + "_" + std::to_string(size.width) + "x" +
+                               std::to_string(size.height) + "." + extension;
+            if (!WriteImage(surface, format, path)) {
+                SDL_FreeSurface(surface);
+                return false;
+            }
+            AddFile(path, format, size.width, size.height, 1);
+        }
+        SDL_FreeSurface(surface);
+    }
+
+    // 压缩包页面：各页内容不同，避免解码器或缓存从重复数据中受益
+    std::vector<std::string> pagePaths;
+    for (int i = 0; i < pages; ++i) {
+        SDL_Surface* surface = MakeImage(pageSize.width, pageSize.height, 1000 + static_cast<uint32_t>(i));
+        char name[32];
+        std::snprintf(name, sizeof(name), "/pages/page_%03d.jpg", i);
+        std::string path = directory + name;
+        bool ok = surface && WriteImage(surface, "jpeg", path);
+        SDL_FreeSurface(surface);
+        if (!ok) {
+            return false;
+        }
+        pagePaths.push_back(path);
+    }
+    for (const std::string& format : {std::string("zip"), std::string("tar.gz")}) {
+        std::string path = directory + "/pages." + format;
+        if (!WriteArchive(format, path, pagePaths)) {
+            return false;
+        }
+        AddFile(path, format, pageSize.width, pageSize.height, pages);
+    }
+    return true;
+}
+
+bool Corpus::WriteImage(SDL_Surface* surface, const std::string& format, const std::string& path) {
+    bool ok = false;
+    if (format == "png") {
+        ok = IMG_SavePNG(surface, path.c_str()) == 0;
+    } else if (format == "jpeg") {
+        ok = IMG_SaveJPG(surface, path.c_str(), 90) == 0;
+    } else if (format == "jpeg-progressive") {
+        // SDL_image只写基线JPEG，渐进式直接用libjpeg写；ARGB8888在小端序内存中为BGRA
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (file) {
+            jpeg_compress_struct cinfo;
+            jpeg_error_mgr error;
+            cinfo.err = jpeg_std_error(&error);
+            jpeg_create_compress(&cinfo);
+            jpeg_stdio_dest(&cinfo, file);
+            cinfo.image_width = static_cast<JDIMENSION>(surface->w);
+            cinfo.image_height = static_cast<JDIMENSION>(surface->h);
+            cinfo.input_components = 4;
+            cinfo.in_color_space = JCS_EXT_BGRA;
+            jpeg_set_defaults(&cinfo);
+            jpeg_set_quality(&cinfo, 90, TRUE);
+            jpeg_simple_progression(&cinfo);
+            jpeg_start_compress(&cinfo, TRUE);
+            while (cinfo.next_scanline < cinfo.image_height) {
+                JSAMPROW row = static_cast<JSAMPROW>(surface->pixels) + static_cast<size_t>(cinfo.next_scanline) * surface->pitch;
+                jpeg_write_scanlines(&cinfo, &row, 1);
+            }
+            jpeg_finish_compress(&cinfo);
+            jpeg_destroy_compress(&cinfo);
+            ok = std::fclose(file) == 0;
+        }
+    }
+#ifdef IMAGEVIEWER_HAVE_PNG
+    else if (format == "png-interlaced") {
+        // Adam7隔行，丢弃填充的alpha字节写成RGB
+        FILE* file = std::fopen(path.c_str(), "wb");
+        png_structp png = file ? png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr) : nullptr;
+        png_infop info = png ? png_create_info_struct(png) : nullptr;
+        if (info && !setjmp(png_jmpbuf(png))) {
+            png_init_io(png, file);
+            png_set_IHDR(png, info, static_cast<png_uint_32>(surface->w), static_cast<png_uint_32>(surface->h), 8,
+                         PNG_COLOR_TYPE_RGB, PNG_INTERLACE_ADAM7, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+            png_write_info(png, info);
+            png_set_bgr(png);
+            png_set_filler(png, 0, PNG_FILLER_AFTER);
+            int passes = png_set_interlace_handling(png);
+            for (int pass = 0; pass < passes; ++pass) {
+                for (int y = 0; y < surface->h; ++y) {
+                    png_write_row(png, static_cast<png_bytep>(surface->pixels) + static_cast<size_t>(y) * surface->pitch);
+                }
+            }
+            png_write_end(png, info);
+            ok = true;
+        }
+        png_destroy_write_struct(&png, &info);
+        if (file) {
+            ok = std::fclose(file) == 0 && ok;
+        }
+    }
+#endif
+#ifdef IMAGEVIEWER_BENCH_HAVE_WEBP
+    else if (format == "webp") {
+        // ARGB8888在小端序内存中为BGRA
+        uint8_t* output = nullptr;
+        size_t size = WebPEncodeBGRA(static_cast<const uint8_t*>(surface->pixels), surface->w, surface->h,
+                                     surface->pitch, 85.0f, &output);
+        if (size > 0) {
+            std::ofstream out(path, std::ios::binary);
+            out.write(reinterpret_cast<const char*>(output), static_cast<std::streamsize>(size));
+            ok = static_cast<bool>(out);
+        }
+        WebPFree(output);
+    }
+#endif
+#ifdef IMAGEVIEWER_HAVE_TIFF
+    else if (format == "tiff") {
+        TIFF* tiff = TIFFOpen(path.c_str(), "w");
+        if (tiff) {
+            TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, static_cast<uint32_t>(surface->w));
+            TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, static_cast<uint32_t>(surface->h));
+            TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, 3);
+            TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, 8);
+            TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+            TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+            TIFFSetField(tiff, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+            TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, 64);
+            std::vector<uint8_t> row(static_cast<size_t>(surface->w) * 3);
+            ok = true;
+            for (int y = 0; y < surface->h && ok; ++y) {
+                const Uint32* src = reinterpret_cast<const Uint32*>(static_cast<const Uint8*>(surface->pixels) +
+                                                                    static_cast<size_t>(y) * surface->pitch);
+                for (int x = 0; x < surface->w; ++x) {
+                    row[x * 3] = static_cast<uint8_t>(src[x] >> 16);
+                    row[x * 3 + 1] = static_cast<uint8_t>(src[x] >> 8);
+                    row[x * 3 + 2] = static_cast<uint8_t>(src[x]);
+                }
+                ok = TIFFWriteScanline(tiff, row.data(), static_cast<uint32_t>(y), 0) == 1;
+            }
+            TIFFClose(tiff);
+        }
+    }
+#endif
+    if (!ok) {
+        std::cerr << "Unable to write " << path << ": " << SDL_GetError() << std::endl;
+    }
+    return ok;
+}
+
+bool Corpus::WriteArchive(const std::string& format, const std::string& path, const std::vector<std::string>& pagePaths) {
+    struct archive* a = archive_write_new();
+    if (format == "zip") {
+        archive_write_set_format_zip(a);
+    } else {
+        archive_write_set_format_pax_restricted(a);
+        archive_write_add_filter_gzip(a);
+    }
+    if (archive_write_open_filename(a, path.c_str()) != ARCHIVE_OK) {
+        std::cerr << "Unable to create " << path << ": " << archive_error_string(a) << std::endl;
+        archive_write_free(a);
+        return false;
+    }
+    bool ok = true;
+    std::vector<char> data;
+    for (const std::string& pagePath : pagePaths) {
+        if (!ReadFile(pagePath, &data)) {
+            ok = false;
+            break;
+        }
+        // 固定的时间戳和权限，保证压缩包逐字节相同
+        struct archive_entry* entry = archive_entry_new();
+        archive_entry_set_pathname(entry, std::filesystem::path(pagePath).filename().c_str());
+        archive_entry_set_size(entry, static_cast<la_int64_t>(data.size()));
+        archive_entry_set_filetype(entry, AE_IFREG);
+        archive_entry_set_perm(entry, 0644);
+        archive_entry_set_mtime(entry, 0, 0);
+        ok = archive_write_header(a, entry) == ARCHIVE_OK &&
+             archive_write_data(a, data.data(), data.size()) == static_cast<la_ssize_t>(data.size());
+        archive_entry_free(entry);
+        if (!ok) {
+            std::cerr << "Unable to write " << path << ": " << archive_error_string(a) << std::endl;
+            break;
+        }
+    }
+    ok = archive_write_close(a) == ARCHIVE_OK && ok;
+    archive_write_free(a);
+    return ok;
+}
+
+void Corpus::AddFile(const std::string& path, const std::string& format, int width, int height, int pages) {
+    File file;
+    file.path = path;
+    file.format = format;
+    file.width = width;
+    file.height = height;
+    file.pages = pages;
+    std::error_code ec;
+    file.bytes = std::filesystem::file_size(path, ec);
+    files.push_back(file);
+}
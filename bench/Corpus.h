@@ -0,0 +1,40 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 基准测试用的合成图片集：同样的参数每次生成逐字节相同的文件，
+// 不同版本的测量结果可以直接比较
+class Corpus {
+public:
+    struct File {
+        std::string path;
+        std::string format;     // png、png-interlaced、jpeg、jpeg-progressive、webp、tiff、zip、tar.gz
+        int width = 0;          // 压缩包为每页的尺寸
+        int height = 0;
+        int pages = 1;          // 压缩包内的图片数
+        uint64_t bytes = 0;     // 文件大小
+    };
+
+    struct Size {
+        int width;
+        int height;
+    };
+
+    // 在directory下生成各格式、各尺寸的图片各一张，以及两个含pages页JPEG的压缩包（ZIP、tar.gz）
+    bool Generate(const std::string& directory, const std::vector<Size>& sizes, Size pageSize, int pages);
+
+    const std::vector<File>& GetFiles() const { return files; }
+
+    // 确定性的类照片内容（渐变、色块和噪声），ARGB8888
+    static SDL_Surface* MakeImage(int width, int height, uint32_t seed);
+
+private:
+    bool WriteImage(SDL_Surface* surface, const std::string& format, const std::string& path);
+    bool WriteArchive(const std::string& format, const std::string& path, const std::vector<std::string>& pagePaths);
+    void AddFile(const std::string& path, const std::string& format, int width, int height, int pages);
+
+    std::vector<File> files;
+};
@@ -0,0 +1,762 @@
+#include "ImageViewer.h"
+#include "Corpus.h"
+#include "Resampler.h"
+#include "BatchReader.h"
+#include "ProgressiveDecoder.h"
+#include "PerceptualHash.h"
+#include "DuplicateFinder.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+// 一个阶段在一种格式和尺寸下的测量结果
+struct StageResult {
+    std::string stage;
+    std::string format;
+    int width = 0;
+    int height = 0;
+    std::vector<double> samples;    // 每次操作的耗时（毫秒）
+    uint64_t bytes = 0;             // 解码类阶段按全分辨率像素计，打开压缩包按文件大小计
+    int images = 0;
+};
+
+// 批量读取在一种后端和队列深度下的吞吐量
+struct ReadResult {
+    std::string backend;
+    int queueDepth = 0;
+    int files = 0;
+    uint64_t bytes = 0;
+    uint64_t reads = 0;
+    double seconds = 0.0;
+};
+
+// 通过友元直接驱动ImageViewer的各阶段，与交互时走相同的代码路径
+class ImageViewerBench {
+public:
+    ImageViewerBench(ImageViewer& viewer, int iterations) : viewer(viewer), iterations(iterations) {}
+
+    void RunImage(const Corpus::File& file);
+    void RunArchive(const Corpus::File& file);
+    void RunArchivePreload(const Corpus::File& file);
+    void RunProgressive(const Corpus::File& file);
+    void RunSignature(const Corpus::File& file);
+    void RunResampler();
+    void RunClusters();
+    void RunBatchRead(const std::vector<Corpus::File>& files);
+    void WriteJson(std::ostream& out, const Corpus& corpus) const;
+    // 所有正确性检查都通过，且24MP缩放达到加速目标
+    bool Passed() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static double Milliseconds(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    StageResult& AddStage(const std::string& stage, const Corpus::File& file);
+    void DisplayCurrent();
+
+    ImageViewer& viewer;
+    int iterations;
+    std::deque<StageResult> results;   // 添加阶段时已有阶段的引用保持有效
+
+    std::vector<ReadResult> readResults;
+
+    // 重采样：SIMD与标量实现对比，Lanczos3和Box分别计时
+    std::string resamplerIsa;
+    double resamplerScalarMs = 0.0;
+    double resamplerSimdMs = 0.0;
+    double resamplerBoxScalarMs = 0.0;
+    double resamplerBoxSimdMs = 0.0;
+    // 24MP原图缩到1920x1280的Lanczos3，SIMD应至少快kResamplerTargetSpeedup倍
+    double resamplerLargeScalarMs = 0.0;
+    double resamplerLargeSimdMs = 0.0;
+    bool resamplerLargeMeetsTarget = true;
+    int resamplerChecks = 0;
+    std::vector<std::string> resamplerMismatches;   // 与标量结果不一致的滤波器、指令集和尺寸
+
+    // 感知哈希的DCT：SIMD与标量实现的签名应一致
+    bool signatureIdentical = true;
+    // 重复组：距离在阈值内的成对图片归为一组，超出的不归
+    int clusterChecks = 0;
+    std::vector<std::string> clusterMismatches;
+};
+
+namespace {
+
+const double kResamplerTargetSpeedup = 4.0;
+
+std::string Escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            escaped += buffer;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+double Percentile(std::vector<double> samples, double q) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    size_t rank = static_cast<size_t>(std::ceil(q * samples.size()));
+    return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+} // namespace
+
+StageResult& ImageViewerBench::AddStage(const std::string& stage, const Corpus::File& file) {
+    StageResult result;
+    result.stage = stage;
+    result.format = file.format;
+    result.width = file.width;
+    result.height = file.height;
+    results.push_back(result);
+    return results.back();
+}
+
+void ImageViewerBench::DisplayCurrent() {
+    // 先显示内嵌预览时持续绘制，直到后台解码的全图替换预览、大层级分条上传完毕
+    while (true) {
+        JobScheduler::GetInstance().DrainCompletions();
+        viewer.textureUploader.Pump(viewer.textureCache);
+        viewer.Render(FrameScheduler::kAll);
+        int index = viewer.currentImageIndex;
+        bool previewing = index >= 0 && index < (int)viewer.images->size() && (*viewer.images)[index].previewActive;
+        if (!previewing && !viewer.textureUploader.HasPending()) {
+            break;
+        }
+        if (previewing) {
+            SDL_Delay(1);
+        }
+    }
+    // 不运行事件循环，丢弃后台线程推送的唤醒事件
+    SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+}
+
+void ImageViewerBench::RunImage(const Corpus::File& file) {
+    ImageData item;
+    item.path = file.path;
+    item.key = file.path;
+    uint64_t pixelBytes = static_cast<uint64_t>(file.width) * file.height * 4;
+
+    // 整图解码（SDL_image或缩放IDCT的全分辨率路径）
+    StageResult& decode = AddStage("decode", file);
+    SDL_Surface* surface = nullptr;
+    for (int i = 0; i < iterations; ++i) {
+        SDL_FreeSurface(surface);
+        Clock::time_point start = Clock::now();
+        surface = viewer.DecodeSurface(item);
+        decode.samples.push_back(Milliseconds(start));
+        if (surface) {
+            decode.bytes += pixelBytes;
+            ++decode.images;
+        }
+    }
+
+    // 适应窗口的解码：缩放IDCT、mip层级和Lanczos显示图
+    StageResult& decodeFit = AddStage("decode_fit", file);
+    for (int i = 0; i < iterations; ++i) {
+        Clock::time_point start = Clock::now();
+        std::unique_ptr<DecodedImage> decoded = viewer.DecodeImage(item);
+        decodeFit.samples.push_back(Milliseconds(start));
+        if (decoded) {
+            decodeFit.bytes += pixelBytes;
+            ++decodeFit.images;
+        }
+    }
+
+    // 上传
+    StageResult& upload = AddStage("upload", file);
+    for (int i = 0; surface && i < iterations; ++i) {
+        Clock::time_point start = Clock::now();
+        SDL_Texture* texture = SDL_CreateTextureFromSurface(viewer.renderer, surface);
+        upload.samples.push_back(Milliseconds(start));
+        if (texture) {
+            upload.bytes += static_cast<uint64_t>(surface->h) * surface->pitch;
+            ++upload.images;
+            SDL_DestroyTexture(texture);
+        }
+    }
+    SDL_FreeSurface(surface);
+
+    // 分条上传：每个样本是一帧内的上传耗时，p99即大图到达时UI的单帧停顿
+    StageResult& uploadFrame = AddStage("upload_frame", file);
+    for (int i = 0; i < iterations; ++i) {
+        viewer.ClearAllImages();
+        viewer.images->push_back(item);
+        std::unique_ptr<DecodedImage> decoded = viewer.DecodeImage(item, true);
+        if (!decoded || viewer.NeedsTiling(decoded->width, decoded->height)) {
+            break;
+        }
+        Clock::time_point start = Clock::now();
+        viewer.UploadDecoded(0, std::move(decoded), 0);
+        uploadFrame.samples.push_back(Milliseconds(start));
+        while (viewer.textureUploader.HasPending()) {
+            start = Clock::now();
+            viewer.textureUploader.Pump(viewer.textureCache);
+            uploadFrame.samples.push_back(Milliseconds(start));
+        }
+        uploadFrame.bytes += pixelBytes;
+        ++uploadFrame.images;
+    }
+    viewer.ClearAllImages();
+
+    // 打开文件直到全图显示，每次都从空缓存开始
+    StageResult& load = AddStage("load_image", file);
+    for (int i = 0; i < iterations; ++i) {
+        viewer.ClearAllImages();
+        Clock::time_point start = Clock::now();
+        viewer.OnFileOpened(file.path);
+        DisplayCurrent();
+        load.samples.push_back(Milliseconds(start));
+        if (!viewer.images->empty() && !(*viewer.images)[0].loadFailed) {
+            load.bytes += pixelBytes;
+            ++load.images;
+        }
+    }
+
+    // 适应窗口时整帧绘制
+    StageResult& render = AddStage("render", file);
+    int outputWidth = 0, outputHeight = 0;
+    SDL_GetRendererOutputSize(viewer.renderer, &outputWidth, &outputHeight);
+    for (int i = 0; i < iterations * 10; ++i) {
+        Clock::time_point start = Clock::now();
+        viewer.Render(FrameScheduler::kAll);
+        render.samples.push_back(Milliseconds(start));
+        render.bytes += static_cast<uint64_t>(outputWidth) * outputHeight * 4;
+        ++render.images;
+    }
+    viewer.ClearAllImages();
+}
+
+void ImageViewerBench::RunArchive(const Corpus::File& file) {
+    StageResult& open = AddStage("archive_open", file);
+    StageResult& pages = AddStage("archive_pages", file);
+    uint64_t pageBytes = static_cast<uint64_t>(file.width) * file.height * 4;
+    for (int i = 0; i < iterations; ++i) {
+        viewer.ClearAllImages();
+        // 建立条目索引并显示第一页
+        Clock::time_point start = Clock::now();
+        viewer.OnArchiveOpened(file.path);
+        DisplayCurrent();
+        open.samples.push_back(Milliseconds(start));
+        if (viewer.images->empty()) {
+            continue;
+        }
+        open.bytes += file.bytes;
+        ++open.images;
+        // 逐页翻过，预取线程在后台解码后续页面
+        for (int page = 1; page < (int)viewer.images->size(); ++page) {
+            start = Clock::now();
+            viewer.ShowImage(page);
+            DisplayCurrent();
+            pages.samples.push_back(Milliseconds(start));
+            pages.bytes += pageBytes;
+            ++pages.images;
+        }
+    }
+    viewer.ClearAllImages();
+}
+
+void ImageViewerBench::RunArchivePreload(const Corpus::File& file) {
+    // 固实压缩包整本预加载：单个解码线程对比每核一个
+    int cores = std::max(1, SDL_GetCPUCount());
+    ArchivePipeline::Options saved = viewer.archivePipelineOptions;
+    uint64_t pageBytes = static_cast<uint64_t>(file.width) * file.height * 4;
+    for (int workers : {1, cores}) {
+        StageResult& preload = AddStage(workers == 1 ? "archive_preload_1" : "archive_preload", file);
+        viewer.archivePipelineOptions.maxJobs = workers;
+        viewer.archivePipelineOptions.ahead = 1 << 20;
+        for (int i = 0; i < iterations; ++i) {
+            viewer.ClearAllImages();
+            Clock::time_point start = Clock::now();
+            viewer.OnArchiveOpened(file.path);
+            if (!viewer.archivePipeline.IsRunning()) {
+                break;
+            }
+            while (!viewer.archivePipeline.IsFinished()) {
+                if (viewer.UploadArchiveResults(8) == 0) {
+                    SDL_Delay(1);
+                }
+            }
+            preload.samples.push_back(Milliseconds(start));
+            preload.bytes += pageBytes * viewer.images->size();
+            preload.images += (int)viewer.images->size();
+            SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+        }
+        if (workers == cores) {
+            break;
+        }
+    }
+    viewer.archivePipelineOptions = saved;
+    viewer.ClearAllImages();
+}
+
+void ImageViewerBench::RunProgressive(const Corpus::File& file) {
+    // 边读边解码：每遍都输出，第一遍近似图的耗时对比完整解码
+    int width = 0, height = 0;
+    ProgressiveDecoder::Format format = ProgressiveDecoder::Probe(file.path, &width, &height);
+    if (format == ProgressiveDecoder::Format::None) {
+        return;
+    }
+    uint64_t pixelBytes = static_cast<uint64_t>(file.width) * file.height * 4;
+    StageResult& firstPass = AddStage("progressive_first_pass", file);
+    StageResult& full = AddStage("progressive_full", file);
+    CancelToken token = CancelToken::Create();
+    for (int i = 0; i < iterations; ++i) {
+        Clock::time_point start = Clock::now();
+        double firstMs = -1.0;
+        SDL_Surface* surface = ProgressiveDecoder::Decode(file.path, format, 1, [&](SDL_Surface*, int) {
+            if (firstMs < 0.0) {
+                firstMs = Milliseconds(start);
+            }
+            return true;
+        }, token, 0);
+        double fullMs = Milliseconds(start);
+        if (!surface) {
+            break;
+        }
+        SDL_FreeSurface(surface);
+        firstPass.samples.push_back(firstMs < 0.0 ? fullMs : firstMs);
+        firstPass.bytes += pixelBytes;
+        ++firstPass.images;
+        full.samples.push_back(fullMs);
+        full.bytes += pixelBytes;
+        ++full.images;
+    }
+}
+
+void ImageViewerBench::RunSignature(const Corpus::File& file) {
+    // 查重的后台计算：缩小解码加感知哈希，不经过签名缓存
+    ImageData item;
+    item.path = file.path;
+    item.key = file.path;
+    StageResult& stage = AddStage("signature", file);
+    for (int i = 0; i < iterations; ++i) {
+        Clock::time_point start = Clock::now();
+        SDL_Surface* source = viewer.DecodeReduced(item, PerceptualHash::kSize);
+        PerceptualHash::Signature signature;
+        bool computed = PerceptualHash::Compute(source, &signature);
+        stage.samples.push_back(Milliseconds(start));
+        if (!computed) {
+            SDL_FreeSurface(source);
+            break;
+        }
+        PerceptualHash::Signature scalar;
+        PerceptualHash::Compute(source, &scalar, Resampler::Isa::Scalar);
+        signatureIdentical = signatureIdentical && scalar.pHash == signature.pHash && scalar.dHash == signature.dHash;
+        SDL_FreeSurface(source);
+        stage.bytes += file.bytes;
+        ++stage.images;
+    }
+}
+
+namespace {
+
+bool SameSurface(SDL_Surface* a, SDL_Surface* b) {
+    if (!a || !b || a->w != b->w || a->h != b->h) {
+        return false;
+    }
+    for (int y = 0; y < a->h; ++y) {
+        if (std::memcmp(static_cast<Uint8*>(a->pixels) + static_cast<size_t>(y) * a->pitch,
+                        static_cast<Uint8*>(b->pixels) + static_cast<size_t>(y) * b->pitch,
+                        static_cast<size_t>(a->w) * 4) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char* FilterName(Resampler::Filter filter) {
+    switch (filter) {
+        case Resampler::Filter::Box: return "box";
+        case Resampler::Filter::Mitchell: return "mitchell";
+        default: return "lanczos3";
+    }
+}
+
+// 翻转hash中从bit开始的count位
+uint64_t FlipBits(uint64_t hash, int bit, int count) {
+    for (int i = 0; i < count; ++i) {
+        hash ^= 1ull << ((bit + i * 7) % 64);
+    }
+    return hash;
+}
+
+} // namespace
+
+void ImageViewerBench::RunResampler() {
+    // 计时：Lanczos3（显示图）和Box（感知哈希、缩略图的快速路径）
+    SDL_Surface* source = Corpus::MakeImage(1920, 1080, 7);
+    if (!source) {
+        return;
+    }
+    Resampler::Isa isa = Resampler::DetectIsa();
+    resamplerIsa = Resampler::IsaName(isa);
+    for (Resampler::Filter filter : {Resampler::Filter::Lanczos3, Resampler::Filter::Box}) {
+        double* scalarMs = filter == Resampler::Filter::Box ? &resamplerBoxScalarMs : &resamplerScalarMs;
+        double* simdMs = filter == Resampler::Filter::Box ? &resamplerBoxSimdMs : &resamplerSimdMs;
+        for (int i = 0; i < iterations; ++i) {
+            Clock::time_point start = Clock::now();
+            SDL_FreeSurface(Resampler::Resize(source, 640, 360, filter, Resampler::Isa::Scalar));
+            *scalarMs += Milliseconds(start);
+            start = Clock::now();
+            SDL_FreeSurface(Resampler::Resize(source, 640, 360, filter, isa));
+            *simdMs += Milliseconds(start);
+        }
+        *scalarMs /= std::max(1, iterations);
+        *simdMs /= std::max(1, iterations);
+    }
+    SDL_FreeSurface(source);
+
+    // 24MP：整行数据超出缓存，测量的是实际打开相机原图时的缩放
+    source = Corpus::MakeImage(6000, 4000, 11);
+    if (source) {
+        for (int i = 0; i < iterations; ++i) {
+            Clock::time_point start = Clock::now();
+            SDL_FreeSurface(Resampler::Resize(source, 1920, 1280, Resampler::Filter::Lanczos3, Resampler::Isa::Scalar));
+            resamplerLargeScalarMs += Milliseconds(start);
+            start = Clock::now();
+            SDL_FreeSurface(Resampler::Resize(source, 1920, 1280, Resampler::Filter::Lanczos3, isa));
+            resamplerLargeSimdMs += Milliseconds(start);
+        }
+        resamplerLargeScalarMs /= std::max(1, iterations);
+        resamplerLargeSimdMs /= std::max(1, iterations);
+        SDL_FreeSurface(source);
+        // 只有标量实现的CPU不参与比较
+        if (isa != Resampler::Isa::Scalar && resamplerLargeSimdMs > 0.0 &&
+            resamplerLargeScalarMs / resamplerLargeSimdMs < kResamplerTargetSpeedup) {
+            resamplerLargeMeetsTarget = false;
+            std::cerr << "Resampler " << resamplerIsa << " speedup on 6000x4000 is "
+                      << resamplerLargeScalarMs / resamplerLargeSimdMs << "x, below " << kResamplerTargetSpeedup << "x" << std::endl;
+        }
+    }
+
+    // 正确性：每种滤波器、CPU支持的每种指令集与标量实现逐字节一致。
+    // 覆盖缩小、放大、1像素宽高和奇数宽度（SIMD的行尾处理）
+    struct Case {
+        int srcWidth, srcHeight, width, height;
+    };
+    const Case cases[] = {
+        {1920, 1080, 640, 360}, {1001, 333, 333, 111}, {97, 61, 300, 200}, {7, 5, 13, 11},
+        {1, 1, 17, 9}, {37, 1, 1, 1}, {640, 480, 1, 480}, {5, 300, 5, 7}, {33, 17, 31, 19},
+    };
+    std::vector<Resampler::Isa> isas;
+    for (Resampler::Isa candidate : {Resampler::Isa::SSE41, Resampler::Isa::AVX2}) {
+        if (candidate <= isa) {
+            isas.push_back(candidate);
+        }
+    }
+    for (const Case& c : cases) {
+        SDL_Surface* image = Corpus::MakeImage(c.srcWidth, c.srcHeight, c.srcWidth * 31 + c.srcHeight);
+        if (!image) {
+            continue;
+        }
+        for (Resampler::Filter filter : {Resampler::Filter::Box, Resampler::Filter::Mitchell, Resampler::Filter::Lanczos3}) {
+            SDL_Surface* scalar = Resampler::Resize(image, c.width, c.height, filter, Resampler::Isa::Scalar);
+            for (Resampler::Isa simdIsa : isas) {
+                SDL_Surface* simd = Resampler::Resize(image, c.width, c.height, filter, simdIsa);
+                ++resamplerChecks;
+                if (!SameSurface(scalar, simd)) {
+                    std::ostringstream name;
+                    name << FilterName(filter) << " " << Resampler::IsaName(simdIsa) << " " << c.srcWidth << "x" << c.srcHeight
+                         << "->" << c.width << "x" << c.height;
+                    resamplerMismatches.push_back(name.str());
+                    std::cerr << "Resampler mismatch: " << name.str() << std::endl;
+                }
+                SDL_FreeSurface(simd);
+            }
+            SDL_FreeSurface(scalar);
+        }
+        SDL_FreeSurface(image);
+    }
+}
+
+void ImageViewerBench::RunClusters() {
+    // 随机的基准签名两两相距约32位；每个基准派生一张变体，按与基准的距离决定是否应归为一组。
+    // 翻转的位分散在各段，覆盖多索引哈希的不同分段
+    struct Variant {
+        int pHashBits;
+        int dHashBits;
+        bool grouped;
+    };
+    const Variant variants[] = {
+        {0, 0, true},
+        {2, 3, true},
+        {DuplicateFinder::kPHashThreshold, DuplicateFinder::kDHashThreshold, true},
+        {DuplicateFinder::kPHashThreshold + 2, 0, false},
+        {10, 10, false},
+        {0, DuplicateFinder::kDHashThreshold + 2, false},
+    };
+    std::mt19937_64 random(42);
+    std::vector<PerceptualHash::Signature> signatures;
+    std::vector<bool> expected;
+    for (int base = 0; base < 64; ++base) {
+        for (const Variant& variant : variants) {
+            PerceptualHash::Signature a = {random(), random()};
+            PerceptualHash::Signature b = {FlipBits(a.pHash, base, variant.pHashBits), FlipBits(a.dHash, base * 3, variant.dHashBits)};
+            signatures.push_back(a);
+            signatures.push_back(b);
+            expected.push_back(variant.grouped);
+        }
+    }
+    std::vector<char> valid(signatures.size(), 1);
+    std::vector<std::vector<int>> clusters = DuplicateFinder::BuildClusters(signatures, valid);
+    std::vector<bool> grouped(expected.size(), false);
+    for (const std::vector<int>& cluster : clusters) {
+        // 每组应恰好是一对基准和变体
+        if (cluster.size() == 2 && cluster[0] % 2 == 0 && cluster[1] == cluster[0] + 1) {
+            grouped[cluster[0] / 2] = true;
+        } else {
+            clusterMismatches.push_back("unexpected cluster of " + std::to_string(cluster.size()) +
+                                        " starting at " + std::to_string(cluster[0]));
+        }
+    }
+    for (size_t pair = 0; pair < expected.size(); ++pair) {
+        ++clusterChecks;
+        if (grouped[pair] != expected[pair]) {
+            const Variant& variant = variants[pair % (sizeof(variants) / sizeof(variants[0]))];
+            clusterMismatches.push_back("pair " + std::to_string(pair) + " at distance " + std::to_string(variant.pHashBits) +
+                                        "/" + std::to_string(variant.dHashBits) + (expected[pair] ? " not grouped" : " grouped"));
+        }
+    }
+    for (const std::string& mismatch : clusterMismatches) {
+        std::cerr << "Duplicate cluster mismatch: " << mismatch << std::endl;
+    }
+}
+
+bool ImageViewerBench::Passed() const {
+    return resamplerMismatches.empty() && resamplerLargeMeetsTarget && signatureIdentical && clusterMismatches.empty();
+}
+
+void ImageViewerBench::RunBatchRead(const std::vector<Corpus::File>& files) {
+    std::vector<BatchReader::Backend> backends = {BatchReader::Backend::IoUring, BatchReader::Backend::ThreadPool};
+    for (BatchReader::Backend backend : backends) {
+        for (int depth : {1, 4, 16}) {
+            ReadResult result;
+            result.backend = BatchReader::BackendName(backend);
+            result.queueDepth = depth;
+            std::mutex mutex;
+            std::condition_variable done;
+            int remaining = 0;
+            BatchReader reader;
+            if (!reader.Start(depth, [&](uint64_t, std::unique_ptr<MappedFile> contents) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (contents) {
+                        ++result.files;
+                    }
+                    if (--remaining == 0) {
+                        done.notify_all();
+                    }
+                }, backend)) {
+                continue;
+            }
+            for (int i = 0; i < iterations; ++i) {
+                // 丢弃页缓存，测量设备读取而不是内存拷贝
+                std::vector<BatchReader::Request> batch;
+                for (const Corpus::File& file : files) {
+                    int fd = open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+                    if (fd >= 0) {
+                        fdatasync(fd);
+                        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+                        close(fd);
+                    }
+                    batch.push_back({batch.size(), file.path});
+                }
+                remaining = (int)batch.size();
+                Clock::time_point start = Clock::now();
+                reader.Submit(std::move(batch));
+                std::unique_lock<std::mutex> lock(mutex);
+                done.wait(lock, [&]() { return remaining == 0; });
+                result.seconds += Milliseconds(start) / 1000.0;
+            }
+            reader.Stop();
+            result.bytes = reader.GetBytesRead();
+            result.reads = reader.GetReadCount();
+            readResults.push_back(result);
+        }
+    }
+}
+
+void ImageViewerBench::WriteJson(std::ostream& out, const Corpus& corpus) const {
+    SDL_RendererInfo info = {};
+    SDL_GetRendererInfo(viewer.renderer, &info);
+    out << std::fixed << std::setprecision(3);
+    out << "{\n";
+    out << "  \"benchmark\": \"image_viewer_bench\",\n";
+    out << "  \"video_driver\": \"" << Escape(SDL_GetCurrentVideoDriver() ? SDL_GetCurrentVideoDriver() : "") << "\",\n";
+    out << "  \"renderer\": \"" << Escape(info.name ? info.name : "") << "\",\n";
+    out << "  \"cpu_count\": " << SDL_GetCPUCount() << ",\n";
+    out << "  \"iterations\": " << iterations << ",\n";
+    out << "  \"corpus\": [\n";
+    const std::vector<Corpus::File>& files = corpus.GetFiles();
+    for (size_t i = 0; i < files.size(); ++i) {
+        const Corpus::File& file = files[i];
+        out << "    {\"path\": \"" << Escape(file.path) << "\", \"format\": \"" << file.format
+            << "\", \"width\": " << file.width << ", \"height\": " << file.height
+            << ", \"pages\": " << file.pages << ", \"bytes\": " << file.bytes << "}"
+            << (i + 1 < files.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n";
+    out << "  \"stages\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const StageResult& result = results[i];
+        double seconds = 0.0;
+        for (double sample : result.samples) {
+            seconds += sample / 1000.0;
+        }
+        double mbPerSecond = seconds > 0.0 ? result.bytes / (1024.0 * 1024.0) / seconds : 0.0;
+        double imagesPerSecond = seconds > 0.0 ? result.images / seconds : 0.0;
+        out << "    {\"stage\": \"" << result.stage << "\", \"format\": \"" << result.format
+            << "\", \"width\": " << result.width << ", \"height\": " << result.height
+            << ", \"count\": " << result.samples.size() << ", \"images\": " << result.images
+            << ", \"bytes\": " << result.bytes << ", \"seconds\": " << seconds
+            << ", \"mb_per_s\": " << mbPerSecond << ", \"images_per_s\": " << imagesPerSecond
+            << ", \"p50_ms\": " << Percentile(result.samples, 0.50)
+            << ", \"p99_ms\": " << Percentile(result.samples, 0.99) << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n";
+    out << "  \"batch_read\": [\n";
+    for (size_t i = 0; i < readResults.size(); ++i) {
+        const ReadResult& result = readResults[i];
+        double mbPerSecond = result.seconds > 0.0 ? result.bytes / (1024.0 * 1024.0) / result.seconds : 0.0;
+        double iops = result.seconds > 0.0 ? result.reads / result.seconds : 0.0;
+        out << "    {\"backend\": \"" << result.backend << "\", \"queue_depth\": " << result.queueDepth
+            << ", \"files\": " << result.files << ", \"bytes\": " << result.bytes << ", \"reads\": " << result.reads
+            << ", \"seconds\": " << result.seconds << ", \"mb_per_s\": " << mbPerSecond << ", \"iops\": " << iops << "}"
+            << (i + 1 < readResults.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n";
+    out << "  \"resampler\": {\"isa\": \"" << resamplerIsa << "\", \"scalar_ms\": " << resamplerScalarMs
+        << ", \"simd_ms\": " << resamplerSimdMs
+        << ", \"speedup\": " << (resamplerSimdMs > 0.0 ? resamplerScalarMs / resamplerSimdMs : 0.0)
+        << ", \"box_scalar_ms\": " << resamplerBoxScalarMs << ", \"box_simd_ms\": " << resamplerBoxSimdMs
+        << ", \"box_speedup\": " << (resamplerBoxSimdMs > 0.0 ? resamplerBoxScalarMs / resamplerBoxSimdMs : 0.0)
+        << ", \"large_scalar_ms\": " << resamplerLargeScalarMs << ", \"large_simd_ms\": " << resamplerLargeSimdMs
+        << ", \"large_speedup\": " << (resamplerLargeSimdMs > 0.0 ? resamplerLargeScalarMs / resamplerLargeSimdMs : 0.0)
+        << ", \"large_meets_target\": " << (resamplerLargeMeetsTarget ? "true" : "false")
+        << ", \"checks\": " << resamplerChecks << ", \"mismatches\": [";
+    for (size_t i = 0; i < resamplerMismatches.size(); ++i) {
+        out << (i > 0 ? ", " : "") << "\"" << Escape(resamplerMismatches[i]) << "\"";
+    }
+    out << "], \"identical\": " << (resamplerMismatches.empty() ? "true" : "false") << "},\n";
+    out << "  \"signature\": {\"identical\": " << (signatureIdentical ? "true" : "false") << "},\n";
+    out << "  \"clusters\": {\"checks\": " << clusterChecks << ", \"mismatches\": " << clusterMismatches.size()
+        << ", \"passed\": " << (clusterMismatches.empty() ? "true" : "false") << "}\n";
+    out << "}\n";
+}
+
+int main(int argc, char* argv[]) {
+    // 命令行参数：--corpus=DIR --output=FILE --iterations=N --quick
+    std::string corpusDir = (std::filesystem::temp_directory_path() / "image_viewer_bench").string();
+    std::string outputPath;
+    int iterations = 5;
+    bool quick = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--corpus=", 0) == 0) {
+            corpusDir = arg.substr(9);
+        } else if (arg.rfind("--output=", 0) == 0) {
+            outputPath = arg.substr(9);
+        } else if (arg.rfind("--iterations=", 0) == 0) {
+            iterations = std::max(1, std::atoi(arg.c_str() + 13));
+        } else if (arg == "--quick") {
+            quick = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--corpus=DIR] [--output=FILE] [--iterations=N] [--quick]" << std::endl;
+            return 1;
+        }
+    }
+
+    // 无窗口系统、无GPU：dummy视频驱动和软件渲染器，结果只反映CPU路径
+    setenv("SDL_VIDEODRIVER", "dummy", 1);
+    SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+    // 缩略图缓存放在图片集目录下，不读写用户的缓存
+    setenv("XDG_CACHE_HOME", (corpusDir + "/cache").c_str(), 1);
+
+    // 查看器的日志输出到标准错误，标准输出只有JSON
+    std::streambuf* stdoutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+
+    int status = 0;
+    {
+        ImageViewer viewer;
+        if (!viewer.Initialize(1280, 800)) {
+            std::cerr << "Failed to initialize Image Viewer" << std::endl;
+            std::cout.rdbuf(stdoutBuffer);
+            return 1;
+        }
+
+        Corpus corpus;
+        std::vector<Corpus::Size> sizes = quick ? std::vector<Corpus::Size>{{320, 240}, {1280, 720}}
+                                                : std::vector<Corpus::Size>{{640, 480}, {1920, 1080}, {4000, 3000}};
+        Corpus::Size pageSize = quick ? Corpus::Size{800, 600} : Corpus::Size{1600, 1200};
+        if (!corpus.Generate(corpusDir, sizes, pageSize, quick ? 6 : 24)) {
+            std::cerr << "Failed to generate corpus in " << corpusDir << std::endl;
+            status = 1;
+        } else {
+            ImageViewerBench bench(viewer, iterations);
+            for (const Corpus::File& file : corpus.GetFiles()) {
+                std::cerr << "Benchmarking " << file.path << std::endl;
+                if (file.format == "zip" || file.format == "tar.gz") {
+                    bench.RunArchive(file);
+                    bench.RunArchivePreload(file);
+                } else {
+                    bench.RunImage(file);
+                    bench.RunProgressive(file);
+                    bench.RunSignature(file);
+                }
+            }
+            bench.RunBatchRead(corpus.GetFiles());
+            bench.RunResampler();
+            bench.RunClusters();
+
+            if (outputPath.empty()) {
+                std::ostream out(stdoutBuffer);
+                bench.WriteJson(out, corpus);
+            } else {
+                std::ofstream out(outputPath);
+                bench.WriteJson(out, corpus);
+                if (!out) {
+                    std::cerr << "Unable to write " << outputPath << std::endl;
+                    status = 1;
+                }
+            }
+            // SIMD与标量不一致、24MP加速不足或重复组分错时以非零状态退出，CI据此判定失败
+            if (!bench.Passed()) {
+                std::cerr << "Correctness checks failed" << std::endl;
+                status = 1;
+            }
+        }
+        viewer.Cleanup();
+    }
+    std::cout.rdbuf(stdoutBuffer);
+    return status;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ArchiveReader.h"
+#include "DecodedImage.h"
+#include "JobScheduler.h"
+#include "MappedFile.h"
+
+// 固实压缩包（7z、RAR、tar.gz等只能从头顺序解压）的预加载流水线：一个线程按存储顺序解压条目，
+// 字节放入有界队列；JobScheduler的线程上并行解码；UI线程按存储顺序取出结果上传。
+// 单独读取一页需要解压它之前的所有数据，逐页读取的总开销是平方级的
+class ArchivePipeline {
+public:
+    // 在工作线程上调用，entry是ArchiveReader::GetEntries()中的序号，失败返回空
+    using DecodeFunc = std::function<std::unique_ptr<DecodedImage>(int entry, std::unique_ptr<MappedFile> contents)>;
+
+    struct Options {
+        int maxJobs = 2;                        // 同时解码的页数
+        size_t queueBytes = 64 * 1024 * 1024;   // 已解压、等待解码的字节上限
+        int resultCapacity = 8;                 // 已解码、等待上传的图片上限
+        int ahead = 24;                         // 最多解压到当前页之后的页数
+    };
+
+    ArchivePipeline();
+    ~ArchivePipeline();
+
+    // 开始解压reader的所有图片条目，有结果可取时推送wakeEventType
+    bool Start(std::shared_ptr<const ArchiveReader> reader, DecodeFunc decode, const Options& options, Uint32 wakeEventType);
+    void Stop();
+    bool IsRunning() const { return readerThread.joinable(); }   // 只在UI线程调用
+
+    // 按存储顺序取出下一个结果；下一个还没解码完时返回false。image为空表示该条目解码失败
+    bool TakeNext(int* entry, std::unique_ptr<DecodedImage>* image);
+
+    // 当前显示的页，解压进度随之推进
+    void SetCurrent(int entry);
+
+    // 流水线稍后会产出该条目
+    bool WillProduce(int entry);
+
+    // 等待该条目解码完成并取出；存储顺序在它之前、尚未取出的结果被丢弃。不会产出时返回空
+    std::unique_ptr<DecodedImage> WaitFor(int entry);
+
+    // 所有条目都已产出并取出
+    bool IsFinished();
+
+    // 禁用拷贝构造和赋值
+    ArchivePipeline(const ArchivePipeline&) = delete;
+    ArchivePipeline& operator=(const ArchivePipeline&) = delete;
+
+private:
+    struct Task {
+        int sequence;
+        std::vector<unsigned char> data;
+    };
+
+    struct Result {
+        int entry;
+        std::unique_ptr<DecodedImage> image;
+    };
+
+    void ReaderLoop();
+    void ReadEntries();                 // 在读取线程上按存储顺序解压所有条目
+    void RunJob();                      // 解码队列中的第一页
+    void SubmitJobsLocked();
+    bool CanDecodeLocked() const;       // 队首的页可以解码：结果有空位，或正是UI线程下一个要取的
+    bool ExhaustedLocked() const;       // 已经不会再有新的结果
+
+    std::shared_ptr<const ArchiveReader> reader;
+    DecodeFunc decodeFunc;
+    Options options;
+    Uint32 wakeEventType = (Uint32)-1;
+    std::thread readerThread;
+    CancelToken jobToken;               // Stop时取消排队的解码任务
+    int queuedJobs = 0;                 // 已提交给JobScheduler、尚未开始的任务数
+
+    std::vector<int> order;             // 存储顺序 -> 条目序号
+    std::vector<int> sequenceOf;        // 条目序号 -> 存储顺序
+
+    std::mutex mutex;
+    bool running = false;
+    std::condition_variable readerWake;     // 队列有空位、进度推进或停止
+    std::condition_variable resultWake;     // 有新结果或停止
+    bool stopping = false;
+    bool readerDone = false;
+    std::deque<Task> tasks;
+    size_t queuedBytes = 0;
+    int decoding = 0;                   // 已从队列取出、结果尚未放入的任务数
+    int limitSequence = 0;              // 读取线程最多解压到该存储顺序
+    int nextSequence = 0;               // UI线程下一个要取的存储顺序，之前的结果不再需要
+    std::map<int, Result> results;      // 存储顺序 -> 已解码的结果
+};
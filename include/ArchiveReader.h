@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct archive;
+
+// 压缩包条目索引
+struct ArchiveEntryInfo {
+    std::string name;
+    int64_t offset = -1;          // 条目头在压缩包中的偏移，未知为-1
+    int64_t compressedSize = -1;  // 压缩后大小，未知为-1
+    int64_t size = -1;            // 解压后大小，未知为-1
+    int headerIndex = 0;          // 在压缩包中的原始顺序，顺序读取时使用
+    bool stored = false;          // ZIP未压缩条目，可直接按偏移读取原始字节
+};
+
+// 随机访问压缩包读取器：打开时只建立一次条目索引，不解压数据，并把压缩包映射到内存；
+// ZIP和未压缩的tar按偏移单独读取一个条目，其余格式回退为顺序跳转
+class ArchiveReader {
+public:
+    ArchiveReader();
+    ~ArchiveReader();
+
+    // 建立索引
+    bool Open(const std::string& path);
+
+    const std::string& GetPath() const { return archivePath; }
+
+    // 按自然排序排列的图片条目
+    const std::vector<ArchiveEntryInfo>& GetEntries() const { return entries; }
+
+    // 是否支持按偏移随机读取
+    bool IsSeekable() const { return seekable; }
+
+    // 创建一个已定位到条目数据的libarchive读取器，调用方用archive_read_free释放。
+    // 每次调用使用独立的读取器，可在工作线程并发调用
+    struct archive* OpenEntryReader(int index) const;
+
+    // 从第一个条目头开始顺序读取整个压缩包的读取器，headerIndex按archive_read_next_header的顺序计数；
+    // 固实压缩包一次解压所有条目时使用。调用方用archive_read_free释放
+    struct archive* OpenStream() const;
+
+    // ZIP未压缩条目直接返回映射内存中的原始字节，无需解压和拷贝
+    bool GetStoredData(int index, const char** data, size_t* size) const;
+
+    // 在body中读取映射（包括上面返回的读取器和原始字节）；压缩包被截断时返回false，之后的读取改为读文件
+    bool Guard(const std::function<void()>& body) const;
+    bool IsTruncated() const { return truncated; }
+
+    // 是否为支持的图片扩展名（不区分大小写）
+    static bool IsImageName(const std::string& name);
+
+private:
+    // 禁用拷贝构造和赋值
+    ArchiveReader(const ArchiveReader&) = delete;
+    ArchiveReader& operator=(const ArchiveReader&) = delete;
+
+    bool ReadZipCentralDirectory();
+    bool ScanHeaders();
+    bool MapArchive();
+    void UnmapArchive();
+    struct archive* OpenAtOffset(const ArchiveEntryInfo& info) const;
+    struct archive* OpenSequential(const ArchiveEntryInfo& info) const;
+
+    std::string archivePath;
+    std::vector<ArchiveEntryInfo> entries;
+    bool seekable = false;
+    bool isZip = false;
+
+    // 整个压缩包的只读映射，映射失败时为空，读取回退到文件
+    const char* mapping = nullptr;
+    size_t mappingSize = 0;
+    mutable std::atomic<bool> truncated{false};   // 映射中出现过SIGBUS，不再使用
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <memory>
+#include "ArchiveReader.h"
+
+// 把压缩包条目包装为SDL_RWops，解码器直接从libarchive读取器取数据，
+// 不再为每个条目分配完整大小的缓冲区；条目大小未知时同样可用
+class ArchiveStream {
+public:
+    // 打开一个条目，返回的SDL_RWops由调用方关闭（例如IMG_Load_RW(rw, 1)）
+    static SDL_RWops* Open(const std::shared_ptr<const ArchiveReader>& reader, int index);
+};
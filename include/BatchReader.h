@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MappedFile.h"
+
+// 批量异步读取整个文件：预取窗口内的文件一次提交给io_uring，机械硬盘和网络挂载上同时有多个请求，
+// 不再在两次读取之间空闲；内核不支持io_uring或被seccomp禁止时改用线程池并发pread
+class BatchReader {
+public:
+    enum class Backend {
+        Auto,           // 优先io_uring
+        IoUring,
+        ThreadPool
+    };
+
+    struct Request {
+        uint64_t tag;       // 原样传给完成回调
+        std::string path;
+    };
+
+    // 在读取线程上调用；读取失败或文件超过kMaxFileBytes时contents为空，由调用方自己读取
+    using CompletionFunc = std::function<void(uint64_t tag, std::unique_ptr<MappedFile> contents)>;
+
+    // 更大的文件（通常分块显示）不整文件读入内存
+    static const size_t kMaxFileBytes = 64 * 1024 * 1024;
+
+    BatchReader();
+    ~BatchReader();
+
+    // queueDepth：同时进行的读取数。指定IoUring但不可用时返回false
+    bool Start(int queueDepth, CompletionFunc onComplete, Backend backend = Backend::Auto);
+    // 丢弃排队的请求（不回调），等待进行中的读取完成
+    void Stop();
+    bool IsRunning() const { return running; }
+
+    // 追加一批请求，未运行时返回false
+    bool Submit(std::vector<Request> batch);
+    // 丢弃尚未开始的请求（不回调），返回它们的tag
+    std::vector<uint64_t> Cancel();
+
+    Backend GetBackend() const { return activeBackend; }
+    int GetQueueDepth() const { return queueDepth; }
+    static const char* BackendName(Backend backend);
+
+    // 读取统计：读取操作数（短读后的续读各计一次）和字节数
+    uint64_t GetReadCount() const { return readCount; }
+    uint64_t GetBytesRead() const { return bytesRead; }
+
+    // 禁用拷贝构造和赋值
+    BatchReader(const BatchReader&) = delete;
+    BatchReader& operator=(const BatchReader&) = delete;
+
+private:
+    struct Ring;        // io_uring的共享内存映射，定义在BatchReader.cpp
+
+    bool SetupRing(int entries);
+    void UringLoop();
+    void PoolLoop();
+    std::vector<Request> TakeRequests(size_t maxCount, bool wait, bool* stop);
+
+    std::unique_ptr<Ring> ring;
+    int wakeFd = -1;                    // eventfd，新请求到达或Stop时唤醒io_uring线程
+    std::vector<std::thread> threads;
+    CompletionFunc onComplete;
+    Backend activeBackend = Backend::ThreadPool;
+    int queueDepth = 0;
+    std::atomic<bool> running{false};
+
+    std::mutex mutex;
+    std::condition_variable requestsAvailable;
+    std::deque<Request> requests;
+    bool stopping = false;
+
+    std::atomic<uint64_t> readCount{0};
+    std::atomic<uint64_t> bytesRead{0};
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// 可复用的临时缓冲区池，避免每次读取都重新分配堆内存（线程安全）
+class BufferPool {
+public:
+    explicit BufferPool(size_t bufferCapacity, size_t maxPooled = 16);
+
+    // 取出一个已清空、容量至少为bufferCapacity的缓冲区
+    std::vector<char> Acquire();
+
+    // 归还缓冲区，池满时直接释放
+    void Release(std::vector<char>&& buffer);
+
+private:
+    size_t capacity;
+    size_t maxPooled;
+    std::mutex mutex;
+    std::vector<std::vector<char>> buffers;
+};
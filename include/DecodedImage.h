@@ -0,0 +1,25 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <vector>
+
+// 解码结果：levels[0]为原图或缩放IDCT缩小后的表面，之后每层宽高减半（mip金字塔）
+struct DecodedImage {
+    std::vector<SDL_Surface*> levels;
+    SDL_Surface* fitted = nullptr;  // 按适应窗口的尺寸高质量缩小的显示图，无需缩小时为空
+    int width = 0;   // 原图尺寸
+    int height = 0;
+    int baseLevel = 0;  // levels[0]对应的mip层级，JPEG按缩放IDCT缩小解码时大于0
+
+    DecodedImage() = default;
+    ~DecodedImage() {
+        for (SDL_Surface* surface : levels) {
+            SDL_FreeSurface(surface);
+        }
+        SDL_FreeSurface(fitted);
+    }
+
+    // 禁用拷贝构造和赋值
+    DecodedImage(const DecodedImage&) = delete;
+    DecodedImage& operator=(const DecodedImage&) = delete;
+};
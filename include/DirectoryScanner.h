@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 目录扫描：getdents64一次读取一批目录项，子目录和文件头识别由调用线程和JobScheduler的线程并行处理，
+// 按文件头的魔数识别图片格式（不看扩展名），结果按自然顺序排序。
+// 跳过隐藏文件和目录，不跟随指向目录的符号链接
+class DirectoryScanner {
+public:
+    struct Options {
+        bool recursive = true;
+        int threads = 4;            // 参与扫描的线程数，包括调用线程
+        int maxDepth = 32;
+    };
+
+    struct Stats {
+        uint64_t directories = 0;
+        uint64_t entries = 0;       // 读到的目录项总数
+        uint64_t images = 0;
+    };
+
+    // 返回root下图片文件的完整路径：先按所在目录、再按文件名自然排序。root无法打开时返回空
+    static std::vector<std::string> Scan(const std::string& root, const Options& options, Stats* stats = nullptr);
+
+    // 按文件头识别图片格式（"jpeg"、"png"等），不是支持的图片返回nullptr
+    static const char* SniffFormat(const unsigned char* header, size_t size);
+
+    // 读取文件头识别单个文件，供增量更新使用
+    static bool SniffFile(const std::string& path);
+
+    // Scan结果的排序规则：先比较所在目录，再比较文件名
+    static bool CatalogLess(const std::string& a, const std::string& b);
+
+    // 识别所需的文件头长度
+    static const size_t kSniffBytes = 32;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "JobScheduler.h"
+#include "PerceptualHash.h"
+
+// 重复和近似重复图片查找：在JobScheduler的线程上以最低优先级逐张计算感知哈希，全部完成后
+// 用多索引哈希（64位pHash分成5段，各段分别建表）找出pHash汉明距离不超过kPHashThreshold的图片对，
+// 再以dHash确认，按连通分量合并为重复组。比BK树在十万张规模下查询快得多。结果在UI线程上查询
+class DuplicateFinder {
+public:
+    // 在工作线程上调用，计算第index张图片的签名，失败返回false
+    using SignatureFunc = std::function<bool(int index, PerceptualHash::Signature* signature)>;
+    // 在工作线程上调用，提示即将计算第index张，可提前预读文件
+    using ReadaheadFunc = std::function<void(int index)>;
+
+    // pHash按中位数取位，距离总是偶数；多索引哈希只保证找全距离不超过9的
+    static const int kPHashThreshold = 8;
+    static const int kDHashThreshold = 10;
+    static const int kReadahead = 16;       // 预读领先于计算的图片数
+
+    DuplicateFinder();
+    ~DuplicateFinder();
+
+    // 开始新的一遍，停止上一遍并清除其结果；maxJobs：同时计算的图片数
+    void Start(int count, SignatureFunc signature, ReadaheadFunc readahead, int maxJobs);
+    // 目录增删了图片：remap[旧序号]为新序号，-1表示已删除或已修改。已算出的签名沿用，
+    // 只计算新增和修改的图片；新的重复组出来之前，旧的重复组换成新序号继续可用
+    void Update(int count, const std::vector<int>& remap, SignatureFunc signature, ReadaheadFunc readahead, int maxJobs);
+    void Stop();
+
+    // 以下只在UI线程调用
+    bool IsRunning() const { return pass != nullptr && !finished; }
+    int GetClusterCount() const { return (int)clusters.size(); }
+    // 所在重复组（按序号升序），不在任何组中返回nullptr
+    const std::vector<int>* GetCluster(int index) const;
+    // 同组的下一张（循环），没有返回-1
+    int NextInCluster(int index) const;
+    // 下一组的第一张（循环），没有返回-1
+    int NextCluster(int index) const;
+
+    // 由签名求重复组，每组至少两张、按第一张的序号排列；valid为false的签名不参与
+    static std::vector<std::vector<int>> BuildClusters(const std::vector<PerceptualHash::Signature>& signatures,
+                                                       const std::vector<char>& valid);
+
+    // 禁用拷贝构造和赋值
+    DuplicateFinder(const DuplicateFinder&) = delete;
+    DuplicateFinder& operator=(const DuplicateFinder&) = delete;
+
+private:
+    // 一遍计算的共享状态，各任务按原子计数领取todo中的序号
+    struct Pass {
+        int count = 0;
+        SignatureFunc signatureFunc;
+        ReadaheadFunc readaheadFunc;
+        std::vector<PerceptualHash::Signature> signatures;
+        std::vector<char> valid;
+        std::vector<char> done;         // 签名已计算（成功或失败）
+        std::vector<int> todo;          // 需要计算的序号
+        std::atomic<int> next{0};
+        std::atomic<int> remaining{0};
+        std::atomic<int> failed{0};
+        CancelToken token;              // Stop时取消排队的任务和未执行的回调
+        Uint32 startTicks = 0;
+    };
+
+    std::shared_ptr<Pass> CreatePass(int count, SignatureFunc signature, ReadaheadFunc readahead);
+    void Launch(std::shared_ptr<Pass> current, int maxJobs);
+    void RunJob(std::shared_ptr<Pass> current);
+    void Finish(std::shared_ptr<Pass> current);
+    void SetClusters(std::vector<std::vector<int>> groups, int count);
+
+    // 以下只在UI线程访问
+    std::shared_ptr<Pass> pass;
+    bool finished = false;
+    std::vector<std::vector<int>> clusters;
+    std::vector<int> clusterOf;         // 每张图片所在的组，-1表示没有重复
+};
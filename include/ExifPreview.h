@@ -0,0 +1,33 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// JPEG内嵌预览图：EXIF IFD1缩略图（通常160像素）和MPF（APP2）中的大预览图。
+// 只读取SOF之前的标记段和预览图本身，不解码主图
+class ExifPreview {
+public:
+    struct Candidate {
+        uint64_t offset = 0;    // 预览图JPEG流在文件中的偏移
+        uint32_t length = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    struct Info {
+        int width = 0;          // 主图尺寸，取自SOF
+        int height = 0;
+        std::vector<Candidate> candidates;  // 按尺寸从小到大排列
+    };
+
+    // 解析文件开头的APP段，不是JPEG或没有SOF时返回false
+    static bool Probe(const std::string& path, Info* info);
+
+    // 尺寸不小于目标的最小预览图，都不够大时取最大的；没有预览图返回nullptr
+    static const Candidate* Choose(const Info& info, int targetWidth, int targetHeight);
+
+    // 解码预览图，用缩放IDCT缩小到仍不小于目标尺寸，失败返回nullptr
+    static SDL_Surface* Decode(const std::string& path, const Candidate& candidate, int targetWidth, int targetHeight);
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 在offset处读写完整的size字节：短读写时继续，被信号中断时重试。
+// 读到文件末尾或出错返回false
+bool PreadFully(int fd, void* buffer, size_t size, int64_t offset);
+bool PwriteFully(int fd, const void* buffer, size_t size, int64_t offset);
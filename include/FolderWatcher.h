@@ -0,0 +1,74 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 文件夹监视：inotify监听已打开的文件夹及其子目录（与DirectoryScanner一致，跳过隐藏目录），
+// 把新建、删除、重命名和修改合并为变更列表，短暂静默后（持续有事件时最多1秒）推送唤醒事件，由UI线程增量更新目录
+class FolderWatcher {
+public:
+    struct Change {
+        enum class Type {
+            Added,      // 移入，或新目录中已有的文件
+            Removed,    // 删除或移出；directory为true时移除该目录下的所有文件
+            Modified,   // 写入完成（关闭写），可能是新文件
+            Renamed,    // 在监视范围内移动，oldPath为原路径
+            Rescan      // 事件队列溢出，需要重新扫描整个文件夹
+        };
+        Type type;
+        std::string path;
+        std::string oldPath;
+        bool directory = false;
+    };
+
+    FolderWatcher();
+    ~FolderWatcher();
+
+    // 开始监视root，已在监视其他文件夹时先停止；失败返回false
+    bool Start(const std::string& root, Uint32 wakeEventType);
+    void Stop();
+
+    bool HasChanges() const { return changesPending.load(std::memory_order_acquire); }
+
+    // 取出自上次调用以来的变更，按发生顺序排列
+    std::vector<Change> TakeChanges();
+
+    // 禁用拷贝构造和赋值
+    FolderWatcher(const FolderWatcher&) = delete;
+    FolderWatcher& operator=(const FolderWatcher&) = delete;
+
+private:
+    void WatcherLoop();
+    void AddWatchRecursive(const std::string& directory, bool reportFiles, int depth);
+    void RemoveWatches(const std::string& directory);  // 移除directory及其子目录的监视
+    void ReadEvents();
+    void Publish(Change change);
+    void Flush();                           // 未配对的移出视为删除，变更交给UI线程
+
+    int inotifyFd = -1;
+    int stopFd = -1;                        // eventfd，Stop时唤醒监视线程
+    std::thread thread;
+    Uint32 wakeEventType = (Uint32)-1;
+
+    struct WatchedDirectory {
+        std::string path;
+        int depth;
+    };
+
+    // 只在监视线程上访问
+    std::map<int, WatchedDirectory> watches;    // 监视描述符 -> 目录
+    std::map<uint32_t, Change> movedFrom;       // 移出事件的cookie -> 原路径，等待配对的移入
+    std::vector<Change> pending;                // 静默期结束前积累的变更
+    std::chrono::steady_clock::time_point waitingSince;    // pending中第一个变更的时间
+    int maxDepth = 32;
+
+    std::mutex mutex;
+    std::vector<Change> changes;
+    std::atomic<bool> changesPending{false};
+};
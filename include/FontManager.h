@@ -6,6 +6,8 @@
 #include <memory>
 #include <vector>
 #include <fstream>
+#include <cstdint>
+#include <unordered_map>
 
 class FontManager {
 public:
@@ -30,21 +32,24 @@ public:
     // 获取指定大小的字体
     TTF_Font* GetFont(FontSize size = MEDIUM);
     
-    // 渲染文字到表面
+    // 渲染文字到表面（UTF-8）
     SDL_Surface* RenderText(const std::string& text, SDL_Color color, FontSize size = MEDIUM);
     
     // 渲染文字到纹理
     SDL_Texture* RenderTextTexture(SDL_Renderer* renderer, const std::string& text, SDL_Color color, FontSize size = MEDIUM);
     
-    // 计算文字尺寸
+    // 计算文字尺寸（UTF-8），使用缓存的字形宽度和字距，不光栅化
     void GetTextSize(const std::string& text, int* width, int* height, FontSize size = MEDIUM);
     
-    // 渲染文字到指定位置
+    // 渲染文字到指定位置：字形取自图集，整串文字一次批量绘制
     void RenderTextAt(SDL_Renderer* renderer, const std::string& text, int x, int y, SDL_Color color, FontSize size = MEDIUM);
     
     // 渲染居中文字
     void RenderTextCentered(SDL_Renderer* renderer, const std::string& text, SDL_Rect rect, SDL_Color color, FontSize size = MEDIUM);
     
+    // 释放字形图集纹理（必须在销毁渲染器之前调用）
+    void ReleaseTextures();
+    
     // 检查是否成功加载字体
     bool IsInitialized() const { return initialized; }
     
@@ -59,11 +64,58 @@ private:
     // 尝试加载系统字体
     std::string GetSystemFont();
     
+    // 主字体缺少的字形（如中日韩文字）从后备字体中取
+    std::string GetFallbackFont();
+    
     // 加载字体
     bool LoadFonts();
     
+    // 缓存的字形：度量信息和在图集中的位置
+    struct Glyph {
+        TTF_Font* font = nullptr;      // 提供该字形的字体（主字体或后备字体）
+        Uint32 renderCodepoint = 0;    // 实际绘制的码点，缺字时为替换字符
+        int advance = 0;
+        int offsetX = 0;               // 字形位图左边相对笔位置的偏移
+        bool inAtlas = false;          // 已上传（空白字形也算已上传）
+        SDL_Rect atlasRect = {0, 0, 0, 0};
+    };
+    
+    // 每种字体大小一个图集纹理，按行依次排放字形
+    struct GlyphAtlas {
+        SDL_Renderer* renderer = nullptr;
+        SDL_Texture* texture = nullptr;
+        int penX = 0;
+        int penY = 0;
+        int rowHeight = 0;
+        std::unordered_map<Uint32, Glyph> glyphs;
+        std::unordered_map<uint64_t, int> kerning;   // (前一码点 << 32 | 码点) -> 字距调整
+    };
+    
+    struct GlyphQuad {
+        SDL_Rect src;
+        SDL_Rect dst;
+    };
+    
+    int SizeIndex(FontSize size) const;
+    Glyph& GetGlyph(int sizeIndex, Uint32 codepoint);
+    int GetKerning(int sizeIndex, Uint32 previous, const Glyph& previousGlyph, Uint32 codepoint, const Glyph& glyph);
+    bool EnsureAtlas(SDL_Renderer* renderer, GlyphAtlas& atlas);
+    bool UploadGlyph(GlyphAtlas& atlas, Glyph& glyph);
+    void ResetAtlas(GlyphAtlas& atlas);
+    void FlushQuads(SDL_Renderer* renderer, GlyphAtlas& atlas, SDL_Color color);
+    static Uint32 NextCodepoint(const std::string& text, size_t& pos);
+    
     // 字体路径和对象
     std::string fontPath;
+    std::string fallbackPath;
     TTF_Font* fonts[5] = {nullptr}; // 对应5种字体大小
+    TTF_Font* fallbackFonts[5] = {nullptr};
     bool initialized = false;
+    
+    GlyphAtlas atlases[5];
+    // 批量绘制缓冲，跨调用复用，稳定后不再分配
+    std::vector<GlyphQuad> quads;
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+    bool geometrySupported = true;    // SDL_RenderGeometry不可用时逐字形绘制
 };
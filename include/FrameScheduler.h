@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// 帧调度：记录自上一帧以来需要重绘的区域，
+// 两帧之间的多次重绘请求合并为一帧，无损坏时主循环完全阻塞等待事件
+class FrameScheduler {
+public:
+    enum Region : unsigned {
+        kNone = 0,
+        kMenuBar = 1u << 0,     // 菜单栏及展开的下拉菜单
+        kImage = 1u << 1,       // 菜单栏下方的图片区域
+        kAll = kMenuBar | kImage
+    };
+
+    FrameScheduler() = default;
+
+    // 显示器刷新率，用于统计掉帧；不大于0时忽略
+    void SetRefreshRate(int hz);
+    int GetRefreshIntervalMs() const;
+
+    // 标记区域需要重绘，已有待绘制的帧时合并进该帧
+    void Invalidate(unsigned regions);
+
+    bool HasDamage() const { return damage != kNone; }
+
+    // 取出并清空待重绘区域，计为绘制一帧
+    unsigned TakeDamage();
+
+    // 统计
+    uint64_t GetFramesRendered() const { return framesRendered; }
+    uint64_t GetFramesSkipped() const { return framesSkipped; }
+
+    // 禁用拷贝构造和赋值
+    FrameScheduler(const FrameScheduler&) = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    unsigned damage = kNone;
+    Clock::duration refreshInterval = std::chrono::microseconds(16667);
+    Clock::time_point damagedAt;    // 由无损坏变为有损坏的时刻
+    Clock::time_point lastFrameAt;
+    uint64_t framesRendered = 0;
+    uint64_t framesSkipped = 0;     // 有待绘制内容却没有出帧的刷新周期数
+};
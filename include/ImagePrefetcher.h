@@ -0,0 +1,126 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "BatchReader.h"
+#include "DecodedImage.h"
+#include "JobScheduler.h"
+#include "MappedFile.h"
+
+// 邻近图片预取器：根据导航方向和速度，在JobScheduler的线程上提前解码前后几张图片，
+// UI线程只需要把解码好的表面（含mip层级）上传为纹理。
+// 窗口内的文件先由BatchReader整批异步读入内存，读完的图片才交给解码线程
+class ImagePrefetcher {
+public:
+    // 在工作线程上调用的解码函数，失败返回空。contents是已读入的文件内容，为空时自行读取
+    using DecodeFunc = std::function<std::unique_ptr<DecodedImage>(int index, std::unique_ptr<MappedFile> contents)>;
+    // 持锁调用，返回图片的文件路径；不是单独的文件（例如压缩包条目）时返回空
+    using SourceFunc = std::function<std::string(int index)>;
+
+    ImagePrefetcher();
+    ~ImagePrefetcher();
+
+    // 启动/停止预取；maxJobs：同时进行的解码数
+    bool Start(int maxJobs = 2);
+    void Stop();
+
+    // 切换到新的图片目录，丢弃旧目录的预取结果。source不为空时预读窗口内的文件
+    void Reset(int imageCount, DecodeFunc decode, SourceFunc source = nullptr);
+    // 目录增删了图片：remap[旧序号]为新序号，-1表示已删除或已修改。保留其余图片的预取结果和导航状态
+    void Remap(int imageCount, const std::vector<int>& remap, DecodeFunc decode, SourceFunc source = nullptr);
+
+    // 同时进行的文件读取数，0表示不批量读取，解码线程自己读文件，只提示内核预读
+    void SetReadQueueDepth(int depth);
+    const BatchReader& GetReader() const { return reader; }
+
+    // 预取窗口：沿导航方向预取ahead张，反方向预取behind张
+    void SetWindowSize(int ahead, int behind);
+    int GetAheadCount() const { return aheadCount; }
+    int GetBehindCount() const { return behindCount; }
+
+    // 通知当前显示的图片已切换，重新调度预取
+    void OnNavigate(int index);
+
+    // 取出已解码的图片（命中）；未预取时返回空（未命中）
+    std::unique_ptr<DecodedImage> TakeImage(int index);
+
+    // 当前图片先显示预览时，立即在后台解码全图，完成（或失败）后推送唤醒事件
+    void Request(int index);
+    void SetWakeEvent(Uint32 eventType);
+
+    // 不等待正在解码的图片，尚未就绪返回空
+    std::unique_ptr<DecodedImage> TryTakeImage(int index);
+    bool HasImage(int index);
+    bool IsQueued(int index);               // 等待或正在解码
+
+    // 预取统计
+    uint64_t GetHitCount() const { return hitCount; }
+    uint64_t GetMissCount() const { return missCount; }
+
+private:
+    // 禁用拷贝构造和赋值
+    ImagePrefetcher(const ImagePrefetcher&) = delete;
+    ImagePrefetcher& operator=(const ImagePrefetcher&) = delete;
+
+    void RunJob();                     // 解码pending中第一张可以解码的图片
+    void SubmitJobsLocked();
+    void ScheduleLocked(int center);
+    bool InWindowLocked(int index) const;
+    void ClearReadyLocked();
+    void SubmitReadsLocked();
+    std::deque<int>::iterator FindRunnableLocked();
+    void OnFileRead(uint64_t tag, std::unique_ptr<MappedFile> contents);
+    uint64_t MakeTag(int index) const { return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(index); }
+
+    std::mutex mutex;
+    std::condition_variable workDone;
+    bool started = false;
+    bool stopping = false;
+    CancelToken jobToken;              // Stop时取消排队的解码任务
+    int maxJobs = 0;
+    int queuedJobs = 0;                // 已提交给JobScheduler、尚未开始的任务数
+    int activeJobs = 0;
+
+    DecodeFunc decodeFunc;
+    SourceFunc sourceFunc;
+    std::set<int> readaheadIssued;     // 已提示预读的索引，离开窗口后移除
+
+    BatchReader reader;
+    int readQueueDepth = 8;
+    bool batchReads = false;           // reader在运行
+    std::set<int> reading;             // 已提交读取、尚未完成的索引，读完才能解码
+    std::map<int, std::unique_ptr<MappedFile>> loadedFiles; // 已读入、等待解码的文件
+    int imageCount = 0;
+    unsigned generation = 0;           // Reset后递增，丢弃过期的解码结果
+
+    std::deque<int> pending;           // 待解码的索引，按优先级排列
+    std::set<uint64_t> inFlight;       // 正在解码的MakeTag(index)，旧目录的任务不算作新目录的同序号图片
+    std::map<int, std::unique_ptr<DecodedImage>> ready; // 已解码、等待上传的图片
+    int urgentIndex = -1;              // Request的图片，完成时唤醒UI线程
+    Uint32 wakeEventType = (Uint32)-1;
+
+    // 预取窗口
+    int aheadCount = 3;
+    int behindCount = 1;
+    int windowLow = 0;
+    int windowHigh = -1;
+
+    // 导航方向和速度
+    int lastIndex = -1;
+    int direction = 1;
+    Uint32 lastNavigateTicks = 0;
+    float navigateRate = 0.0f;         // 每秒翻页数（指数平滑）
+
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> missCount{0};
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include "DecodedImage.h"
+
+// mip金字塔生成：2x2盒式滤波逐级缩小一半（SSE2加速，其他平台使用标量实现）
+class ImagePyramid {
+public:
+    // 在levels[0]之后追加各级缩小图，直到最长边不超过minSize。
+    // 只支持每像素4字节的格式，其他格式保持只有一层
+    static void Build(DecodedImage& image, int minSize = 512);
+
+    // 生成宽高各减半的新表面，失败返回nullptr
+    static SDL_Surface* Downsample2x(SDL_Surface* source);
+
+    // 按屏幕缩放比例选择层级：该层再缩小不超过一半
+    static int SelectLevel(float scale, int levelCount);
+};
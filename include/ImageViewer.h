@@ -2,16 +2,51 @@
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <vector>
+#include <memory>
 #include "MenuBar.h"
 #include "FontManager.h"
+#include "ImagePrefetcher.h"
+#include "MappedFile.h"
+#include "ArchivePipeline.h"
+#include "TextureCache.h"
+#include "TextureUploader.h"
+#include "JobScheduler.h"
+#include "ArchiveReader.h"
+#include "TiledImage.h"
+#include "FrameScheduler.h"
+#include "ThumbnailGrid.h"
+#include "ThumbnailStore.h"
+#include "SignatureStore.h"
+#include "DuplicateFinder.h"
+#include "FolderWatcher.h"
 
+// 文件头的分块探测结果，UI线程和工作线程都会查询，只读一次文件头。
+// 目录项复制时共享，文件被修改时换成新的目录项
+struct TileProbe {
+    std::once_flag once;
+    bool tileable = false;          // 超大且可按区域解码
+};
+
+// 图片目录项：打开时只记录来源，纹理由TextureCache按需创建
 struct ImageData {
-    SDL_Texture* texture = nullptr;
-    int width = 0;
+    int width = 0;                  // 解码前为0
     int height = 0;
-    std::string path;
+    std::string path;               // 文件路径，或压缩包内的条目名
+    std::string key;                // 纹理缓存中的图片标识
+    std::shared_ptr<const ArchiveReader> archive;  // 所属压缩包（压缩层），文件为空
+    int archiveEntry = -1;          // 压缩包索引中的条目序号
+    int levelCount = 0;             // 已上传的mip层级数，包括未上传的baseLevel个更精细层级
+    int baseLevel = 0;              // 已上传的最精细层级，放大超过该层级时全分辨率重新解码
+    int fittedWidth = 0;            // 已上传的适应窗口显示图尺寸
+    int fittedHeight = 0;
+    bool tiled = false;             // 超出纹理尺寸或内存预算，按图块渲染
+    bool previewActive = false;     // 正在显示内嵌预览或渐进式近似图，全图在后台解码
+    bool loadFailed = false;        // 解码失败后不再重复尝试
+    std::shared_ptr<TileProbe> tileProbe = std::make_shared<TileProbe>();
 };
 
 class ImageViewer {
@@ -22,42 +57,144 @@ public:
     bool Initialize(int width = 800, int height = 600);
     void Run();
     void Cleanup();
+
+    // 预取窗口大小（沿导航方向/反方向的图片数）
+    void SetPrefetchWindow(int ahead, int behind);
+
+    // 纹理缓存预算（MB）
+    void SetTextureCacheBudget(size_t megabytes);
+
+    // 磁盘缩略图缓存上限（MB）
+    void SetThumbnailCacheLimit(size_t megabytes);
+
+    // 预取窗口内文件的批量读取队列深度，0表示不批量读取
+    void SetReadQueueDepth(int depth);
+
+    // 每帧分条上传大纹理的时间预算（毫秒），0表示整张上传
+    void SetUploadBudget(double milliseconds);
+
+    // 时间线追踪的输出文件；recordNow为true时立即开始记录，退出时写出
+    void SetTraceFile(const std::string& path, bool recordNow);
     
 private:
+    friend class ImageViewerBench;  // 基准测试直接驱动加载、上传和绘制各阶段
+
     SDL_Window* window;
     SDL_Renderer* renderer;
     bool isRunning;
     bool isFullscreen;
     bool hasOpenedFile;
-    bool needsRedraw;  // 添加重绘标志
     MenuBar menuBar;
+    FrameScheduler frameScheduler;  // 损坏区域跟踪，空闲时不绘制
+    SDL_Texture* frameTarget = nullptr;  // 保留上一帧内容，只重绘损坏区域
+    int frameTargetWidth = 0, frameTargetHeight = 0;
 
     // 多图相关
-    std::vector<ImageData> images;
+    // 目录：与后台线程共享，增删图片时换成新的vector，不在原地改变结构
+    std::shared_ptr<std::vector<ImageData>> images = std::make_shared<std::vector<ImageData>>();
     int currentImageIndex = -1;
+    ImagePrefetcher prefetcher;   // 解码层：预取线程解码好的表面
+    ArchivePipeline archivePipeline; // 固实压缩包：顺序解压、并行解码，按存储顺序上传
+    ArchivePipeline::Options archivePipelineOptions;
+    TextureCache textureCache;    // 纹理层：按预算LRU淘汰
+    TextureUploader textureUploader; // 大层级分条上传，传完才进入纹理层
+    std::atomic<int> previewIndex{-1};  // 正在后台加载内嵌预览或边读边解码的图片，预取线程跳过它
+    CancelToken previewToken;
+    Uint32 textureFormat = SDL_PIXELFORMAT_ARGB8888; // 渲染器首选纹理格式，预取线程提前转换
+    int maxTextureSize = 16384;   // 渲染器支持的最大纹理边长
+    std::unique_ptr<TiledImage> tiledImage; // 当前超大图片的分块渲染器
+    int tiledIndex = -1;
+    ThumbnailGrid thumbnailGrid;  // 缩略图网格视图
+    ThumbnailStore thumbnailStore; // 磁盘缩略图缓存，重新打开目录时不再解码原图
+    SignatureStore signatureStore; // 感知哈希签名，与缩略图缓存放在一起
+    DuplicateFinder duplicateFinder; // 后台计算已打开文件夹的感知哈希，查找重复图片
+    FolderWatcher folderWatcher;  // 已打开文件夹的变更通知，增量更新目录
+    std::string watchedFolder;
+    bool gridMode = false;
+    bool isDraggingScrollbar = false;
+    std::string traceFile = "image_viewer_trace.json"; // F12停止记录时写出的Chrome trace文件
+    Uint32 wakeEventType = (Uint32)-1;      // 后台线程完成工作时推送的用户事件
+    std::atomic<int> fitAreaWidth{800};     // 图片显示区域，解码线程按它生成适应窗口的显示图
+    std::atomic<int> fitAreaHeight{600};
     float imageScale;
     int imageOffsetX, imageOffsetY;
 
+    // 拖动平移
+    bool isPanning = false;
+    int panStartX = 0, panStartY = 0;
+    int panOriginX = 0, panOriginY = 0;
+
     // 缩放相关
     float scaleFactor;
     int windowWidth, windowHeight;
     int lastWindowWidth, lastWindowHeight;
 
-    void HandleEvents();
-    void Render();
+    void HandleEvents();                          // 取出所有已到达的事件
+    void HandleEvent(const SDL_Event& e);
+    void Render(unsigned damage);
+    bool EnsureFrameTarget();                     // 按输出尺寸(重)建帧纹理，不支持时返回false
     void RenderWelcomeScreen();
     void RenderImage();
     void ToggleFullscreen();
+    void ToggleTrace();                           // F12：开始记录，再按一次写出
     void MinimizeWindow();
     void OnFileOpened(const std::string& filepath);
     void OnFolderOpened(const std::string& folderpath);
     void OnArchiveOpened(const std::string& archivename); // 新增：处理打开归档文件
+    void ApplyFolderChanges();                    // 合并文件夹变更，保留未变图片的纹理和当前位置
 
     // 图片相关方法
-    bool LoadImage(const std::string& imagePath); // 可扩展为批量加载
+    bool LoadImage(const std::string& imagePath); // 添加到目录并立即解码
+    bool EnsureImageLoaded(int index);            // 按需解码并创建纹理
+    SDL_Texture* AcquireTexture(int index, int level = 0); // 纹理层未命中时从解码层或压缩层重新上传
+    SDL_Texture* UploadDecoded(int index, std::unique_ptr<DecodedImage> decoded, int level);
+    int UploadArchiveResults(int maxCount);       // 上传流水线按顺序解码好的页，返回处理的结果数
+    bool ShowPreview(int index);                  // 全图未解码时先在后台加载预览，全图解码后替换
+    // 工作线程上：优先解码JPEG内嵌预览，没有时渐进式JPEG/隔行PNG边读边解码，每遍近似图先显示
+    void RunPreviewJob(const std::string& path, CancelToken token);
+    void FinishPreview(SDL_Surface* surface, int width, int height); // 上传预览并开始解码全图
+    void CancelPreviewLoad();
+    void RefitIfResized(int index, int oldWidth, int oldHeight);
+    bool SwapInFullImage(int index);              // 后台解码完成后替换预览，仍在解码返回false
+    void ShowProgressivePass(SDL_Surface* surface, int width, int height); // 更新近似图的流式纹理
+    void FinishProgressiveLoad(std::unique_ptr<DecodedImage> decoded);
+    void ShowImage(int index);                    // 切换当前图片
+    void StartPrefetch(const std::vector<int>* remap = nullptr); // 目录建好后启动预取和缩略图生成；remap：文件夹变更时旧序号到新序号
+    void ShowGrid(bool show);                     // 切换网格视图/单图视图
+    bool HandleGridKey(SDL_Keycode key);          // 网格视图的键盘导航，已处理返回true
+    int NextDuplicate(int index) const;           // D：同组的下一张，Shift+D：下一组的第一张；没有返回-1
+    SDL_Surface* DecodeThumbnail(const ImageData& item) const; // 可在工作线程调用
+    SDL_Surface* LoadThumbnail(const ImageData& item);          // 先查磁盘缓存，可在工作线程调用
+    SDL_Surface* DecodeReduced(const ImageData& item, int size) const; // 不小于size的缩小解码，可在工作线程调用
+    bool ComputeSignature(const ImageData& item, PerceptualHash::Signature* signature); // 先查签名缓存，可在工作线程调用
+    // 可在工作线程调用。boxWidth/boxHeight不为0时JPEG用缩放IDCT解码，输出仍不小于按比例放入该区域的尺寸；
+    // scaleDenom返回缩小倍数，fullWidth/fullHeight返回原图尺寸；contents不为空时从已读入的文件内容解码
+    SDL_Surface* DecodeSurface(const ImageData& item, int boxWidth = 0, int boxHeight = 0,
+                               int* scaleDenom = nullptr, int* fullWidth = nullptr, int* fullHeight = nullptr,
+                               const MappedFile* contents = nullptr) const;
+    // 从rw解码并关闭它；mapped不为空时rw读取的就是它的内容，JPEG直接交给libjpeg
+    SDL_Surface* DecodeStream(const ImageData& item, SDL_RWops* rw, const MappedFile* mapped, int boxWidth, int boxHeight,
+                              int* scaleDenom, int* fullWidth, int* fullHeight) const;
+    // 解码并生成mip层级；默认只解码到适应窗口所需的分辨率
+    std::unique_ptr<DecodedImage> DecodeImage(const ImageData& item, bool fullResolution = false,
+                                              const MappedFile* contents = nullptr) const;
+    // 由缩小scaleDenom倍解码的表面生成mip层级和适应窗口的显示图，取得surface的所有权；可在工作线程调用
+    std::unique_ptr<DecodedImage> BuildDecodedImage(SDL_Surface* surface, int scaleDenom, int fullWidth, int fullHeight) const;
+    SDL_Surface* ConvertToTextureFormat(SDL_Surface* surface) const; // 失败时返回原表面
+    static std::string LevelKey(const ImageData& item, int level);
+    static std::string FitKey(const ImageData& item);
+    static std::string PreviewKey(const ImageData& item);
+    static float FitScale(int imageWidth, int imageHeight, int areaWidth, int areaHeight);
+    void UpdateFitArea();
+    bool NeedsTiling(int width, int height) const; // 整图纹理放不下或过大
+    bool CanTileFile(const ImageData& item) const; // 超大且可按区域解码的文件，可在工作线程调用
+    bool PrepareTiledImage(int index);            // 超大文件直接建立分块渲染，不整图解码
+    void SetTiledImage(int index, std::unique_ptr<TileSource> source);
+    void ReleaseTiledImage();
     void ClearImage();
     void FitImageToWindow();
     void CenterImage();
+    void ZoomAt(float factor, int x, int y);    // 以(x, y)为中心缩放
     void ClearAllImages(); // 新增：释放所有图片
 
     // 缩放相关方法
@@ -66,5 +203,5 @@ private:
     float GetCurrentScaleFactor() const { return scaleFactor; }
 
     // 节能相关方法
-    void MarkForRedraw() { needsRedraw = true; }
+    void MarkForRedraw(unsigned regions = FrameScheduler::kAll) { frameScheduler.Invalidate(regions); }
 };
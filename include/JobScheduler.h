@@ -0,0 +1,119 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 协作式取消标记，复制后共享同一状态。默认构造的空标记永远不会被取消。
+// 取消只丢弃排队的任务和回调，不会打断正在执行的任务；耗时的任务在自然的间隔（如每几行、每个块）检查IsCancelled()
+class CancelToken {
+public:
+    static CancelToken Create();
+
+    void Cancel() const;
+    bool IsCancelled() const;
+    bool IsValid() const { return state != nullptr; }
+
+private:
+    friend class JobScheduler;
+
+    struct State {
+        std::atomic<bool> cancelled{false};
+        std::atomic<int> running{0};    // 正在执行的任务数，CancelAndWait等待它归零
+    };
+    std::shared_ptr<State> state;
+};
+
+// 所有后台工作共用的固定线程池：每个线程有一组按优先级分开的双端队列，自己从尾部取，
+// 空闲线程从其他线程的头部窃取。高优先级的任务总是先于低优先级执行，已取消的任务出队时直接丢弃。
+// 完成回调交给主线程，每帧执行一次
+class JobScheduler {
+public:
+    // 从高到低
+    enum class Priority {
+        Visible,        // 当前显示的图片、图块和用户操作
+        Prefetch,       // 邻近图片
+        Thumbnail,      // 缩略图
+        Indexing        // 目录扫描、重复图片查找
+    };
+    static const int kPriorityCount = 4;
+
+    using Job = std::function<void()>;
+
+    // 单例模式
+    static JobScheduler& GetInstance();
+
+    // wakeEventType：有完成回调待执行时推送的SDL用户事件
+    bool Start(int threadCount, Uint32 wakeEventType = (Uint32)-1);
+    // 丢弃排队的任务和回调，等待正在执行的任务完成
+    void Stop();
+    bool IsRunning() const { return running; }
+    int GetThreadCount() const { return (int)threads.size(); }
+
+    // 未运行时返回false，任务不会执行。在工作线程上提交时放入该线程自己的队列
+    bool Submit(Priority priority, Job job, const CancelToken& token = CancelToken());
+
+    // 取消该标记的所有任务，并等待正在执行的完成；不能在该标记的任务中调用
+    void CancelAndWait(const CancelToken& token);
+
+    // 任何线程都可调用：回调在主线程的DrainCompletions中执行，标记已取消时丢弃
+    void PostToMain(Job completion, const CancelToken& token = CancelToken());
+    // 主线程每帧调用一次，返回执行的回调数
+    int DrainCompletions();
+
+    // 统计
+    uint64_t GetExecutedCount() const { return executedCount; }
+    uint64_t GetStolenCount() const { return stolenCount; }
+    uint64_t GetCancelledCount() const { return cancelledCount; }
+
+    // 禁用拷贝构造和赋值
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+private:
+    JobScheduler() = default;
+    ~JobScheduler();
+
+    struct Entry {
+        Job job;
+        CancelToken token;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Entry> queues[kPriorityCount];
+    };
+
+    void WorkerLoop(int index);
+    bool TakeJob(int self, Entry* entry);
+    void Run(Entry& entry);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<bool> running{false};
+    std::atomic<unsigned> nextWorker{0};            // 外部线程提交时轮流放入各线程的队列
+    std::atomic<int> queuedCount[kPriorityCount] = {};  // 各优先级排队的任务数，跳过空的优先级
+
+    std::mutex sleepMutex;
+    std::condition_variable workAvailable;
+    int queuedTotal = 0;
+    bool stopping = false;
+
+    std::mutex doneMutex;
+    std::condition_variable jobDone;                // 带标记的任务执行完毕
+
+    std::mutex completionMutex;
+    std::vector<Entry> completions;
+    Uint32 wakeEventType = (Uint32)-1;
+
+    std::atomic<uint64_t> executedCount{0};
+    std::atomic<uint64_t> stolenCount{0};
+    std::atomic<uint64_t> cancelledCount{0};
+};
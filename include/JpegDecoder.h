@@ -0,0 +1,34 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <cstddef>
+#include <functional>
+
+struct jpeg_decompress_struct;
+
+// libjpeg-turbo内存解码：输出ARGB8888表面（小端序内存中为BGRA），
+// 缩放IDCT直接输出原图的1/2、1/4、1/8，不解码被丢弃的像素。可在任意线程调用
+class JpegDecoder {
+public:
+    // 读到文件头后按原图尺寸选择缩小倍数
+    using ScaleFunc = std::function<int(int width, int height)>;
+
+    // 解码为原图的1/scaleDenom（1、2、4、8，尺寸向上取整），失败或CMYK返回nullptr
+    static SDL_Surface* Decode(const unsigned char* data, size_t size, int scaleDenom = 1);
+
+    // 同上，缩小倍数由chooseScale决定；width/height返回原图尺寸，scaleDenom返回实际的缩小倍数
+    static SDL_Surface* Decode(const unsigned char* data, size_t size, const ScaleFunc& chooseScale,
+                               int* width, int* height, int* scaleDenom);
+    // 从rw的当前位置按块读取解码，不把整个文件读入内存；返回后rw的位置不确定
+    static SDL_Surface* Decode(SDL_RWops* rw, const ScaleFunc& chooseScale, int* width, int* height, int* scaleDenom);
+
+    // 只读取文件头得到原图尺寸，不是JPEG返回false
+    static bool ReadSize(const unsigned char* data, size_t size, int* width, int* height);
+
+    // 输出仍不小于目标尺寸的最大缩小倍数
+    static int ChooseScale(int width, int height, int targetWidth, int targetHeight);
+
+private:
+    static SDL_Surface* DecodeWith(const std::function<void(jpeg_decompress_struct*)>& setSource,
+                                   const ScaleFunc& chooseScale, int* width, int* height, int* scaleDenom);
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+
+// libjpeg默认出错时退出进程，这里改为跳回调用处：
+// cinfo.err = jpeg_std_error(&error.pub); error.pub.error_exit = JpegErrorExit; 然后setjmp(error.jump)
+struct JpegErrorManager {
+    jpeg_error_mgr pub;
+    std::jmp_buf jump;
+};
+
+// 输出错误信息后longjmp到error.jump
+void JpegErrorExit(j_common_ptr cinfo);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 只读映射整个图片文件，解码器通过SDL_RWFromConstMem直接读取页缓存，省去stdio缓冲的一次拷贝。
+// 映射后提示内核顺序预读；网络文件系统上映射的缺页往返代价高且文件可能被远端截断，改用pread读入内存。
+// 映射的文件被其他程序截断后访问缺失的页会触发SIGBUS，读取映射内存的解码放在Guard中进行
+class MappedFile {
+public:
+    ~MappedFile();
+
+    // 打开失败或超过2GB时设置SDL错误并返回空。allowMap为false时总是读入内存（Guard失败后重读）
+    static std::unique_ptr<MappedFile> Open(const std::string& path, bool allowMap = true);
+
+    // 接管已读入内存的文件内容（BatchReader的异步读取结果）
+    static std::unique_ptr<MappedFile> FromBuffer(std::vector<unsigned char> contents);
+
+    // 提示内核在后台预读文件，不等待；用于即将解码的邻近图片
+    static void WillNeed(const std::string& path);
+
+    const unsigned char* GetData() const { return data; }
+    size_t GetSize() const { return size; }
+    bool IsMapped() const { return mapped; }
+
+    // 返回的SDL_RWops必须在本对象释放前关闭
+    SDL_RWops* OpenStream() const;
+
+    // 执行body，其间本线程访问[data, data + size)触发的SIGBUS不终止进程：缺失的页换成全0的页，
+    // 置位truncated后继续执行。返回false表示映射已被截断（包括此前其他线程发现的），调用方应丢弃结果
+    static bool Guard(const void* data, size_t size, std::atomic<bool>* truncated, const std::function<void()>& body);
+    bool Guard(const std::function<void()>& body) const { return Guard(data, mapped ? size : 0, &truncated, body); }
+
+    // 禁用拷贝构造和赋值
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+    MappedFile() = default;
+
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    mutable std::atomic<bool> truncated{false};
+    std::vector<unsigned char> buffer;  // pread回退或异步读取的文件内容
+};
@@ -5,8 +5,8 @@
 #include <string>
 #include <functional>
 #include <vector>
-#include <future>
 #include "FontManager.h"
+#include "JobScheduler.h"
 
 struct MenuItem {
     SDL_Rect rect;
@@ -41,6 +41,15 @@ public:
     void SetOnFolderOpened(std::function<void(const std::string&)> callback);
     void SetOnArchiveOpened(std::function<void(const std::string&)> callback);
     
+    // 下拉菜单是否展开
+    bool IsDropdownVisible() const { return showDropdown; }
+
+    // 上次调用以来外观是否变化；下拉菜单展开或收起时dropdownToggled为true，其下方的区域也需重绘
+    bool TakeDamage(bool* dropdownToggled);
+
+    // 菜单栏及展开的下拉菜单所占区域
+    SDL_Rect GetBounds() const;
+    
     // 获取菜单栏高度（支持缩放）
     int GetHeight() const { return static_cast<int>(baseMenuHeight * scaleFactor); }
     
@@ -85,6 +94,10 @@ private:
     void DrawText(SDL_Renderer* renderer, const std::string& text, int x, int y, SDL_Color color);
     bool IsPointInRect(int x, int y, const SDL_Rect& rect);
     void UpdateScaledSizes();
+    unsigned VisualState() const;   // 悬停、按下、展开状态的位掩码
+    // 在JobScheduler的线程上运行阻塞的对话框，关闭后在主线程调用OnDialogClosed；提交失败返回false
+    bool RunDialogAsync(std::string (*dialog)(), int code);
+    void OnDialogClosed(int code, const std::string& path);
     
     // 下拉菜单项回调
     void OnOpenFile();
@@ -93,11 +106,10 @@ private:
     
 
     // 异步文件对话框
-    std::future<std::string> openFileFuture;
-    bool openFilePending = false;
-    std::future<std::string> openFolderFuture;
-    bool openFolderPending = false;
-    std::future<std::string> openArchiveFuture;
-    bool openArchivePending = false;
     bool isOpening = false;
+    CancelToken dialogToken = CancelToken::Create();  // 菜单栏销毁后丢弃对话框的结果
+
+    // 外观变化跟踪
+    unsigned drawnState = 0;
+    bool drawnDropdown = false;
 };
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <string>
+
+// 自然排序比较："page2" 排在 "page10" 之前，字母不区分大小写
+bool NaturalLess(const std::string& a, const std::string& b);
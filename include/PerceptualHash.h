@@ -0,0 +1,26 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include "Resampler.h"
+
+// 感知哈希：pHash取32x32亮度图DCT的左上8x8低频系数，与中位数比较得到64位；
+// dHash取9x8亮度图相邻像素的大小关系。两者都对缩放、轻微压缩和调色不敏感，用于查找近似重复的图片。
+// DCT的矩阵乘法按CPU选择AVX2/SSE4.1实现，逐通道按相同顺序累加，结果与标量实现逐位一致
+class PerceptualHash {
+public:
+    struct Signature {
+        uint64_t pHash = 0;
+        uint64_t dHash = 0;
+    };
+
+    static const int kSize = 32;        // DCT输入边长，解码时缩小到不小于它即可
+
+    // 由每像素4字节的表面计算签名，失败返回false。可在任意线程调用
+    static bool Compute(SDL_Surface* surface, Signature* signature);
+
+    // 指定指令集（超出CPU支持时降级），用于与标量实现对比
+    static bool Compute(SDL_Surface* surface, Signature* signature, Resampler::Isa isa);
+
+    static int Distance(uint64_t a, uint64_t b) { return __builtin_popcountll(a ^ b); }
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "JobScheduler.h"
+
+// 渐进式JPEG和Adam7隔行PNG的边读边解码：按块顺序读取文件，每读完一遍扫描（JPEG）或一遍隔行（PNG）
+// 就输出一张完整尺寸的近似图，网络共享上的大文件不必等整个文件读完才有画面。可在任意线程调用
+class ProgressiveDecoder {
+public:
+    enum class Format {
+        None,           // 基线JPEG、非隔行PNG等，整图解码即可
+        Jpeg,           // 渐进式JPEG（SOF2、SOF10）
+        Png             // Adam7隔行PNG（需要libpng）
+    };
+
+    // 两遍输出之间的最短间隔：本地文件数据来得快时跳过中间的输出遍，不增加总耗时
+    static const Uint32 kPassIntervalMs = 50;
+
+    // 每输出一遍近似图调用一次（最后的完整图除外），surface只在回调期间有效；返回false时停止解码
+    using PassFunc = std::function<bool(SDL_Surface* surface, int pass)>;
+
+    // 只读取文件头，得到格式和原图尺寸
+    static Format Probe(const std::string& path, int* width, int* height);
+
+    // 解码为ARGB8888表面，JPEG用缩放IDCT输出1/scaleDenom。相邻两遍输出至少间隔passIntervalMs（0表示每遍都输出）。
+    // 失败或cancel被取消时返回nullptr
+    static SDL_Surface* Decode(const std::string& path, Format format, int scaleDenom, const PassFunc& onPass,
+                               const CancelToken& cancel, Uint32 passIntervalMs = kPassIntervalMs);
+
+private:
+    static SDL_Surface* DecodeJpeg(int fd, int scaleDenom, const PassFunc& onPass, const CancelToken& cancel,
+                                   Uint32 passIntervalMs);
+    static SDL_Surface* DecodePng(int fd, const PassFunc& onPass, const CancelToken& cancel, Uint32 passIntervalMs);
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+
+// 可分离卷积重采样：先水平后垂直两遍，系数为14位定点数。
+// x86上按CPU在运行时选择AVX2/SSE4.1实现，各实现与标量实现的结果逐字节一致
+class Resampler {
+public:
+    enum class Filter {
+        Box,        // 区域平均，最快
+        Mitchell,   // 三次样条（B = C = 1/3），缩略图使用
+        Lanczos3    // 最锐利，适应窗口的显示图使用
+    };
+
+    enum class Isa {
+        Scalar,
+        SSE41,
+        AVX2
+    };
+
+    // 缩放为width x height的新表面，只支持每像素4字节的格式，失败返回nullptr。
+    // 可在任意线程调用
+    static SDL_Surface* Resize(SDL_Surface* source, int width, int height, Filter filter);
+
+    // 指定指令集（超出CPU支持时降级），用于与标量实现对比
+    static SDL_Surface* Resize(SDL_Surface* source, int width, int height, Filter filter, Isa isa);
+
+    // 当前CPU支持的最佳指令集
+    static Isa DetectIsa();
+    static const char* IsaName(Isa isa);
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "PerceptualHash.h"
+#include "ThumbnailStore.h"
+
+// 持久化感知哈希签名，与缩略图缓存放在同一目录：定长记录追加写入signatures.bin，打开时整个读入内存，
+// 同一来源后写的记录覆盖先写的；过期记录过多时打开时重写。新记录攒成一批再写入。键与ThumbnailStore相同，
+// 以来源标识的两个独立哈希查找和校验，来源的大小或修改时间不一致时视为过期。可在多个线程并发调用
+class SignatureStore {
+public:
+    SignatureStore();
+    ~SignatureStore();
+
+    // 打开（必要时创建）缓存目录；失败时Get/Put直接返回
+    bool Open(const std::string& directory);
+    void Close();
+
+    // 命中返回true；未命中或来源已修改返回false
+    bool Get(const ThumbnailStore::Key& key, PerceptualHash::Signature* signature);
+    bool Put(const ThumbnailStore::Key& key, const PerceptualHash::Signature& signature);
+    // 写入积累的记录；Close时自动调用
+    void Flush();
+
+    // 统计
+    uint64_t GetHitCount() const { return hitCount; }
+    uint64_t GetMissCount() const { return missCount; }
+
+    // 禁用拷贝构造和赋值
+    SignatureStore(const SignatureStore&) = delete;
+    SignatureStore& operator=(const SignatureStore&) = delete;
+
+private:
+    struct Record {
+        uint64_t check;                 // 来源标识的第二个哈希，排除键的哈希冲突
+        uint64_t sourceSize;
+        int64_t sourceMtime;
+        PerceptualHash::Signature signature;
+    };
+
+    struct DiskRecord;
+
+    bool RewriteLocked(const std::string& path);
+    bool FlushLocked();
+
+    std::mutex mutex;
+    int fd = -1;
+    uint64_t fileSize = 0;              // 追加写入的位置
+    std::unordered_map<uint64_t, Record> records;   // 以来源标识的哈希为键
+    std::vector<DiskRecord> pending;                // 尚未写入文件的记录
+
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> missCount{0};
+};
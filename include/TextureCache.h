@@ -0,0 +1,74 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// GPU纹理缓存：按图片标识索引，按字节预算做LRU淘汰，
+// 当前图片附近的纹理固定不淘汰
+class TextureCache {
+public:
+    TextureCache();
+    ~TextureCache();
+
+    // 设置显存预算（MB）
+    void SetBudgetMB(size_t megabytes);
+    size_t GetBudgetBytes() const { return budgetBytes; }
+    size_t GetUsedBytes() const { return usedBytes; }
+    size_t GetCount() const { return entries.size(); }
+
+    // 查找纹理并标记为最近使用，未缓存时返回nullptr；每帧都会调用，不计入命中统计
+    SDL_Texture* Get(const std::string& key);
+    bool Contains(const std::string& key) const { return index.count(key) != 0; }
+
+    // 放入纹理，缓存取得所有权；超出预算时淘汰最久未使用的未固定纹理
+    void Put(const std::string& key, SDL_Texture* texture);
+
+    // 释放指定纹理
+    void Remove(const std::string& key);
+
+    // 替换某一组的固定集合（如整图层级、可见图块），任一组固定的纹理都不会被淘汰
+    void SetPinned(const std::vector<std::string>& keys, int group = 0);
+
+    // 释放所有纹理（必须在销毁渲染器之前调用）
+    void Clear();
+
+    // 按宽、高和像素格式计算纹理字节数
+    static size_t TextureBytes(int width, int height, Uint32 format);
+
+    // 统计：每次切换图片记录一次是否已有纹理
+    void RecordLookup(bool hit) { ++(hit ? hitCount : missCount); }
+    uint64_t GetHitCount() const { return hitCount; }
+    uint64_t GetMissCount() const { return missCount; }
+    uint64_t GetEvictionCount() const { return evictionCount; }
+
+private:
+    // 禁用拷贝构造和赋值
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    struct Entry {
+        std::string key;
+        SDL_Texture* texture;
+        size_t bytes;
+    };
+
+    void EvictToBudget();
+    bool IsPinned(const std::string& key) const;
+
+    std::list<Entry> entries; // 表头为最近使用
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    std::unordered_map<int, std::unordered_set<std::string>> pinned;
+
+    size_t budgetBytes = 512u * 1024u * 1024u;
+    size_t usedBytes = 0;
+
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+    uint64_t evictionCount = 0;
+};
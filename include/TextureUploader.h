@@ -0,0 +1,93 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "DecodedImage.h"
+#include "TextureCache.h"
+
+// 大纹理分条上传：一次SDL_CreateTextureFromSurface上传几十MB会让UI停顿一帧以上，
+// 这里每帧在时间预算内用SDL_UpdateTexture把若干行写入常驻的流式中转纹理（按格式和宽度档位各一张），
+// 再在GPU上复制到目标纹理，整张传完才放入TextureCache。缓存中的纹理不是流式纹理，不带CPU端的像素副本。
+// 不支持渲染目标时直接写入流式纹理。取消的上传的纹理保留几张，同尺寸的下一张图片直接复用
+class TextureUploader {
+public:
+    static const size_t kStripBytes = 512 * 1024;       // 每次SDL_UpdateTexture上传的字节数
+    static const size_t kImmediateBytes = 4 * 1024 * 1024; // 不超过它的表面直接整张上传
+
+    TextureUploader();
+    ~TextureUploader();
+
+    // 每帧上传的时间预算（毫秒），0表示不分条，所有表面直接整张上传
+    void SetBudget(double milliseconds) { budgetMs = milliseconds; }
+    double GetBudget() const { return budgetMs; }
+    bool IsEnabled() const { return budgetMs > 0.0; }
+
+    // 为surface排队上传，完成后以key放入缓存；group通常是图片的key，用于整组取消和提前。
+    // owner持有surface直到上传完成。创建纹理失败时返回false
+    bool Enqueue(SDL_Renderer* renderer, const std::string& group, const std::string& key,
+                 std::shared_ptr<DecodedImage> owner, SDL_Surface* surface);
+
+    // 当前图片的上传排到最前
+    void Prioritize(const std::string& group);
+    void Cancel(const std::string& group);
+    bool IsPending(const std::string& group) const;
+    bool HasPending() const { return !uploads.empty(); }
+
+    // 在预算内上传，返回本次完成并放入缓存的纹理数
+    int Pump(TextureCache& cache);
+
+    // 释放所有纹理（必须在销毁渲染器之前调用）；渲染目标内容丢失时也要调用
+    void Clear();
+
+    // 统计
+    uint64_t GetUploadedBytes() const { return uploadedBytes; }
+    uint64_t GetStripCount() const { return stripCount; }
+    uint64_t GetReusedCount() const { return reusedCount; }
+
+    // 禁用拷贝构造和赋值
+    TextureUploader(const TextureUploader&) = delete;
+    TextureUploader& operator=(const TextureUploader&) = delete;
+
+private:
+    static const size_t kMaxSpare = 2;
+    static const size_t kMaxStaging = 4;
+    static const int kMinStagingWidth = 256;
+
+    struct Upload {
+        std::string group;
+        std::string key;
+        std::shared_ptr<DecodedImage> owner;
+        SDL_Surface* surface;
+        SDL_Texture* texture;
+        bool staged;                    // texture是渲染目标，经中转纹理写入
+        int nextRow;
+    };
+
+    // 中转纹理：宽度取不小于表面宽度的2的幂，高度为一条的行数
+    struct Staging {
+        Uint32 format;
+        int width;
+        int height;
+        SDL_Texture* texture;
+    };
+
+    SDL_Texture* AcquireTexture(Uint32 format, int width, int height, bool* staged);
+    void ReleaseTexture(SDL_Texture* texture);
+    const Staging* AcquireStaging(Uint32 format, int width);
+    bool UploadStrip(Upload& upload, int* rows);
+
+    SDL_Renderer* renderer = nullptr;   // Enqueue时记录
+    std::deque<Upload> uploads;
+    std::vector<SDL_Texture*> spare;    // 取消的上传留下的纹理
+    std::vector<Staging> staging;       // 最近使用的在前
+    double budgetMs = 4.0;
+
+    uint64_t uploadedBytes = 0;
+    uint64_t stripCount = 0;
+    uint64_t reusedCount = 0;
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+#include "JobScheduler.h"
+
+// 虚拟化缩略图网格：只遍历可见的格子，缩略图打包进图集纹理，
+// 每页图集一次SDL_RenderGeometry绘制；缩略图在JobScheduler的线程上按视口优先的顺序生成
+class ThumbnailGrid {
+public:
+    // 在工作线程上调用，返回最长边不超过kThumbSize、每像素4字节的表面，失败返回nullptr
+    using ThumbnailFunc = std::function<SDL_Surface*(int index)>;
+
+    static const int kThumbSize = 128;
+    static const int kCellPadding = 8;
+    static const int kScrollbarWidth = 8;
+
+    ThumbnailGrid();
+    ~ThumbnailGrid();
+
+    // 启动/停止生成；maxJobs：同时生成的缩略图数。缩略图完成时推送wakeEvent，上传为pixelFormat格式的图集
+    bool Start(int maxJobs, Uint32 wakeEvent, Uint32 pixelFormat);
+    void Stop();
+
+    // 切换到新的图片目录，丢弃旧目录的缩略图
+    void Reset(int imageCount, ThumbnailFunc func);
+    // 目录增删了图片：remap[旧序号]为新序号，-1表示已删除或已修改。保留滚动位置和其余缩略图
+    void Remap(int imageCount, const std::vector<int>& remap, ThumbnailFunc func);
+
+    // 不在网格视图时停止生成
+    void CancelRequests();
+
+    // 网格占用的屏幕区域
+    void SetViewport(const SDL_Rect& area);
+
+    // 选中项，自动滚动到可见
+    void SetSelected(int index);
+    int GetSelected() const { return selected; }
+    void MoveSelection(int delta) { SetSelected(selected + delta); }
+
+    // 滚动
+    void Scroll(int pixels);
+    void ScrollToFraction(float fraction);      // 拖动滚动条
+    bool HitScrollbar(int x, int y) const;
+
+    // 屏幕坐标下的图片序号，不在格子上返回-1
+    int HitTest(int x, int y) const;
+
+    int GetColumns() const;
+    int GetVisibleRows() const;
+    int GetCellSize() const { return kThumbSize + 2 * kCellPadding; }
+
+    // 上传已完成的缩略图，绘制可见格子并请求缺少的缩略图
+    void Render(SDL_Renderer* renderer);
+
+    // 纹理必须在渲染器之前释放
+    void ReleaseTextures();
+
+    // 统计
+    uint64_t GetGeneratedCount() const { return generatedCount; }
+
+    // 禁用拷贝构造和赋值
+    ThumbnailGrid(const ThumbnailGrid&) = delete;
+    ThumbnailGrid& operator=(const ThumbnailGrid&) = delete;
+
+private:
+    static const int kAtlasSize = 2048;
+    static const int kSlotsPerRow = kAtlasSize / kThumbSize;
+    static const int kSlotsPerPage = kSlotsPerRow * kSlotsPerRow;
+    static const int kMaxAtlasPages = 4;
+
+    // 已上传到图集的缩略图
+    struct Resident {
+        int slot;
+        int width;
+        int height;
+        uint64_t lastUsed;      // 最后绘制的帧序号，淘汰时取最久未用的
+    };
+
+    void RunJob();                      // 生成pending中的第一张缩略图
+    void SubmitJobsLocked();
+    void UploadReady(SDL_Renderer* renderer);
+    int AllocateSlot(SDL_Renderer* renderer);
+    void RequestThumbnails(int first, int last);
+    SDL_Rect CellRect(int index) const;
+    int GetMaxScroll() const;
+    void ClampScroll();
+
+    // 后台生成
+    std::mutex mutex;
+    bool started = false;
+    bool stopping = false;
+    CancelToken jobToken;               // Stop时取消排队的任务
+    int maxJobs = 0;
+    int queuedJobs = 0;                 // 已提交给JobScheduler、尚未开始的任务数
+    Uint32 wakeEventType = (Uint32)-1;
+    Uint32 atlasFormat = SDL_PIXELFORMAT_ARGB8888;
+
+    ThumbnailFunc thumbnailFunc;
+    unsigned generation = 0;            // Reset后递增，丢弃过期的结果
+    std::deque<int> pending;            // 待生成的序号，按优先级排列
+    std::set<int> inFlight;
+    std::map<int, SDL_Surface*> ready;  // 已生成、等待上传
+    std::set<int> failed;
+
+    // 以下只在UI线程访问
+    int imageCount = 0;
+    SDL_Rect viewport = {0, 0, 0, 0};
+    int scrollY = 0;
+    int scrollDirection = 1;
+    int selected = 0;
+    uint64_t frame = 0;
+
+    std::vector<SDL_Texture*> atlasPages;
+    std::vector<int> freeSlots;
+    std::unordered_map<int, Resident> resident;
+
+    std::atomic<uint64_t> generatedCount{0};
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "JobScheduler.h"
+
+// 持久化缩略图缓存：缩略图追加写入包文件，索引是内存映射的开放寻址哈希表。
+// 条目以来源标识（文件路径，或压缩包路径加条目名）为键，同时记录来源的大小和修改时间，
+// 不一致时视为过期；包文件超出上限时在后台按最近访问时间淘汰并压缩。可在多个线程并发调用
+class ThumbnailStore {
+public:
+    // 缩略图来源
+    struct Key {
+        std::string identity;       // 缩略图尺寸、路径（和条目名）
+        uint64_t sourceSize = 0;
+        int64_t sourceMtime = 0;    // 纳秒
+    };
+
+    ThumbnailStore();
+    ~ThumbnailStore();
+
+    // 打开（必要时创建）缓存目录；失败时缓存不可用，Get/Put直接返回
+    bool Open(const std::string& directory);
+    void Close();
+
+    // $XDG_CACHE_HOME/image_viewer，未设置时为~/.cache/image_viewer
+    static std::string DefaultDirectory();
+
+    // 生成缓存键，stat失败返回false
+    static bool MakeFileKey(const std::string& path, int thumbSize, Key* key);
+    static bool MakeArchiveKey(const std::string& archivePath, const std::string& entryName, int thumbSize, Key* key);
+
+    // 包文件大小上限
+    void SetSizeLimit(uint64_t bytes);
+
+    // 命中返回ARGB8888表面；未命中或来源已修改返回nullptr
+    SDL_Surface* Get(const Key& key);
+
+    // 写入每像素4字节的缩略图，不透明时以JPEG压缩保存
+    bool Put(const Key& key, SDL_Surface* thumbnail);
+
+    // 统计
+    uint64_t GetHitCount() const { return hitCount; }
+    uint64_t GetMissCount() const { return missCount; }
+    uint64_t GetStaleCount() const { return staleCount; }
+
+    // 禁用拷贝构造和赋值
+    ThumbnailStore(const ThumbnailStore&) = delete;
+    ThumbnailStore& operator=(const ThumbnailStore&) = delete;
+
+private:
+    struct IndexHeader;
+    struct IndexEntry;
+
+    void CloseLocked();
+    bool InitIndexLocked(uint32_t capacity);
+    bool MapIndexLocked();
+    void UnmapIndexLocked();
+    IndexHeader* Header() const;
+    IndexEntry* Entries() const;
+    IndexEntry* FindLocked(uint64_t hash) const;
+    bool InsertLocked(const IndexEntry& entry);
+    void RemoveLocked(IndexEntry* entry);
+    bool RehashLocked(uint32_t capacity);
+    bool NeedsCompactionLocked(uint64_t incoming) const;
+    // 在线程池上以最低优先级压缩，已在进行时不重复
+    void ScheduleCompactionLocked();
+    void Compact(CancelToken token);
+
+    std::mutex mutex;
+    std::string packPath;
+    int packFd = -1;
+    int indexFd = -1;
+    char* indexMap = nullptr;
+    size_t indexMapSize = 0;
+    uint64_t sizeLimit = 256ull << 20;
+    bool compacting = false;
+    CancelToken compactToken;
+
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> missCount{0};
+    std::atomic<uint64_t> staleCount{0};
+};
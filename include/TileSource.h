@@ -0,0 +1,46 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <memory>
+#include <string>
+#include "DecodedImage.h"
+#include "JobScheduler.h"
+
+// 分块渲染的像素来源：按层级和区域解码，层级L的宽高为原图的1/2^L（向下取整，至少为1）。
+// DecodeRegion会在分块工作线程上并发调用，实现必须线程安全
+class TileSource {
+public:
+    virtual ~TileSource() = default;
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+
+    // 最粗层级的最长边不超过tileSize
+    int GetLevelCount(int tileSize) const;
+    static void LevelSize(int width, int height, int level, int* levelWidth, int* levelHeight);
+
+    // 解码层级level上的区域（层级坐标），返回每像素4字节的表面，失败或被取消返回nullptr
+    virtual SDL_Surface* DecodeRegion(int level, const SDL_Rect& region, const CancelToken& cancel) = 0;
+
+    // 打开可按区域解码的文件（JPEG；编译了libtiff时包括TIFF），不支持的格式返回空
+    static std::unique_ptr<TileSource> OpenFile(const std::string& path);
+
+    // 只读取文件头得到图片尺寸（PNG、JPEG、TIFF）
+    static bool ProbeSize(const std::string& path, int* width, int* height);
+
+protected:
+    int width = 0;
+    int height = 0;
+};
+
+// 已整图解码的图片（如压缩包内的超大图片）：从mip层级中裁剪区域
+class SurfaceTileSource : public TileSource {
+public:
+    // 补齐mip层级，直到最长边不超过tileSize
+    SurfaceTileSource(std::unique_ptr<DecodedImage> image, int tileSize);
+
+    SDL_Surface* DecodeRegion(int level, const SDL_Rect& region, const CancelToken& cancel) override;
+
+private:
+    std::unique_ptr<DecodedImage> image;
+};
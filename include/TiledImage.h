@@ -0,0 +1,71 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "JobScheduler.h"
+#include "TileSource.h"
+#include "TextureCache.h"
+
+// 超大图片的分块渲染：每个层级切成固定大小的图块，只解码和上传与视口相交的图块。
+// 图块在JobScheduler的线程上按区域解码，未就绪的图块先用更粗层级的图块代替；
+// 离开这张图片时排队的解码任务随之取消
+class TiledImage {
+public:
+    static const int kTileSize = 512;
+    static const int kPinGroup = 1;   // 在TextureCache中固定可见图块所用的分组
+
+    // wakeEventType：图块解码完成时推送的SDL用户事件，用于唤醒UI线程重绘；maxJobs：同时解码的图块行数
+    TiledImage(std::unique_ptr<TileSource> source, const std::string& key, Uint32 wakeEventType, int maxJobs = 2);
+    ~TiledImage();
+
+    int GetWidth() const { return source->GetWidth(); }
+    int GetHeight() const { return source->GetHeight(); }
+    int GetLevelCount() const { return levelCount; }
+
+    // 上传已解码的图块并绘制视口内的部分；同时按离视口中心的距离重新排列解码请求
+    void Render(SDL_Renderer* renderer, TextureCache& cache, float scale, int offsetX, int offsetY, const SDL_Rect& viewport);
+
+private:
+    // 禁用拷贝构造和赋值
+    TiledImage(const TiledImage&) = delete;
+    TiledImage& operator=(const TiledImage&) = delete;
+
+    struct TileId {
+        int level;
+        int col;
+        int row;
+    };
+
+    std::string TileKey(const TileId& tile) const;
+    SDL_Rect TileRect(const TileId& tile) const;   // 图块在层级中的像素范围
+    void UploadReady(SDL_Renderer* renderer, TextureCache& cache);
+    bool DrawFallback(SDL_Renderer* renderer, TextureCache& cache, const TileId& tile, const SDL_Rect& dest,
+                      std::vector<std::string>& pinnedKeys);
+    void RequestTiles(const std::vector<TileId>& tiles, const TextureCache& cache);
+    void RunJob();                                 // 解码pending中的第一批图块
+    void SubmitJobsLocked();
+
+    std::unique_ptr<TileSource> source;
+    std::string key;
+    Uint32 wakeEventType;
+    int levelCount;
+
+    std::mutex mutex;
+    bool stopping = false;
+    CancelToken jobToken;
+    int maxJobs;
+    int queuedJobs = 0;                            // 已提交给JobScheduler、尚未开始的任务数
+    int activeJobs = 0;
+
+    std::deque<TileId> pending;                    // 待解码的图块，每帧整体替换
+    std::set<std::string> inFlight;                // 正在解码的图块
+    std::map<std::string, SDL_Surface*> ready;     // 已解码、等待上传的图块
+    std::set<std::string> failed;                  // 解码失败的图块，不再重复请求
+};
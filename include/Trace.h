@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// 时间线追踪：作用域span记录到每个线程自己的环形缓冲区（单写者，无锁），
+// 导出为Chrome trace-event JSON，可在chrome://tracing或Perfetto中查看。
+// 关闭时每个span只有一次原子读
+class Trace {
+public:
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // 给当前线程命名，显示在时间线的线程轨道上
+    static void SetThreadName(const char* name);
+
+    // 写出各线程缓冲区中的事件（每线程保留最近的kCapacity个），失败返回false
+    static bool Export(const std::string& path);
+
+    // 记录一个完整事件；name必须是静态字符串
+    static void Record(const char* name, uint64_t startNs, uint64_t endNs);
+    static uint64_t NowNs();
+
+    static const size_t kCapacity = 1 << 14;
+
+    // 作用域span：构造时开始，析构时结束
+    class Scope {
+    public:
+        explicit Scope(const char* name) : name(name), startNs(IsEnabled() ? NowNs() : 0) {}
+        ~Scope() {
+            if (startNs) {
+                Record(name, startNs, NowNs());
+            }
+        }
+
+        // 禁用拷贝构造和赋值
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        uint64_t startNs;
+    };
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// 追踪当前作用域，name为静态字符串
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
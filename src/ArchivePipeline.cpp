@@ -0,0 +1,303 @@
+#include "ArchivePipeline.h"
+#include <algorithm>
+#include <iostream>
+#include <archive.h>
+#include <archive_entry.h>
+#include "Trace.h"
+
+ArchivePipeline::ArchivePipeline() {
+}
+
+ArchivePipeline::~ArchivePipeline() {
+    Stop();
+}
+
+bool ArchivePipeline::Start(std::shared_ptr<const ArchiveReader> archive, DecodeFunc decode, const Options& pipelineOptions,
+                            Uint32 eventType) {
+    Stop();
+    const std::vector<ArchiveEntryInfo>& entries = archive->GetEntries();
+    // 解码任务在线程池上执行，线程池未运行时结果永远不会产出
+    if (entries.empty() || !JobScheduler::GetInstance().IsRunning()) {
+        return false;
+    }
+    reader = std::move(archive);
+    decodeFunc = std::move(decode);
+    options = pipelineOptions;
+    options.maxJobs = std::max(1, options.maxJobs);
+    options.resultCapacity = std::max(1, options.resultCapacity);
+    wakeEventType = eventType;
+
+    // 条目按自然顺序排列，解压按存储顺序进行
+    std::vector<int> storageOrder(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        storageOrder[i] = (int)i;
+    }
+    std::stable_sort(storageOrder.begin(), storageOrder.end(), [&entries](int a, int b) {
+        return entries[a].headerIndex < entries[b].headerIndex;
+    });
+
+    {
+        // 预取线程可能同时调用WillProduce
+        std::lock_guard<std::mutex> lock(mutex);
+        order = std::move(storageOrder);
+        sequenceOf.assign(order.size(), 0);
+        for (size_t i = 0; i < order.size(); ++i) {
+            sequenceOf[order[i]] = (int)i;
+        }
+        running = true;
+        stopping = false;
+        readerDone = false;
+        tasks.clear();
+        queuedBytes = 0;
+        decoding = 0;
+        limitSequence = options.ahead;
+        nextSequence = 0;
+        results.clear();
+        jobToken = CancelToken::Create();
+        queuedJobs = 0;
+    }
+    readerThread = std::thread(&ArchivePipeline::ReaderLoop, this);
+    std::cout << "Archive pipeline started: " << entries.size() << " entries, " << options.maxJobs << " decode jobs" << std::endl;
+    return true;
+}
+
+void ArchivePipeline::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        running = false;
+    }
+    readerWake.notify_all();
+    resultWake.notify_all();
+    if (readerThread.joinable()) {
+        readerThread.join();
+    }
+    // 排队的解码任务直接丢弃，等正在解码的页完成
+    if (jobToken.IsValid()) {
+        JobScheduler::GetInstance().CancelAndWait(jobToken);
+        jobToken = CancelToken();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    queuedJobs = 0;
+    tasks.clear();
+    queuedBytes = 0;
+    results.clear();
+    reader.reset();
+    decodeFunc = nullptr;
+}
+
+void ArchivePipeline::ReaderLoop() {
+    Trace::SetThreadName("Archive reader");
+    // 映射的压缩包被截断时之后读出的数据不可信，停止产出，已跳过的页由UI线程单独读取
+    if (!reader->Guard([this]() { ReadEntries(); })) {
+        std::cerr << "Archive " << reader->GetPath() << " was truncated while reading" << std::endl;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        readerDone = true;
+    }
+    resultWake.notify_all();
+}
+
+void ArchivePipeline::ReadEntries() {
+    struct archive* a = reader->OpenStream();
+    std::map<int, int> entryByHeader;
+    const std::vector<ArchiveEntryInfo>& entries = reader->GetEntries();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entryByHeader[entries[i].headerIndex] = (int)i;
+    }
+    struct archive_entry* header;
+    int headerIndex = 0;
+    while (a && archive_read_next_header(a, &header) == ARCHIVE_OK) {
+        auto found = entryByHeader.find(headerIndex++);
+        if (found == entryByHeader.end()) {
+            archive_read_data_skip(a);
+            continue;
+        }
+        int sequence = sequenceOf[found->second];
+        bool skip = false;
+        {
+            // 解码跟不上或已超前当前页太多时暂停解压
+            std::unique_lock<std::mutex> lock(mutex);
+            readerWake.wait(lock, [this, sequence]() {
+                return stopping || sequence < nextSequence || (sequence <= limitSequence && queuedBytes < options.queueBytes);
+            });
+            if (stopping) {
+                break;
+            }
+            // UI已跳过该页
+            skip = sequence < nextSequence;
+        }
+        if (skip) {
+            archive_read_data_skip(a);
+            continue;
+        }
+        Task task;
+        task.sequence = sequence;
+        {
+            TRACE_SCOPE("ArchivePipeline::Inflate");
+            if (archive_entry_size_is_set(header) && archive_entry_size(header) > 0) {
+                task.data.reserve(static_cast<size_t>(archive_entry_size(header)));
+            }
+            unsigned char buffer[64 * 1024];
+            la_ssize_t count;
+            while ((count = archive_read_data(a, buffer, sizeof(buffer))) > 0) {
+                task.data.insert(task.data.end(), buffer, buffer + count);
+            }
+            if (count < 0) {
+                std::cerr << "Archive pipeline read error: " << archive_error_string(a) << std::endl;
+                task.data.clear();
+            }
+        }
+        if (reader->IsTruncated()) {
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queuedBytes += task.data.size();
+            tasks.push_back(std::move(task));
+            SubmitJobsLocked();
+        }
+    }
+    if (a) {
+        archive_read_free(a);
+    }
+}
+
+void ArchivePipeline::RunJob() {
+    Task task;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --queuedJobs;
+        if (stopping || !CanDecodeLocked()) {
+            return;
+        }
+        task = std::move(tasks.front());
+        tasks.pop_front();
+        queuedBytes -= task.data.size();
+        ++decoding;
+    }
+    readerWake.notify_one();
+
+    int entry = order[task.sequence];
+    std::unique_ptr<DecodedImage> image;
+    bool wanted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        wanted = !stopping && task.sequence >= nextSequence;
+    }
+    if (wanted && !task.data.empty()) {
+        TRACE_SCOPE("ArchivePipeline::Decode");
+        image = decodeFunc(entry, MappedFile::FromBuffer(std::move(task.data)));
+    }
+
+    bool published = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --decoding;
+        if (!stopping && task.sequence >= nextSequence) {
+            results[task.sequence] = {entry, std::move(image)};
+            published = true;
+        }
+        SubmitJobsLocked();
+    }
+    resultWake.notify_all();
+    if (published && wakeEventType != (Uint32)-1) {
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = wakeEventType;
+        SDL_PushEvent(&event);
+    }
+}
+
+void ArchivePipeline::SubmitJobsLocked() {
+    // 任务不在线程池上等待结果空位：取不到可解码的页就返回，UI线程取走结果后再提交
+    while (!stopping && queuedJobs + decoding < options.maxJobs && queuedJobs < (int)tasks.size() && CanDecodeLocked()) {
+        if (!JobScheduler::GetInstance().Submit(JobScheduler::Priority::Prefetch, [this]() { RunJob(); }, jobToken)) {
+            break;
+        }
+        ++queuedJobs;
+    }
+}
+
+bool ArchivePipeline::CanDecodeLocked() const {
+    // 结果按存储顺序取出：已满时只解码UI线程下一个要取的页（或已跳过的页），避免互相等待
+    return !tasks.empty() &&
+           (tasks.front().sequence <= nextSequence || (int)results.size() + decoding < options.resultCapacity);
+}
+
+bool ArchivePipeline::ExhaustedLocked() const {
+    return readerDone && tasks.empty() && decoding == 0;
+}
+
+bool ArchivePipeline::TakeNext(int* entry, std::unique_ptr<DecodedImage>* image) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = results.find(nextSequence);
+    if (it == results.end()) {
+        // 读取出错时后续条目不会再产出
+        if (ExhaustedLocked() && nextSequence < (int)order.size()) {
+            nextSequence = (int)order.size();
+            results.clear();
+        }
+        return false;
+    }
+    *entry = it->second.entry;
+    *image = std::move(it->second.image);
+    results.erase(it);
+    ++nextSequence;
+    SubmitJobsLocked();
+    readerWake.notify_one();
+    return true;
+}
+
+void ArchivePipeline::SetCurrent(int entry) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running || entry < 0 || entry >= (int)sequenceOf.size()) {
+            return;
+        }
+        limitSequence = std::max(limitSequence, sequenceOf[entry] + options.ahead);
+    }
+    readerWake.notify_one();
+}
+
+bool ArchivePipeline::WillProduce(int entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running || entry < 0 || entry >= (int)sequenceOf.size()) {
+        return false;
+    }
+    return sequenceOf[entry] >= nextSequence && !(ExhaustedLocked() && !results.count(sequenceOf[entry]));
+}
+
+std::unique_ptr<DecodedImage> ArchivePipeline::WaitFor(int entry) {
+    TRACE_SCOPE("ArchivePipeline::WaitFor");
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!running || entry < 0 || entry >= (int)sequenceOf.size() || sequenceOf[entry] < nextSequence) {
+        return nullptr;
+    }
+    int sequence = sequenceOf[entry];
+    // 跳到后面的页：丢弃之前的结果，读取线程直接跳过之前的条目
+    results.erase(results.begin(), results.lower_bound(sequence));
+    nextSequence = sequence;
+    limitSequence = std::max(limitSequence, sequence + options.ahead);
+    SubmitJobsLocked();
+    readerWake.notify_all();
+    resultWake.wait(lock, [this, sequence]() {
+        return stopping || results.count(sequence) || ExhaustedLocked();
+    });
+    auto it = results.find(sequence);
+    if (it == results.end()) {
+        return nullptr;
+    }
+    std::unique_ptr<DecodedImage> image = std::move(it->second.image);
+    results.erase(it);
+    ++nextSequence;
+    SubmitJobsLocked();
+    readerWake.notify_one();
+    return image;
+}
+
+bool ArchivePipeline::IsFinished() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !running || (ExhaustedLocked() && results.empty());
+}
@@ -0,0 +1,371 @@
+#include "ArchiveReader.h"
+#include "NaturalSort.h"
+#include "FileIo.h"
+#include "MappedFile.h"
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <archive.h>
+#include <archive_entry.h>
+
+namespace {
+
+// ZIP结构签名
+const uint32_t kZipLocalHeaderSig = 0x04034b50;
+const uint32_t kZipCentralHeaderSig = 0x02014b50;
+const uint32_t kZipEndOfCentralDirSig = 0x06054b50;
+const uint32_t kZip64LocatorSig = 0x07064b50;
+const uint32_t kZip64EndOfCentralDirSig = 0x06064b50;
+
+uint16_t ReadLE16(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t ReadLE32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t ReadLE64(const unsigned char* p) {
+    return static_cast<uint64_t>(ReadLE32(p)) | (static_cast<uint64_t>(ReadLE32(p + 4)) << 32);
+}
+
+} // namespace
+
+ArchiveReader::ArchiveReader() {
+}
+
+ArchiveReader::~ArchiveReader() {
+    UnmapArchive();
+}
+
+bool ArchiveReader::IsImageName(const std::string& name) {
+    size_t dot = name.find_last_of('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string ext = name.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == "png" || ext == "jpg" || ext == "jpeg" || ext == "bmp" || ext == "tif" || ext == "tiff" || ext == "webp";
+}
+
+bool ArchiveReader::Open(const std::string& path) {
+    UnmapArchive();
+    archivePath = path;
+    entries.clear();
+    seekable = false;
+    isZip = false;
+
+    // ZIP直接读取中央目录，其余格式用libarchive扫描条目头
+    if (!ReadZipCentralDirectory() && !ScanHeaders()) {
+        return false;
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [](const ArchiveEntryInfo& a, const ArchiveEntryInfo& b) {
+        return NaturalLess(a.name, b.name);
+    });
+    MapArchive();
+    std::cout << "Archive indexed: " << entries.size() << " images"
+              << (seekable ? " (random access)" : " (sequential)") << std::endl;
+    return true;
+}
+
+bool ArchiveReader::ReadZipCentralDirectory() {
+    int fd = open(archivePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 22) {
+        close(fd);
+        return false;
+    }
+    int64_t fileSize = st.st_size;
+
+    // 在文件末尾（最多64KB注释）查找中央目录结束记录
+    size_t tailSize = static_cast<size_t>(std::min<int64_t>(fileSize, 65535 + 22));
+    std::vector<unsigned char> tail(tailSize);
+    if (!PreadFully(fd, tail.data(), tailSize, fileSize - tailSize)) {
+        close(fd);
+        return false;
+    }
+    int64_t eocd = -1;
+    for (int64_t i = static_cast<int64_t>(tailSize) - 22; i >= 0; --i) {
+        if (ReadLE32(&tail[i]) == kZipEndOfCentralDirSig) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0) {
+        close(fd);
+        return false;
+    }
+
+    uint64_t totalEntries = ReadLE16(&tail[eocd + 10]);
+    uint64_t cdSize = ReadLE32(&tail[eocd + 12]);
+    uint64_t cdOffset = ReadLE32(&tail[eocd + 16]);
+
+    // 中央目录应在结束记录（ZIP64时为ZIP64结束记录）之前
+    uint64_t cdLimit = static_cast<uint64_t>(fileSize - static_cast<int64_t>(tailSize) + eocd);
+
+    // ZIP64
+    if (totalEntries == 0xFFFF || cdSize == 0xFFFFFFFF || cdOffset == 0xFFFFFFFF) {
+        int64_t eocdPos = fileSize - static_cast<int64_t>(tailSize) + eocd;
+        unsigned char locator[20];
+        unsigned char record[56];
+        if (eocdPos < 20 || !PreadFully(fd, locator, sizeof(locator), eocdPos - 20) ||
+            ReadLE32(locator) != kZip64LocatorSig) {
+            close(fd);
+            return false;
+        }
+        uint64_t recordOffset = ReadLE64(locator + 8);
+        if (eocdPos < 20 + static_cast<int64_t>(sizeof(record)) ||
+            recordOffset > static_cast<uint64_t>(eocdPos - 20) - sizeof(record) ||
+            !PreadFully(fd, record, sizeof(record), static_cast<int64_t>(recordOffset)) ||
+            ReadLE32(record) != kZip64EndOfCentralDirSig) {
+            close(fd);
+            return false;
+        }
+        totalEntries = ReadLE64(record + 32);
+        cdSize = ReadLE64(record + 40);
+        cdOffset = ReadLE64(record + 48);
+        cdLimit = recordOffset;
+    }
+    // 偏移和大小来自文件，分开比较避免相加溢出
+    if (cdOffset > cdLimit || cdSize > cdLimit - cdOffset) {
+        close(fd);
+        return false;
+    }
+
+    std::vector<unsigned char> cd(cdSize);
+    if (!PreadFully(fd, cd.data(), cd.size(), static_cast<int64_t>(cdOffset))) {
+        close(fd);
+        return false;
+    }
+    close(fd);
+
+    // 任何一项解析失败都视为中央目录损坏，交给ScanHeaders从本地文件头重建
+    std::vector<ArchiveEntryInfo> found;
+    size_t pos = 0;
+    for (uint64_t n = 0; n < totalEntries; ++n) {
+        if (pos + 46 > cd.size() || ReadLE32(&cd[pos]) != kZipCentralHeaderSig) {
+            return false;
+        }
+        const unsigned char* h = &cd[pos];
+        uint16_t method = ReadLE16(h + 10);
+        uint16_t flags = ReadLE16(h + 8);
+        uint64_t compressedSize = ReadLE32(h + 20);
+        uint64_t size = ReadLE32(h + 24);
+        uint16_t nameLength = ReadLE16(h + 28);
+        uint16_t extraLength = ReadLE16(h + 30);
+        uint16_t commentLength = ReadLE16(h + 32);
+        uint64_t offset = ReadLE32(h + 42);
+        if (pos + 46 + nameLength + extraLength + commentLength > cd.size()) {
+            return false;
+        }
+        std::string name(reinterpret_cast<const char*>(h + 46), nameLength);
+
+        // ZIP64扩展字段按需依次给出解压大小、压缩大小和偏移
+        const unsigned char* extra = h + 46 + nameLength;
+        for (size_t e = 0; e + 4 <= extraLength;) {
+            uint16_t id = ReadLE16(extra + e);
+            uint16_t length = ReadLE16(extra + e + 2);
+            if (id == 0x0001) {
+                const unsigned char* field = extra + e + 4;
+                const unsigned char* end = field + length;
+                if (size == 0xFFFFFFFF && field + 8 <= end) { size = ReadLE64(field); field += 8; }
+                if (compressedSize == 0xFFFFFFFF && field + 8 <= end) { compressedSize = ReadLE64(field); field += 8; }
+                if (offset == 0xFFFFFFFF && field + 8 <= end) { offset = ReadLE64(field); }
+                break;
+            }
+            e += 4 + length;
+        }
+
+        if (offset >= cdOffset || compressedSize > cdOffset - offset) {
+            return false;
+        }
+        if (!name.empty() && name.back() != '/' && IsImageName(name)) {
+            ArchiveEntryInfo info;
+            info.name = name;
+            info.offset = static_cast<int64_t>(offset);
+            info.compressedSize = static_cast<int64_t>(compressedSize);
+            info.size = static_cast<int64_t>(size);
+            info.headerIndex = static_cast<int>(n);
+            info.stored = (method == 0 && (flags & 0x1) == 0);
+            found.push_back(info);
+        }
+        pos += 46 + nameLength + extraLength + commentLength;
+    }
+
+    entries = std::move(found);
+    isZip = true;
+    seekable = true;
+    return true;
+}
+
+bool ArchiveReader::ScanHeaders() {
+    struct archive* a = archive_read_new();
+    archive_read_support_format_all(a);
+    archive_read_support_filter_all(a);
+    if (archive_read_open_filename(a, archivePath.c_str(), 10240) != ARCHIVE_OK) {
+        std::cerr << "Unable to open archive " << archivePath << ": " << archive_error_string(a) << std::endl;
+        archive_read_free(a);
+        return false;
+    }
+
+    // 只读取条目头，数据部分由libarchive跳过
+    struct archive_entry* entry;
+    int headerIndex = 0;
+    while (archive_read_next_header(a, &entry) == ARCHIVE_OK) {
+        const char* pathname = archive_entry_pathname(entry);
+        if (pathname && archive_entry_filetype(entry) == AE_IFREG && IsImageName(pathname)) {
+            ArchiveEntryInfo info;
+            info.name = pathname;
+            info.offset = archive_read_header_position(a);
+            info.size = archive_entry_size_is_set(entry) ? archive_entry_size(entry) : -1;
+            info.headerIndex = headerIndex;
+            entries.push_back(info);
+        }
+        ++headerIndex;
+        archive_read_data_skip(a);
+    }
+
+    // 未压缩的tar可以按条目头偏移直接定位
+    if ((archive_format(a) & ARCHIVE_FORMAT_BASE_MASK) == ARCHIVE_FORMAT_TAR &&
+        archive_filter_count(a) == 1 && archive_filter_code(a, 0) == ARCHIVE_FILTER_NONE) {
+        seekable = true;
+        for (auto& info : entries) {
+            info.compressedSize = info.size;
+        }
+    }
+    archive_read_free(a);
+    return true;
+}
+
+bool ArchiveReader::MapArchive() {
+    int fd = open(archivePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void* address = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        std::cerr << "Unable to map archive " << archivePath << ", falling back to file reads" << std::endl;
+        return false;
+    }
+    mapping = static_cast<const char*>(address);
+    mappingSize = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void ArchiveReader::UnmapArchive() {
+    if (mapping) {
+        munmap(const_cast<char*>(mapping), mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+}
+
+bool ArchiveReader::GetStoredData(int index, const char** data, size_t* size) const {
+    if (!mapping || truncated || !isZip || index < 0 || index >= (int)entries.size() || !entries[index].stored) {
+        return false;
+    }
+    const ArchiveEntryInfo& info = entries[index];
+    if (info.offset < 0 || static_cast<uint64_t>(info.offset) + 30 > mappingSize) {
+        return false;
+    }
+    // 本地头之后就是原始数据
+    const unsigned char* header = reinterpret_cast<const unsigned char*>(mapping + info.offset);
+    if (ReadLE32(header) != kZipLocalHeaderSig) {
+        return false;
+    }
+    uint64_t dataOffset = static_cast<uint64_t>(info.offset) + 30 + ReadLE16(header + 26) + ReadLE16(header + 28);
+    if (dataOffset + static_cast<uint64_t>(info.compressedSize) > mappingSize) {
+        return false;
+    }
+    *data = mapping + dataOffset;
+    *size = static_cast<size_t>(info.compressedSize);
+    return true;
+}
+
+bool ArchiveReader::Guard(const std::function<void()>& body) const {
+    return MappedFile::Guard(mapping, mappingSize, &truncated, body);
+}
+
+struct archive* ArchiveReader::OpenEntryReader(int index) const {
+    if (index < 0 || index >= (int)entries.size()) {
+        return nullptr;
+    }
+    const ArchiveEntryInfo& info = entries[index];
+    struct archive* a = nullptr;
+    if (seekable && mapping && !truncated && info.offset >= 0) {
+        a = OpenAtOffset(info);
+    }
+    if (!a) {
+        a = OpenSequential(info);
+    }
+    return a;
+}
+
+struct archive* ArchiveReader::OpenAtOffset(const ArchiveEntryInfo& info) const {
+    if (static_cast<uint64_t>(info.offset) >= mappingSize) {
+        return nullptr;
+    }
+    // 从条目头开始以流式格式读取映射内存，第一个条目就是目标
+    struct archive* a = archive_read_new();
+    if (isZip) {
+        archive_read_support_format_zip_streamable(a);
+    } else {
+        archive_read_support_format_tar(a);
+    }
+    struct archive_entry* entry;
+    if (archive_read_open_memory(a, mapping + info.offset, mappingSize - static_cast<size_t>(info.offset)) == ARCHIVE_OK &&
+        archive_read_next_header(a, &entry) == ARCHIVE_OK) {
+        const char* pathname = archive_entry_pathname(entry);
+        if (pathname && info.name == pathname) {
+            return a;
+        }
+    }
+    archive_read_free(a);
+    return nullptr;
+}
+
+struct archive* ArchiveReader::OpenStream() const {
+    struct archive* a = archive_read_new();
+    archive_read_support_format_all(a);
+    archive_read_support_filter_all(a);
+    int result = mapping && !truncated ? archive_read_open_memory(a, mapping, mappingSize)
+                         : archive_read_open_filename(a, archivePath.c_str(), 10240);
+    if (result != ARCHIVE_OK) {
+        std::cerr << "Failed to open archive " << archivePath << ": " << archive_error_string(a) << std::endl;
+        archive_read_free(a);
+        return nullptr;
+    }
+    return a;
+}
+
+struct archive* ArchiveReader::OpenSequential(const ArchiveEntryInfo& info) const {
+    struct archive* a = OpenStream();
+    if (!a) {
+        return nullptr;
+    }
+    struct archive_entry* entry;
+    while (archive_read_next_header(a, &entry) == ARCHIVE_OK) {
+        const char* pathname = archive_entry_pathname(entry);
+        if (pathname && info.name == pathname) {
+            return a;
+        }
+        archive_read_data_skip(a);
+    }
+    archive_read_free(a);
+    return nullptr;
+}
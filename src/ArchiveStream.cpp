@@ -0,0 +1,219 @@
+#include "ArchiveStream.h"
+#include "BufferPool.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <archive.h>
+
+namespace {
+
+// 保留条目开头的字节，满足解码器格式探测后回退到开头的需求
+const size_t kPrefixBytes = 64 * 1024;
+
+BufferPool& PrefixPool() {
+    static BufferPool pool(kPrefixBytes, 32);
+    return pool;
+}
+
+struct StreamState {
+    std::shared_ptr<const ArchiveReader> reader;
+    int index = -1;
+    struct archive* a = nullptr;   // 为空表示数据完全来自映射内存
+    const char* block = nullptr;   // libarchive当前数据块（或映射内存），不拷贝
+    size_t blockSize = 0;
+    int64_t blockStart = 0;        // 当前块在条目中的偏移
+    bool eof = false;
+    int64_t position = 0;
+    int64_t size = -1;             // 条目大小，未知时读到末尾后确定
+    std::vector<char> prefix;      // 条目开头部分的副本，来自缓冲池
+};
+
+StreamState* GetState(SDL_RWops* context) {
+    return static_cast<StreamState*>(context->hidden.unknown.data1);
+}
+
+// 从头重新打开条目（向回跳转超出已保留的开头部分时使用）
+bool Restart(StreamState* state) {
+    if (state->a) {
+        archive_read_free(state->a);
+    }
+    state->a = state->reader->OpenEntryReader(state->index);
+    state->block = nullptr;
+    state->blockSize = 0;
+    state->blockStart = 0;
+    state->eof = (state->a == nullptr);
+    return state->a != nullptr;
+}
+
+// 取下一个数据块，返回false表示已到末尾或出错
+bool NextBlock(StreamState* state) {
+    if (state->eof || !state->a) {
+        return false;
+    }
+    const void* buffer = nullptr;
+    size_t size = 0;
+    la_int64_t offset = 0;
+    int result = archive_read_data_block(state->a, &buffer, &size, &offset);
+    if (result == ARCHIVE_EOF) {
+        state->eof = true;
+        state->size = state->blockStart + static_cast<int64_t>(state->blockSize);
+        return false;
+    }
+    if (result < ARCHIVE_WARN) {
+        std::cerr << "Archive stream error: " << archive_error_string(state->a) << std::endl;
+        state->eof = true;
+        return false;
+    }
+    state->block = static_cast<const char*>(buffer);
+    state->blockSize = size;
+    state->blockStart = offset;
+
+    // 只拷贝开头kPrefixBytes字节，其余数据直接从块读给解码器
+    int64_t kept = static_cast<int64_t>(state->prefix.size());
+    if (kept < static_cast<int64_t>(kPrefixBytes) && offset <= kept && offset + static_cast<int64_t>(size) > kept) {
+        size_t from = static_cast<size_t>(kept - offset);
+        size_t count = std::min(size - from, kPrefixBytes - state->prefix.size());
+        state->prefix.insert(state->prefix.end(), state->block + from, state->block + from + count);
+    }
+    return true;
+}
+
+Sint64 StreamSize(SDL_RWops* context) {
+    return GetState(context)->size;
+}
+
+Sint64 StreamSeek(SDL_RWops* context, Sint64 offset, int whence) {
+    StreamState* state = GetState(context);
+    Sint64 target;
+    switch (whence) {
+        case RW_SEEK_SET:
+            target = offset;
+            break;
+        case RW_SEEK_CUR:
+            target = state->position + offset;
+            break;
+        case RW_SEEK_END:
+            // 大小未知时读到末尾
+            while (state->size < 0 && NextBlock(state)) {
+            }
+            if (state->size < 0) {
+                return SDL_SetError("Archive entry size unknown");
+            }
+            target = state->size + offset;
+            break;
+        default:
+            return SDL_SetError("Unknown seek mode");
+    }
+    if (target < 0) {
+        return SDL_SetError("Seek before start of archive entry");
+    }
+    state->position = target;
+    return target;
+}
+
+size_t StreamRead(SDL_RWops* context, void* ptr, size_t size, size_t maxnum) {
+    StreamState* state = GetState(context);
+    if (size == 0) {
+        return 0;
+    }
+    char* dst = static_cast<char*>(ptr);
+    size_t wanted = size * maxnum;
+    size_t copied = 0;
+    bool restarted = false;
+    while (copied < wanted) {
+        int64_t pos = state->position;
+        const char* src = nullptr;
+        size_t available = 0;
+        if (pos < static_cast<int64_t>(state->prefix.size())) {
+            src = state->prefix.data() + pos;
+            available = state->prefix.size() - static_cast<size_t>(pos);
+        } else if (state->block && pos >= state->blockStart && pos < state->blockStart + static_cast<int64_t>(state->blockSize)) {
+            src = state->block + (pos - state->blockStart);
+            available = static_cast<size_t>(state->blockStart + static_cast<int64_t>(state->blockSize) - pos);
+        } else if (state->block && pos < state->blockStart) {
+            // 已经流过的数据，只能重新解压
+            if (restarted || !Restart(state)) {
+                break;
+            }
+            restarted = true;
+            continue;
+        } else {
+            if (!NextBlock(state)) {
+                break;
+            }
+            continue;
+        }
+        size_t count = std::min(available, wanted - copied);
+        std::memcpy(dst + copied, src, count);
+        copied += count;
+        state->position += static_cast<int64_t>(count);
+    }
+    return copied / size;
+}
+
+size_t StreamWrite(SDL_RWops*, const void*, size_t, size_t) {
+    SDL_SetError("Archive stream is read-only");
+    return 0;
+}
+
+int StreamClose(SDL_RWops* context) {
+    if (context) {
+        StreamState* state = GetState(context);
+        if (state->a) {
+            archive_read_free(state->a);
+        }
+        PrefixPool().Release(std::move(state->prefix));
+        delete state;
+        SDL_FreeRW(context);
+    }
+    return 0;
+}
+
+} // namespace
+
+SDL_RWops* ArchiveStream::Open(const std::shared_ptr<const ArchiveReader>& reader, int index) {
+    if (!reader || index < 0 || index >= (int)reader->GetEntries().size()) {
+        return nullptr;
+    }
+
+    StreamState* state = new StreamState();
+    state->reader = reader;
+    state->index = index;
+    state->size = reader->GetEntries()[index].size;
+
+    // ZIP未压缩条目直接读取映射内存；其余条目由libarchive逐块解压
+    const char* data = nullptr;
+    size_t dataSize = 0;
+    if (reader->GetStoredData(index, &data, &dataSize)) {
+        state->block = data;
+        state->blockSize = dataSize;
+        state->size = static_cast<int64_t>(dataSize);
+        state->eof = true;
+    } else {
+        state->prefix = PrefixPool().Acquire();
+        if (!Restart(state)) {
+            std::cerr << "Unable to open archive entry " << reader->GetEntries()[index].name << std::endl;
+            PrefixPool().Release(std::move(state->prefix));
+            delete state;
+            return nullptr;
+        }
+    }
+
+    SDL_RWops* rw = SDL_AllocRW();
+    if (!rw) {
+        if (state->a) {
+            archive_read_free(state->a);
+        }
+        PrefixPool().Release(std::move(state->prefix));
+        delete state;
+        return nullptr;
+    }
+    rw->size = StreamSize;
+    rw->seek = StreamSeek;
+    rw->read = StreamRead;
+    rw->write = StreamWrite;
+    rw->close = StreamClose;
+    rw->type = SDL_RWOPS_UNKNOWN;
+    rw->hidden.unknown.data1 = state;
+    return rw;
+}
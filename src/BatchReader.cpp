@@ -0,0 +1,444 @@
+#include "BatchReader.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "Trace.h"
+
+// 直接使用系统调用，不依赖liburing；内核头文件过旧时只有线程池
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define BATCH_READER_HAVE_URING 1
+#endif
+
+namespace {
+
+const int kMaxQueueDepth = 64;
+const uint64_t kWakeTag = ~0ull;
+
+// 打开要整文件读取的普通文件，过大、为空或无法打开返回false
+bool OpenForRead(const std::string& path, int* fd, size_t* size) {
+    *fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (*fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(*fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        static_cast<uint64_t>(st.st_size) > BatchReader::kMaxFileBytes) {
+        close(*fd);
+        *fd = -1;
+        return false;
+    }
+    *size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+// 进行中的一个文件读取
+struct ReadSlot {
+    uint64_t tag = 0;
+    int fd = -1;
+    std::vector<unsigned char> buffer;
+    size_t done = 0;
+    struct iovec iov = {};
+    bool used = false;
+};
+
+} // namespace
+
+#ifdef BATCH_READER_HAVE_URING
+
+struct BatchReader::Ring {
+    int fd = -1;
+    void* sqMemory = MAP_FAILED;
+    size_t sqMemorySize = 0;
+    void* cqMemory = MAP_FAILED;        // 内核支持单次映射时与sqMemory相同，不单独释放
+    size_t cqMemorySize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    ~Ring() {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqesSize);
+        }
+        if (cqMemory != MAP_FAILED && cqMemory != sqMemory) {
+            munmap(cqMemory, cqMemorySize);
+        }
+        if (sqMemory != MAP_FAILED) {
+            munmap(sqMemory, sqMemorySize);
+        }
+        // 关闭时内核取消并等待仍在进行的请求
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    // 只有读取线程提交，提交队列有空位由调用方保证（每个槽最多一个请求）
+    void Push(const io_uring_sqe& sqe) {
+        unsigned tail = *sqTail;
+        unsigned index = tail & *sqMask;
+        sqes[index] = sqe;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    }
+};
+
+bool BatchReader::SetupRing(int entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+        return false;
+    }
+    ring.reset(new Ring());
+    ring->fd = fd;
+    ring->sqMemorySize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqMemorySize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap) {
+        ring->sqMemorySize = ring->cqMemorySize = std::max(ring->sqMemorySize, ring->cqMemorySize);
+    }
+    ring->sqMemory = mmap(nullptr, ring->sqMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sqMemory == MAP_FAILED) {
+        ring.reset();
+        return false;
+    }
+    ring->cqMemory = singleMap ? ring->sqMemory
+                               : mmap(nullptr, ring->cqMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = static_cast<io_uring_sqe*>(mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (ring->cqMemory == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        ring.reset();
+        return false;
+    }
+    char* sq = static_cast<char*>(ring->sqMemory);
+    char* cq = static_cast<char*>(ring->cqMemory);
+    ring->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+}
+
+void BatchReader::UringLoop() {
+    Trace::SetThreadName("Batch reader");
+    std::vector<ReadSlot> slots(static_cast<size_t>(queueDepth));
+    int inFlight = 0;
+    unsigned toSubmit = 0;
+    bool wakeArmed = false;
+    bool stop = false;
+
+    auto queueRead = [&](size_t slotIndex) {
+        ReadSlot& slot = slots[slotIndex];
+        slot.iov.iov_base = slot.buffer.data() + slot.done;
+        slot.iov.iov_len = slot.buffer.size() - slot.done;
+        io_uring_sqe sqe;
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READV;
+        sqe.fd = slot.fd;
+        sqe.addr = reinterpret_cast<uint64_t>(&slot.iov);
+        sqe.len = 1;
+        sqe.off = slot.done;
+        sqe.user_data = slotIndex;
+        ring->Push(sqe);
+        ++toSubmit;
+    };
+    auto finish = [&](ReadSlot& slot, bool ok) {
+        close(slot.fd);
+        slot.fd = -1;
+        slot.used = false;
+        --inFlight;
+        std::unique_ptr<MappedFile> contents = ok ? MappedFile::FromBuffer(std::move(slot.buffer)) : nullptr;
+        slot.buffer = std::vector<unsigned char>();
+        onComplete(slot.tag, std::move(contents));
+    };
+
+    while (true) {
+        if (!wakeArmed && !stop) {
+            // 在eventfd上挂一个poll请求，新请求到达时与读取完成一样从io_uring_enter返回
+            io_uring_sqe sqe;
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_POLL_ADD;
+            sqe.fd = wakeFd;
+            sqe.poll_events = POLLIN;
+            sqe.user_data = kWakeTag;
+            ring->Push(sqe);
+            ++toSubmit;
+            wakeArmed = true;
+        }
+        if (!stop) {
+            // 取出新请求填满队列，整批一次提交
+            std::vector<Request> started = TakeRequests(static_cast<size_t>(queueDepth - inFlight), false, &stop);
+            for (Request& request : started) {
+                int fd;
+                size_t size;
+                if (!OpenForRead(request.path, &fd, &size)) {
+                    onComplete(request.tag, nullptr);
+                    continue;
+                }
+                size_t slotIndex = 0;
+                while (slots[slotIndex].used) {
+                    ++slotIndex;
+                }
+                ReadSlot& slot = slots[slotIndex];
+                slot.tag = request.tag;
+                slot.fd = fd;
+                slot.buffer.resize(size);
+                slot.done = 0;
+                slot.used = true;
+                ++inFlight;
+                queueRead(slotIndex);
+            }
+        }
+        if (stop && inFlight == 0) {
+            break;
+        }
+
+        int submitted = static_cast<int>(syscall(__NR_io_uring_enter, ring->fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+        if (submitted < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            std::cerr << "io_uring_enter failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        toSubmit -= std::min(toSubmit, static_cast<unsigned>(submitted));
+
+        TRACE_SCOPE("BatchReader::Reap");
+        unsigned head = *ring->cqHead;
+        unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = ring->cqes[head & *ring->cqMask];
+            uint64_t userData = cqe.user_data;
+            int result = cqe.res;
+            if (userData == kWakeTag) {
+                uint64_t value;
+                if (read(wakeFd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                    std::cerr << "BatchReader wake read failed: " << std::strerror(errno) << std::endl;
+                }
+                wakeArmed = false;
+                continue;
+            }
+            ReadSlot& slot = slots[static_cast<size_t>(userData)];
+            if (result == -EINTR || result == -EAGAIN) {
+                queueRead(static_cast<size_t>(userData));
+            } else if (result < 0) {
+                finish(slot, false);
+            } else {
+                ++readCount;
+                bytesRead += static_cast<uint64_t>(result);
+                slot.done += static_cast<size_t>(result);
+                if (result == 0) {
+                    // 读取期间文件被截断
+                    slot.buffer.resize(slot.done);
+                    finish(slot, slot.done > 0);
+                } else if (slot.done < slot.buffer.size()) {
+                    queueRead(static_cast<size_t>(userData));
+                } else {
+                    finish(slot, true);
+                }
+            }
+        }
+        __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+    }
+}
+
+#else
+
+struct BatchReader::Ring {};
+
+bool BatchReader::SetupRing(int) {
+    return false;
+}
+
+void BatchReader::UringLoop() {
+}
+
+#endif
+
+BatchReader::BatchReader() {
+}
+
+BatchReader::~BatchReader() {
+    Stop();
+}
+
+const char* BatchReader::BackendName(Backend backend) {
+    switch (backend) {
+        case Backend::IoUring:
+            return "io_uring";
+        case Backend::ThreadPool:
+            return "thread_pool";
+        default:
+            return "auto";
+    }
+}
+
+bool BatchReader::Start(int depth, CompletionFunc callback, Backend backend) {
+    Stop();
+    queueDepth = std::max(1, std::min(kMaxQueueDepth, depth));
+    onComplete = std::move(callback);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = false;
+    }
+    bool uring = false;
+    if (backend != Backend::ThreadPool) {
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        // 提交队列多留一项给唤醒用的poll请求
+        uring = wakeFd >= 0 && SetupRing(queueDepth + 1);
+        if (!uring) {
+            if (wakeFd >= 0) {
+                close(wakeFd);
+                wakeFd = -1;
+            }
+            if (backend == Backend::IoUring) {
+                std::cerr << "io_uring is not available: " << std::strerror(errno) << std::endl;
+                return false;
+            }
+        }
+    }
+    activeBackend = uring ? Backend::IoUring : Backend::ThreadPool;
+    running = true;
+    if (uring) {
+        threads.emplace_back(&BatchReader::UringLoop, this);
+    } else {
+        for (int i = 0; i < queueDepth; ++i) {
+            threads.emplace_back(&BatchReader::PoolLoop, this);
+        }
+    }
+    std::cout << "BatchReader started with " << BackendName(activeBackend) << ", queue depth " << queueDepth << std::endl;
+    return true;
+}
+
+void BatchReader::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        requests.clear();
+    }
+    requestsAvailable.notify_all();
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) {
+            std::cerr << "BatchReader wake failed: " << std::strerror(errno) << std::endl;
+        }
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    ring.reset();
+    if (wakeFd >= 0) {
+        close(wakeFd);
+        wakeFd = -1;
+    }
+    running = false;
+}
+
+bool BatchReader::Submit(std::vector<Request> batch) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running || stopping) {
+            return false;
+        }
+        for (Request& request : batch) {
+            requests.push_back(std::move(request));
+        }
+    }
+    requestsAvailable.notify_all();
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) {
+            std::cerr << "BatchReader wake failed: " << std::strerror(errno) << std::endl;
+        }
+    }
+    return true;
+}
+
+std::vector<uint64_t> BatchReader::Cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<uint64_t> tags;
+    tags.reserve(requests.size());
+    for (const Request& request : requests) {
+        tags.push_back(request.tag);
+    }
+    requests.clear();
+    return tags;
+}
+
+std::vector<BatchReader::Request> BatchReader::TakeRequests(size_t maxCount, bool wait, bool* stop) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (wait) {
+        requestsAvailable.wait(lock, [this]() { return stopping || !requests.empty(); });
+    }
+    *stop = stopping;
+    std::vector<Request> taken;
+    while (!stopping && taken.size() < maxCount && !requests.empty()) {
+        taken.push_back(std::move(requests.front()));
+        requests.pop_front();
+    }
+    return taken;
+}
+
+void BatchReader::PoolLoop() {
+    Trace::SetThreadName("Batch reader");
+    while (true) {
+        bool stop = false;
+        std::vector<Request> taken = TakeRequests(1, true, &stop);
+        if (stop) {
+            return;
+        }
+        if (taken.empty()) {
+            continue;
+        }
+        TRACE_SCOPE("BatchReader::Read");
+        const Request& request = taken.front();
+        int fd;
+        size_t size;
+        if (!OpenForRead(request.path, &fd, &size)) {
+            onComplete(request.tag, nullptr);
+            continue;
+        }
+        std::vector<unsigned char> buffer(size);
+        size_t done = 0;
+        bool ok = true;
+        while (done < size) {
+            ssize_t n = pread(fd, buffer.data() + done, size - done, static_cast<off_t>(done));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                // 读取期间被截断时保留已读部分
+                ok = n == 0 && done > 0;
+                buffer.resize(done);
+                break;
+            }
+            ++readCount;
+            bytesRead += static_cast<uint64_t>(n);
+            done += static_cast<size_t>(n);
+        }
+        close(fd);
+        onComplete(request.tag, ok ? MappedFile::FromBuffer(std::move(buffer)) : nullptr);
+    }
+}
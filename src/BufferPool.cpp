@@ -0,0 +1,31 @@
+#include "BufferPool.h"
+
+BufferPool::BufferPool(size_t bufferCapacity, size_t maxPooled)
+    : capacity(bufferCapacity), maxPooled(maxPooled) {
+}
+
+std::vector<char> BufferPool::Acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!buffers.empty()) {
+            std::vector<char> buffer = std::move(buffers.back());
+            buffers.pop_back();
+            return buffer;
+        }
+    }
+    std::vector<char> buffer;
+    buffer.reserve(capacity);
+    return buffer;
+}
+
+void BufferPool::Release(std::vector<char>&& buffer) {
+    buffer.clear();
+    // 被撑大的缓冲区不回收，防止池长期占用大块内存
+    if (buffer.capacity() < capacity || buffer.capacity() > capacity * 4) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (buffers.size() < maxPooled) {
+        buffers.push_back(std::move(buffer));
+    }
+}
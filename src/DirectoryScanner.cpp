@@ -0,0 +1,288 @@
+#include "DirectoryScanner.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "JobScheduler.h"
+#include "NaturalSort.h"
+#include "Trace.h"
+
+namespace {
+
+// 每次getdents64读取的缓冲区，NFS上一次往返可取回数百个目录项
+const size_t kDirentBufferSize = 256 * 1024;
+// 每个识别任务包含的文件数
+const size_t kSniffBatch = 256;
+
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// 打开的目录，最后一个引用它的任务结束时关闭；子项用openat相对它打开，不重复解析路径
+struct Directory {
+    int fd = -1;
+    std::string path;       // 相对于根目录，根目录为空
+    int depth = 0;
+    ~Directory() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+};
+
+// names为空时列出目录（subdirectory不为空时先相对directory打开该子目录），否则识别这些文件。
+// 子目录在执行时才打开，排队中的任务不占用文件描述符
+struct Task {
+    std::shared_ptr<Directory> directory;
+    std::string subdirectory;
+    std::vector<std::string> names;
+};
+
+struct Result {
+    std::string directory;
+    std::string name;
+};
+
+class ScanState {
+public:
+    ScanState(const std::string& root, const DirectoryScanner::Options& options) : root(root), options(options) {}
+
+    void Push(Task task) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+        ++outstanding;
+        workAvailable.notify_one();
+    }
+
+    void WorkerLoop() {
+        std::vector<Result> found;
+        while (true) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                workAvailable.wait(lock, [this]() { return !tasks.empty() || outstanding == 0; });
+                if (tasks.empty()) {
+                    break;
+                }
+                // 后进先出：深度优先，打开的目录数保持较少
+                task = std::move(tasks.back());
+                tasks.pop_back();
+            }
+            if (task.names.empty()) {
+                List(task);
+            } else {
+                Sniff(task, &found);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--outstanding == 0) {
+                workAvailable.notify_all();
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        results.insert(results.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+    }
+
+    std::vector<Result> results;
+    std::atomic<uint64_t> directories{0};
+    std::atomic<uint64_t> entries{0};
+
+private:
+    void List(const Task& task) {
+        TRACE_SCOPE("DirectoryScanner::List");
+        std::shared_ptr<Directory> directory = task.directory;
+        if (!task.subdirectory.empty()) {
+            int fd = openat(task.directory->fd, task.subdirectory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+            if (fd < 0) {
+                return;
+            }
+            directory = std::make_shared<Directory>();
+            directory->fd = fd;
+            directory->path = task.directory->path.empty() ? task.subdirectory : task.directory->path + "/" + task.subdirectory;
+            directory->depth = task.directory->depth + 1;
+        }
+        directories.fetch_add(1, std::memory_order_relaxed);
+        std::unique_ptr<char[]> buffer(new char[kDirentBufferSize]);
+        std::vector<std::string> files;
+        while (true) {
+            long bytes = syscall(SYS_getdents64, directory->fd, buffer.get(), kDirentBufferSize);
+            if (bytes <= 0) {
+                if (bytes < 0) {
+                    std::cerr << "Unable to read directory " << root << "/" << directory->path << ": " << std::strerror(errno) << std::endl;
+                }
+                break;
+            }
+            for (long offset = 0; offset < bytes;) {
+                const LinuxDirent64* entry = reinterpret_cast<const LinuxDirent64*>(buffer.get() + offset);
+                offset += entry->d_reclen;
+                // 跳过.、..和隐藏项
+                if (entry->d_name[0] == '.') {
+                    continue;
+                }
+                entries.fetch_add(1, std::memory_order_relaxed);
+                unsigned char type = entry->d_type;
+                if (type == DT_UNKNOWN || type == DT_LNK) {
+                    // 部分文件系统不填类型；符号链接按目标分类，但不进入目录
+                    struct stat st;
+                    int flags = type == DT_UNKNOWN ? AT_SYMLINK_NOFOLLOW : 0;
+                    if (fstatat(directory->fd, entry->d_name, &st, flags) != 0) {
+                        continue;
+                    }
+                    type = S_ISREG(st.st_mode) ? DT_REG : (S_ISDIR(st.st_mode) && type == DT_UNKNOWN ? DT_DIR : DT_UNKNOWN);
+                }
+                if (type == DT_REG) {
+                    files.emplace_back(entry->d_name);
+                    if (files.size() == kSniffBatch) {
+                        Push({directory, std::string(), std::move(files)});
+                        files.clear();
+                    }
+                } else if (type == DT_DIR && options.recursive && directory->depth < options.maxDepth) {
+                    Push({directory, entry->d_name, {}});
+                }
+            }
+        }
+        if (!files.empty()) {
+            Push({directory, std::string(), std::move(files)});
+        }
+    }
+
+    void Sniff(const Task& task, std::vector<Result>* found) {
+        TRACE_SCOPE("DirectoryScanner::Sniff");
+        unsigned char header[DirectoryScanner::kSniffBytes];
+        for (const std::string& name : task.names) {
+            int fd = openat(task.directory->fd, name.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+            if (fd < 0) {
+                continue;
+            }
+            ssize_t n = read(fd, header, sizeof(header));
+            close(fd);
+            if (n > 0 && DirectoryScanner::SniffFormat(header, static_cast<size_t>(n))) {
+                found->push_back({task.directory->path, name});
+            }
+        }
+    }
+
+    std::string root;
+    DirectoryScanner::Options options;
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::vector<Task> tasks;
+    int outstanding = 0;    // 已入队或正在执行的任务数，为0时扫描结束
+};
+
+uint32_t ReadLE32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+} // namespace
+
+const char* DirectoryScanner::SniffFormat(const unsigned char* h, size_t size) {
+    if (size >= 3 && h[0] == 0xFF && h[1] == 0xD8 && h[2] == 0xFF) {
+        return "jpeg";
+    }
+    if (size >= 8 && std::memcmp(h, "\x89PNG\r\n\x1a\n", 8) == 0) {
+        return "png";
+    }
+    if (size >= 6 && (std::memcmp(h, "GIF87a", 6) == 0 || std::memcmp(h, "GIF89a", 6) == 0)) {
+        return "gif";
+    }
+    if (size >= 12 && std::memcmp(h, "RIFF", 4) == 0 && std::memcmp(h + 8, "WEBP", 4) == 0) {
+        return "webp";
+    }
+    if (size >= 4 && (std::memcmp(h, "II*\0", 4) == 0 || std::memcmp(h, "MM\0*", 4) == 0 ||
+                      std::memcmp(h, "II+\0", 4) == 0 || std::memcmp(h, "MM\0+", 4) == 0)) {
+        return "tiff";
+    }
+    // "BM"太短，再检查信息头长度
+    if (size >= 18 && h[0] == 'B' && h[1] == 'M') {
+        uint32_t infoSize = ReadLE32(h + 14);
+        if (infoSize == 12 || infoSize == 40 || infoSize == 52 || infoSize == 56 || infoSize == 64 ||
+            infoSize == 108 || infoSize == 124) {
+            return "bmp";
+        }
+    }
+    return nullptr;
+}
+
+bool DirectoryScanner::SniffFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0) {
+        return false;
+    }
+    unsigned char header[kSniffBytes];
+    ssize_t n = read(fd, header, sizeof(header));
+    close(fd);
+    return n > 0 && SniffFormat(header, static_cast<size_t>(n)) != nullptr;
+}
+
+bool DirectoryScanner::CatalogLess(const std::string& a, const std::string& b) {
+    size_t slashA = a.rfind('/');
+    size_t slashB = b.rfind('/');
+    std::string directoryA = slashA == std::string::npos ? std::string() : a.substr(0, slashA);
+    std::string directoryB = slashB == std::string::npos ? std::string() : b.substr(0, slashB);
+    if (directoryA != directoryB) {
+        return NaturalLess(directoryA, directoryB);
+    }
+    return NaturalLess(a.substr(slashA + 1), b.substr(slashB + 1));
+}
+
+std::vector<std::string> DirectoryScanner::Scan(const std::string& root, const Options& options, Stats* stats) {
+    TRACE_SCOPE("DirectoryScanner::Scan");
+    std::vector<std::string> paths;
+    int fd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Unable to open directory " << root << ": " << std::strerror(errno) << std::endl;
+        return paths;
+    }
+    auto directory = std::make_shared<Directory>();
+    directory->fd = fd;
+
+    ScanState state(root, options);
+    state.Push({directory, std::string(), {}});
+    directory.reset();
+    // 调用线程也参与扫描，线程池忙于更高优先级的工作时由它独自完成
+    CancelToken token = CancelToken::Create();
+    int threadCount = std::max(1, options.threads);
+    for (int i = 1; i < threadCount; ++i) {
+        JobScheduler::GetInstance().Submit(JobScheduler::Priority::Indexing, [&state]() { state.WorkerLoop(); }, token);
+    }
+    state.WorkerLoop();
+    // 还没开始的辅助任务不再需要；已开始的在任务队列为空后退出
+    JobScheduler::GetInstance().CancelAndWait(token);
+
+    // 同一目录的文件相邻，目录之间和目录内部都按自然顺序
+    std::vector<Result>& results = state.results;
+    std::sort(results.begin(), results.end(), [](const Result& a, const Result& b) {
+        if (a.directory != b.directory) {
+            return NaturalLess(a.directory, b.directory);
+        }
+        return NaturalLess(a.name, b.name);
+    });
+    std::string prefix = root;
+    if (!prefix.empty() && prefix.back() != '/') {
+        prefix += '/';
+    }
+    paths.reserve(results.size());
+    for (const Result& result : results) {
+        paths.push_back(prefix + (result.directory.empty() ? result.name : result.directory + "/" + result.name));
+    }
+    if (stats) {
+        stats->directories = state.directories.load();
+        stats->entries = state.entries.load();
+        stats->images = paths.size();
+    }
+    return paths;
+}
@@ -0,0 +1,311 @@
+#include "DuplicateFinder.h"
+#include <algorithm>
+#include <iostream>
+#include "Trace.h"
+
+namespace {
+
+// 64位分成5段（最后一段12位），两个哈希相差不超过9位时至少有一段相差不超过1位。
+// 分成4段每段查到差2位能覆盖更大的距离，但每张要查548个桶，十万张时慢两倍多
+const int kChunks = 5;
+const int kChunkBits = (64 + kChunks - 1) / kChunks;
+const int kBuckets = 1 << kChunkBits;
+const int kChunkRadius = 1;
+
+inline int Chunk(uint64_t hash, int chunk) {
+    return static_cast<int>((hash >> (chunk * kChunkBits)) & (kBuckets - 1));
+}
+
+// 一段中至多kChunkRadius位为1的所有掩码（含0）
+const std::vector<int>& ProbeMasks() {
+    static const std::vector<int> masks = []() {
+        std::vector<int> result;
+        for (int mask = 0; mask < kBuckets; ++mask) {
+            if (__builtin_popcount(mask) <= kChunkRadius) {
+                result.push_back(mask);
+            }
+        }
+        return result;
+    }();
+    return masks;
+}
+
+// 桶内条目带上pHash，筛选时不必按序号回查签名
+struct BucketEntry {
+    uint64_t pHash;
+    int index;
+};
+
+int FindRoot(std::vector<int>& parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+} // namespace
+
+DuplicateFinder::DuplicateFinder() {
+}
+
+DuplicateFinder::~DuplicateFinder() {
+    Stop();
+}
+
+void DuplicateFinder::Start(int count, SignatureFunc signature, ReadaheadFunc readahead, int maxJobs) {
+    Stop();
+    if (count <= 0 || !signature) {
+        return;
+    }
+    std::shared_ptr<Pass> current = CreatePass(count, std::move(signature), std::move(readahead));
+    pass = current;
+    Launch(current, maxJobs);
+}
+
+void DuplicateFinder::Update(int count, const std::vector<int>& remap, SignatureFunc signature,
+                             ReadaheadFunc readahead, int maxJobs) {
+    std::shared_ptr<Pass> previous = pass;
+    if (!previous || count <= 0 || !signature) {
+        Start(count, std::move(signature), std::move(readahead), maxJobs);
+        return;
+    }
+    // 等进行中的计算结束，之后上一遍的签名不再被写入
+    JobScheduler::GetInstance().CancelAndWait(previous->token);
+    std::shared_ptr<Pass> current = CreatePass(count, std::move(signature), std::move(readahead));
+    for (int index = 0; index < previous->count && index < (int)remap.size(); ++index) {
+        int mapped = remap[index];
+        if (mapped >= 0 && mapped < count && previous->done[index]) {
+            current->signatures[mapped] = previous->signatures[index];
+            current->valid[mapped] = previous->valid[index];
+            current->done[mapped] = 1;
+        }
+    }
+    std::vector<std::vector<int>> groups;
+    for (const std::vector<int>& cluster : clusters) {
+        std::vector<int> members;
+        for (int index : cluster) {
+            if (index < (int)remap.size() && remap[index] >= 0 && remap[index] < count) {
+                members.push_back(remap[index]);
+            }
+        }
+        if (members.size() >= 2) {
+            std::sort(members.begin(), members.end());
+            groups.push_back(std::move(members));
+        }
+    }
+    std::sort(groups.begin(), groups.end());
+    SetClusters(std::move(groups), count);
+    pass = current;
+    finished = false;
+    Launch(current, maxJobs);
+}
+
+void DuplicateFinder::Stop() {
+    if (pass) {
+        JobScheduler::GetInstance().CancelAndWait(pass->token);
+        pass.reset();
+    }
+    finished = false;
+    clusters.clear();
+    clusterOf.clear();
+}
+
+std::shared_ptr<DuplicateFinder::Pass> DuplicateFinder::CreatePass(int count, SignatureFunc signature,
+                                                                   ReadaheadFunc readahead) {
+    std::shared_ptr<Pass> current = std::make_shared<Pass>();
+    current->count = count;
+    current->signatureFunc = std::move(signature);
+    current->readaheadFunc = std::move(readahead);
+    current->signatures.resize(count);
+    current->valid.assign(count, 0);
+    current->done.assign(count, 0);
+    current->token = CancelToken::Create();
+    current->startTicks = SDL_GetTicks();
+    return current;
+}
+
+void DuplicateFinder::Launch(std::shared_ptr<Pass> current, int maxJobs) {
+    for (int index = 0; index < current->count; ++index) {
+        if (!current->done[index]) {
+            current->todo.push_back(index);
+        }
+    }
+    int count = (int)current->todo.size();
+    current->remaining = count;
+    if (count == 0) {
+        // 只删除了图片，签名都已算出，重新分组即可
+        JobScheduler::GetInstance().Submit(JobScheduler::Priority::Indexing, [this, current]() { Finish(current); }, current->token);
+        return;
+    }
+    // 每个任务只算一张再提交下一张，浏览时的解码和缩略图总能插到前面
+    int jobs = std::min(std::max(1, maxJobs), count);
+    for (int i = 0; i < jobs; ++i) {
+        JobScheduler::GetInstance().Submit(JobScheduler::Priority::Indexing, [this, current]() { RunJob(current); }, current->token);
+    }
+}
+
+void DuplicateFinder::RunJob(std::shared_ptr<Pass> current) {
+    int count = (int)current->todo.size();
+    int slot = current->next++;
+    if (slot >= count) {
+        return;
+    }
+    TRACE_SCOPE("DuplicateFinder::RunJob");
+    if (current->readaheadFunc) {
+        // 第一张同时预读开头的一批，之后每张只补上窗口末尾
+        int last = std::min(slot + kReadahead, count - 1);
+        for (int ahead = slot == 0 ? 1 : last; ahead <= last; ++ahead) {
+            current->readaheadFunc(current->todo[ahead]);
+        }
+    }
+    int index = current->todo[slot];
+    current->valid[index] = current->signatureFunc(index, &current->signatures[index]) ? 1 : 0;
+    current->done[index] = 1;
+    if (!current->valid[index]) {
+        ++current->failed;
+    }
+    if (current->next < count) {
+        JobScheduler::GetInstance().Submit(JobScheduler::Priority::Indexing, [this, current]() { RunJob(current); }, current->token);
+    }
+    if (--current->remaining == 0) {
+        Finish(current);
+    }
+}
+
+void DuplicateFinder::Finish(std::shared_ptr<Pass> current) {
+    Uint32 hashMs = SDL_GetTicks() - current->startTicks;
+    auto result = std::make_shared<std::vector<std::vector<int>>>(BuildClusters(current->signatures, current->valid));
+    JobScheduler::GetInstance().PostToMain([this, current, result, hashMs]() {
+        if (pass != current) {
+            return;
+        }
+        finished = true;
+        SetClusters(std::move(*result), current->count);
+        int duplicates = 0;
+        for (const std::vector<int>& cluster : clusters) {
+            duplicates += (int)cluster.size();
+        }
+        std::cout << "Duplicate finder: hashed " << current->todo.size() << " of " << current->count << " images in "
+                  << hashMs << " ms (" << current->failed << " failed), " << clusters.size() << " clusters with "
+                  << duplicates << " images" << std::endl;
+    }, current->token);
+}
+
+void DuplicateFinder::SetClusters(std::vector<std::vector<int>> groups, int count) {
+    clusters = std::move(groups);
+    clusterOf.assign(count, -1);
+    for (int c = 0; c < (int)clusters.size(); ++c) {
+        for (int index : clusters[c]) {
+            clusterOf[index] = c;
+        }
+    }
+}
+
+std::vector<std::vector<int>> DuplicateFinder::BuildClusters(const std::vector<PerceptualHash::Signature>& signatures,
+                                                             const std::vector<char>& valid) {
+    TRACE_SCOPE("DuplicateFinder::BuildClusters");
+    int count = (int)signatures.size();
+    std::vector<int> members;
+    for (int i = 0; i < count; ++i) {
+        if (valid[i]) {
+            members.push_back(i);
+        }
+    }
+    // 每段一张桶表（CSR布局），桶内序号升序
+    std::vector<int> offsets(static_cast<size_t>(kChunks) * (kBuckets + 1), 0);
+    std::vector<BucketEntry> entries(static_cast<size_t>(kChunks) * members.size());
+    for (int c = 0; c < kChunks; ++c) {
+        int* offset = &offsets[static_cast<size_t>(c) * (kBuckets + 1)];
+        for (int i : members) {
+            ++offset[Chunk(signatures[i].pHash, c) + 1];
+        }
+        for (int b = 0; b < kBuckets; ++b) {
+            offset[b + 1] += offset[b];
+        }
+        std::vector<int> fill(offset, offset + kBuckets);
+        BucketEntry* buckets = &entries[static_cast<size_t>(c) * members.size()];
+        for (int i : members) {
+            buckets[fill[Chunk(signatures[i].pHash, c)]++] = {signatures[i].pHash, i};
+        }
+    }
+
+    std::vector<int> parent(count);
+    for (int i = 0; i < count; ++i) {
+        parent[i] = i;
+    }
+    // 距离不超过阈值的两个哈希至少有一段相差不超过kChunkRadius位，只需查这些桶
+    // 逐段处理，一段的桶表留在缓存中
+    const std::vector<int>& masks = ProbeMasks();
+    for (int c = 0; c < kChunks; ++c) {
+        const int* offset = &offsets[static_cast<size_t>(c) * (kBuckets + 1)];
+        const BucketEntry* buckets = &entries[static_cast<size_t>(c) * members.size()];
+        for (int i : members) {
+            const PerceptualHash::Signature& a = signatures[i];
+            int value = Chunk(a.pHash, c);
+            for (int mask : masks) {
+                int bucket = value ^ mask;
+                // 每对只从序号小的一方检查
+                const BucketEntry* end = buckets + offset[bucket + 1];
+                for (const BucketEntry* b = buckets + offset[bucket]; b != end; ++b) {
+                    if (b->index <= i || PerceptualHash::Distance(a.pHash, b->pHash) > kPHashThreshold ||
+                        PerceptualHash::Distance(a.dHash, signatures[b->index].dHash) > kDHashThreshold) {
+                        continue;
+                    }
+                    int rootA = FindRoot(parent, i);
+                    int rootB = FindRoot(parent, b->index);
+                    if (rootA != rootB) {
+                        parent[std::max(rootA, rootB)] = std::min(rootA, rootB);
+                    }
+                }
+            }
+        }
+    }
+
+    // 根总是组内序号最小的一张，按序号遍历即按第一张排列
+    std::vector<int> clusterIndex(count, -1);
+    std::vector<std::vector<int>> groups;
+    for (int i : members) {
+        int root = FindRoot(parent, i);
+        if (root == i) {
+            continue;
+        }
+        if (clusterIndex[root] < 0) {
+            clusterIndex[root] = (int)groups.size();
+            groups.push_back({root});
+        }
+        groups[clusterIndex[root]].push_back(i);
+    }
+    return groups;
+}
+
+const std::vector<int>* DuplicateFinder::GetCluster(int index) const {
+    if (index < 0 || index >= (int)clusterOf.size() || clusterOf[index] < 0) {
+        return nullptr;
+    }
+    return &clusters[clusterOf[index]];
+}
+
+int DuplicateFinder::NextInCluster(int index) const {
+    const std::vector<int>* cluster = GetCluster(index);
+    if (!cluster) {
+        return -1;
+    }
+    size_t position = std::lower_bound(cluster->begin(), cluster->end(), index) - cluster->begin();
+    return (*cluster)[(position + 1) % cluster->size()];
+}
+
+int DuplicateFinder::NextCluster(int index) const {
+    if (clusters.empty()) {
+        return -1;
+    }
+    if (GetCluster(index)) {
+        return clusters[(clusterOf[index] + 1) % clusters.size()].front();
+    }
+    for (const std::vector<int>& cluster : clusters) {
+        if (cluster.front() > index) {
+            return cluster.front();
+        }
+    }
+    return clusters.front().front();
+}
@@ -0,0 +1,250 @@
+#include "ExifPreview.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "FileIo.h"
+#include "JpegDecoder.h"
+
+namespace {
+
+// 预览图超过此大小时不值得在UI线程上读取
+const uint32_t kMaxPreviewBytes = 8u << 20;
+
+uint16_t Read16(const unsigned char* p, bool littleEndian) {
+    return littleEndian ? static_cast<uint16_t>(p[0] | (p[1] << 8)) : static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+uint32_t Read32(const unsigned char* p, bool littleEndian) {
+    return littleEndian ? (static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+                           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24))
+                        : ((static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]));
+}
+
+bool IsSofMarker(unsigned char marker) {
+    return marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+}
+
+// 逐段扫描从start开始的JPEG流直到SOF，返回SOF中的尺寸；
+// segments不为空时收集APP1/APP2段的内容及其在文件中的偏移
+struct Segment {
+    unsigned char marker;
+    uint64_t offset;
+    std::vector<unsigned char> data;
+};
+
+bool ScanToFrame(int fd, uint64_t start, uint64_t end, int* width, int* height, std::vector<Segment>* segments) {
+    unsigned char header[4];
+    if (start + 2 > end || !PreadFully(fd, header, 2, static_cast<int64_t>(start)) || header[0] != 0xFF || header[1] != 0xD8) {
+        return false;
+    }
+    uint64_t pos = start + 2;
+    while (pos + 4 <= end) {
+        if (!PreadFully(fd, header, 4, static_cast<int64_t>(pos)) || header[0] != 0xFF) {
+            return false;
+        }
+        unsigned char marker = header[1];
+        if (marker == 0xFF) {
+            // 填充字节
+            ++pos;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+            pos += 2;
+            continue;
+        }
+        uint32_t length = (static_cast<uint32_t>(header[2]) << 8) | header[3];
+        if (length < 2 || pos + 2 + length > end) {
+            return false;
+        }
+        uint64_t body = pos + 4;
+        if (IsSofMarker(marker)) {
+            unsigned char frame[5];
+            if (length < 7 || !PreadFully(fd, frame, sizeof(frame), static_cast<int64_t>(body))) {
+                return false;
+            }
+            *height = (frame[1] << 8) | frame[2];
+            *width = (frame[3] << 8) | frame[4];
+            return *width > 0 && *height > 0;
+        }
+        if (marker == 0xDA) {
+            // SOS之前没有SOF，不是有效的基线/渐进JPEG
+            return false;
+        }
+        if (segments && (marker == 0xE1 || marker == 0xE2)) {
+            Segment segment;
+            segment.marker = marker;
+            segment.offset = body;
+            segment.data.resize(length - 2);
+            if (!PreadFully(fd, segment.data.data(), segment.data.size(), static_cast<int64_t>(body))) {
+                return false;
+            }
+            segments->push_back(std::move(segment));
+        }
+        pos += 2 + length;
+    }
+    return false;
+}
+
+// EXIF：IFD1中的JPEGInterchangeFormat/Length指向缩略图，偏移相对于TIFF头
+void ParseExif(const unsigned char* tiff, size_t size, uint64_t base, std::vector<ExifPreview::Candidate>* candidates) {
+    if (size < 8 || !((tiff[0] == 'I' && tiff[1] == 'I') || (tiff[0] == 'M' && tiff[1] == 'M'))) {
+        return;
+    }
+    bool le = tiff[0] == 'I';
+    if (Read16(tiff + 2, le) != 42) {
+        return;
+    }
+    // 偏移来自文件，按64位比较，避免接近4G的值回绕后通过检查
+    uint64_t ifd0 = Read32(tiff + 4, le);
+    if (ifd0 + 2 > size) {
+        return;
+    }
+    uint32_t count0 = Read16(tiff + ifd0, le);
+    uint64_t nextOffset = ifd0 + 2 + static_cast<uint64_t>(count0) * 12;
+    if (nextOffset + 4 > size) {
+        return;
+    }
+    uint64_t ifd1 = Read32(tiff + nextOffset, le);
+    if (ifd1 == 0 || ifd1 + 2 > size) {
+        return;
+    }
+    uint32_t count1 = Read16(tiff + ifd1, le);
+    uint32_t thumbOffset = 0;
+    uint32_t thumbLength = 0;
+    for (uint32_t i = 0; i < count1; ++i) {
+        uint64_t entry = ifd1 + 2 + static_cast<uint64_t>(i) * 12;
+        if (entry + 12 > size) {
+            break;
+        }
+        uint16_t tag = Read16(tiff + entry, le);
+        uint16_t type = Read16(tiff + entry + 2, le);
+        // LONG或SHORT
+        uint32_t value = type == 3 ? Read16(tiff + entry + 8, le) : Read32(tiff + entry + 8, le);
+        if (tag == 0x0201) {
+            thumbOffset = value;
+        } else if (tag == 0x0202) {
+            thumbLength = value;
+        }
+    }
+    if (thumbOffset > 0 && thumbLength > 0 && static_cast<uint64_t>(thumbOffset) + thumbLength <= size) {
+        ExifPreview::Candidate candidate;
+        candidate.offset = base + thumbOffset;
+        candidate.length = thumbLength;
+        candidates->push_back(candidate);
+    }
+}
+
+// MPF：MP Index IFD的MPEntry列出文件中的各幅图像，偏移相对于MP头；第一项是主图本身
+void ParseMpf(const unsigned char* mp, size_t size, uint64_t base, std::vector<ExifPreview::Candidate>* candidates) {
+    if (size < 8 || !((mp[0] == 'I' && mp[1] == 'I') || (mp[0] == 'M' && mp[1] == 'M'))) {
+        return;
+    }
+    bool le = mp[0] == 'I';
+    uint64_t ifd = Read32(mp + 4, le);
+    if (ifd + 2 > size) {
+        return;
+    }
+    uint32_t count = Read16(mp + ifd, le);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint64_t entry = ifd + 2 + static_cast<uint64_t>(i) * 12;
+        if (entry + 12 > size) {
+            break;
+        }
+        if (Read16(mp + entry, le) != 0xB002) {
+            continue;
+        }
+        uint32_t bytes = Read32(mp + entry + 4, le);
+        uint32_t offset = Read32(mp + entry + 8, le);
+        if (static_cast<uint64_t>(offset) + bytes > size) {
+            return;
+        }
+        for (uint64_t e = 0; e + 16 <= bytes; e += 16) {
+            const unsigned char* item = mp + offset + e;
+            uint32_t attribute = Read32(item, le);
+            uint32_t imageSize = Read32(item + 4, le);
+            uint32_t imageOffset = Read32(item + 8, le);
+            // 只取JPEG格式的附属图像
+            if (imageOffset == 0 || ((attribute >> 24) & 0x7) != 0) {
+                continue;
+            }
+            ExifPreview::Candidate candidate;
+            candidate.offset = base + imageOffset;
+            candidate.length = imageSize;
+            candidates->push_back(candidate);
+        }
+        return;
+    }
+}
+
+} // namespace
+
+bool ExifPreview::Probe(const std::string& path, Info* info) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    uint64_t fileSize = static_cast<uint64_t>(st.st_size);
+    std::vector<Segment> segments;
+    if (!ScanToFrame(fd, 0, fileSize, &info->width, &info->height, &segments)) {
+        close(fd);
+        return false;
+    }
+
+    std::vector<Candidate> found;
+    for (const Segment& segment : segments) {
+        const unsigned char* data = segment.data.data();
+        size_t size = segment.data.size();
+        if (segment.marker == 0xE1 && size > 6 && std::memcmp(data, "Exif\0\0", 6) == 0) {
+            ParseExif(data + 6, size - 6, segment.offset + 6, &found);
+        } else if (segment.marker == 0xE2 && size > 4 && std::memcmp(data, "MPF\0", 4) == 0) {
+            ParseMpf(data + 4, size - 4, segment.offset + 4, &found);
+        }
+    }
+    // 读取每个预览图自身的SOF得到尺寸
+    info->candidates.clear();
+    for (Candidate candidate : found) {
+        if (candidate.length == 0 || candidate.length > kMaxPreviewBytes || candidate.offset + candidate.length > fileSize) {
+            continue;
+        }
+        if (ScanToFrame(fd, candidate.offset, candidate.offset + candidate.length, &candidate.width, &candidate.height, nullptr)) {
+            info->candidates.push_back(candidate);
+        }
+    }
+    close(fd);
+    std::sort(info->candidates.begin(), info->candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return static_cast<int64_t>(a.width) * a.height < static_cast<int64_t>(b.width) * b.height;
+    });
+    return true;
+}
+
+const ExifPreview::Candidate* ExifPreview::Choose(const Info& info, int targetWidth, int targetHeight) {
+    for (const Candidate& candidate : info.candidates) {
+        if (candidate.width >= targetWidth && candidate.height >= targetHeight) {
+            return &candidate;
+        }
+    }
+    return info.candidates.empty() ? nullptr : &info.candidates.back();
+}
+
+SDL_Surface* ExifPreview::Decode(const std::string& path, const Candidate& candidate, int targetWidth, int targetHeight) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    std::vector<unsigned char> data(candidate.length);
+    bool ok = PreadFully(fd, data.data(), data.size(), static_cast<int64_t>(candidate.offset));
+    close(fd);
+    if (!ok) {
+        return nullptr;
+    }
+    int scale = JpegDecoder::ChooseScale(candidate.width, candidate.height, targetWidth, targetHeight);
+    return JpegDecoder::Decode(data.data(), data.size(), scale);
+}
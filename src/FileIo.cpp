@@ -0,0 +1,37 @@
+#include "FileIo.h"
+#include <cerrno>
+#include <unistd.h>
+
+bool PreadFully(int fd, void* buffer, size_t size, int64_t offset) {
+    char* dst = static_cast<char*>(buffer);
+    while (size > 0) {
+        ssize_t n = pread(fd, dst, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        dst += n;
+        size -= static_cast<size_t>(n);
+        offset += n;
+    }
+    return true;
+}
+
+bool PwriteFully(int fd, const void* buffer, size_t size, int64_t offset) {
+    const char* src = static_cast<const char*>(buffer);
+    while (size > 0) {
+        ssize_t n = pwrite(fd, src, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        src += n;
+        size -= static_cast<size_t>(n);
+        offset += n;
+    }
+    return true;
+}
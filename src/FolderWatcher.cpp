@@ -0,0 +1,303 @@
+#include "FolderWatcher.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Trace.h"
+
+namespace {
+
+const uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_CREATE | IN_DELETE |
+                            IN_DELETE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW;
+// 最后一个事件之后等待的静默时间，一次拷贝或渲染输出的多个事件合并为一次更新
+const int kQuietMs = 150;
+// 持续有事件（如长时间的批量拷贝）时，第一个事件之后最多等这么久也要推送
+const int kMaxLatencyMs = 1000;
+
+bool IsHidden(const char* name) {
+    return name[0] == '.';
+}
+
+// 只有根目录"/"以斜杠结尾，其余目录在Start时已去掉末尾的斜杠
+std::string JoinPath(const std::string& directory, const char* name) {
+    if (!directory.empty() && directory.back() == '/') {
+        return directory + name;
+    }
+    return directory + "/" + name;
+}
+
+} // namespace
+
+FolderWatcher::FolderWatcher() {
+}
+
+FolderWatcher::~FolderWatcher() {
+    Stop();
+}
+
+bool FolderWatcher::Start(const std::string& folder, Uint32 eventType) {
+    Stop();
+    // 与DirectoryScanner生成的路径一致，末尾的斜杠不产生"//"
+    std::string root = folder;
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        std::cerr << "Unable to initialize inotify: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopFd < 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+        return false;
+    }
+    wakeEventType = eventType;
+    // 添加监视需要遍历整棵目录树，在监视线程上进行
+    thread = std::thread([this, root]() {
+        Trace::SetThreadName("Folder watcher");
+        AddWatchRecursive(root, false, 0);
+        std::cout << "Watching " << watches.size() << " directories under " << root << std::endl;
+        WatcherLoop();
+    });
+    return true;
+}
+
+void FolderWatcher::Stop() {
+    if (thread.joinable()) {
+        uint64_t one = 1;
+        if (write(stopFd, &one, sizeof(one)) < 0) {
+            std::cerr << "Unable to stop folder watcher: " << std::strerror(errno) << std::endl;
+        }
+        thread.join();
+    }
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+    if (stopFd >= 0) {
+        close(stopFd);
+        stopFd = -1;
+    }
+    watches.clear();
+    movedFrom.clear();
+    pending.clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    changes.clear();
+    changesPending.store(false, std::memory_order_release);
+}
+
+std::vector<FolderWatcher::Change> FolderWatcher::TakeChanges() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Change> taken;
+    taken.swap(changes);
+    changesPending.store(false, std::memory_order_release);
+    return taken;
+}
+
+void FolderWatcher::AddWatchRecursive(const std::string& directory, bool reportFiles, int depth) {
+    int wd = inotify_add_watch(inotifyFd, directory.c_str(), kWatchMask);
+    if (wd < 0) {
+        // 通常是超出fs.inotify.max_user_watches，其余子目录仍可监视
+        std::cerr << "Unable to watch " << directory << ": " << std::strerror(errno) << std::endl;
+        return;
+    }
+    watches[wd] = {directory, depth};
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        return;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        if (IsHidden(entry->d_name)) {
+            continue;
+        }
+        std::string path = JoinPath(directory, entry->d_name);
+        unsigned char type = entry->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            if (lstat(path.c_str(), &st) != 0) {
+                continue;
+            }
+            type = S_ISDIR(st.st_mode) ? DT_DIR : (S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN);
+        }
+        if (type == DT_DIR && depth < maxDepth) {
+            AddWatchRecursive(path, reportFiles, depth + 1);
+        } else if (reportFiles && (type == DT_REG || type == DT_LNK)) {
+            // 监视建立之前已写入新目录的文件
+            Publish({Change::Type::Added, path, std::string()});
+        }
+    }
+    closedir(dir);
+}
+
+void FolderWatcher::RemoveWatches(const std::string& directory) {
+    std::string prefix = JoinPath(directory, "");
+    for (auto it = watches.begin(); it != watches.end();) {
+        const std::string& path = it->second.path;
+        if (path == directory || path.compare(0, prefix.size(), prefix) == 0) {
+            inotify_rm_watch(inotifyFd, it->first);
+            it = watches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void FolderWatcher::WatcherLoop() {
+    while (true) {
+        pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+        bool waiting = !pending.empty() || !movedFrom.empty();
+        int timeout = -1;
+        if (waiting) {
+            // 静默期从最后一个事件算起，但不超过第一个事件之后的最大延迟
+            long long remaining = kMaxLatencyMs - std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - waitingSince).count();
+            if (remaining <= 0) {
+                Flush();
+                continue;
+            }
+            timeout = static_cast<int>(std::min<long long>(kQuietMs, remaining));
+        }
+        int ready = poll(fds, 2, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Folder watcher poll failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            return;
+        }
+        if (ready == 0) {
+            Flush();
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            ReadEvents();
+            if (!waiting && (!pending.empty() || !movedFrom.empty())) {
+                waitingSince = std::chrono::steady_clock::now();
+            }
+        }
+    }
+}
+
+void FolderWatcher::ReadEvents() {
+    TRACE_SCOPE("FolderWatcher::ReadEvents");
+    alignas(inotify_event) char buffer[64 * 1024];
+    while (true) {
+        ssize_t bytes = read(inotifyFd, buffer, sizeof(buffer));
+        if (bytes <= 0) {
+            return;
+        }
+        for (ssize_t offset = 0; offset < bytes;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            if (event->mask & IN_Q_OVERFLOW) {
+                // 事件已丢失，只能重新扫描
+                movedFrom.clear();
+                pending.clear();
+                Publish({Change::Type::Rescan, std::string(), std::string()});
+                continue;
+            }
+            auto watch = watches.find(event->wd);
+            if (event->mask & IN_IGNORED) {
+                if (watch != watches.end()) {
+                    watches.erase(watch);
+                }
+                continue;
+            }
+            if (watch == watches.end() || event->len == 0) {
+                continue;
+            }
+            std::string path = JoinPath(watch->second.path, event->name);
+            bool hidden = IsHidden(event->name);
+            bool isDirectory = (event->mask & IN_ISDIR) != 0;
+
+            if (event->mask & IN_MOVED_FROM) {
+                // 等待同一cookie的移入事件，静默期内未配对则视为删除
+                Change change{Change::Type::Removed, path, std::string()};
+                change.directory = isDirectory;
+                movedFrom[event->cookie] = change;
+            } else if (event->mask & IN_MOVED_TO) {
+                auto from = movedFrom.find(event->cookie);
+                if (isDirectory) {
+                    // 目录移动：旧路径下的文件全部移除，新目录重新监视并报告其中的文件
+                    if (from != movedFrom.end()) {
+                        Publish(from->second);
+                        movedFrom.erase(from);
+                    }
+                    if (!hidden && watch->second.depth < maxDepth) {
+                        AddWatchRecursive(path, true, watch->second.depth + 1);
+                    }
+                } else if (from != movedFrom.end()) {
+                    // 重命名为隐藏文件视为删除；从隐藏的临时文件重命名而来时原路径不在目录中，按新增处理
+                    Change change = from->second;
+                    movedFrom.erase(from);
+                    if (hidden) {
+                        Publish(change);
+                    } else {
+                        Publish({Change::Type::Renamed, path, change.path});
+                    }
+                } else if (!hidden) {
+                    Publish({Change::Type::Added, path, std::string()});
+                }
+            } else if (event->mask & IN_CLOSE_WRITE) {
+                if (!hidden) {
+                    Publish({Change::Type::Modified, path, std::string()});
+                }
+            } else if (event->mask & IN_CREATE) {
+                // 新文件等关闭写后再报告；新目录立即监视
+                if (isDirectory && !hidden && watch->second.depth < maxDepth) {
+                    AddWatchRecursive(path, true, watch->second.depth + 1);
+                }
+            } else if (event->mask & IN_DELETE) {
+                Change change{Change::Type::Removed, path, std::string()};
+                change.directory = isDirectory;
+                Publish(change);
+            }
+        }
+    }
+}
+
+void FolderWatcher::Publish(Change change) {
+    // 同一文件连续的写入只报告一次
+    if (change.type == Change::Type::Modified && !pending.empty() &&
+        pending.back().type == Change::Type::Modified && pending.back().path == change.path) {
+        return;
+    }
+    pending.push_back(std::move(change));
+}
+
+void FolderWatcher::Flush() {
+    for (auto& entry : movedFrom) {
+        if (entry.second.directory) {
+            // 目录移出了监视范围，其监视仍然有效，但路径已失效
+            RemoveWatches(entry.second.path);
+        }
+        pending.push_back(entry.second);
+    }
+    movedFrom.clear();
+    if (pending.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        changes.insert(changes.end(), std::make_move_iterator(pending.begin()), std::make_move_iterator(pending.end()));
+        changesPending.store(true, std::memory_order_release);
+    }
+    pending.clear();
+    if (wakeEventType != (Uint32)-1) {
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = wakeEventType;
+        SDL_PushEvent(&event);
+    }
+}
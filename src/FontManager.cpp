@@ -1,7 +1,14 @@
 #include "FontManager.h"
+#include "Trace.h"
 #include <iostream>
 #include <array>
 #include <memory>
+#include <algorithm>
+
+namespace {
+// 图集纹理边长
+const int kAtlasSize = 1024;
+}
 
 FontManager& FontManager::GetInstance() {
     static FontManager instance;
@@ -13,6 +20,7 @@ FontManager::~FontManager() {
 }
 
 bool FontManager::Initialize() {
+    TRACE_SCOPE("FontManager::Initialize");
     if (initialized) {
         return true;
     }
@@ -45,11 +53,19 @@ bool FontManager::Initialize() {
 }
 
 void FontManager::Cleanup() {
+    // 渲染器销毁时会释放其纹理，这里只丢弃缓存的字形（其中记录了字体指针）
+    for (GlyphAtlas& atlas : atlases) {
+        atlas = GlyphAtlas();
+    }
     for (int i = 0; i < 5; ++i) {
         if (fonts[i]) {
             TTF_CloseFont(fonts[i]);
             fonts[i] = nullptr;
         }
+        if (fallbackFonts[i]) {
+            TTF_CloseFont(fallbackFonts[i]);
+            fallbackFonts[i] = nullptr;
+        }
     }
     
     if (initialized) {
@@ -124,6 +140,29 @@ std::string FontManager::GetSystemFont() {
     return "";
 }
 
+std::string FontManager::GetFallbackFont() {
+    // 查询覆盖中文的字体，与主字体相同时不需要后备
+    const char* fontconfigCmd = "fc-match -f '%{file}' 'sans-serif:lang=zh-cn'";
+    
+    std::array<char, 512> buffer;
+    std::string result;
+    
+    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(fontconfigCmd, "r"), pclose);
+    if (!pipe) {
+        return "";
+    }
+    while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
+        result += buffer.data();
+    }
+    if (!result.empty() && result.back() == '\n') {
+        result.pop_back();
+    }
+    if (result.empty() || result == fontPath || !std::ifstream(result).good()) {
+        return "";
+    }
+    return result;
+}
+
 bool FontManager::LoadFonts() {
     int sizes[] = {SMALL, MEDIUM, LARGE, XLARGE, XXLARGE};
     
@@ -135,24 +174,239 @@ bool FontManager::LoadFonts() {
         }
     }
     
+    // 后备字体可选，加载失败不影响主字体
+    fallbackPath = GetFallbackFont();
+    if (!fallbackPath.empty()) {
+        for (int i = 0; i < 5; ++i) {
+            fallbackFonts[i] = TTF_OpenFont(fallbackPath.c_str(), sizes[i]);
+        }
+        std::cout << "Fallback font: " << fallbackPath << std::endl;
+    }
+    
     return true;
 }
 
+int FontManager::SizeIndex(FontSize size) const {
+    switch (size) {
+        case SMALL:   return 0;
+        case MEDIUM:  return 1;
+        case LARGE:   return 2;
+        case XLARGE:  return 3;
+        case XXLARGE: return 4;
+    }
+    return 0;
+}
+
 TTF_Font* FontManager::GetFont(FontSize size) {
     if (!initialized) {
         return nullptr;
     }
-    
-    int index = 0;
-    switch (size) {
-        case SMALL:   index = 0; break;
-        case MEDIUM:  index = 1; break;
-        case LARGE:   index = 2; break;
-        case XLARGE:  index = 3; break;
-        case XXLARGE: index = 4; break;
+    return fonts[SizeIndex(size)];
+}
+
+Uint32 FontManager::NextCodepoint(const std::string& text, size_t& pos) {
+    unsigned char lead = static_cast<unsigned char>(text[pos++]);
+    if (lead < 0x80) {
+        return lead;
+    }
+    int extra;
+    Uint32 codepoint;
+    if ((lead & 0xE0) == 0xC0) {
+        extra = 1;
+        codepoint = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        extra = 2;
+        codepoint = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        extra = 3;
+        codepoint = lead & 0x07;
+    } else {
+        return 0xFFFD;
+    }
+    for (int i = 0; i < extra; ++i) {
+        if (pos >= text.size() || (static_cast<unsigned char>(text[pos]) & 0xC0) != 0x80) {
+            return 0xFFFD;  // 截断的序列，不吞掉后面的字符
+        }
+        codepoint = (codepoint << 6) | (static_cast<unsigned char>(text[pos++]) & 0x3F);
+    }
+    // 过长编码、代理区和超出范围的码点都按非法处理
+    static const Uint32 minimum[] = {0, 0x80, 0x800, 0x10000};
+    if (codepoint < minimum[extra] || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        return 0xFFFD;
+    }
+    return codepoint;
+}
+
+FontManager::Glyph& FontManager::GetGlyph(int sizeIndex, Uint32 codepoint) {
+    GlyphAtlas& atlas = atlases[sizeIndex];
+    auto it = atlas.glyphs.find(codepoint);
+    if (it != atlas.glyphs.end()) {
+        return it->second;
     }
     
-    return fonts[index];
+    // 主字体、后备字体都没有时依次用U+FFFD、'?'代替
+    Glyph glyph;
+    const Uint32 candidates[] = {codepoint, 0xFFFD, '?'};
+    for (Uint32 candidate : candidates) {
+        if (TTF_GlyphIsProvided32(fonts[sizeIndex], candidate)) {
+            glyph.font = fonts[sizeIndex];
+        } else if (fallbackFonts[sizeIndex] && TTF_GlyphIsProvided32(fallbackFonts[sizeIndex], candidate)) {
+            glyph.font = fallbackFonts[sizeIndex];
+        } else {
+            continue;
+        }
+        glyph.renderCodepoint = candidate;
+        break;
+    }
+    if (glyph.font) {
+        int minx, maxx, miny, maxy, advance;
+        if (TTF_GlyphMetrics32(glyph.font, glyph.renderCodepoint, &minx, &maxx, &miny, &maxy, &advance) == 0) {
+            glyph.advance = advance;
+            // SDL_ttf单独渲染字形时，左侧超出笔位置的部分会向右平移
+            glyph.offsetX = std::min(0, minx);
+        }
+    } else {
+        glyph.inAtlas = true;  // 无法绘制，只占位
+    }
+    return atlas.glyphs.emplace(codepoint, glyph).first->second;
+}
+
+int FontManager::GetKerning(int sizeIndex, Uint32 previous, const Glyph& previousGlyph, Uint32 codepoint, const Glyph& glyph) {
+    // 不同字体的字形之间没有字距数据
+    if (!glyph.font || glyph.font != previousGlyph.font) {
+        return 0;
+    }
+    GlyphAtlas& atlas = atlases[sizeIndex];
+    uint64_t key = (static_cast<uint64_t>(previous) << 32) | codepoint;
+    auto it = atlas.kerning.find(key);
+    if (it != atlas.kerning.end()) {
+        return it->second;
+    }
+    int kerning = TTF_GetFontKerningSizeGlyphs32(glyph.font, previousGlyph.renderCodepoint, glyph.renderCodepoint);
+    atlas.kerning.emplace(key, kerning);
+    return kerning;
+}
+
+bool FontManager::EnsureAtlas(SDL_Renderer* renderer, GlyphAtlas& atlas) {
+    if (atlas.texture && atlas.renderer == renderer) {
+        return true;
+    }
+    // 首次使用或换了渲染器：创建新图集，所有字形需重新上传
+    ResetAtlas(atlas);
+    atlas.renderer = renderer;
+    atlas.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, kAtlasSize, kAtlasSize);
+    if (!atlas.texture) {
+        std::cerr << "Failed to create glyph atlas: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_SetTextureBlendMode(atlas.texture, SDL_BLENDMODE_BLEND);
+    return true;
+}
+
+void FontManager::ResetAtlas(GlyphAtlas& atlas) {
+    atlas.penX = 0;
+    atlas.penY = 0;
+    atlas.rowHeight = 0;
+    for (auto& entry : atlas.glyphs) {
+        if (entry.second.font) {
+            entry.second.inAtlas = false;
+            entry.second.atlasRect = {0, 0, 0, 0};
+        }
+    }
+}
+
+bool FontManager::UploadGlyph(GlyphAtlas& atlas, Glyph& glyph) {
+    TRACE_SCOPE("FontManager::UploadGlyph");
+    // 白色字形，绘制时用顶点颜色着色
+    SDL_Color white = {255, 255, 255, 255};
+    SDL_Surface* surface = TTF_RenderGlyph32_Blended(glyph.font, glyph.renderCodepoint, white);
+    if (!surface || surface->w > kAtlasSize || surface->h > kAtlasSize) {
+        // 空白字形（如空格）没有位图
+        SDL_FreeSurface(surface);
+        glyph.inAtlas = true;
+        glyph.atlasRect = {0, 0, 0, 0};
+        return true;
+    }
+    if (atlas.penX + surface->w > kAtlasSize) {
+        atlas.penX = 0;
+        atlas.penY += atlas.rowHeight + 1;
+        atlas.rowHeight = 0;
+    }
+    if (atlas.penY + surface->h > kAtlasSize) {
+        SDL_FreeSurface(surface);
+        return false;
+    }
+    if (surface->format->format != SDL_PIXELFORMAT_ARGB8888) {
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(surface);
+        if (!converted) {
+            glyph.inAtlas = true;
+            return true;
+        }
+        surface = converted;
+    }
+    glyph.atlasRect = {atlas.penX, atlas.penY, surface->w, surface->h};
+    SDL_UpdateTexture(atlas.texture, &glyph.atlasRect, surface->pixels, surface->pitch);
+    glyph.inAtlas = true;
+    atlas.penX += surface->w + 1;   // 留1像素间隔，避免线性过滤采样到相邻字形
+    atlas.rowHeight = std::max(atlas.rowHeight, surface->h);
+    SDL_FreeSurface(surface);
+    return true;
+}
+
+void FontManager::FlushQuads(SDL_Renderer* renderer, GlyphAtlas& atlas, SDL_Color color) {
+    TRACE_SCOPE("FontManager::FlushQuads");
+    if (quads.empty()) {
+        return;
+    }
+    if (geometrySupported) {
+        vertices.clear();
+        indices.clear();
+        const float scale = 1.0f / kAtlasSize;
+        for (const GlyphQuad& quad : quads) {
+            int base = static_cast<int>(vertices.size());
+            float x0 = static_cast<float>(quad.dst.x);
+            float y0 = static_cast<float>(quad.dst.y);
+            float x1 = static_cast<float>(quad.dst.x + quad.dst.w);
+            float y1 = static_cast<float>(quad.dst.y + quad.dst.h);
+            float u0 = quad.src.x * scale;
+            float v0 = quad.src.y * scale;
+            float u1 = (quad.src.x + quad.src.w) * scale;
+            float v1 = (quad.src.y + quad.src.h) * scale;
+            vertices.push_back({{x0, y0}, color, {u0, v0}});
+            vertices.push_back({{x1, y0}, color, {u1, v0}});
+            vertices.push_back({{x1, y1}, color, {u1, v1}});
+            vertices.push_back({{x0, y1}, color, {u0, v1}});
+            const int corners[] = {0, 1, 2, 0, 2, 3};
+            for (int corner : corners) {
+                indices.push_back(base + corner);
+            }
+        }
+        if (SDL_RenderGeometry(renderer, atlas.texture, vertices.data(), static_cast<int>(vertices.size()),
+                               indices.data(), static_cast<int>(indices.size())) == 0) {
+            quads.clear();
+            return;
+        }
+        std::cerr << "SDL_RenderGeometry unavailable, drawing glyphs individually: " << SDL_GetError() << std::endl;
+        geometrySupported = false;
+    }
+    SDL_SetTextureColorMod(atlas.texture, color.r, color.g, color.b);
+    SDL_SetTextureAlphaMod(atlas.texture, color.a);
+    for (const GlyphQuad& quad : quads) {
+        SDL_RenderCopy(renderer, atlas.texture, &quad.src, &quad.dst);
+    }
+    quads.clear();
+}
+
+void FontManager::ReleaseTextures() {
+    for (GlyphAtlas& atlas : atlases) {
+        if (atlas.texture) {
+            SDL_DestroyTexture(atlas.texture);
+            atlas.texture = nullptr;
+        }
+        atlas.renderer = nullptr;
+        ResetAtlas(atlas);
+    }
 }
 
 SDL_Surface* FontManager::RenderText(const std::string& text, SDL_Color color, FontSize size) {
@@ -161,10 +415,11 @@ SDL_Surface* FontManager::RenderText(const std::string& text, SDL_Color color, F
         return nullptr;
     }
     // 使用Blended模式获得平滑抗锯齿字体
-    return TTF_RenderText_Blended(font, text.c_str(), color);
+    return TTF_RenderUTF8_Blended(font, text.c_str(), color);
 }
 
 SDL_Texture* FontManager::RenderTextTexture(SDL_Renderer* renderer, const std::string& text, SDL_Color color, FontSize size) {
+    TRACE_SCOPE("FontManager::RenderTextTexture");
     SDL_Surface* surface = RenderText(text, color, size);
     if (!surface) {
         return nullptr;
@@ -184,22 +439,60 @@ void FontManager::GetTextSize(const std::string& text, int* width, int* height,
         return;
     }
     
-    TTF_SizeText(font, text.c_str(), width, height);
+    int index = SizeIndex(size);
+    int penX = 0;
+    Uint32 previous = 0;
+    const Glyph* previousGlyph = nullptr;
+    for (size_t pos = 0; pos < text.size();) {
+        Uint32 codepoint = NextCodepoint(text, pos);
+        const Glyph& glyph = GetGlyph(index, codepoint);
+        if (previousGlyph) {
+            penX += GetKerning(index, previous, *previousGlyph, codepoint, glyph);
+        }
+        penX += glyph.advance;
+        previous = codepoint;
+        previousGlyph = &glyph;
+    }
+    if (width) *width = penX;
+    if (height) *height = TTF_FontHeight(font);
 }
 
 void FontManager::RenderTextAt(SDL_Renderer* renderer, const std::string& text, int x, int y, SDL_Color color, FontSize size) {
-    SDL_Texture* texture = RenderTextTexture(renderer, text, color, size);
-    if (!texture) {
+    TRACE_SCOPE("FontManager::RenderTextAt");
+    if (!GetFont(size)) {
+        return;
+    }
+    int index = SizeIndex(size);
+    GlyphAtlas& atlas = atlases[index];
+    if (!EnsureAtlas(renderer, atlas)) {
         return;
     }
     
-    int textWidth, textHeight;
-    SDL_QueryTexture(texture, nullptr, nullptr, &textWidth, &textHeight);
-    
-    SDL_Rect destRect = {x, y, textWidth, textHeight};
-    SDL_RenderCopy(renderer, texture, nullptr, &destRect);
-    
-    SDL_DestroyTexture(texture);
+    quads.clear();
+    int penX = x;
+    Uint32 previous = 0;
+    const Glyph* previousGlyph = nullptr;
+    for (size_t pos = 0; pos < text.size();) {
+        Uint32 codepoint = NextCodepoint(text, pos);
+        Glyph& glyph = GetGlyph(index, codepoint);
+        if (previousGlyph) {
+            penX += GetKerning(index, previous, *previousGlyph, codepoint, glyph);
+        }
+        if (!glyph.inAtlas && !UploadGlyph(atlas, glyph)) {
+            // 图集已满：先画出已排好的字形，清空图集后重新上传
+            FlushQuads(renderer, atlas, color);
+            ResetAtlas(atlas);
+            UploadGlyph(atlas, glyph);
+        }
+        if (glyph.atlasRect.w > 0) {
+            SDL_Rect dst = {penX + glyph.offsetX, y, glyph.atlasRect.w, glyph.atlasRect.h};
+            quads.push_back({glyph.atlasRect, dst});
+        }
+        penX += glyph.advance;
+        previous = codepoint;
+        previousGlyph = &glyph;
+    }
+    FlushQuads(renderer, atlas, color);
 }
 
 void FontManager::RenderTextCentered(SDL_Renderer* renderer, const std::string& text, SDL_Rect rect, SDL_Color color, FontSize size) {
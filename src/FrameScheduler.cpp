@@ -0,0 +1,42 @@
+#include "FrameScheduler.h"
+#include <algorithm>
+
+void FrameScheduler::SetRefreshRate(int hz) {
+    if (hz > 0) {
+        refreshInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / hz;
+    }
+}
+
+int FrameScheduler::GetRefreshIntervalMs() const {
+    return std::max(1, static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(refreshInterval).count()));
+}
+
+void FrameScheduler::Invalidate(unsigned regions) {
+    regions &= kAll;
+    if (regions == kNone) {
+        return;
+    }
+    if (damage == kNone) {
+        damagedAt = Clock::now();
+    }
+    damage |= regions;
+}
+
+unsigned FrameScheduler::TakeDamage() {
+    unsigned regions = damage;
+    damage = kNone;
+    if (regions == kNone) {
+        return regions;
+    }
+    // 从损坏出现（或上一帧开始绘制）到这一帧开始绘制经过的刷新周期数，
+    // 正常出帧时约为一个周期（含上一帧等待VSync），多出的周期就是掉的帧
+    Clock::time_point now = Clock::now();
+    Clock::time_point since = std::max(damagedAt, lastFrameAt);
+    int64_t intervals = (now - since + refreshInterval / 2) / refreshInterval;
+    if (intervals > 1) {
+        framesSkipped += static_cast<uint64_t>(intervals - 1);
+    }
+    lastFrameAt = now;
+    ++framesRendered;
+    return regions;
+}
@@ -0,0 +1,459 @@
+#include "ImagePrefetcher.h"
+#include "Trace.h"
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+// 不批量读取时，每张图片解码前提示预读的后续图片数
+const int kReadaheadCount = 2;
+
+} // namespace
+
+ImagePrefetcher::ImagePrefetcher() {
+}
+
+ImagePrefetcher::~ImagePrefetcher() {
+    Stop();
+}
+
+bool ImagePrefetcher::Start(int jobs) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (started) {
+            return true;
+        }
+        started = true;
+        stopping = false;
+        maxJobs = std::max(1, jobs);
+        queuedJobs = 0;
+        activeJobs = 0;
+        jobToken = CancelToken::Create();
+    }
+    std::cout << "ImagePrefetcher started with up to " << maxJobs << " concurrent decodes" << std::endl;
+    SetReadQueueDepth(readQueueDepth);
+    return true;
+}
+
+void ImagePrefetcher::SetReadQueueDepth(int depth) {
+    // 读取线程的完成回调要取mutex，不能持锁停止
+    reader.Stop();
+    bool running = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batchReads = false;
+        readQueueDepth = std::max(0, depth);
+        // 已提交的读取随reader停止丢弃，对应的图片改由解码线程自己读
+        reading.clear();
+        SubmitJobsLocked();
+        running = started;
+    }
+    if (depth <= 0 || !running) {
+        return;
+    }
+    bool readerStarted = reader.Start(depth, [this](uint64_t tag, std::unique_ptr<MappedFile> contents) {
+        OnFileRead(tag, std::move(contents));
+    });
+    std::lock_guard<std::mutex> lock(mutex);
+    batchReads = readerStarted;
+    if (batchReads && lastIndex >= 0) {
+        SubmitReadsLocked();
+    }
+}
+
+void ImagePrefetcher::Stop() {
+    reader.Stop();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        pending.clear();
+    }
+    workDone.notify_all();
+    // 排队的任务直接丢弃，等待正在解码的完成
+    JobScheduler::GetInstance().CancelAndWait(jobToken);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ClearReadyLocked();
+    batchReads = false;
+    reading.clear();
+    started = false;
+    queuedJobs = 0;
+    activeJobs = 0;
+}
+
+void ImagePrefetcher::Reset(int count, DecodeFunc decode, SourceFunc source) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++generation;
+    pending.clear();
+    ClearReadyLocked();
+    // 旧目录进行中的读取完成时按generation丢弃
+    reader.Cancel();
+    reading.clear();
+    decodeFunc = std::move(decode);
+    sourceFunc = std::move(source);
+    readaheadIssued.clear();
+    imageCount = count;
+    urgentIndex = -1;
+    windowLow = 0;
+    windowHigh = -1;
+    lastIndex = -1;
+    direction = 1;
+    navigateRate = 0.0f;
+}
+
+void ImagePrefetcher::SetWindowSize(int ahead, int behind) {
+    std::lock_guard<std::mutex> lock(mutex);
+    aheadCount = std::max(0, ahead);
+    behindCount = std::max(0, behind);
+    if (lastIndex >= 0) {
+        ScheduleLocked(lastIndex);
+    }
+}
+
+void ImagePrefetcher::Remap(int count, const std::vector<int>& remap, DecodeFunc decode, SourceFunc source) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto mapIndex = [&remap](int index) {
+        return index >= 0 && index < (int)remap.size() ? remap[index] : -1;
+    };
+    // 进行中的解码和读取按旧序号提交，按generation丢弃；已完成的结果换成新序号保留
+    ++generation;
+    reader.Cancel();
+    reading.clear();
+    std::map<int, std::unique_ptr<DecodedImage>> remappedReady;
+    for (auto& item : ready) {
+        int index = mapIndex(item.first);
+        if (index >= 0) {
+            remappedReady[index] = std::move(item.second);
+        }
+    }
+    ready.swap(remappedReady);
+    std::map<int, std::unique_ptr<MappedFile>> remappedFiles;
+    for (auto& item : loadedFiles) {
+        int index = mapIndex(item.first);
+        if (index >= 0) {
+            remappedFiles[index] = std::move(item.second);
+        }
+    }
+    loadedFiles.swap(remappedFiles);
+    std::set<int> remappedReadahead;
+    for (int index : readaheadIssued) {
+        if (mapIndex(index) >= 0) {
+            remappedReadahead.insert(mapIndex(index));
+        }
+    }
+    readaheadIssued.swap(remappedReadahead);
+    pending.clear();
+
+    decodeFunc = std::move(decode);
+    sourceFunc = std::move(source);
+    imageCount = count;
+    urgentIndex = mapIndex(urgentIndex);
+    lastIndex = mapIndex(lastIndex);
+    // 当前图片被删除时由接下来的OnNavigate重新调度
+    if (lastIndex >= 0) {
+        ScheduleLocked(lastIndex);
+    } else {
+        windowLow = 0;
+        windowHigh = -1;
+    }
+    if (urgentIndex >= 0 && !ready.count(urgentIndex)) {
+        pending.erase(std::remove(pending.begin(), pending.end(), urgentIndex), pending.end());
+        pending.push_front(urgentIndex);
+        SubmitJobsLocked();
+    }
+}
+
+void ImagePrefetcher::OnNavigate(int index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!decodeFunc || index < 0 || index >= imageCount) {
+        return;
+    }
+
+    // 记录导航方向，并用指数平滑估计翻页速度
+    Uint32 now = SDL_GetTicks();
+    if (lastIndex >= 0 && index != lastIndex) {
+        direction = index > lastIndex ? 1 : -1;
+        Uint32 elapsed = std::max<Uint32>(1, now - lastNavigateTicks);
+        float rate = 1000.0f * std::abs(index - lastIndex) / elapsed;
+        navigateRate = navigateRate * 0.7f + rate * 0.3f;
+    }
+    lastIndex = index;
+    lastNavigateTicks = now;
+
+    ScheduleLocked(index);
+}
+
+void ImagePrefetcher::ScheduleLocked(int center) {
+    // 快速翻页时加大前进方向的窗口，避免追上预取进度
+    int ahead = aheadCount;
+    if (navigateRate > 4.0f) {
+        ahead *= 2;
+    }
+    int behind = behindCount;
+
+    int aheadEnd = center + direction * ahead;
+    int behindEnd = center - direction * behind;
+    windowLow = std::max(0, std::min(aheadEnd, behindEnd));
+    windowHigh = std::min(imageCount - 1, std::max(aheadEnd, behindEnd));
+
+    // 丢弃窗口外的已解码图片
+    for (auto it = ready.begin(); it != ready.end();) {
+        if (!InWindowLocked(it->first)) {
+            it = ready.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = readaheadIssued.begin(); it != readaheadIssued.end();) {
+        if (!InWindowLocked(*it)) {
+            it = readaheadIssued.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = loadedFiles.begin(); it != loadedFiles.end();) {
+        if (!InWindowLocked(it->first)) {
+            it = loadedFiles.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // 按距离排列：前进方向优先，其次是反方向
+    pending.clear();
+    int maxDistance = std::max(ahead, behind);
+    for (int d = 1; d <= maxDistance; ++d) {
+        int candidates[2] = {
+            d <= ahead ? center + direction * d : -1,
+            d <= behind ? center - direction * d : -1
+        };
+        for (int index : candidates) {
+            if (index < 0 || index >= imageCount) continue;
+            if (ready.count(index) || inFlight.count(MakeTag(index))) continue;
+            pending.push_back(index);
+        }
+    }
+    if (batchReads) {
+        SubmitReadsLocked();
+    }
+    SubmitJobsLocked();
+}
+
+void ImagePrefetcher::SubmitJobsLocked() {
+    if (!started || stopping) {
+        return;
+    }
+    // 文件还在读取的图片等读完再提交
+    int runnable = 0;
+    for (int index : pending) {
+        if (!reading.count(index) && ++runnable == maxJobs) {
+            break;
+        }
+    }
+    // 每个任务只解码一张，完成后按当时的窗口重新提交，导航后跳过的图片不会再被解码
+    while (queuedJobs < runnable && queuedJobs + activeJobs < maxJobs) {
+        if (!JobScheduler::GetInstance().Submit(JobScheduler::Priority::Prefetch, [this]() { RunJob(); }, jobToken)) {
+            break;
+        }
+        ++queuedJobs;
+    }
+}
+
+void ImagePrefetcher::SubmitReadsLocked() {
+    // 窗口移动后尚未开始的读取按新的优先级重新提交
+    for (uint64_t tag : reader.Cancel()) {
+        if ((tag >> 32) == generation) {
+            reading.erase(static_cast<int>(tag & 0xFFFFFFFFu));
+        }
+    }
+    if (!sourceFunc) {
+        return;
+    }
+    std::vector<BatchReader::Request> batch;
+    std::vector<int> indices;
+    for (int index : pending) {
+        if (reading.count(index) || loadedFiles.count(index)) {
+            continue;
+        }
+        std::string path = sourceFunc(index);
+        if (path.empty()) {
+            continue;
+        }
+        batch.push_back({MakeTag(index), std::move(path)});
+        indices.push_back(index);
+    }
+    // 整个窗口一次提交，设备上同时有多个请求
+    if (!batch.empty() && reader.Submit(std::move(batch))) {
+        reading.insert(indices.begin(), indices.end());
+    }
+}
+
+void ImagePrefetcher::OnFileRead(uint64_t tag, std::unique_ptr<MappedFile> contents) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if ((tag >> 32) != generation) {
+            return;
+        }
+        int index = static_cast<int>(tag & 0xFFFFFFFFu);
+        if (!reading.erase(index)) {
+            return;
+        }
+        // 读取失败时不保存内容，解码线程自己再读一次并报告错误
+        if (contents && InWindowLocked(index) && std::find(pending.begin(), pending.end(), index) != pending.end()) {
+            loadedFiles[index] = std::move(contents);
+        }
+        SubmitJobsLocked();
+    }
+}
+
+std::deque<int>::iterator ImagePrefetcher::FindRunnableLocked() {
+    return std::find_if(pending.begin(), pending.end(), [this](int index) { return reading.count(index) == 0; });
+}
+
+bool ImagePrefetcher::InWindowLocked(int index) const {
+    return index >= windowLow && index <= windowHigh;
+}
+
+std::unique_ptr<DecodedImage> ImagePrefetcher::TakeImage(int index) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!decodeFunc) {
+        return nullptr;
+    }
+
+    // 正在解码的图片直接等待结果，避免重复解码
+    workDone.wait(lock, [this, index]() {
+        return stopping || inFlight.count(MakeTag(index)) == 0;
+    });
+
+    auto it = ready.find(index);
+    if (it == ready.end()) {
+        ++missCount;
+        return nullptr;
+    }
+    std::unique_ptr<DecodedImage> image = std::move(it->second);
+    ready.erase(it);
+    ++hitCount;
+    return image;
+}
+
+void ImagePrefetcher::ClearReadyLocked() {
+    ready.clear();
+}
+
+void ImagePrefetcher::RunJob() {
+    TRACE_SCOPE("ImagePrefetcher::RunJob");
+    int index;
+    uint64_t tag;
+    unsigned taskGeneration;
+    DecodeFunc decode;
+    std::unique_ptr<MappedFile> contents;
+    std::vector<std::string> readaheadPaths;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --queuedJobs;
+        // 文件还在读取的图片先跳过，按优先级取第一张可以解码的
+        auto next = FindRunnableLocked();
+        if (stopping || next == pending.end()) {
+            return;
+        }
+        index = *next;
+        pending.erase(next);
+        tag = MakeTag(index);
+        inFlight.insert(tag);
+        ++activeJobs;
+        taskGeneration = generation;
+        decode = decodeFunc;
+        auto loaded = loadedFiles.find(index);
+        if (loaded != loadedFiles.end()) {
+            contents = std::move(loaded->second);
+            loadedFiles.erase(loaded);
+        }
+        if (!batchReads && sourceFunc) {
+            readaheadIssued.insert(index);
+            for (int following : pending) {
+                if ((int)readaheadPaths.size() == kReadaheadCount) {
+                    break;
+                }
+                if (readaheadIssued.insert(following).second) {
+                    std::string path = sourceFunc(following);
+                    if (!path.empty()) {
+                        readaheadPaths.push_back(std::move(path));
+                    }
+                }
+            }
+        }
+    }
+
+    // 后续图片由内核在后台读入页缓存，轮到它们解码时不必等待磁盘
+    for (const std::string& path : readaheadPaths) {
+        MappedFile::WillNeed(path);
+    }
+    std::unique_ptr<DecodedImage> image = decode ? decode(index, std::move(contents)) : nullptr;
+
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight.erase(tag);
+        --activeJobs;
+        // 目录已切换或已离开窗口的结果直接丢弃
+        if (image && taskGeneration == generation && InWindowLocked(index) && !ready.count(index)) {
+            ready[index] = std::move(image);
+        }
+        wake = taskGeneration == generation && index == urgentIndex;
+        SubmitJobsLocked();
+    }
+    workDone.notify_all();
+    // 正在显示预览的图片已解码，唤醒UI线程替换
+    if (wake && wakeEventType != (Uint32)-1) {
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = wakeEventType;
+        SDL_PushEvent(&event);
+    }
+}
+
+void ImagePrefetcher::Request(int index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!decodeFunc || index < 0 || index >= imageCount) {
+        return;
+    }
+    urgentIndex = index;
+    if (ready.count(index) || inFlight.count(MakeTag(index))) {
+        return;
+    }
+    // 排在所有预取之前，并提交一个Visible优先级的任务，不等预取任务轮到
+    pending.erase(std::remove(pending.begin(), pending.end(), index), pending.end());
+    pending.push_front(index);
+    if (started && !stopping && !reading.count(index) &&
+        JobScheduler::GetInstance().Submit(JobScheduler::Priority::Visible, [this]() { RunJob(); }, jobToken)) {
+        ++queuedJobs;
+    }
+}
+
+void ImagePrefetcher::SetWakeEvent(Uint32 eventType) {
+    std::lock_guard<std::mutex> lock(mutex);
+    wakeEventType = eventType;
+}
+
+std::unique_ptr<DecodedImage> ImagePrefetcher::TryTakeImage(int index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = ready.find(index);
+    if (it == ready.end()) {
+        return nullptr;
+    }
+    std::unique_ptr<DecodedImage> image = std::move(it->second);
+    ready.erase(it);
+    ++hitCount;
+    return image;
+}
+
+bool ImagePrefetcher::HasImage(int index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ready.count(index) != 0;
+}
+
+bool ImagePrefetcher::IsQueued(int index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return inFlight.count(MakeTag(index)) != 0 || std::find(pending.begin(), pending.end(), index) != pending.end();
+}
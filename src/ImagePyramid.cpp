@@ -0,0 +1,113 @@
+#include "ImagePyramid.h"
+#include <algorithm>
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// 标量实现：每个输出像素取2x2源像素的平均值，奇数边界重复最后一行/列
+void DownsampleRowScalar(const Uint8* row0, const Uint8* row1, Uint8* dst, int srcWidth, int dstStart, int dstWidth) {
+    for (int x = dstStart; x < dstWidth; ++x) {
+        int x0 = 2 * x;
+        int x1 = std::min(x0 + 1, srcWidth - 1);
+        for (int c = 0; c < 4; ++c) {
+            int sum = row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c];
+            dst[x * 4 + c] = static_cast<Uint8>((sum + 2) >> 2);
+        }
+    }
+}
+
+#ifdef __SSE2__
+// 4个输入像素（两行）得到2个输出像素，16位精确求和后四舍五入
+inline __m128i Average2x2(__m128i top, __m128i bottom, __m128i zero) {
+    __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+    __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+    return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+// 每次处理8个源像素，输出4个像素；返回已处理的输出像素数
+int DownsampleRowSSE2(const Uint8* row0, const Uint8* row1, Uint8* dst, int dstWidth) {
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 4 <= dstWidth; x += 4) {
+        const Uint8* s0 = row0 + x * 8;
+        const Uint8* s1 = row1 + x * 8;
+        __m128i a = Average2x2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s0)),
+                               _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1)), zero);
+        __m128i b = Average2x2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s0 + 16)),
+                               _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1 + 16)), zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(a, b));
+    }
+    return x;
+}
+#endif
+
+} // namespace
+
+SDL_Surface* ImagePyramid::Downsample2x(SDL_Surface* source) {
+    if (!source || source->format->BytesPerPixel != 4) {
+        return nullptr;
+    }
+    int srcWidth = source->w;
+    int srcHeight = source->h;
+    int dstWidth = std::max(1, srcWidth / 2);
+    int dstHeight = std::max(1, srcHeight / 2);
+
+    SDL_Surface* dest = SDL_CreateRGBSurfaceWithFormat(0, dstWidth, dstHeight, 32, source->format->format);
+    if (!dest) {
+        return nullptr;
+    }
+    SDL_SetSurfaceBlendMode(dest, SDL_BLENDMODE_NONE);
+
+    if (SDL_MUSTLOCK(source)) {
+        SDL_LockSurface(source);
+    }
+    const Uint8* srcPixels = static_cast<const Uint8*>(source->pixels);
+    Uint8* dstPixels = static_cast<Uint8*>(dest->pixels);
+    for (int y = 0; y < dstHeight; ++y) {
+        const Uint8* row0 = srcPixels + static_cast<size_t>(2 * y) * source->pitch;
+        const Uint8* row1 = srcPixels + static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * source->pitch;
+        Uint8* dst = dstPixels + static_cast<size_t>(y) * dest->pitch;
+        int done = 0;
+#ifdef __SSE2__
+        // 源宽度为1时没有完整的像素对，只走标量路径
+        if (srcWidth >= 2) {
+            done = DownsampleRowSSE2(row0, row1, dst, dstWidth);
+        }
+#endif
+        DownsampleRowScalar(row0, row1, dst, srcWidth, done, dstWidth);
+    }
+    if (SDL_MUSTLOCK(source)) {
+        SDL_UnlockSurface(source);
+    }
+    return dest;
+}
+
+void ImagePyramid::Build(DecodedImage& image, int minSize) {
+    if (image.levels.empty()) {
+        return;
+    }
+    while (true) {
+        SDL_Surface* last = image.levels.back();
+        if (std::max(last->w, last->h) <= minSize || (last->w == 1 && last->h == 1)) {
+            break;
+        }
+        SDL_Surface* next = Downsample2x(last);
+        if (!next) {
+            break;
+        }
+        image.levels.push_back(next);
+    }
+}
+
+int ImagePyramid::SelectLevel(float scale, int levelCount) {
+    if (levelCount <= 1 || scale >= 1.0f || scale <= 0.0f) {
+        return 0;
+    }
+    // 选择scale * 2^level <= 1的最大层级，剩余缩小由线性过滤完成
+    int level = static_cast<int>(std::floor(std::log2(1.0f / scale)));
+    return std::max(0, std::min(level, levelCount - 1));
+}
@@ -1,12 +1,22 @@
 #include "ImageViewer.h"
 #include <iostream>
 #include <algorithm>
-#include <filesystem>
-#include <archive.h>
-#include <archive_entry.h>
+#include <cmath>
+#include <map>
+#include <set>
+#include "ArchiveStream.h"
+#include "ImagePyramid.h"
+#include "Resampler.h"
+#include "ExifPreview.h"
+#include "JpegDecoder.h"
+#include "ProgressiveDecoder.h"
+#include "DirectoryScanner.h"
+#include "JobScheduler.h"
+#include "MappedFile.h"
+#include "Trace.h"
 
 ImageViewer::ImageViewer() 
-    : window(nullptr), renderer(nullptr), isRunning(false), isFullscreen(false), hasOpenedFile(false), needsRedraw(true),
+    : window(nullptr), renderer(nullptr), isRunning(false), isFullscreen(false), hasOpenedFile(false),
       imageScale(1.0f), imageOffsetX(0), imageOffsetY(0),
       scaleFactor(1.0f), windowWidth(800), windowHeight(600), lastWindowWidth(800), lastWindowHeight(600),
       currentImageIndex(-1) {
@@ -17,6 +27,7 @@ ImageViewer::~ImageViewer() {
 }
 
 bool ImageViewer::Initialize(int width, int height) {
+    Trace::SetThreadName("UI");
     windowWidth = width;
     windowHeight = height;
     lastWindowWidth = width;
@@ -59,6 +70,40 @@ bool ImageViewer::Initialize(int width, int height) {
     
     // 设置渲染器颜色
     SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF);
+
+    // 按显示器刷新率统计掉帧
+    SDL_DisplayMode displayMode;
+    if (SDL_GetWindowDisplayMode(window, &displayMode) == 0) {
+        frameScheduler.SetRefreshRate(displayMode.refresh_rate);
+    }
+
+    // 记录渲染器首选的纹理格式，解码线程提前转换，上传时无需再转换
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) == 0) {
+        for (Uint32 i = 0; i < info.num_texture_formats; ++i) {
+            if (!SDL_ISPIXELFORMAT_FOURCC(info.texture_formats[i])) {
+                textureFormat = info.texture_formats[i];
+                break;
+            }
+        }
+        // 软件渲染器不限制纹理尺寸，报告为0
+        if (info.max_texture_width > 0 && info.max_texture_height > 0) {
+            maxTextureSize = std::min(info.max_texture_width, info.max_texture_height);
+        }
+    }
+
+    // 分块解码或当前图片的后台解码完成时唤醒事件循环
+    wakeEventType = SDL_RegisterEvents(1);
+    prefetcher.SetWakeEvent(wakeEventType);
+
+    // 所有后台工作共用一个线程池，保留一个核心给UI线程；对话框打开期间会占用一个线程
+    JobScheduler::GetInstance().Start(std::max(2, SDL_GetCPUCount() - 1), wakeEventType);
+    prefetcher.Start(std::max(1, std::min(4, SDL_GetCPUCount() - 1)));
+    thumbnailStore.Open(ThumbnailStore::DefaultDirectory());
+    signatureStore.Open(ThumbnailStore::DefaultDirectory());
+    thumbnailGrid.Start(std::max(1, std::min(4, SDL_GetCPUCount() - 1)), wakeEventType, textureFormat);
+    // 固实压缩包的解码任务只在预加载期间提交，可以占满线程池
+    archivePipelineOptions.maxJobs = JobScheduler::GetInstance().GetThreadCount();
     
  
     // 初始化字体管理器
@@ -91,134 +136,389 @@ bool ImageViewer::Initialize(int width, int height) {
     UpdateScaleFactor();
     menuBar.SetScaleFactor(scaleFactor);
     menuBar.UpdateLayout(windowWidth, windowHeight);
+    UpdateFitArea();
+    std::cout << "Resampler: " << Resampler::IsaName(Resampler::DetectIsa()) << std::endl;
     
     isRunning = true;
+    MarkForRedraw();
     std::cout << "SDL initialized successfully!" << std::endl;
     return true;
 }
 
 void ImageViewer::Run() {
     while (isRunning) {
+        // 没有待绘制的内容时阻塞等待事件；还有分条上传时每个刷新周期醒来继续上传，不空转
+        if (!frameScheduler.HasDamage()) {
+            SDL_Event e;
+            int received = textureUploader.HasPending()
+                ? SDL_WaitEventTimeout(&e, frameScheduler.GetRefreshIntervalMs())
+                : SDL_WaitEvent(&e);
+            if (received) {
+                HandleEvent(e);
+            }
+        }
+        // 取出绘制期间积压的所有事件，合并为一帧；VSync下每个刷新周期最多绘制一帧
         HandleEvents();
-        
-        // 只在需要时重绘
-        if (needsRedraw) {
-            Render();
-            needsRedraw = false;
+        // 后台任务交给主线程的回调每帧执行一次
+        JobScheduler::GetInstance().DrainCompletions();
+        // 大纹理每帧只上传预算内的几条，输入和菜单不必等整张传完
+        if (textureUploader.Pump(textureCache) > 0) {
+            MarkForRedraw(FrameScheduler::kImage);
+        }
+        if (isRunning && frameScheduler.HasDamage()) {
+            Render(frameScheduler.TakeDamage());
         }
-        
-        // 使用更长的延迟以节能，或者等待事件
-        SDL_WaitEventTimeout(nullptr, 16); // 最多等待16ms，如果有事件则立即返回
     }
 }
 
 void ImageViewer::HandleEvents() {
     SDL_Event e;
     while (SDL_PollEvent(&e) != 0) {
-        // 先让菜单栏处理事件
-        menuBar.HandleEvent(e);
-        switch (e.type) {
-            case SDL_QUIT:
-                isRunning = false;
+        HandleEvent(e);
+    }
+}
+
+void ImageViewer::HandleEvent(const SDL_Event& e) {
+    if (e.type == wakeEventType) {
+        if (folderWatcher.HasChanges()) {
+            ApplyFolderChanges();
+        }
+        // 每次只上传少量页面，其余留到下一轮事件，避免阻塞输入
+        if (archivePipeline.IsRunning() && UploadArchiveResults(2) == 2) {
+            SDL_Event wake;
+            SDL_zero(wake);
+            wake.type = wakeEventType;
+            SDL_PushEvent(&wake);
+        }
+        // 后台完成了新的图块，重绘时上传
+        MarkForRedraw(FrameScheduler::kImage);
+        return;
+    }
+    // 先让菜单栏处理事件，外观变化只重绘菜单；下拉菜单展开或收起时其下方的图片也要重画
+    menuBar.HandleEvent(e);
+    bool dropdownToggled = false;
+    if (menuBar.TakeDamage(&dropdownToggled)) {
+        MarkForRedraw(dropdownToggled ? FrameScheduler::kAll : FrameScheduler::kMenuBar);
+    }
+    switch (e.type) {
+        case SDL_QUIT:
+            isRunning = false;
+            break;
+        case SDL_KEYDOWN:
+            if (gridMode && HandleGridKey(e.key.keysym.sym)) {
+                MarkForRedraw(FrameScheduler::kImage);
                 break;
-            case SDL_KEYDOWN:
-                switch (e.key.keysym.sym) {
-                    case SDLK_ESCAPE:
-                        if (isFullscreen) {
-                            ToggleFullscreen();
-                        } else {
-                            isRunning = false;
-                        }
-                        break;
-                    case SDLK_F11:
+            }
+            switch (e.key.keysym.sym) {
+                case SDLK_ESCAPE:
+                    if (isFullscreen) {
                         ToggleFullscreen();
-                        break;
-                    case SDLK_m:
-                        if (e.key.keysym.mod & KMOD_CTRL) {
-                            MinimizeWindow();
-                        }
-                        break;
-                    case SDLK_q:
-                        if (e.key.keysym.mod & KMOD_CTRL) {
-                            isRunning = false;
-                        }
-                        break;
-                    case SDLK_LEFT:
-                        // 上一张
-                        if (images.size() > 1 && currentImageIndex > 0) {
-                            --currentImageIndex;
-                            FitImageToWindow();
-                            CenterImage();
-                            MarkForRedraw();
-                        }
-                        break;
-                    case SDLK_RIGHT:
-                        // 下一张
-                        if (images.size() > 1 && currentImageIndex < (int)images.size() - 1) {
-                            ++currentImageIndex;
-                            FitImageToWindow();
-                            CenterImage();
-                            MarkForRedraw();
-                        }
-                        break;
+                    } else {
+                        isRunning = false;
+                    }
+                    break;
+                case SDLK_F11:
+                    ToggleFullscreen();
+                    break;
+                case SDLK_F12:
+                    ToggleTrace();
+                    break;
+                case SDLK_m:
+                    if (e.key.keysym.mod & KMOD_CTRL) {
+                        MinimizeWindow();
+                    }
+                    break;
+                case SDLK_q:
+                    if (e.key.keysym.mod & KMOD_CTRL) {
+                        isRunning = false;
+                    }
+                    break;
+                case SDLK_LEFT:
+                    // 上一张
+                    if (images->size() > 1 && currentImageIndex > 0) {
+                        ShowImage(currentImageIndex - 1);
+                    }
+                    break;
+                case SDLK_RIGHT:
+                    // 下一张
+                    if (images->size() > 1 && currentImageIndex < (int)images->size() - 1) {
+                        ShowImage(currentImageIndex + 1);
+                    }
+                    break;
+                case SDLK_g:
+                    // 缩略图网格
+                    ShowGrid(true);
+                    break;
+                case SDLK_0:
+                    // 适应窗口
+                    FitImageToWindow();
+                    CenterImage();
+                    break;
+                case SDLK_1:
+                    // 原始大小，以窗口中心缩放
+                    if (imageScale > 0.0f) {
+                        ZoomAt(1.0f / imageScale, windowWidth / 2, (windowHeight + menuBar.GetHeight()) / 2);
+                    }
+                    break;
+                case SDLK_d: {
+                    // 在重复图片之间跳转
+                    int target = NextDuplicate(currentImageIndex);
+                    if (target >= 0 && target != currentImageIndex) {
+                        ShowImage(target);
+                    }
+                    break;
                 }
-                MarkForRedraw(); // 键盘事件后标记重绘
-                break;
-                
-            case SDL_WINDOWEVENT:
-                if (e.window.event == SDL_WINDOWEVENT_CLOSE) {
-                    isRunning = false;
-                } else if (e.window.event == SDL_WINDOWEVENT_RESIZED) {
-                    HandleWindowResize(e.window.data1, e.window.data2);
-                    MarkForRedraw(); // 窗口大小改变后标记重绘
-                } else if (e.window.event == SDL_WINDOWEVENT_EXPOSED) {
-                    MarkForRedraw(); // 窗口暴露事件后标记重绘
+            }
+            MarkForRedraw(FrameScheduler::kImage); // 键盘事件后标记重绘
+            break;
+            
+        case SDL_WINDOWEVENT:
+            if (e.window.event == SDL_WINDOWEVENT_CLOSE) {
+                isRunning = false;
+            } else if (e.window.event == SDL_WINDOWEVENT_RESIZED) {
+                HandleWindowResize(e.window.data1, e.window.data2);
+                MarkForRedraw(); // 窗口大小改变后标记重绘
+            } else if (e.window.event == SDL_WINDOWEVENT_EXPOSED) {
+                MarkForRedraw(); // 窗口暴露事件后标记重绘
+            }
+            break;
+
+        case SDL_RENDER_TARGETS_RESET:
+        case SDL_RENDER_DEVICE_RESET:
+            // 帧纹理和分条上传的目标纹理内容已丢失，图片纹理在显示时重新上传
+            textureUploader.Clear();
+            textureCache.Clear();
+            MarkForRedraw();
+            break;
+            
+        case SDL_MOUSEWHEEL: {
+            // 以光标为中心缩放
+            int mouseX, mouseY;
+            SDL_GetMouseState(&mouseX, &mouseY);
+            int steps = e.wheel.direction == SDL_MOUSEWHEEL_FLIPPED ? -e.wheel.y : e.wheel.y;
+            if (gridMode) {
+                // 每格滚动一行
+                thumbnailGrid.Scroll(-steps * thumbnailGrid.GetCellSize());
+                MarkForRedraw(FrameScheduler::kImage);
+            } else if (steps != 0) {
+                ZoomAt(std::pow(1.15f, static_cast<float>(steps)), mouseX, mouseY);
+            }
+            break;
+        }
+
+        case SDL_MOUSEBUTTONDOWN:
+            if (gridMode) {
+                // 单击选中，双击打开；按住滚动条拖动
+                if (e.button.button != SDL_BUTTON_LEFT || e.button.y < menuBar.GetHeight() || menuBar.IsDropdownVisible()) {
+                    break;
                 }
+                if (thumbnailGrid.HitScrollbar(e.button.x, e.button.y)) {
+                    isDraggingScrollbar = true;
+                    thumbnailGrid.ScrollToFraction(static_cast<float>(e.button.y - menuBar.GetHeight()) / std::max(1, windowHeight - menuBar.GetHeight()));
+                } else {
+                    int index = thumbnailGrid.HitTest(e.button.x, e.button.y);
+                    if (index >= 0 && e.button.clicks >= 2) {
+                        ShowGrid(false);
+                        ShowImage(index);
+                    } else if (index >= 0) {
+                        thumbnailGrid.SetSelected(index);
+                    }
+                }
+                MarkForRedraw(FrameScheduler::kImage);
                 break;
-                
-            case SDL_MOUSEBUTTONDOWN:
-            case SDL_MOUSEBUTTONUP:
-            case SDL_MOUSEMOTION:
-                MarkForRedraw(); // 鼠标事件后标记重绘
-                break;
-        }
+            }
+            // 在图片区域按下左键开始拖动
+            if (e.button.button == SDL_BUTTON_LEFT && e.button.y >= menuBar.GetHeight() && !menuBar.IsDropdownVisible()) {
+                isPanning = true;
+                panStartX = e.button.x;
+                panStartY = e.button.y;
+                panOriginX = imageOffsetX;
+                panOriginY = imageOffsetY;
+            }
+            break;
+        case SDL_MOUSEBUTTONUP:
+            if (e.button.button == SDL_BUTTON_LEFT) {
+                isPanning = false;
+                isDraggingScrollbar = false;
+            }
+            break;
+        case SDL_MOUSEMOTION:
+            // 未拖动时的移动只可能改变菜单悬停状态，上面已处理
+            if (isDraggingScrollbar) {
+                thumbnailGrid.ScrollToFraction(static_cast<float>(e.motion.y - menuBar.GetHeight()) / std::max(1, windowHeight - menuBar.GetHeight()));
+                MarkForRedraw(FrameScheduler::kImage);
+            } else if (isPanning) {
+                imageOffsetX = panOriginX + (e.motion.x - panStartX);
+                imageOffsetY = panOriginY + (e.motion.y - panStartY);
+                MarkForRedraw(FrameScheduler::kImage);
+            }
+            break;
     }
 }
 
-void ImageViewer::Render() {
-    // 清除屏幕
-    if (hasOpenedFile) {
-        SDL_SetRenderDrawColor(renderer, 0x20, 0x20, 0x20, 0xFF); // 深灰色背景
-    } else {
-        SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF); // 白色背景
+bool ImageViewer::EnsureFrameTarget() {
+    if (!SDL_RenderTargetSupported(renderer)) {
+        return false;
     }
-    SDL_RenderClear(renderer);
-    
-    if (hasOpenedFile && currentImageIndex >= 0 && currentImageIndex < (int)images.size() && images[currentImageIndex].texture) {
-        // 渲染图片
-        RenderImage();
-    } else if (hasOpenedFile) {
-        // 如果文件打开但图片加载失败，显示错误信息
-        int menuHeight = menuBar.GetHeight();
-        int centerX = windowWidth / 2;
-        int centerY = (windowHeight + menuHeight) / 2;
+    int outputWidth, outputHeight;
+    SDL_GetRendererOutputSize(renderer, &outputWidth, &outputHeight);
+    if (frameTarget && frameTargetWidth == outputWidth && frameTargetHeight == outputHeight) {
+        return true;
+    }
+    if (frameTarget) {
+        SDL_DestroyTexture(frameTarget);
+    }
+    frameTarget = SDL_CreateTexture(renderer, textureFormat, SDL_TEXTUREACCESS_TARGET, outputWidth, outputHeight);
+    if (!frameTarget) {
+        std::cerr << "Unable to create frame target! SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    frameTargetWidth = outputWidth;
+    frameTargetHeight = outputHeight;
+    // 新纹理内容未定义，需要整帧重绘
+    return false;
+}
+
+void ImageViewer::Render(unsigned damage) {
+    TRACE_SCOPE("Render");
+    // 后备缓冲区的内容在Present后未定义，局部重绘画在保留上一帧的帧纹理上
+    bool reuseTarget = EnsureFrameTarget();
+    if (frameTarget) {
+        SDL_SetRenderTarget(renderer, frameTarget);
+    }
+    if (!reuseTarget) {
+        damage = FrameScheduler::kAll;
+    }
+
+    int menuHeight = menuBar.GetHeight();
+    if (damage & FrameScheduler::kImage) {
+        // 只有图片区域损坏时不重画菜单栏一行
+        SDL_Rect imageArea = {0, menuHeight, windowWidth, windowHeight - menuHeight};
+        bool clipped = !(damage & FrameScheduler::kMenuBar);
+        if (clipped) {
+            SDL_RenderSetClipRect(renderer, &imageArea);
+        }
+
+        // 清除屏幕
+        if (hasOpenedFile) {
+            SDL_SetRenderDrawColor(renderer, 0x20, 0x20, 0x20, 0xFF); // 深灰色背景
+        } else {
+            SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF); // 白色背景
+        }
+        SDL_RenderClear(renderer);
         
-        FontManager& fontManager = FontManager::GetInstance();
-        SDL_Color errorColor = {255, 100, 100, 255}; // 红色
-        SDL_Rect errorRect = {centerX - 150, centerY - 10, 300, 20};
-        fontManager.RenderTextCentered(renderer, "Failed to load image", errorRect, errorColor, FontManager::FontSize::MEDIUM);
-    } else {
-        // 显示欢迎界面
-        RenderWelcomeScreen();
+        if (gridMode) {
+            // 缩略图网格
+            thumbnailGrid.Render(renderer);
+        } else if (hasOpenedFile && currentImageIndex >= 0 && currentImageIndex < (int)images->size() && !(*images)[currentImageIndex].loadFailed) {
+            // 渲染图片
+            RenderImage();
+        } else if (hasOpenedFile) {
+            // 如果文件打开但图片加载失败，显示错误信息
+            int centerX = windowWidth / 2;
+            int centerY = (windowHeight + menuHeight) / 2;
+            
+            FontManager& fontManager = FontManager::GetInstance();
+            SDL_Color errorColor = {255, 100, 100, 255}; // 红色
+            SDL_Rect errorRect = {centerX - 150, centerY - 10, 300, 20};
+            fontManager.RenderTextCentered(renderer, "Failed to load image", errorRect, errorColor, FontManager::FontSize::MEDIUM);
+        } else {
+            // 显示欢迎界面
+            RenderWelcomeScreen();
+        }
+        // 最后渲染菜单栏，确保它在最上层（裁剪时只留下展开的下拉菜单）
+        menuBar.Render(renderer);
+        if (clipped) {
+            SDL_RenderSetClipRect(renderer, nullptr);
+        }
+    } else if (damage & FrameScheduler::kMenuBar) {
+        // 菜单栏和下拉菜单都不透明，只在其范围内重画
+        SDL_Rect bounds = menuBar.GetBounds();
+        SDL_RenderSetClipRect(renderer, &bounds);
+        menuBar.Render(renderer);
+        SDL_RenderSetClipRect(renderer, nullptr);
+    }
+
+    if (frameTarget) {
+        SDL_SetRenderTarget(renderer, nullptr);
+        SDL_RenderCopy(renderer, frameTarget, nullptr, nullptr);
     }
-    // 最后渲染菜单栏，确保它在最上层
-    menuBar.Render(renderer);
     // 更新屏幕
     SDL_RenderPresent(renderer);
 }
 
+void ImageViewer::SetPrefetchWindow(int ahead, int behind) {
+    prefetcher.SetWindowSize(ahead, behind);
+    std::cout << "Prefetch window set to: " << ahead << " ahead, " << behind << " behind" << std::endl;
+}
+
+void ImageViewer::SetReadQueueDepth(int depth) {
+    prefetcher.SetReadQueueDepth(depth);
+}
+
+void ImageViewer::SetUploadBudget(double milliseconds) {
+    textureUploader.SetBudget(std::max(0.0, milliseconds));
+    std::cout << "Upload budget set to: " << textureUploader.GetBudget() << " ms per frame" << std::endl;
+}
+
+void ImageViewer::SetTextureCacheBudget(size_t megabytes) {
+    textureCache.SetBudgetMB(megabytes);
+}
+
+void ImageViewer::SetThumbnailCacheLimit(size_t megabytes) {
+    thumbnailStore.SetSizeLimit(static_cast<uint64_t>(megabytes) << 20);
+}
+
+void ImageViewer::SetTraceFile(const std::string& path, bool recordNow) {
+    traceFile = path;
+    if (recordNow) {
+        Trace::SetEnabled(true);
+    }
+}
+
 void ImageViewer::Cleanup() {
-    ClearImage();
+    if (prefetcher.GetHitCount() + prefetcher.GetMissCount() > 0) {
+        std::cout << "Prefetch hits: " << prefetcher.GetHitCount()
+                  << ", misses: " << prefetcher.GetMissCount() << std::endl;
+    }
+    if (textureCache.GetHitCount() + textureCache.GetMissCount() > 0) {
+        std::cout << "Texture cache hits: " << textureCache.GetHitCount()
+                  << ", misses: " << textureCache.GetMissCount()
+                  << ", evictions: " << textureCache.GetEvictionCount() << std::endl;
+    }
+    if (frameScheduler.GetFramesRendered() > 0) {
+        std::cout << "Frames rendered: " << frameScheduler.GetFramesRendered()
+                  << ", skipped: " << frameScheduler.GetFramesSkipped() << std::endl;
+    }
+    if (thumbnailStore.GetHitCount() + thumbnailStore.GetMissCount() > 0) {
+        std::cout << "Thumbnail cache hits: " << thumbnailStore.GetHitCount()
+                  << ", misses: " << thumbnailStore.GetMissCount()
+                  << ", stale: " << thumbnailStore.GetStaleCount() << std::endl;
+    }
+    if (signatureStore.GetHitCount() + signatureStore.GetMissCount() > 0) {
+        std::cout << "Signature cache hits: " << signatureStore.GetHitCount()
+                  << ", misses: " << signatureStore.GetMissCount() << std::endl;
+    }
+    // 先清空目录并停止监视，之后不会再有组件重新提交后台任务
+    ClearAllImages();
+    prefetcher.Stop();
+    thumbnailGrid.Stop();
+    if (Trace::IsEnabled()) {
+        ToggleTrace();
+    }
+    thumbnailStore.Close();
+    signatureStore.Close();
+    // 各组件的任务都已取消或完成
+    JobScheduler::GetInstance().Stop();
+    // 纹理必须在渲染器之前释放
+    textureUploader.Clear();
+    textureCache.Clear();
+    thumbnailGrid.ReleaseTextures();
+    if (frameTarget) {
+        SDL_DestroyTexture(frameTarget);
+        frameTarget = nullptr;
+    }
+    FontManager::GetInstance().ReleaseTextures();
     
     if (renderer) {
         SDL_DestroyRenderer(renderer);
@@ -256,31 +556,205 @@ void ImageViewer::OnFileOpened(const std::string& filename) {
 }
 
 void ImageViewer::OnFolderOpened(const std::string& folderpath) {
+    TRACE_SCOPE("OnFolderOpened");
     ClearAllImages(); // 先清除之前的图片
     std::cout << "Folder opened: " << folderpath << std::endl;
     hasOpenedFile = true;
     SDL_SetWindowTitle(window, ("Image Viewer - " + folderpath).c_str());
-    // TODO: 在这里添加浏览文件夹中图片的逻辑
-
-    //将图片添加到images
     MarkForRedraw(); // 打开文件夹后标记重绘
-    //遍历folderpath下的图片文件，加载到images中
-    for (const auto& entry : std::filesystem::directory_iterator(folderpath)) {
-        if (entry.is_regular_file() && (entry.path().extension() == ".png"|| entry.path().extension() == ".jpg" || entry.path().extension() == ".jpeg" || entry.path().extension() == ".bmp" || entry.path().extension() == ".tif" || entry.path().extension() == ".tiff"||entry.path().extension() == ".webp")) {
-            LoadImage(entry.path().string());
-        }
+    // 先开始监视，扫描期间的变更稍后合并，不会遗漏
+    if (folderWatcher.Start(folderpath, wakeEventType)) {
+        watchedFolder = folderpath;
     }
+    // 并行遍历folderpath及其子目录，按文件头识别图片，只记录路径，不解码
+    DirectoryScanner::Options options;
+    options.threads = std::max(2, std::min(8, SDL_GetCPUCount()));
+    for (const std::string& path : DirectoryScanner::Scan(folderpath, options)) {
+        ImageData item;
+        item.path = path;
+        item.key = path;
+        images->push_back(item);
+    }
+    std::cout << "Folder catalog built: " << images->size() << " images" << std::endl;
+    StartPrefetch();
 
-    if (!images.empty()) {
-        currentImageIndex = 0;
-        FitImageToWindow();
-        CenterImage();
+    if (!images->empty()) {
+        // 只解码第一张
+        ShowImage(0);
     } else {
         currentImageIndex = -1; // 没有图片
     }
 
 }
 
+void ImageViewer::ApplyFolderChanges() {
+    TRACE_SCOPE("ApplyFolderChanges");
+    std::vector<FolderWatcher::Change> changes = folderWatcher.TakeChanges();
+    if (changes.empty() || watchedFolder.empty()) {
+        return;
+    }
+    // 文件夹中的图片以路径为键；stale中的图片内容已变或已不存在，丢弃其纹理和解码状态
+    std::set<std::string> paths;
+    for (const ImageData& item : *images) {
+        paths.insert(item.key);
+    }
+    std::set<std::string> stale;
+    std::map<std::string, std::string> renamed;
+    auto removePrefix = [&](const std::string& directory) {
+        std::string prefix = directory + "/";
+        for (auto it = paths.lower_bound(prefix); it != paths.end() && it->compare(0, prefix.size(), prefix) == 0;) {
+            stale.insert(*it);
+            it = paths.erase(it);
+        }
+    };
+    for (const FolderWatcher::Change& change : changes) {
+        switch (change.type) {
+            case FolderWatcher::Change::Type::Added:
+            case FolderWatcher::Change::Type::Modified:
+                stale.insert(change.path);
+                if (DirectoryScanner::SniffFile(change.path)) {
+                    paths.insert(change.path);
+                } else {
+                    paths.erase(change.path);
+                }
+                break;
+            case FolderWatcher::Change::Type::Removed:
+                if (change.directory) {
+                    removePrefix(change.path);
+                } else if (paths.erase(change.path)) {
+                    stale.insert(change.path);
+                }
+                break;
+            case FolderWatcher::Change::Type::Renamed:
+                if (paths.erase(change.oldPath)) {
+                    stale.insert(change.oldPath);
+                    renamed[change.oldPath] = change.path;
+                }
+                stale.insert(change.path);
+                if (DirectoryScanner::SniffFile(change.path)) {
+                    paths.insert(change.path);
+                } else {
+                    paths.erase(change.path);
+                }
+                break;
+            case FolderWatcher::Change::Type::Rescan: {
+                // 事件丢失，无法确定哪些文件被改写，全部重新加载
+                for (const ImageData& item : *images) {
+                    stale.insert(item.key);
+                }
+                DirectoryScanner::Options options;
+                options.threads = std::max(2, std::min(8, SDL_GetCPUCount()));
+                std::vector<std::string> scanned = DirectoryScanner::Scan(watchedFolder, options);
+                paths = std::set<std::string>(scanned.begin(), scanned.end());
+                break;
+            }
+        }
+    }
+
+    // 新目录：未变的图片保留层级数、尺寸等状态，其余重新记录
+    std::map<std::string, const ImageData*> previous;
+    for (const ImageData& item : *images) {
+        previous[item.key] = &item;
+    }
+    std::vector<ImageData> updated;
+    updated.reserve(paths.size());
+    for (const std::string& path : paths) {
+        auto it = previous.find(path);
+        if (it != previous.end() && !stale.count(path)) {
+            updated.push_back(*it->second);
+        } else {
+            ImageData item;
+            item.path = path;
+            item.key = path;
+            updated.push_back(item);
+        }
+    }
+    std::sort(updated.begin(), updated.end(), [](const ImageData& a, const ImageData& b) {
+        return DirectoryScanner::CatalogLess(a.key, b.key);
+    });
+    for (const ImageData& item : *images) {
+        if (!stale.count(item.key)) {
+            continue;
+        }
+        textureUploader.Cancel(item.key);
+        for (int level = 0; level < std::max(1, item.levelCount); ++level) {
+            textureCache.Remove(LevelKey(item, level));
+        }
+        textureCache.Remove(FitKey(item));
+        textureCache.Remove(PreviewKey(item));
+    }
+
+    // 按路径把旧序号映射到新目录；图片已删除时停在原位置的下一张
+    auto remap = [&](int index, bool* changed) -> int {
+        if (index < 0 || index >= (int)images->size() || updated.empty()) {
+            *changed = true;
+            return -1;
+        }
+        std::string key = (*images)[index].key;
+        *changed = stale.count(key) > 0;
+        for (size_t hops = 0; renamed.count(key) && hops < renamed.size(); ++hops) {
+            key = renamed[key];
+        }
+        auto it = std::lower_bound(updated.begin(), updated.end(), key, [](const ImageData& item, const std::string& k) {
+            return DirectoryScanner::CatalogLess(item.key, k);
+        });
+        if (it == updated.end()) {
+            *changed = true;
+            return (int)updated.size() - 1;
+        }
+        if (it->key != key) {
+            *changed = true;
+        }
+        return (int)(it - updated.begin());
+    };
+    bool currentChanged = false;
+    int current = remap(currentImageIndex, &currentChanged);
+    bool tiledChanged = true;
+    int tiled = tiledImage ? remap(tiledIndex, &tiledChanged) : -1;
+    bool selectionChanged = false;
+    int selected = remap(thumbnailGrid.GetSelected(), &selectionChanged);
+
+    // 未变的图片旧序号到新序号的映射，增删改的图片为-1
+    std::vector<int> oldToNew(images->size(), -1);
+    for (size_t index = 0; index < images->size(); ++index) {
+        bool changed = false;
+        int mapped = remap((int)index, &changed);
+        if (!changed) {
+            oldToNew[index] = mapped;
+        }
+    }
+    // 后台加载的预览按previewIndex投递，图片未变时换成新序号继续加载
+    if (previewIndex >= 0 && oldToNew[previewIndex] < 0) {
+        CancelPreviewLoad();
+    }
+    if (previewIndex >= 0) {
+        previewIndex = oldToNew[previewIndex];
+    }
+
+    size_t previousCount = images->size();
+    images = std::make_shared<std::vector<ImageData>>(std::move(updated));
+    if (tiledChanged) {
+        ReleaseTiledImage();
+    } else {
+        tiledIndex = tiled;
+    }
+    StartPrefetch(&oldToNew);
+    if (images->empty()) {
+        ShowGrid(false);
+        currentImageIndex = -1;
+        ClearImage();
+    } else if (currentChanged) {
+        ShowImage(current);
+    } else {
+        currentImageIndex = current;
+        prefetcher.OnNavigate(current);
+    }
+    thumbnailGrid.SetSelected(std::max(0, selected));
+    std::cout << "Folder updated: " << changes.size() << " changes, " << previousCount << " -> "
+              << images->size() << " images" << std::endl;
+    MarkForRedraw();
+}
+
 void ImageViewer::RenderWelcomeScreen() {
     int menuHeight = menuBar.GetHeight();
     
@@ -342,6 +816,16 @@ void ImageViewer::ToggleFullscreen() {
     MarkForRedraw(); // 全屏切换后标记重绘
 }
 
+void ImageViewer::ToggleTrace() {
+    if (Trace::IsEnabled()) {
+        Trace::SetEnabled(false);
+        Trace::Export(traceFile);
+    } else {
+        std::cout << "Tracing started, press F12 again to write " << traceFile << std::endl;
+        Trace::SetEnabled(true);
+    }
+}
+
 void ImageViewer::MinimizeWindow() {
     SDL_MinimizeWindow(window);
     std::cout << "Window minimized" << std::endl;
@@ -359,9 +843,10 @@ void ImageViewer::HandleWindowResize(int newWidth, int newHeight) {
     // 更新菜单栏缩放
     menuBar.SetScaleFactor(scaleFactor);
     menuBar.UpdateLayout(windowWidth, windowHeight);
+    UpdateFitArea();
     
     // 如果有图片，重新调整其位置和大小
-    if (currentImageIndex >= 0 && currentImageIndex < (int)images.size()) {
+    if (currentImageIndex >= 0 && currentImageIndex < (int)images->size()) {
         FitImageToWindow();
         CenterImage();
     }
@@ -383,41 +868,911 @@ void ImageViewer::UpdateScaleFactor() {
 }
 
 bool ImageViewer::LoadImage(const std::string& imagePath) {
-    // 加载图片
-    SDL_Surface* loadedSurface = IMG_Load(imagePath.c_str());
-    if (loadedSurface == nullptr) {
-        std::cerr << "Unable to load image " << imagePath << "! IMG_Error: " << IMG_GetError() << std::endl;
+    TRACE_SCOPE("LoadImage");
+    // 添加目录项并立即解码
+    ImageData item;
+    item.path = imagePath;
+    item.key = imagePath;
+    // 工作线程可能还在读当前目录，增删图片时换成新的目录
+    auto appended = std::make_shared<std::vector<ImageData>>(*images);
+    appended->push_back(item);
+    images = appended;
+    // 预取器负责当前图片的后台解码
+    StartPrefetch();
+    if (!EnsureImageLoaded((int)images->size() - 1)) {
+        images = std::make_shared<std::vector<ImageData>>(images->begin(), images->end() - 1);
         return false;
     }
-    // 创建纹理
-    SDL_Texture* tex = SDL_CreateTextureFromSurface(renderer, loadedSurface);
-    if (tex == nullptr) {
-        std::cerr << "Unable to create texture from " << imagePath << "! SDL_Error: " << SDL_GetError() << std::endl;
-        SDL_FreeSurface(loadedSurface);
+    return true;
+}
+
+bool ImageViewer::EnsureImageLoaded(int index) {
+    if (index < 0 || index >= (int)images->size()) return false;
+    // 超大文件按图块区域解码；其他格式整图解码，解码后仍超大时再转为分块
+    if (PrepareTiledImage(index)) return true;
+    // 全图尚未解码时先在后台显示JPEG内嵌预览或渐进式近似图，全图解码后替换
+    if (ShowPreview(index)) return true;
+    return AcquireTexture(index) != nullptr || (tiledImage && tiledIndex == index);
+}
+
+bool ImageViewer::ShowPreview(int index) {
+    TRACE_SCOPE("ShowPreview");
+    ImageData& img = (*images)[index];
+    if (img.archive || img.loadFailed || prefetcher.HasImage(index) || textureUploader.IsPending(img.key)) {
         return false;
     }
-    // 获取图片尺寸
-    int w = loadedSurface->w;
-    int h = loadedSurface->h;
-    // 释放表面
-    SDL_FreeSurface(loadedSurface);
-    // 存入images
-    images.push_back({tex, w, h, imagePath});
-    std::cout << "Image loaded successfully: " << w << "x" << h << std::endl;
+    for (int level = 0; level < img.levelCount; ++level) {
+        if (textureCache.Contains(LevelKey(img, level))) {
+            return false;
+        }
+    }
+    if (index == previewIndex) {
+        return true;
+    }
+    // 预取线程已在解码（或排队解码）的图片等它的结果，不再重复读文件
+    if (prefetcher.IsQueued(index) || (img.previewActive && textureCache.Contains(PreviewKey(img)))) {
+        img.previewActive = true;
+        prefetcher.Request(index);
+        return true;
+    }
+    CancelPreviewLoad();
+    // 读文件头和解码预览都在后台，网络共享上翻页时UI线程不等磁盘
+    CancelToken token = CancelToken::Create();
+    std::string path = img.path;
+    bool submitted = JobScheduler::GetInstance().Submit(JobScheduler::Priority::Visible,
+        [this, path, token]() { RunPreviewJob(path, token); }, token);
+    if (!submitted) {
+        return false;
+    }
+    // 任务结束前预取线程跳过这张图，RenderImage也不同步解码
+    previewIndex = index;
+    previewToken = token;
+    img.previewActive = true;
     return true;
 }
 
+void ImageViewer::RunPreviewJob(const std::string& path, CancelToken token) {
+    // 先找内嵌预览：只读取文件头部的APP段和预览图本身，比渐进式的第一遍更快
+    ExifPreview::Info info;
+    SDL_Surface* surface = nullptr;
+    if (ExifPreview::Probe(path, &info) && !NeedsTiling(info.width, info.height)) {
+        float scale = FitScale(info.width, info.height, fitAreaWidth, fitAreaHeight);
+        int targetWidth = std::max(1, static_cast<int>(info.width * std::min(scale, 1.0f)));
+        int targetHeight = std::max(1, static_cast<int>(info.height * std::min(scale, 1.0f)));
+        const ExifPreview::Candidate* candidate = ExifPreview::Choose(info, targetWidth, targetHeight);
+        if (candidate && !token.IsCancelled()) {
+            surface = ExifPreview::Decode(path, *candidate, targetWidth, targetHeight);
+        }
+    }
+    if (token.IsCancelled()) {
+        SDL_FreeSurface(surface);
+        return;
+    }
+
+    // 没有内嵌预览的渐进式文件边读边显示每遍的近似图，网络共享上不必等整个文件读完
+    int width = 0;
+    int height = 0;
+    ProgressiveDecoder::Format format = ProgressiveDecoder::Format::None;
+    if (!surface) {
+        format = ProgressiveDecoder::Probe(path, &width, &height);
+        if (format != ProgressiveDecoder::Format::None && NeedsTiling(width, height)) {
+            format = ProgressiveDecoder::Format::None;
+        }
+    }
+    if (format == ProgressiveDecoder::Format::None) {
+        // 回调要求可复制，表面包一层shared_ptr；没有预览时也要通知主线程改为解码全图
+        std::shared_ptr<SDL_Surface> preview(surface, SDL_FreeSurface);
+        width = info.width;
+        height = info.height;
+        JobScheduler::GetInstance().PostToMain([this, preview, width, height]() {
+            FinishPreview(preview.get(), width, height);
+        }, token);
+        return;
+    }
+
+    // 与DecodeSurface一致：JPEG只解码到适应窗口所需的分辨率
+    int denom = 1;
+    if (format == ProgressiveDecoder::Format::Jpeg) {
+        float scale = std::min({1.0f, static_cast<float>(fitAreaWidth) / width, static_cast<float>(fitAreaHeight) / height});
+        denom = JpegDecoder::ChooseScale(width, height, std::max(1, static_cast<int>(width * scale)),
+                                         std::max(1, static_cast<int>(height * scale)));
+    }
+    SDL_Surface* decodedSurface = ProgressiveDecoder::Decode(path, format, denom,
+        [this, width, height, token](SDL_Surface* partial, int) {
+            // 解码继续写入partial，交给主线程的是一份拷贝
+            std::shared_ptr<SDL_Surface> copy(SDL_ConvertSurfaceFormat(partial, textureFormat, 0), SDL_FreeSurface);
+            if (copy) {
+                JobScheduler::GetInstance().PostToMain([this, copy, width, height]() {
+                    ShowProgressivePass(copy.get(), width, height);
+                }, token);
+            }
+            return !token.IsCancelled();
+        }, token);
+    if (token.IsCancelled()) {
+        SDL_FreeSurface(decodedSurface);
+        return;
+    }
+    // 回调要求可复制，解码结果包一层shared_ptr
+    auto decoded = std::make_shared<std::unique_ptr<DecodedImage>>(
+        decodedSurface ? BuildDecodedImage(ConvertToTextureFormat(decodedSurface), denom, width, height) : nullptr);
+    JobScheduler::GetInstance().PostToMain([this, decoded]() {
+        FinishProgressiveLoad(std::move(*decoded));
+    }, token);
+}
+
+void ImageViewer::FinishPreview(SDL_Surface* surface, int width, int height) {
+    // 被取代的加载已取消，回调不会执行；目录变更时previewIndex随图片换成新序号
+    int index = previewIndex;
+    if (index < 0) {
+        return;
+    }
+    TRACE_SCOPE("FinishPreview");
+    previewIndex = -1;
+    previewToken = CancelToken();
+    ImageData& img = (*images)[index];
+    SDL_Texture* texture = surface ? SDL_CreateTextureFromSurface(renderer, surface) : nullptr;
+    if (texture) {
+        std::cout << "Showing embedded preview " << surface->w << "x" << surface->h
+                  << " for " << width << "x" << height << " image" << std::endl;
+        textureCache.Put(PreviewKey(img), texture);
+        // 预览按主图尺寸拉伸显示，适应窗口和缩放与全图一致
+        int oldWidth = img.width;
+        int oldHeight = img.height;
+        img.width = width;
+        img.height = height;
+        RefitIfResized(index, oldWidth, oldHeight);
+    }
+    // 没有可用的预览时仍保持预览状态，全图在后台解码完成后由SwapInFullImage替换
+    prefetcher.Request(index);
+    if (index == currentImageIndex) {
+        MarkForRedraw(FrameScheduler::kImage);
+    }
+}
+
+void ImageViewer::CancelPreviewLoad() {
+    // 解码线程读下一块之前看到取消，已排队的近似图和结果直接丢弃。
+    // 只解码了几遍的近似图也一并丢弃，再次显示时重新加载
+    int index = previewIndex;
+    previewToken.Cancel();
+    previewToken = CancelToken();
+    previewIndex = -1;
+    if (index >= 0 && index < (int)images->size()) {
+        (*images)[index].previewActive = false;
+        textureCache.Remove(PreviewKey((*images)[index]));
+    }
+}
+
+void ImageViewer::RefitIfResized(int index, int oldWidth, int oldHeight) {
+    // 尺寸在后台加载后才确定（或与预览不同）时，当前图片重新适应窗口
+    const ImageData& img = (*images)[index];
+    if (index == currentImageIndex && (img.width != oldWidth || img.height != oldHeight)) {
+        FitImageToWindow();
+        CenterImage();
+    }
+}
+
+bool ImageViewer::SwapInFullImage(int index) {
+    // 内嵌预览还在解码时等它的结果；渐进式加载完成时由FinishProgressiveLoad替换
+    if (index == previewIndex) {
+        return false;
+    }
+    ImageData& img = (*images)[index];
+    std::unique_ptr<DecodedImage> decoded = prefetcher.TryTakeImage(index);
+    if (!decoded && prefetcher.IsQueued(index)) {
+        return false;
+    }
+    img.previewActive = false;
+    textureCache.Remove(PreviewKey(img));
+    int oldWidth = img.width;
+    int oldHeight = img.height;
+    if (decoded) {
+        UploadDecoded(index, std::move(decoded), 0);
+    } else {
+        // 后台结果已被丢弃（如离开了预取窗口），同步解码
+        AcquireTexture(index);
+    }
+    RefitIfResized(index, oldWidth, oldHeight);
+    return true;
+}
+
+void ImageViewer::ShowProgressivePass(SDL_Surface* surface, int width, int height) {
+    int index = previewIndex;
+    if (index < 0) {
+        return;
+    }
+    TRACE_SCOPE("ShowProgressivePass");
+    ImageData& img = (*images)[index];
+    // 各遍尺寸相同，只更新同一张流式纹理的像素
+    SDL_Texture* texture = textureCache.Get(PreviewKey(img));
+    Uint32 format = 0;
+    int access = 0, textureWidth = 0, textureHeight = 0;
+    if (texture) {
+        SDL_QueryTexture(texture, &format, &access, &textureWidth, &textureHeight);
+    }
+    if (!texture || access != SDL_TEXTUREACCESS_STREAMING || format != surface->format->format ||
+        textureWidth != surface->w || textureHeight != surface->h) {
+        texture = SDL_CreateTexture(renderer, surface->format->format, SDL_TEXTUREACCESS_STREAMING, surface->w, surface->h);
+        if (!texture) {
+            std::cerr << "Unable to create streaming texture! SDL_Error: " << SDL_GetError() << std::endl;
+            return;
+        }
+        SDL_SetTextureBlendMode(texture, SDL_ISPIXELFORMAT_ALPHA(surface->format->format) ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+        textureCache.Put(PreviewKey(img), texture);
+    }
+    if (SDL_UpdateTexture(texture, nullptr, surface->pixels, surface->pitch) != 0) {
+        std::cerr << "Unable to update texture! SDL_Error: " << SDL_GetError() << std::endl;
+        return;
+    }
+    // 近似图与内嵌预览一样按主图尺寸拉伸显示
+    int oldWidth = img.width;
+    int oldHeight = img.height;
+    img.width = width;
+    img.height = height;
+    RefitIfResized(index, oldWidth, oldHeight);
+    if (index == currentImageIndex) {
+        MarkForRedraw(FrameScheduler::kImage);
+    }
+}
+
+void ImageViewer::FinishProgressiveLoad(std::unique_ptr<DecodedImage> decoded) {
+    int index = previewIndex;
+    if (index < 0) {
+        return;
+    }
+    TRACE_SCOPE("FinishProgressiveLoad");
+    previewIndex = -1;
+    previewToken = CancelToken();
+    ImageData& img = (*images)[index];
+    img.previewActive = false;
+    textureCache.Remove(PreviewKey(img));
+    int oldWidth = img.width;
+    int oldHeight = img.height;
+    if (decoded) {
+        UploadDecoded(index, std::move(decoded), 0);
+    } else {
+        // 文件损坏等情况按普通路径再解码一次，仍失败时标记为加载失败
+        AcquireTexture(index);
+    }
+    RefitIfResized(index, oldWidth, oldHeight);
+    if (index == currentImageIndex) {
+        MarkForRedraw(FrameScheduler::kImage);
+    }
+}
+
+bool ImageViewer::NeedsTiling(int width, int height) const {
+    // 超过64M像素的整图纹理会占满大部分纹理预算
+    const long long kMaxPixels = 64LL * 1024 * 1024;
+    return width > maxTextureSize || height > maxTextureSize || (long long)width * height > kMaxPixels;
+}
+
+bool ImageViewer::CanTileFile(const ImageData& item) const {
+    if (item.archive) {
+        return false;
+    }
+    // 预取、缩略图和显示都会问同一张图，文件头只解析一次
+    TileProbe& probe = *item.tileProbe;
+    std::call_once(probe.once, [&]() {
+        int width, height;
+        probe.tileable = TileSource::ProbeSize(item.path, &width, &height) && NeedsTiling(width, height) &&
+                         TileSource::OpenFile(item.path) != nullptr;
+    });
+    return probe.tileable;
+}
+
+bool ImageViewer::PrepareTiledImage(int index) {
+    if (tiledImage && tiledIndex == index) return true;
+    ImageData& img = (*images)[index];
+    if (img.loadFailed || !CanTileFile(img)) return false;
+    std::unique_ptr<TileSource> source = TileSource::OpenFile(img.path);
+    if (!source) return false;
+    SetTiledImage(index, std::move(source));
+    return true;
+}
+
+void ImageViewer::SetTiledImage(int index, std::unique_ptr<TileSource> source) {
+    ReleaseTiledImage();
+    ImageData& img = (*images)[index];
+    img.width = source->GetWidth();
+    img.height = source->GetHeight();
+    img.tiled = true;
+    tiledImage = std::make_unique<TiledImage>(std::move(source), img.key, wakeEventType);
+    tiledIndex = index;
+    std::cout << "Tiled image: " << img.width << "x" << img.height
+              << " (" << tiledImage->GetLevelCount() << " levels)" << std::endl;
+}
+
+void ImageViewer::ReleaseTiledImage() {
+    tiledImage.reset();
+    tiledIndex = -1;
+    textureCache.SetPinned({}, TiledImage::kPinGroup);
+}
+
+std::string ImageViewer::LevelKey(const ImageData& item, int level) {
+    return level == 0 ? item.key : item.key + "#" + std::to_string(level);
+}
+
+std::string ImageViewer::FitKey(const ImageData& item) {
+    return item.key + "#fit";
+}
+
+std::string ImageViewer::PreviewKey(const ImageData& item) {
+    return item.key + "#preview";
+}
+
+float ImageViewer::FitScale(int imageWidth, int imageHeight, int areaWidth, int areaHeight) {
+    float scaleX = static_cast<float>(areaWidth) / static_cast<float>(imageWidth);
+    float scaleY = static_cast<float>(areaHeight) / static_cast<float>(imageHeight);
+    // 选择较小的缩放比例以保持图片比例，并限制最小缩放比例
+    return std::max(0.1f, std::min(scaleX, scaleY));
+}
+
+void ImageViewer::UpdateFitArea() {
+    fitAreaWidth = windowWidth;
+    fitAreaHeight = windowHeight - menuBar.GetHeight();
+    thumbnailGrid.SetViewport({0, menuBar.GetHeight(), windowWidth, windowHeight - menuBar.GetHeight()});
+}
+
+SDL_Texture* ImageViewer::AcquireTexture(int index, int level) {
+    if (index < 0 || index >= (int)images->size()) return nullptr;
+    ImageData& img = (*images)[index];
+    if (img.loadFailed) return nullptr;
+
+    if (level < img.baseLevel && img.levelCount > 0) {
+        // 放大超过缩小解码的分辨率，按全分辨率重新解码
+        std::unique_ptr<DecodedImage> full = DecodeImage(img, true);
+        if (full) {
+            return UploadDecoded(index, std::move(full), level);
+        }
+    }
+
+    // 纹理层：所需层级被淘汰时先用其他已缓存的层级，同时在后台重新解码，解码好后补上所需层级
+    SDL_Texture* tex = textureCache.Get(LevelKey(img, level));
+    if (tex) return tex;
+    for (int l = 0; l < img.levelCount; ++l) {
+        if (l != level && textureCache.Contains(LevelKey(img, l))) {
+            // 还在分条上传的层级传完即可，不必重新解码
+            if (!textureUploader.IsPending(img.key)) {
+                std::unique_ptr<DecodedImage> decoded = prefetcher.TryTakeImage(index);
+                if (decoded) {
+                    SDL_Texture* restored = UploadDecoded(index, std::move(decoded), level);
+                    if (restored) return restored;
+                } else if (!prefetcher.IsQueued(index)) {
+                    prefetcher.Request(index);
+                }
+            }
+            return textureCache.Get(LevelKey(img, l));
+        }
+    }
+
+    // 解码层：预取线程已解码的图片；未命中时从压缩层（文件或压缩包字节）同步解码
+    std::unique_ptr<DecodedImage> decoded = prefetcher.TakeImage(index);
+    if (!decoded && archivePipeline.IsRunning()) {
+        // 固实压缩包：等流水线解压到该页，单独读取要从头解压
+        decoded = archivePipeline.WaitFor(index);
+    }
+    if (!decoded) {
+        decoded = DecodeImage(img);
+    }
+    return UploadDecoded(index, std::move(decoded), level);
+}
+
+int ImageViewer::UploadArchiveResults(int maxCount) {
+    TRACE_SCOPE("UploadArchiveResults");
+    int count = 0;
+    int entry;
+    std::unique_ptr<DecodedImage> decoded;
+    while (count < maxCount && archivePipeline.TakeNext(&entry, &decoded)) {
+        ++count;
+        // 解码失败的页在显示时重试；超大页显示时再分块
+        if (!decoded || entry < 0 || entry >= (int)images->size() || NeedsTiling(decoded->width, decoded->height)) {
+            continue;
+        }
+        const ImageData& img = (*images)[entry];
+        if (img.levelCount > 0 && textureCache.Contains(LevelKey(img, img.levelCount - 1))) {
+            continue;
+        }
+        UploadDecoded(entry, std::move(decoded), 0);
+    }
+    return count;
+}
+
+SDL_Texture* ImageViewer::UploadDecoded(int index, std::unique_ptr<DecodedImage> decoded, int level) {
+    TRACE_SCOPE("UploadDecoded");
+    ImageData& img = (*images)[index];
+    if (!decoded) {
+        img.loadFailed = true;
+        return nullptr;
+    }
+    if (NeedsTiling(decoded->width, decoded->height)) {
+        // 只能整图解码的超大图片（如压缩包内的条目）从内存中的层级切块
+        SetTiledImage(index, std::make_unique<SurfaceTileSource>(std::move(decoded), TiledImage::kTileSize));
+        return nullptr;
+    }
+    // 上传所有层级；大层级排队分条上传，传完之前显示时先用更小的层级
+    textureUploader.Cancel(img.key);
+    std::shared_ptr<DecodedImage> owner(std::move(decoded));
+    img.width = owner->width;
+    img.height = owner->height;
+    img.baseLevel = owner->baseLevel;
+    img.levelCount = owner->baseLevel;
+    img.fittedWidth = 0;
+    img.fittedHeight = 0;
+    for (size_t i = 0; i < owner->levels.size(); ++i) {
+        SDL_Surface* surface = owner->levels[i];
+        // 最小的层级总是直接上传，保证立即有东西可显示
+        bool deferred = textureUploader.IsEnabled() && i + 1 < owner->levels.size() &&
+                        static_cast<size_t>(surface->h) * surface->pitch > TextureUploader::kImmediateBytes;
+        if (deferred && textureUploader.Enqueue(renderer, img.key, LevelKey(img, img.levelCount), owner, surface)) {
+            ++img.levelCount;
+            continue;
+        }
+        SDL_Texture* levelTex = SDL_CreateTextureFromSurface(renderer, surface);
+        if (levelTex == nullptr) {
+            std::cerr << "Unable to create texture from " << img.path << "! SDL_Error: " << SDL_GetError() << std::endl;
+            break;
+        }
+        textureCache.Put(LevelKey(img, img.levelCount), levelTex);
+        ++img.levelCount;
+    }
+    int shown = -1;     // 请求的层级还在排队时用更小的层级
+    for (int l = std::max(img.baseLevel, std::min(level, img.levelCount - 1)); l < img.levelCount && shown < 0; ++l) {
+        if (textureCache.Contains(LevelKey(img, l))) {
+            shown = l;
+        }
+    }
+    if (shown < 0) {
+        textureUploader.Cancel(img.key);
+        img.levelCount = 0;
+        img.loadFailed = true;
+        return nullptr;
+    }
+    if (owner->fitted) {
+        SDL_Texture* fittedTex = SDL_CreateTextureFromSurface(renderer, owner->fitted);
+        if (fittedTex) {
+            textureCache.Put(FitKey(img), fittedTex);
+            img.fittedWidth = owner->fitted->w;
+            img.fittedHeight = owner->fitted->h;
+        }
+    }
+    std::cout << "Image loaded successfully: " << img.width << "x" << img.height
+              << " (" << img.levelCount << " levels, from level " << img.baseLevel << ")" << std::endl;
+    return textureCache.Get(LevelKey(img, shown));
+}
+
+SDL_Surface* ImageViewer::DecodeSurface(const ImageData& item, int boxWidth, int boxHeight,
+                                        int* scaleDenom, int* fullWidth, int* fullHeight,
+                                        const MappedFile* contents) const {
+    TRACE_SCOPE("DecodeSurface");
+    // 解码器直接从压缩包流式读取条目；文件映射后从页缓存读取，超过2GB的文件仍用stdio。
+    // 映射的文件或压缩包在解码期间被截断时结果作废，改为读入内存（压缩包改为读文件）再解码一次
+    SDL_Surface* surface = nullptr;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        std::unique_ptr<MappedFile> opened;
+        const MappedFile* mapped = contents;
+        if (!mapped && !item.archive) {
+            opened = MappedFile::Open(item.path, attempt == 0);
+            mapped = opened.get();
+        }
+        auto decode = [&]() {
+            SDL_RWops* rw = mapped ? mapped->OpenStream()
+                            : item.archive ? ArchiveStream::Open(item.archive, item.archiveEntry)
+                                           : SDL_RWFromFile(item.path.c_str(), "rb");
+            if (rw == nullptr) {
+                std::cerr << "Unable to open image " << item.path << "! SDL_Error: " << SDL_GetError() << std::endl;
+                return;
+            }
+            surface = DecodeStream(item, rw, mapped, boxWidth, boxHeight, scaleDenom, fullWidth, fullHeight);
+        };
+        bool intact = true;
+        if (mapped) {
+            intact = mapped->Guard(decode);
+        } else if (item.archive) {
+            intact = item.archive->Guard(decode);
+        } else {
+            decode();
+        }
+        if (intact) {
+            return surface;
+        }
+        std::cerr << "Image " << item.path << " was truncated while decoding" << std::endl;
+        SDL_FreeSurface(surface);
+        surface = nullptr;
+    }
+    return nullptr;
+}
+
+SDL_Surface* ImageViewer::DecodeStream(const ImageData& item, SDL_RWops* rw, const MappedFile* mapped,
+                                       int boxWidth, int boxHeight,
+                                       int* scaleDenom, int* fullWidth, int* fullHeight) const {
+    SDL_Surface* surface = nullptr;
+    int denom = 1;
+    unsigned char magic[2];
+    if (boxWidth > 0 && boxHeight > 0 && SDL_RWread(rw, magic, 1, 2) == 2 && magic[0] == 0xFF && magic[1] == 0xD8) {
+        // JPEG：缩放IDCT直接输出1/2、1/4、1/8，不解码随后会被缩小丢弃的像素。
+        // 映射的文件和ZIP未压缩条目直接交给libjpeg，其余条目按块流式读取，都不拷贝整个文件
+        auto chooseScale = [this, boxWidth, boxHeight](int width, int height) {
+            // 可分块的超大图片需要全分辨率层级
+            if (NeedsTiling(width, height)) {
+                return 1;
+            }
+            float scale = std::min({1.0f, static_cast<float>(boxWidth) / width, static_cast<float>(boxHeight) / height});
+            return JpegDecoder::ChooseScale(width, height, std::max(1, static_cast<int>(width * scale)),
+                                            std::max(1, static_cast<int>(height * scale)));
+        };
+        const unsigned char* data = mapped ? mapped->GetData() : nullptr;
+        size_t dataSize = mapped ? mapped->GetSize() : 0;
+        const char* stored = nullptr;
+        if (!mapped && item.archive && item.archive->GetStoredData(item.archiveEntry, &stored, &dataSize)) {
+            data = reinterpret_cast<const unsigned char*>(stored);
+        }
+        int width = 0;
+        int height = 0;
+        {
+            TRACE_SCOPE("JpegDecoder::Decode");
+            if (data) {
+                surface = JpegDecoder::Decode(data, dataSize, chooseScale, &width, &height, &denom);
+            } else if (SDL_RWseek(rw, 0, RW_SEEK_SET) == 0) {
+                surface = JpegDecoder::Decode(rw, chooseScale, &width, &height, &denom);
+            }
+        }
+        if (surface) {
+            if (fullWidth) *fullWidth = width;
+            if (fullHeight) *fullHeight = height;
+        }
+        if (!surface) {
+            // CMYK等交给SDL_image
+            denom = 1;
+        }
+    }
+    if (surface == nullptr) {
+        if (SDL_RWseek(rw, 0, RW_SEEK_SET) < 0) {
+            SDL_RWclose(rw);
+            return nullptr;
+        }
+        {
+            TRACE_SCOPE("IMG_Load");
+            surface = IMG_Load_RW(rw, 1);
+        }
+        rw = nullptr;
+        if (surface == nullptr) {
+            std::cerr << "Unable to load image " << item.path << "! IMG_Error: " << IMG_GetError() << std::endl;
+            return nullptr;
+        }
+        if (fullWidth) *fullWidth = surface->w;
+        if (fullHeight) *fullHeight = surface->h;
+    }
+    if (rw) {
+        SDL_RWclose(rw);
+    }
+    if (scaleDenom) *scaleDenom = denom;
+    return ConvertToTextureFormat(surface);
+}
+
+SDL_Surface* ImageViewer::ConvertToTextureFormat(SDL_Surface* surface) const {
+    // 转换为纹理格式，上传时可直接拷贝
+    if (surface->format->format != textureFormat) {
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, textureFormat, 0);
+        if (converted) {
+            SDL_FreeSurface(surface);
+            surface = converted;
+        }
+    }
+    return surface;
+}
+
+std::unique_ptr<DecodedImage> ImageViewer::DecodeImage(const ImageData& item, bool fullResolution,
+                                                       const MappedFile* contents) const {
+    TRACE_SCOPE("DecodeImage");
+    int denom = 1;
+    int width = 0;
+    int height = 0;
+    SDL_Surface* surface = fullResolution ? DecodeSurface(item, 0, 0, &denom, &width, &height, contents)
+                                          : DecodeSurface(item, fitAreaWidth, fitAreaHeight, &denom, &width, &height, contents);
+    if (surface == nullptr) {
+        return nullptr;
+    }
+    return BuildDecodedImage(surface, denom, width, height);
+}
+
+std::unique_ptr<DecodedImage> ImageViewer::BuildDecodedImage(SDL_Surface* surface, int denom, int width, int height) const {
+    auto image = std::make_unique<DecodedImage>();
+    image->width = width;
+    image->height = height;
+    // 缩小倍数是2的幂，缩小解码的表面即为对应的mip层级
+    while ((1 << image->baseLevel) < denom) {
+        ++image->baseLevel;
+    }
+    image->levels.push_back(surface);
+    // 在解码线程上生成mip层级，最小一级不小于窗口常见尺寸的一半
+    {
+        TRACE_SCOPE("ImagePyramid::Build");
+        ImagePyramid::Build(*image);
+    }
+    // 适应窗口是最常见的显示方式，预先用Lanczos-3缩小，比GPU线性过滤清晰。
+    // 从至少为目标两倍大的层级开始缩小，减少卷积的源像素
+    float scale = FitScale(image->width, image->height, fitAreaWidth, fitAreaHeight);
+    if (scale < 1.0f && !NeedsTiling(image->width, image->height)) {
+        int level = std::max(0, ImagePyramid::SelectLevel(scale, image->baseLevel + (int)image->levels.size()) - 1);
+        level = std::max(0, level - image->baseLevel);
+        int fittedWidth = std::max(1, static_cast<int>(image->width * scale));
+        int fittedHeight = std::max(1, static_cast<int>(image->height * scale));
+        TRACE_SCOPE("Resampler::Resize");
+        image->fitted = Resampler::Resize(image->levels[level], fittedWidth, fittedHeight, Resampler::Filter::Lanczos3);
+    }
+    return image;
+}
+
+void ImageViewer::StartPrefetch(const std::vector<int>* remap) {
+    // 预取和缩略图线程与UI线程共享目录，结构变化时UI线程换成新的目录，这里持有的不受影响
+    std::shared_ptr<const std::vector<ImageData>> sources = images;
+    ImagePrefetcher::DecodeFunc decode =
+        [this, sources](int index, std::unique_ptr<MappedFile> contents) -> std::unique_ptr<DecodedImage> {
+            const ImageData& item = (*sources)[index];
+            // 可按区域解码的超大文件显示时再分块解码，整图预取只会占满内存
+            if (CanTileFile(item)) {
+                return nullptr;
+            }
+            // 固实压缩包的页由流水线顺序解压后解码
+            if (item.archive && archivePipeline.WillProduce(index)) {
+                return nullptr;
+            }
+            // 正在后台加载预览或边读边解码的当前图片
+            if (index == previewIndex) {
+                return nullptr;
+            }
+            return DecodeImage(item, false, contents.get());
+        };
+    ImagePrefetcher::SourceFunc source = [sources](int index) {
+        // 压缩包条目由ArchiveReader的映射或顺序读取负责
+        const ImageData& item = (*sources)[index];
+        return item.archive ? std::string() : item.path;
+    };
+    ThumbnailGrid::ThumbnailFunc thumbnail = [this, sources](int index) {
+        return LoadThumbnail((*sources)[index]);
+    };
+    // 文件夹变更时只丢弃增删改的图片，其余的预取结果、缩略图和滚动位置换成新序号保留
+    if (remap) {
+        prefetcher.Remap((int)sources->size(), *remap, std::move(decode), std::move(source));
+        thumbnailGrid.Remap((int)sources->size(), *remap, std::move(thumbnail));
+    } else {
+        prefetcher.Reset((int)sources->size(), std::move(decode), std::move(source));
+        thumbnailGrid.Reset((int)sources->size(), std::move(thumbnail));
+    }
+    // 只对打开的文件夹查找重复；文件夹变更时只计算增改的图片，其余沿用上一遍的签名
+    if (watchedFolder.empty()) {
+        duplicateFinder.Stop();
+        return;
+    }
+    DuplicateFinder::SignatureFunc signature = [this, sources](int index, PerceptualHash::Signature* result) {
+        return ComputeSignature((*sources)[index], result);
+    };
+    DuplicateFinder::ReadaheadFunc readahead = [sources](int index) {
+        MappedFile::WillNeed((*sources)[index].path);
+    };
+    int maxJobs = std::max(1, SDL_GetCPUCount() - 1);
+    if (remap) {
+        duplicateFinder.Update((int)sources->size(), *remap, std::move(signature), std::move(readahead), maxJobs);
+    } else {
+        duplicateFinder.Start((int)sources->size(), std::move(signature), std::move(readahead), maxJobs);
+    }
+}
+
+void ImageViewer::ShowGrid(bool show) {
+    if (show == gridMode || (show && images->empty())) {
+        return;
+    }
+    gridMode = show;
+    isPanning = false;
+    isDraggingScrollbar = false;
+    if (show) {
+        thumbnailGrid.SetSelected(std::max(0, currentImageIndex));
+    } else {
+        thumbnailGrid.CancelRequests();
+    }
+    MarkForRedraw();
+}
+
+bool ImageViewer::HandleGridKey(SDL_Keycode key) {
+    int columns = thumbnailGrid.GetColumns();
+    switch (key) {
+        case SDLK_LEFT:
+            thumbnailGrid.MoveSelection(-1);
+            return true;
+        case SDLK_RIGHT:
+            thumbnailGrid.MoveSelection(1);
+            return true;
+        case SDLK_UP:
+            thumbnailGrid.MoveSelection(-columns);
+            return true;
+        case SDLK_DOWN:
+            thumbnailGrid.MoveSelection(columns);
+            return true;
+        case SDLK_PAGEUP:
+            thumbnailGrid.MoveSelection(-columns * thumbnailGrid.GetVisibleRows());
+            return true;
+        case SDLK_PAGEDOWN:
+            thumbnailGrid.MoveSelection(columns * thumbnailGrid.GetVisibleRows());
+            return true;
+        case SDLK_HOME:
+            thumbnailGrid.SetSelected(0);
+            return true;
+        case SDLK_END:
+            thumbnailGrid.SetSelected((int)images->size() - 1);
+            return true;
+        case SDLK_RETURN:
+        case SDLK_KP_ENTER: {
+            // 打开选中的图片
+            int index = thumbnailGrid.GetSelected();
+            ShowGrid(false);
+            ShowImage(index);
+            return true;
+        }
+        case SDLK_ESCAPE:
+        case SDLK_g:
+            ShowGrid(false);
+            return true;
+        case SDLK_d: {
+            int target = NextDuplicate(thumbnailGrid.GetSelected());
+            if (target >= 0) {
+                thumbnailGrid.SetSelected(target);
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+int ImageViewer::NextDuplicate(int index) const {
+    bool nextCluster = (SDL_GetModState() & KMOD_SHIFT) != 0;
+    int target = nextCluster ? duplicateFinder.NextCluster(index) : duplicateFinder.NextInCluster(index);
+    if (target < 0) {
+        std::cout << (duplicateFinder.IsRunning() ? "Still hashing images for duplicates" : "No duplicates found") << std::endl;
+        return -1;
+    }
+    const std::vector<int>* cluster = duplicateFinder.GetCluster(target);
+    std::cout << "Duplicate group of " << cluster->size() << " images, showing image " << target + 1 << std::endl;
+    return target;
+}
+
+SDL_Surface* ImageViewer::DecodeReduced(const ImageData& item, int size) const {
+    if (CanTileFile(item)) {
+        // 超大文件只解码最粗的几个层级之一，不整图解码
+        std::unique_ptr<TileSource> tiles = TileSource::OpenFile(item.path);
+        if (tiles) {
+            int level = tiles->GetLevelCount(size * 2) - 1;
+            int levelWidth, levelHeight;
+            TileSource::LevelSize(tiles->GetWidth(), tiles->GetHeight(), level, &levelWidth, &levelHeight);
+            SDL_Surface* source = tiles->DecodeRegion(level, {0, 0, levelWidth, levelHeight}, CancelToken());
+            if (source) {
+                return source;
+            }
+        }
+    }
+    return DecodeSurface(item, size, size);
+}
+
+SDL_Surface* ImageViewer::DecodeThumbnail(const ImageData& item) const {
+    TRACE_SCOPE("DecodeThumbnail");
+    SDL_Surface* source = DecodeReduced(item, ThumbnailGrid::kThumbSize);
+    if (!source) {
+        return nullptr;
+    }
+    int longest = std::max(source->w, source->h);
+    if (longest <= ThumbnailGrid::kThumbSize) {
+        return source;
+    }
+    float scale = static_cast<float>(ThumbnailGrid::kThumbSize) / longest;
+    int width = std::max(1, std::min(ThumbnailGrid::kThumbSize, static_cast<int>(std::lround(source->w * scale))));
+    int height = std::max(1, std::min(ThumbnailGrid::kThumbSize, static_cast<int>(std::lround(source->h * scale))));
+    SDL_Surface* thumbnail = Resampler::Resize(source, width, height, Resampler::Filter::Mitchell);
+    SDL_FreeSurface(source);
+    return thumbnail;
+}
+
+SDL_Surface* ImageViewer::LoadThumbnail(const ImageData& item) {
+    ThumbnailStore::Key key;
+    bool keyed = item.archive ? ThumbnailStore::MakeArchiveKey(item.archive->GetPath(), item.path, ThumbnailGrid::kThumbSize, &key)
+                              : ThumbnailStore::MakeFileKey(item.path, ThumbnailGrid::kThumbSize, &key);
+    if (keyed) {
+        SDL_Surface* cached = thumbnailStore.Get(key);
+        if (cached) {
+            return cached;
+        }
+    }
+    SDL_Surface* thumbnail = DecodeThumbnail(item);
+    if (thumbnail && keyed) {
+        thumbnailStore.Put(key, thumbnail);
+    }
+    return thumbnail;
+}
+
+bool ImageViewer::ComputeSignature(const ImageData& item, PerceptualHash::Signature* signature) {
+    TRACE_SCOPE("ComputeSignature");
+    ThumbnailStore::Key key;
+    bool keyed = ThumbnailStore::MakeFileKey(item.path, PerceptualHash::kSize, &key);
+    if (keyed && signatureStore.Get(key, signature)) {
+        return true;
+    }
+    // JPEG用缩放IDCT只解码到1/8
+    SDL_Surface* source = DecodeReduced(item, PerceptualHash::kSize);
+    if (!source) {
+        return false;
+    }
+    bool computed = PerceptualHash::Compute(source, signature);
+    SDL_FreeSurface(source);
+    if (computed && keyed) {
+        signatureStore.Put(key, *signature);
+    }
+    return computed;
+}
+
+void ImageViewer::ShowImage(int index) {
+    TRACE_SCOPE("ShowImage");
+    if (index < 0 || index >= (int)images->size()) return;
+    currentImageIndex = index;
+    if (tiledIndex != index) {
+        ReleaseTiledImage();
+    }
+    if (previewIndex != index) {
+        CancelPreviewLoad();
+    }
+    // 先调度邻近图片，当前图片未命中时与UI线程的同步解码并行
+    prefetcher.OnNavigate(index);
+    archivePipeline.SetCurrent(index);
+    textureUploader.Prioritize((*images)[index].key);
+    // 固定当前图片及前后各一张的所有层级，其余按LRU淘汰
+    std::vector<std::string> pinnedKeys;
+    for (int i = std::max(0, index - 1); i <= std::min((int)images->size() - 1, index + 1); ++i) {
+        for (int level = 0; level < std::max(1, (*images)[i].levelCount); ++level) {
+            pinnedKeys.push_back(LevelKey((*images)[i], level));
+        }
+        pinnedKeys.push_back(FitKey((*images)[i]));
+        pinnedKeys.push_back(PreviewKey((*images)[i]));
+    }
+    textureCache.SetPinned(pinnedKeys);
+    // 命中率按导航统计：切换时已有任一层级的纹理即可立即显示
+    const ImageData& target = (*images)[index];
+    if (!target.tiled) {
+        bool cached = false;
+        for (int level = 0; level < target.levelCount && !cached; ++level) {
+            cached = textureCache.Contains(LevelKey(target, level));
+        }
+        textureCache.RecordLookup(cached);
+    }
+    EnsureImageLoaded(index);
+    if ((*images)[index].levelCount > 1) {
+        // 解码后层级数才确定，补充固定
+        for (int level = 1; level < (*images)[index].levelCount; ++level) {
+            pinnedKeys.push_back(LevelKey((*images)[index], level));
+        }
+        textureCache.SetPinned(pinnedKeys);
+    }
+    FitImageToWindow();
+    CenterImage();
+    MarkForRedraw();
+}
+
 void ImageViewer::ClearImage() {
-    if (currentImageIndex >= 0 && currentImageIndex < (int)images.size()) {
-        if (images[currentImageIndex].texture) {
-            SDL_DestroyTexture(images[currentImageIndex].texture);
-            images[currentImageIndex].texture = nullptr;
+    ReleaseTiledImage();
+    CancelPreviewLoad();
+    if (currentImageIndex >= 0 && currentImageIndex < (int)images->size()) {
+        textureUploader.Cancel((*images)[currentImageIndex].key);
+        for (int level = 0; level < (*images)[currentImageIndex].levelCount; ++level) {
+            textureCache.Remove(LevelKey((*images)[currentImageIndex], level));
         }
-        images.erase(images.begin() + currentImageIndex);
-        if (images.empty()) {
+        textureCache.Remove(FitKey((*images)[currentImageIndex]));
+        textureCache.Remove(PreviewKey((*images)[currentImageIndex]));
+        auto remaining = std::make_shared<std::vector<ImageData>>(*images);
+        remaining->erase(remaining->begin() + currentImageIndex);
+        images = remaining;
+        // 流水线按删除前的序号产出，后续页面改为单独读取
+        archivePipeline.Stop();
+        StartPrefetch();
+        if (images->empty()) {
             currentImageIndex = -1;
-        } else if (currentImageIndex >= (int)images.size()) {
-            currentImageIndex = (int)images.size() - 1;
+        } else if (currentImageIndex >= (int)images->size()) {
+            currentImageIndex = (int)images->size() - 1;
         }
     }
     imageScale = 1.0f;
@@ -426,10 +1781,18 @@ void ImageViewer::ClearImage() {
 }
 
 void ImageViewer::ClearAllImages() {
-    for (auto& img : images) {
-        if (img.texture) SDL_DestroyTexture(img.texture);
-    }
-    images.clear();
+    folderWatcher.Stop();
+    watchedFolder.clear();
+    archivePipeline.Stop();
+    ReleaseTiledImage();
+    CancelPreviewLoad();
+    textureUploader.Clear();
+    textureCache.Clear();
+    images = std::make_shared<std::vector<ImageData>>();
+    prefetcher.Reset(0, nullptr);
+    thumbnailGrid.Reset(0, nullptr);
+    duplicateFinder.Stop();
+    gridMode = false;
     currentImageIndex = -1;
     imageScale = 1.0f;
     imageOffsetX = 0;
@@ -437,89 +1800,120 @@ void ImageViewer::ClearAllImages() {
 }
 
 void ImageViewer::FitImageToWindow() {
-    if (currentImageIndex < 0 || currentImageIndex >= (int)images.size() || !images[currentImageIndex].texture) return;
+    if (currentImageIndex < 0 || currentImageIndex >= (int)images->size() || (*images)[currentImageIndex].width <= 0) return;
     int menuHeight = menuBar.GetHeight();
     int availableWidth = windowWidth;
     int availableHeight = windowHeight - menuHeight;
-    int imageWidth = images[currentImageIndex].width;
-    int imageHeight = images[currentImageIndex].height;
-    // 计算缩放比例以适应窗口
-    float scaleX = static_cast<float>(availableWidth) / static_cast<float>(imageWidth);
-    float scaleY = static_cast<float>(availableHeight) / static_cast<float>(imageHeight);
-    // 选择较小的缩放比例以保持圖片比例
-    imageScale = std::min(scaleX, scaleY);
-    // 限制最小缩放比例
-    imageScale = std::max(0.1f, imageScale);
+    int imageWidth = (*images)[currentImageIndex].width;
+    int imageHeight = (*images)[currentImageIndex].height;
+    // 计算缩放比例以适应窗口（与解码线程生成显示图的算法一致）
+    imageScale = FitScale(imageWidth, imageHeight, availableWidth, availableHeight);
     std::cout << "Image scale set to: " << imageScale << std::endl;
 }
 
 void ImageViewer::CenterImage() {
-    if (currentImageIndex < 0 || currentImageIndex >= (int)images.size() || !images[currentImageIndex].texture) return;
+    if (currentImageIndex < 0 || currentImageIndex >= (int)images->size() || (*images)[currentImageIndex].width <= 0) return;
     int menuHeight = menuBar.GetHeight();
-    int scaledWidth = static_cast<int>(images[currentImageIndex].width * imageScale);
-    int scaledHeight = static_cast<int>(images[currentImageIndex].height * imageScale);
+    int scaledWidth = static_cast<int>((*images)[currentImageIndex].width * imageScale);
+    int scaledHeight = static_cast<int>((*images)[currentImageIndex].height * imageScale);
     // 计算居中位置
     imageOffsetX = (windowWidth - scaledWidth) / 2;
     imageOffsetY = menuHeight + (windowHeight - menuHeight - scaledHeight) / 2;
     std::cout << "Image centered at: " << imageOffsetX << ", " << imageOffsetY << std::endl;
 }
 
+void ImageViewer::ZoomAt(float factor, int x, int y) {
+    if (currentImageIndex < 0 || currentImageIndex >= (int)images->size() || (*images)[currentImageIndex].width <= 0) return;
+    float newScale = std::max(0.01f, std::min(imageScale * factor, 32.0f));
+    // 保持光标下的图片位置不动
+    float imageX = (x - imageOffsetX) / imageScale;
+    float imageY = (y - imageOffsetY) / imageScale;
+    imageScale = newScale;
+    imageOffsetX = static_cast<int>(std::lround(x - imageX * imageScale));
+    imageOffsetY = static_cast<int>(std::lround(y - imageY * imageScale));
+    MarkForRedraw();
+}
+
 void ImageViewer::RenderImage() {
-    if (currentImageIndex < 0 || currentImageIndex >= (int)images.size() || !images[currentImageIndex].texture) return;
-    int scaledWidth = static_cast<int>(images[currentImageIndex].width * imageScale);
-    int scaledHeight = static_cast<int>(images[currentImageIndex].height * imageScale);
+    TRACE_SCOPE("RenderImage");
+    ImageData& current = (*images)[currentImageIndex];
+    if (current.previewActive && !SwapInFullImage(currentImageIndex)) {
+        // 全图仍在后台解码，按全图尺寸绘制预览
+        SDL_Texture* preview = textureCache.Get(PreviewKey(current));
+        if (preview) {
+            SDL_Rect destRect = {
+                imageOffsetX,
+                imageOffsetY,
+                static_cast<int>(current.width * imageScale),
+                static_cast<int>(current.height * imageScale)
+            };
+            SDL_RenderCopy(renderer, preview, nullptr, &destRect);
+        }
+        return;
+    }
+    if (tiledImage && tiledIndex == currentImageIndex) {
+        int menuHeight = menuBar.GetHeight();
+        SDL_Rect viewport = {0, menuHeight, windowWidth, windowHeight - menuHeight};
+        tiledImage->Render(renderer, textureCache, imageScale, imageOffsetX, imageOffsetY, viewport);
+        return;
+    }
+    // 按屏幕缩放比例选择mip层级，避免用全分辨率纹理采样小窗口
+    int level = ImagePyramid::SelectLevel(imageScale, (*images)[currentImageIndex].levelCount);
+    SDL_Texture* tex = AcquireTexture(currentImageIndex, level);
+    if (tex == nullptr) return;
+    int scaledWidth = static_cast<int>((*images)[currentImageIndex].width * imageScale);
+    int scaledHeight = static_cast<int>((*images)[currentImageIndex].height * imageScale);
     SDL_Rect destRect = {
         imageOffsetX,
         imageOffsetY,
         scaledWidth,
         scaledHeight
     };
-    SDL_RenderCopy(renderer, images[currentImageIndex].texture, nullptr, &destRect);
+    // 适应窗口时1:1绘制预先缩小的显示图
+    const ImageData& img = (*images)[currentImageIndex];
+    if (img.fittedWidth == scaledWidth && img.fittedHeight == scaledHeight) {
+        SDL_Texture* fitted = textureCache.Get(FitKey(img));
+        if (fitted) {
+            tex = fitted;
+        }
+    }
+    SDL_RenderCopy(renderer, tex, nullptr, &destRect);
 }
 
 
 void ImageViewer::OnArchiveOpened(const std::string& archivename) {
+    TRACE_SCOPE("OnArchiveOpened");
     ClearAllImages();
     std::cout << "Archive opened: " << archivename << std::endl;
     hasOpenedFile = true;
     SDL_SetWindowTitle(window, ("Image Viewer - " + archivename).c_str());
     MarkForRedraw();
 
-    struct archive* a = archive_read_new();
-    archive_read_support_format_all(a);
-    archive_read_support_filter_all(a);
-    if (archive_read_open_filename(a, archivename.c_str(), 10240) == ARCHIVE_OK) {
-        struct archive_entry* entry;
-        while (archive_read_next_header(a, &entry) == ARCHIVE_OK) {
-            std::string name = archive_entry_pathname(entry);
-            std::string ext = name.substr(name.find_last_of('.') + 1);
-            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-            if (ext == "png" || ext == "jpg" || ext == "jpeg" || ext == "bmp" || ext == "tif" || ext == "tiff"|| ext == "webp") {
-                size_t size = archive_entry_size(entry);
-                if (size > 0) {
-                    std::vector<char> buffer(size);
-                    la_ssize_t read = archive_read_data(a, buffer.data(), size);
-                    if (read > 0) {
-                        SDL_RWops* rw = SDL_RWFromMem(buffer.data(), buffer.size());
-                        SDL_Surface* surface = IMG_Load_RW(rw, 1);
-                        if (surface) {
-                            SDL_Texture* tex = SDL_CreateTextureFromSurface(renderer, surface);
-                            if (tex) {
-                                images.push_back({tex, surface->w, surface->h, name});
-                            }
-                            SDL_FreeSurface(surface);
-                        }
-                    }
-                }
-            }
-            archive_read_data_skip(a); // 跳过非图片或已处理文件
+    // 只建立一次条目索引，页面在导航到时才单独读取
+    auto archive = std::make_shared<ArchiveReader>();
+    if (archive->Open(archivename)) {
+        const auto& entries = archive->GetEntries();
+        for (size_t i = 0; i < entries.size(); ++i) {
+            ImageData item;
+            item.path = entries[i].name;
+            item.key = archivename + "::" + entries[i].name;
+            item.archive = archive;
+            item.archiveEntry = (int)i;
+            images->push_back(item);
+        }
+        if (!archive->IsSeekable() && images->size() > 1) {
+            // 固实压缩包只能从头顺序解压：一个线程解压，线程池上并行解码，UI线程按顺序上传
+            std::shared_ptr<const std::vector<ImageData>> sources = images;
+            archivePipeline.Start(archive,
+                [this, sources](int entry, std::unique_ptr<MappedFile> contents) {
+                    return DecodeImage((*sources)[entry], false, contents.get());
+                },
+                archivePipelineOptions, wakeEventType);
         }
     }
-    archive_read_free(a);
-    if (!images.empty()) {
-        currentImageIndex = 0;
-        FitImageToWindow();
-        CenterImage();
+    StartPrefetch();
+    if (!images->empty()) {
+        ShowImage(0);
     } else {
         currentImageIndex = -1;
     }
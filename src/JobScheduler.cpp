@@ -0,0 +1,247 @@
+#include "JobScheduler.h"
+#include <algorithm>
+#include <iostream>
+#include "Trace.h"
+
+namespace {
+
+// 当前线程在线程池中的序号，不是工作线程时为-1
+thread_local int currentWorker = -1;
+
+} // namespace
+
+CancelToken CancelToken::Create() {
+    CancelToken token;
+    token.state = std::make_shared<State>();
+    return token;
+}
+
+void CancelToken::Cancel() const {
+    if (state) {
+        state->cancelled = true;
+    }
+}
+
+bool CancelToken::IsCancelled() const {
+    return state && state->cancelled;
+}
+
+JobScheduler& JobScheduler::GetInstance() {
+    static JobScheduler instance;
+    return instance;
+}
+
+JobScheduler::~JobScheduler() {
+    Stop();
+}
+
+bool JobScheduler::Start(int threadCount, Uint32 eventType) {
+    if (running) {
+        return true;
+    }
+    threadCount = std::max(1, threadCount);
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = false;
+        queuedTotal = 0;
+    }
+    for (std::atomic<int>& count : queuedCount) {
+        count = 0;
+    }
+    wakeEventType = eventType;
+    for (int i = 0; i < threadCount; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    running = true;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(&JobScheduler::WorkerLoop, this, i);
+    }
+    std::cout << "JobScheduler started with " << threadCount << " threads" << std::endl;
+    return true;
+}
+
+void JobScheduler::Stop() {
+    if (threads.empty()) {
+        return;
+    }
+    running = false;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    // 排队的任务不再执行，只等正在执行的完成
+    for (std::unique_ptr<Worker>& worker : workers) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        for (int p = 0; p < kPriorityCount; ++p) {
+            int dropped = (int)worker->queues[p].size();
+            worker->queues[p].clear();
+            queuedCount[p] -= dropped;
+            cancelledCount += dropped;
+            std::lock_guard<std::mutex> sleepLock(sleepMutex);
+            queuedTotal -= dropped;
+        }
+    }
+    workAvailable.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    workers.clear();
+    {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        completions.clear();
+    }
+    std::cout << "JobScheduler executed " << executedCount << " jobs (" << stolenCount << " stolen, "
+              << cancelledCount << " cancelled)" << std::endl;
+}
+
+bool JobScheduler::Submit(Priority priority, Job job, const CancelToken& token) {
+    if (!running || !job) {
+        return false;
+    }
+    int p = static_cast<int>(priority);
+    // 工作线程提交的后续任务留在本线程，数据还在缓存中；其他线程提交的轮流分配
+    int target = currentWorker >= 0 ? currentWorker : (int)(nextWorker++ % workers.size());
+    {
+        Worker& worker = *workers[target];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.queues[p].push_back({std::move(job), token});
+    }
+    ++queuedCount[p];
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        ++queuedTotal;
+    }
+    workAvailable.notify_one();
+    return true;
+}
+
+void JobScheduler::CancelAndWait(const CancelToken& token) {
+    if (!token.state) {
+        return;
+    }
+    token.state->cancelled = true;
+    // 排队的任务出队时丢弃，只需等待已经开始的
+    std::unique_lock<std::mutex> lock(doneMutex);
+    jobDone.wait(lock, [&token]() { return token.state->running == 0; });
+}
+
+void JobScheduler::WorkerLoop(int index) {
+    Trace::SetThreadName("Worker");
+    currentWorker = index;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            if (stopping) {
+                return;
+            }
+        }
+        Entry entry;
+        if (TakeJob(index, &entry)) {
+            Run(entry);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        workAvailable.wait(lock, [this]() { return stopping || queuedTotal > 0; });
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+bool JobScheduler::TakeJob(int self, Entry* entry) {
+    int count = (int)workers.size();
+    for (int p = 0; p < kPriorityCount; ++p) {
+        if (queuedCount[p] == 0) {
+            continue;
+        }
+        // 先取自己队列的尾部，再从其他线程队列的头部窃取同一优先级的任务
+        for (int i = 0; i < count; ++i) {
+            int victim = (self + i) % count;
+            Worker& worker = *workers[victim];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            std::deque<Entry>& queue = worker.queues[p];
+            while (!queue.empty()) {
+                Entry taken;
+                if (victim == self) {
+                    taken = std::move(queue.back());
+                    queue.pop_back();
+                } else {
+                    taken = std::move(queue.front());
+                    queue.pop_front();
+                }
+                --queuedCount[p];
+                {
+                    std::lock_guard<std::mutex> sleepLock(sleepMutex);
+                    --queuedTotal;
+                }
+                if (taken.token.IsCancelled()) {
+                    ++cancelledCount;
+                    continue;
+                }
+                if (victim != self) {
+                    ++stolenCount;
+                }
+                *entry = std::move(taken);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void JobScheduler::Run(Entry& entry) {
+    std::shared_ptr<CancelToken::State> state = entry.token.state;
+    if (state) {
+        // 先登记再检查，CancelAndWait要么看到正在执行，要么本任务看到已取消
+        ++state->running;
+        if (state->cancelled) {
+            ++cancelledCount;
+        } else {
+            entry.job();
+            ++executedCount;
+        }
+        entry.job = nullptr;
+        --state->running;
+        {
+            std::lock_guard<std::mutex> lock(doneMutex);
+        }
+        jobDone.notify_all();
+        return;
+    }
+    entry.job();
+    ++executedCount;
+}
+
+void JobScheduler::PostToMain(Job completion, const CancelToken& token) {
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        wasEmpty = completions.empty();
+        completions.push_back({std::move(completion), token});
+    }
+    // 事件循环空闲时阻塞在SDL_WaitEvent，一批回调只需唤醒一次
+    if (wasEmpty && wakeEventType != (Uint32)-1) {
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = wakeEventType;
+        SDL_PushEvent(&event);
+    }
+}
+
+int JobScheduler::DrainCompletions() {
+    std::vector<Entry> batch;
+    {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        batch.swap(completions);
+    }
+    int count = 0;
+    for (Entry& entry : batch) {
+        if (entry.token.IsCancelled()) {
+            continue;
+        }
+        entry.job();
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,160 @@
+#include "JpegDecoder.h"
+#include <iostream>
+#include "JpegError.h"
+#include <jerror.h>
+
+namespace {
+
+const size_t kReadChunk = 64 * 1024;
+
+// 从SDL_RWops每次读取一块交给libjpeg，压缩包条目不必先解压到整块内存
+struct RWopsSource {
+    jpeg_source_mgr pub;
+    SDL_RWops* rw;
+    JOCTET buffer[kReadChunk];
+};
+
+void InitSource(j_decompress_ptr) {
+}
+
+boolean FillInputBuffer(j_decompress_ptr cinfo) {
+    RWopsSource* source = reinterpret_cast<RWopsSource*>(cinfo->src);
+    size_t count = SDL_RWread(source->rw, source->buffer, 1, sizeof(source->buffer));
+    if (count == 0) {
+        // 数据提前结束：与jpeg_stdio_src一样补一个EOI
+        WARNMS(cinfo, JWRN_JPEG_EOF);
+        source->buffer[0] = 0xFF;
+        source->buffer[1] = JPEG_EOI;
+        count = 2;
+    }
+    source->pub.next_input_byte = source->buffer;
+    source->pub.bytes_in_buffer = count;
+    return TRUE;
+}
+
+void SkipInputData(j_decompress_ptr cinfo, long count) {
+    jpeg_source_mgr* source = cinfo->src;
+    while (count > static_cast<long>(source->bytes_in_buffer)) {
+        count -= static_cast<long>(source->bytes_in_buffer);
+        FillInputBuffer(cinfo);
+    }
+    if (count > 0) {
+        source->next_input_byte += count;
+        source->bytes_in_buffer -= static_cast<size_t>(count);
+    }
+}
+
+void TermSource(j_decompress_ptr) {
+}
+
+} // namespace
+
+void JpegErrorExit(j_common_ptr cinfo) {
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    std::cerr << "JPEG error: " << message << std::endl;
+    std::longjmp(reinterpret_cast<JpegErrorManager*>(cinfo->err)->jump, 1);
+}
+
+int JpegDecoder::ChooseScale(int width, int height, int targetWidth, int targetHeight) {
+    for (int denom = 8; denom > 1; denom /= 2) {
+        if ((width + denom - 1) / denom >= targetWidth && (height + denom - 1) / denom >= targetHeight) {
+            return denom;
+        }
+    }
+    return 1;
+}
+
+bool JpegDecoder::ReadSize(const unsigned char* data, size_t size, int* width, int* height) {
+    if (size < 2 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager error;
+    cinfo.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = JpegErrorExit;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, data, static_cast<unsigned long>(size));
+    jpeg_read_header(&cinfo, TRUE);
+    *width = static_cast<int>(cinfo.image_width);
+    *height = static_cast<int>(cinfo.image_height);
+    jpeg_destroy_decompress(&cinfo);
+    return *width > 0 && *height > 0;
+}
+
+SDL_Surface* JpegDecoder::Decode(const unsigned char* data, size_t size, int scaleDenom) {
+    return Decode(data, size, [scaleDenom](int, int) { return scaleDenom; }, nullptr, nullptr, nullptr);
+}
+
+SDL_Surface* JpegDecoder::Decode(const unsigned char* data, size_t size, const ScaleFunc& chooseScale,
+                                 int* width, int* height, int* scaleDenom) {
+    return DecodeWith([data, size](j_decompress_ptr cinfo) {
+        jpeg_mem_src(cinfo, data, static_cast<unsigned long>(size));
+    }, chooseScale, width, height, scaleDenom);
+}
+
+SDL_Surface* JpegDecoder::Decode(SDL_RWops* rw, const ScaleFunc& chooseScale, int* width, int* height, int* scaleDenom) {
+    RWopsSource source;
+    source.pub.init_source = InitSource;
+    source.pub.fill_input_buffer = FillInputBuffer;
+    source.pub.skip_input_data = SkipInputData;
+    source.pub.resync_to_restart = jpeg_resync_to_restart;
+    source.pub.term_source = TermSource;
+    source.pub.next_input_byte = nullptr;
+    source.pub.bytes_in_buffer = 0;
+    source.rw = rw;
+    return DecodeWith([&source](j_decompress_ptr cinfo) { cinfo->src = &source.pub; },
+                      chooseScale, width, height, scaleDenom);
+}
+
+SDL_Surface* JpegDecoder::DecodeWith(const std::function<void(j_decompress_ptr)>& setSource, const ScaleFunc& chooseScale,
+                                     int* width, int* height, int* scaleDenom) {
+    // setjmp之后不再创建需要析构的对象；表面在setjmp之后赋值，需声明为volatile
+    SDL_Surface* volatile surface = nullptr;
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager error;
+    cinfo.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = JpegErrorExit;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        SDL_FreeSurface(surface);
+        return nullptr;
+    }
+    jpeg_create_decompress(&cinfo);
+    setSource(&cinfo);
+    jpeg_read_header(&cinfo, TRUE);
+    // CMYK无法直接输出为BGRA
+    if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK) {
+        jpeg_destroy_decompress(&cinfo);
+        return nullptr;
+    }
+    int denom = chooseScale(static_cast<int>(cinfo.image_width), static_cast<int>(cinfo.image_height));
+    if (denom != 2 && denom != 4 && denom != 8) {
+        denom = 1;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = static_cast<unsigned int>(denom);
+    cinfo.out_color_space = JCS_EXT_BGRA;
+    jpeg_start_decompress(&cinfo);
+    surface = SDL_CreateRGBSurfaceWithFormat(0, static_cast<int>(cinfo.output_width), static_cast<int>(cinfo.output_height),
+                                             32, SDL_PIXELFORMAT_ARGB8888);
+    if (!surface) {
+        jpeg_destroy_decompress(&cinfo);
+        return nullptr;
+    }
+    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = static_cast<JSAMPROW>(surface->pixels) + static_cast<size_t>(cinfo.output_scanline) * surface->pitch;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    if (width) *width = static_cast<int>(cinfo.image_width);
+    if (height) *height = static_cast<int>(cinfo.image_height);
+    if (scaleDenom) *scaleDenom = denom;
+    jpeg_destroy_decompress(&cinfo);
+    return surface;
+}
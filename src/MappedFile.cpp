@@ -0,0 +1,174 @@
+#include "MappedFile.h"
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#include "FileIo.h"
+#include "Trace.h"
+
+namespace {
+
+// statfs的f_type
+const long kNfsMagic = 0x6969;
+const long kSmbMagic = 0x517B;
+const long kCifsMagic = 0xFF534D42;
+const long kSmb2Magic = 0xFE534D42;
+const long kFuseMagic = 0x65735546;     // sshfs等
+const long kCephMagic = 0x00C36400;
+const long kAfsMagic = 0x5346414F;
+
+// 本线程正在保护的映射区域，Guard嵌套时链接到外层
+struct GuardRegion {
+    uintptr_t begin;
+    uintptr_t end;
+    std::atomic<bool>* truncated;
+    GuardRegion* outer;
+};
+
+thread_local GuardRegion* currentRegion = nullptr;
+uintptr_t pageSize = 4096;
+struct sigaction previousAction;
+
+void OnBusError(int signal, siginfo_t* info, void* context) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(info->si_addr);
+    for (GuardRegion* region = currentRegion; region; region = region->outer) {
+        if (address < region->begin || address >= region->end) {
+            continue;
+        }
+        // 文件末尾之后的页映射为匿名零页，返回后重新执行的读取不再出错
+        void* page = reinterpret_cast<void*>(address & ~(pageSize - 1));
+        if (mmap(page, pageSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+            region->truncated->store(true);
+            return;
+        }
+        break;
+    }
+    // 不是受保护的映射：恢复原来的处理，返回后重新触发
+    sigaction(SIGBUS, &previousAction, nullptr);
+    (void)signal;
+    (void)context;
+}
+
+void InstallBusHandler() {
+    static std::once_flag once;
+    std::call_once(once, []() {
+        pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_sigaction = OnBusError;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGBUS, &action, &previousAction);
+    });
+}
+
+bool IsNetworkFileSystem(int fd) {
+    struct statfs fs;
+    if (fstatfs(fd, &fs) != 0) {
+        return false;
+    }
+    // f_type在部分架构上是有符号的，按32位比较
+    long type = static_cast<long>(static_cast<uint32_t>(fs.f_type));
+    return type == kNfsMagic || type == kSmbMagic || type == kCifsMagic || type == kSmb2Magic ||
+           type == kFuseMagic || type == kCephMagic || type == kAfsMagic;
+}
+
+} // namespace
+
+MappedFile::~MappedFile() {
+    if (mapped) {
+        munmap(const_cast<unsigned char*>(data), size);
+    }
+}
+
+std::unique_ptr<MappedFile> MappedFile::Open(const std::string& path, bool allowMap) {
+    TRACE_SCOPE("MappedFile::Open");
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0) {
+        SDL_SetError("Couldn't open %s: %s", path.c_str(), std::strerror(errno));
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        SDL_SetError("Couldn't read %s: not a regular non-empty file", path.c_str());
+        close(fd);
+        return nullptr;
+    }
+    if (static_cast<uint64_t>(st.st_size) > static_cast<uint64_t>(INT_MAX)) {
+        // SDL_RWFromConstMem的长度是int
+        SDL_SetError("Couldn't map %s: file too large", path.c_str());
+        close(fd);
+        return nullptr;
+    }
+    std::unique_ptr<MappedFile> file(new MappedFile());
+    file->size = static_cast<size_t>(st.st_size);
+    if (allowMap && !IsNetworkFileSystem(fd)) {
+        void* address = mmap(nullptr, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            // 解码器从头到尾读一遍：加大预读窗口，读过的页可以尽早回收
+            madvise(address, file->size, MADV_SEQUENTIAL);
+            close(fd);
+            file->data = static_cast<const unsigned char*>(address);
+            file->mapped = true;
+            return file;
+        }
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    file->buffer.resize(file->size);
+    bool ok = PreadFully(fd, file->buffer.data(), file->size, 0);
+    int readError = errno;
+    close(fd);
+    if (!ok) {
+        SDL_SetError("Couldn't read %s: %s", path.c_str(), std::strerror(readError));
+        return nullptr;
+    }
+    file->data = file->buffer.data();
+    return file;
+}
+
+std::unique_ptr<MappedFile> MappedFile::FromBuffer(std::vector<unsigned char> contents) {
+    std::unique_ptr<MappedFile> file(new MappedFile());
+    file->buffer = std::move(contents);
+    file->data = file->buffer.data();
+    file->size = file->buffer.size();
+    return file;
+}
+
+void MappedFile::WillNeed(const std::string& path) {
+    TRACE_SCOPE("MappedFile::WillNeed");
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        return;
+    }
+    // 预读在内核中异步进行，关闭描述符不影响
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+}
+
+SDL_RWops* MappedFile::OpenStream() const {
+    return SDL_RWFromConstMem(data, static_cast<int>(size));
+}
+
+bool MappedFile::Guard(const void* data, size_t size, std::atomic<bool>* truncated, const std::function<void()>& body) {
+    if (!data || size == 0) {
+        body();
+        return true;
+    }
+    InstallBusHandler();
+    GuardRegion region;
+    region.begin = reinterpret_cast<uintptr_t>(data);
+    region.end = region.begin + size;
+    region.truncated = truncated;
+    region.outer = currentRegion;
+    currentRegion = &region;
+    body();
+    currentRegion = region.outer;
+    return !truncated->load();
+}
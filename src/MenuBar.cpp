@@ -1,10 +1,10 @@
 #include "MenuBar.h"
+#include "Trace.h"
 #include "SimpleFileDialog.h"
 #include <iostream>
 #include <cstdlib>
 #include <memory>
 #include <array>
-#include <future>
 #include <filesystem>
 #include <algorithm>
 
@@ -55,6 +55,7 @@ MenuBar::MenuBar()
 
 MenuBar::~MenuBar() {
     // FontManager是单例，不需要在这里清理
+    dialogToken.Cancel();
 }
 
 bool MenuBar::Initialize(SDL_Renderer* renderer) {
@@ -62,9 +63,71 @@ bool MenuBar::Initialize(SDL_Renderer* renderer) {
     return true;
 }
 
+bool MenuBar::RunDialogAsync(std::string (*dialog)(), int code) {
+    CancelToken token = dialogToken;
+    // 对话框一直占用一个工作线程直到关闭，按用户操作的优先级提交
+    return JobScheduler::GetInstance().Submit(JobScheduler::Priority::Visible, [this, dialog, code, token]() {
+        std::string result = dialog();
+        JobScheduler::GetInstance().PostToMain([this, code, result]() { OnDialogClosed(code, result); }, token);
+    }, token);
+}
+
+void MenuBar::OnDialogClosed(int code, const std::string& path) {
+    static const char* const kSelected[] = {"File", "Folder", "Archive"};
+    static const char* const kNothing[] = {"file", "folder", "archive"};
+    std::function<void(const std::string&)>* callbacks[] = {&onFileOpened, &onFolderOpened, &onArchiveOpened};
+    isOpening = false;
+    if (path.empty()) {
+        std::cout << "[DEBUG] No " << kNothing[code] << " selected" << std::endl;
+        return;
+    }
+    std::cout << "[DEBUG] " << kSelected[code] << " selected: " << path << std::endl;
+    if (*callbacks[code]) {
+        (*callbacks[code])(path);
+    }
+}
+
+unsigned MenuBar::VisualState() const {
+    unsigned state = (fileMenu.isHovered ? 1u : 0u) | (fileMenu.isPressed ? 2u : 0u) | (showDropdown ? 4u : 0u);
+    if (showDropdown) {
+        for (size_t i = 0; i < dropdownItems.size(); ++i) {
+            if (dropdownItems[i].isHovered) {
+                state |= 8u << i;
+            }
+        }
+    }
+    return state;
+}
+
+bool MenuBar::TakeDamage(bool* dropdownToggled) {
+    unsigned state = VisualState();
+    bool changed = state != drawnState;
+    if (dropdownToggled) {
+        *dropdownToggled = showDropdown != drawnDropdown;
+    }
+    drawnState = state;
+    drawnDropdown = showDropdown;
+    return changed;
+}
+
+SDL_Rect MenuBar::GetBounds() const {
+    SDL_Rect bounds = {0, 0, currentWindowWidth, menuHeight};
+    if (showDropdown) {
+        SDL_Rect dropdown = {
+            fileMenu.rect.x,
+            fileMenu.rect.y + menuHeight,
+            dropdownWidth,
+            (int)dropdownItems.size() * dropdownItemHeight
+        };
+        SDL_UnionRect(&bounds, &dropdown, &bounds);
+    }
+    return bounds;
+}
+
 void MenuBar::HandleEvent(const SDL_Event& event) {
+    TRACE_SCOPE("MenuBar::HandleEvent");
     int mouseX, mouseY;
-    
+
     switch (event.type) {
         case SDL_MOUSEBUTTONDOWN:
             if (event.button.button == SDL_BUTTON_LEFT) {
@@ -127,52 +190,10 @@ void MenuBar::HandleEvent(const SDL_Event& event) {
             }
             break;
     }
-    
-    // 事件处理后，检查异步文件对话框是否完成
-    if (openFilePending && openFileFuture.valid() && openFileFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
-        std::string filename = openFileFuture.get();
-        openFilePending = false;
-        isOpening = false;
-        if (!filename.empty()) {
-            std::cout << "[DEBUG] File selected: " << filename << std::endl;
-            if (onFileOpened) {
-                onFileOpened(filename);
-            }
-        } else {
-            std::cout << "[DEBUG] No file selected" << std::endl;
-        }
-    }
-    if (openFolderPending && openFolderFuture.valid() && openFolderFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
-        std::string foldername = openFolderFuture.get();
-        openFolderPending = false;
-        isOpening = false;
-        if (!foldername.empty()) {
-            std::cout << "[DEBUG] Folder selected: " << foldername << std::endl;
-            if (onFolderOpened) {
-                onFolderOpened(foldername);
-            }
-        } else {
-            std::cout << "[DEBUG] No folder selected" << std::endl;
-        }
-    }
-    if (openArchivePending && openArchiveFuture.valid() && openArchiveFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
-        std::string archivename = openArchiveFuture.get();
-        openArchivePending = false;
-        isOpening = false;
-        if (!archivename.empty()) {
-            std::cout << "[DEBUG] Archive selected: " << archivename << std::endl;
-            if (onArchiveOpened) {
-                onArchiveOpened(archivename);
-            }
-        } else {
-            std::cout << "[DEBUG] No archive selected" << std::endl;
-        }
-    }
-
-    
 }
 
 void MenuBar::Render(SDL_Renderer* renderer) {
+    TRACE_SCOPE("MenuBar::Render");
     // 获取当前渲染器输出尺寸
     int windowWidth, windowHeight;
     SDL_GetRendererOutputSize(renderer, &windowWidth, &windowHeight);
@@ -296,11 +317,7 @@ void MenuBar::OnOpenFile() {
         std::cout << "请等待当前操作完成！" << std::endl;
         return;
     }
-    if (!openFilePending) {
-        isOpening = true;
-        openFileFuture = SimpleFileDialog::OpenFileAsync();
-        openFilePending = true;
-    }
+    isOpening = RunDialogAsync(&SimpleFileDialog::OpenFile, 0);
 }
 
 void MenuBar::OnOpenFolder() {
@@ -309,13 +326,7 @@ void MenuBar::OnOpenFolder() {
         std::cout << "请等待当前操作完成！" << std::endl;
         return;
     }
-    if (!openFolderPending) {
-        isOpening = true;
-        openFolderFuture = std::async(std::launch::async, [](){
-            return SimpleFileDialog::OpenFolder();
-        });
-        openFolderPending = true;
-    }
+    isOpening = RunDialogAsync(&SimpleFileDialog::OpenFolder, 1);
 }
 
 void MenuBar::OnOpenArchive() {
@@ -326,13 +337,7 @@ void MenuBar::OnOpenArchive() {
     }
     // 这里可按需实现异步归档打开
     std::cout << "[DEBUG] Archive functionality not yet implemented" << std::endl;
-    if (!openArchivePending) {
-        isOpening = true;
-        openArchiveFuture = std::async(std::launch::async, [](){
-            return SimpleFileDialog::OpenArchive();
-        });
-        openArchivePending = true;
-    }
+    isOpening = RunDialogAsync(&SimpleFileDialog::OpenArchive, 2);
 }
 
 
@@ -0,0 +1,51 @@
+#include "NaturalSort.h"
+#include <cctype>
+
+bool NaturalLess(const std::string& a, const std::string& b) {
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() && j < b.size()) {
+        unsigned char ca = static_cast<unsigned char>(a[i]);
+        unsigned char cb = static_cast<unsigned char>(b[j]);
+        if (std::isdigit(ca) && std::isdigit(cb)) {
+            // 跳过前导零后按数值比较：先比位数，再逐位比较
+            size_t startA = i;
+            size_t startB = j;
+            while (startA < a.size() && a[startA] == '0') ++startA;
+            while (startB < b.size() && b[startB] == '0') ++startB;
+            size_t endA = startA;
+            size_t endB = startB;
+            while (endA < a.size() && std::isdigit(static_cast<unsigned char>(a[endA]))) ++endA;
+            while (endB < b.size() && std::isdigit(static_cast<unsigned char>(b[endB]))) ++endB;
+            size_t lenA = endA - startA;
+            size_t lenB = endB - startB;
+            if (lenA != lenB) {
+                return lenA < lenB;
+            }
+            for (size_t k = 0; k < lenA; ++k) {
+                if (a[startA + k] != b[startB + k]) {
+                    return a[startA + k] < b[startB + k];
+                }
+            }
+            // 数值相同时前导零少的在前
+            if ((startA - i) != (startB - j)) {
+                return (startA - i) < (startB - j);
+            }
+            i = endA;
+            j = endB;
+            continue;
+        }
+        int la = std::tolower(ca);
+        int lb = std::tolower(cb);
+        if (la != lb) {
+            return la < lb;
+        }
+        ++i;
+        ++j;
+    }
+    if ((a.size() - i) != (b.size() - j)) {
+        return (a.size() - i) < (b.size() - j);
+    }
+    // 忽略大小写后相同，按原始字节保证严格弱序
+    return a < b;
+}
@@ -0,0 +1,177 @@
+#include "PerceptualHash.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PERCEPTUALHASH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const int kN = PerceptualHash::kSize;
+const int kLow = 8;                 // 保留的低频系数边长
+const int kPrecision = 13;          // DCT系数定点位数，最大系数0.25对应2048
+const int kRowShift = 9;            // 第一遍结果缩小后不超过16位
+const double kPi = 3.14159265358979323846;
+
+// 正交DCT-II的前kLow行，basis为kLow x kN，transposed为kN x kLow
+struct DctTables {
+    int32_t basis[kLow * kN];
+    int32_t transposed[kN * kLow];
+};
+
+const DctTables& Tables() {
+    static const DctTables tables = []() {
+        DctTables t;
+        for (int u = 0; u < kLow; ++u) {
+            double scale = std::sqrt((u == 0 ? 1.0 : 2.0) / kN);
+            for (int x = 0; x < kN; ++x) {
+                double value = scale * std::cos((2 * x + 1) * u * kPi / (2 * kN));
+                int32_t fixed = static_cast<int32_t>(std::lround(value * (1 << kPrecision)));
+                t.basis[u * kN + x] = fixed;
+                t.transposed[x * kLow + u] = fixed;
+            }
+        }
+        return t;
+    }();
+    return tables;
+}
+
+inline int32_t RoundShift(int32_t sum, int shift) {
+    return shift > 0 ? (sum + (1 << (shift - 1))) >> shift : sum;
+}
+
+// out(m x n) = a(m x k) · b(k x n) >> shift，行主序。整数运算，各实现结果逐位一致
+void MatMulScalar(const int32_t* a, const int32_t* b, int32_t* out, int m, int k, int n, int shift) {
+    for (int i = 0; i < m; ++i) {
+        for (int x = 0; x < n; ++x) {
+            int32_t sum = 0;
+            for (int j = 0; j < k; ++j) {
+                sum += a[i * k + j] * b[j * n + x];
+            }
+            out[i * n + x] = RoundShift(sum, shift);
+        }
+    }
+}
+
+#ifdef PERCEPTUALHASH_X86
+// n为4的倍数
+__attribute__((target("sse4.1")))
+void MatMulSSE41(const int32_t* a, const int32_t* b, int32_t* out, int m, int k, int n, int shift) {
+    __m128i round = _mm_set1_epi32(shift > 0 ? 1 << (shift - 1) : 0);
+    for (int i = 0; i < m; ++i) {
+        for (int x = 0; x < n; x += 4) {
+            __m128i acc = _mm_setzero_si128();
+            for (int j = 0; j < k; ++j) {
+                __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j * n + x));
+                acc = _mm_add_epi32(acc, _mm_mullo_epi32(row, _mm_set1_epi32(a[i * k + j])));
+            }
+            acc = _mm_sra_epi32(_mm_add_epi32(acc, round), _mm_cvtsi32_si128(shift));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * n + x), acc);
+        }
+    }
+}
+
+// n为8的倍数
+__attribute__((target("avx2")))
+void MatMulAVX2(const int32_t* a, const int32_t* b, int32_t* out, int m, int k, int n, int shift) {
+    __m256i round = _mm256_set1_epi32(shift > 0 ? 1 << (shift - 1) : 0);
+    for (int i = 0; i < m; ++i) {
+        for (int x = 0; x < n; x += 8) {
+            __m256i acc = _mm256_setzero_si256();
+            for (int j = 0; j < k; ++j) {
+                __m256i row = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j * n + x));
+                acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(row, _mm256_set1_epi32(a[i * k + j])));
+            }
+            acc = _mm256_sra_epi32(_mm256_add_epi32(acc, round), _mm_cvtsi32_si128(shift));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * n + x), acc);
+        }
+    }
+}
+#endif
+
+using MatMulFunc = void (*)(const int32_t* a, const int32_t* b, int32_t* out, int m, int k, int n, int shift);
+
+MatMulFunc SelectMatMul(Resampler::Isa isa) {
+#ifdef PERCEPTUALHASH_X86
+    if (isa == Resampler::Isa::AVX2) {
+        return MatMulAVX2;
+    }
+    if (isa == Resampler::Isa::SSE41) {
+        return MatMulSSE41;
+    }
+#endif
+    (void)isa;
+    return MatMulScalar;
+}
+
+// 每像素4字节的表面转为亮度
+void ReadLuma(SDL_Surface* surface, int32_t* luma) {
+    for (int y = 0; y < surface->h; ++y) {
+        const Uint32* row = reinterpret_cast<const Uint32*>(static_cast<const Uint8*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch);
+        for (int x = 0; x < surface->w; ++x) {
+            Uint8 r, g, b;
+            SDL_GetRGB(row[x], surface->format, &r, &g, &b);
+            luma[y * surface->w + x] = (77 * r + 150 * g + 29 * b) >> 8;
+        }
+    }
+}
+
+} // namespace
+
+bool PerceptualHash::Compute(SDL_Surface* surface, Signature* signature) {
+    return Compute(surface, signature, Resampler::DetectIsa());
+}
+
+bool PerceptualHash::Compute(SDL_Surface* surface, Signature* signature, Resampler::Isa isa) {
+    if (!surface || surface->w <= 0 || surface->h <= 0) {
+        return false;
+    }
+    isa = std::min(isa, Resampler::DetectIsa());
+    // 忽略宽高比，直接缩放为正方形
+    SDL_Surface* small = Resampler::Resize(surface, kN, kN, Resampler::Filter::Box, isa);
+    if (!small) {
+        return false;
+    }
+    SDL_Surface* strip = Resampler::Resize(small, kLow + 1, kLow, Resampler::Filter::Box, isa);
+    if (!strip) {
+        SDL_FreeSurface(small);
+        return false;
+    }
+    int32_t pixels[kN * kN];
+    ReadLuma(small, pixels);
+    int32_t edges[(kLow + 1) * kLow];
+    ReadLuma(strip, edges);
+    SDL_FreeSurface(strip);
+    SDL_FreeSurface(small);
+
+    // 先对列做DCT只留前8行，再对行做DCT只留前8列
+    const DctTables& tables = Tables();
+    MatMulFunc matMul = SelectMatMul(isa);
+    int32_t rows[kLow * kN];
+    int32_t coefficients[kLow * kLow];
+    matMul(tables.basis, pixels, rows, kLow, kN, kN, kRowShift);
+    matMul(rows, tables.transposed, coefficients, kLow, kN, kLow, 0);
+
+    // 中位数只取交流分量，直流分量只反映整体亮度
+    int32_t ac[kLow * kLow - 1];
+    std::copy(coefficients + 1, coefficients + kLow * kLow, ac);
+    std::nth_element(ac, ac + (kLow * kLow - 1) / 2, ac + kLow * kLow - 1);
+    int32_t median = ac[(kLow * kLow - 1) / 2];
+    signature->pHash = 0;
+    for (int i = 0; i < kLow * kLow; ++i) {
+        if (coefficients[i] > median) {
+            signature->pHash |= 1ull << i;
+        }
+    }
+    signature->dHash = 0;
+    for (int y = 0; y < kLow; ++y) {
+        for (int x = 0; x < kLow; ++x) {
+            if (edges[y * (kLow + 1) + x] > edges[y * (kLow + 1) + x + 1]) {
+                signature->dHash |= 1ull << (y * kLow + x);
+            }
+        }
+    }
+    return true;
+}
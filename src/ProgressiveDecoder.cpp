@@ -0,0 +1,345 @@
+#include "ProgressiveDecoder.h"
+#include <cerrno>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <jpeglib.h>
+#include <jerror.h>
+#ifdef IMAGEVIEWER_HAVE_PNG
+#include <png.h>
+#endif
+#include "FileIo.h"
+#include "JpegError.h"
+#include "Trace.h"
+
+namespace {
+
+// 每次read的大小：网络共享上一次往返能取回的数据量，也是两次检查取消之间的读取量
+const size_t kReadChunk = 64 * 1024;
+
+ssize_t ReadSome(int fd, void* buffer, size_t size) {
+    ssize_t n;
+    do {
+        n = read(fd, buffer, size);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+// 从文件描述符分块读取的数据源，每读一块前检查是否已取消
+struct JpegStreamSource {
+    jpeg_source_mgr pub;
+    int fd;
+    const CancelToken* cancel;
+    JOCTET buffer[kReadChunk];
+};
+
+void JpegInitSource(j_decompress_ptr) {
+}
+
+boolean JpegFillInputBuffer(j_decompress_ptr cinfo) {
+    JpegStreamSource* source = reinterpret_cast<JpegStreamSource*>(cinfo->src);
+    if (source->cancel->IsCancelled()) {
+        std::longjmp(reinterpret_cast<JpegErrorManager*>(cinfo->err)->jump, 1);
+    }
+    ssize_t count = ReadSome(source->fd, source->buffer, sizeof(source->buffer));
+    if (count <= 0) {
+        // 文件被截断：与jpeg_stdio_src一样补一个EOI，已读完的扫描照常输出
+        WARNMS(cinfo, JWRN_JPEG_EOF);
+        source->buffer[0] = 0xFF;
+        source->buffer[1] = JPEG_EOI;
+        count = 2;
+    }
+    source->pub.next_input_byte = source->buffer;
+    source->pub.bytes_in_buffer = static_cast<size_t>(count);
+    return TRUE;
+}
+
+void JpegSkipInputData(j_decompress_ptr cinfo, long count) {
+    jpeg_source_mgr* source = cinfo->src;
+    while (count > static_cast<long>(source->bytes_in_buffer)) {
+        count -= static_cast<long>(source->bytes_in_buffer);
+        JpegFillInputBuffer(cinfo);
+    }
+    if (count > 0) {
+        source->next_input_byte += count;
+        source->bytes_in_buffer -= static_cast<size_t>(count);
+    }
+}
+
+void JpegTermSource(j_decompress_ptr) {
+}
+
+void ReadScanlines(jpeg_decompress_struct* cinfo, SDL_Surface* surface) {
+    while (cinfo->output_scanline < cinfo->output_height) {
+        JSAMPROW row = static_cast<JSAMPROW>(surface->pixels) + static_cast<size_t>(cinfo->output_scanline) * surface->pitch;
+        jpeg_read_scanlines(cinfo, &row, 1);
+    }
+}
+
+#ifdef IMAGEVIEWER_HAVE_PNG
+// libpng渐进读取的回调状态
+struct PngState {
+    SDL_Surface* surface = nullptr;
+    const ProgressiveDecoder::PassFunc* onPass = nullptr;
+    Uint32 passIntervalMs = 0;
+    Uint32 lastOutput = 0;
+    int pass = 0;               // 正在合并的隔行遍
+    int published = 0;
+    bool stopped = false;       // 回调要求停止
+    bool finished = false;      // 读到IEND
+};
+
+void PngInfo(png_structp png, png_infop info) {
+    PngState* state = static_cast<PngState*>(png_get_progressive_ptr(png));
+    png_uint_32 width, height;
+    int depth, colorType;
+    png_get_IHDR(png, info, &width, &height, &depth, &colorType, nullptr, nullptr, nullptr);
+    // 统一转换为8位BGRA，即小端序的ARGB8888
+    bool alpha = (colorType & PNG_COLOR_MASK_ALPHA) != 0 || png_get_valid(png, info, PNG_INFO_tRNS);
+    if (colorType == PNG_COLOR_TYPE_PALETTE) {
+        png_set_palette_to_rgb(png);
+    }
+    if (colorType == PNG_COLOR_TYPE_GRAY && depth < 8) {
+        png_set_expand_gray_1_2_4_to_8(png);
+    }
+    if (png_get_valid(png, info, PNG_INFO_tRNS)) {
+        png_set_tRNS_to_alpha(png);
+    }
+    if (depth == 16) {
+        png_set_strip_16(png);
+    }
+    if ((colorType & PNG_COLOR_MASK_COLOR) == 0) {
+        png_set_gray_to_rgb(png);
+    }
+    png_set_bgr(png);
+    if (!alpha) {
+        png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
+    }
+    png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+    state->surface = SDL_CreateRGBSurfaceWithFormat(0, static_cast<int>(width), static_cast<int>(height), 32,
+                                                    SDL_PIXELFORMAT_ARGB8888);
+    if (!state->surface) {
+        png_error(png, "Unable to allocate surface");
+    }
+    SDL_SetSurfaceBlendMode(state->surface, alpha ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+}
+
+void PngRow(png_structp png, png_bytep newRow, png_uint_32 rowNumber, int pass) {
+    PngState* state = static_cast<PngState*>(png_get_progressive_ptr(png));
+    if (state->stopped) {
+        return;
+    }
+    if (pass != state->pass) {
+        // 开始新的一遍时上一遍已完整合并
+        state->pass = pass;
+        if (SDL_GetTicks() - state->lastOutput >= state->passIntervalMs) {
+            state->stopped = !(*state->onPass)(state->surface, ++state->published);
+            state->lastOutput = SDL_GetTicks();
+        }
+    }
+    // 显示模式合并：本遍的像素填满它所代表的整块，近似图没有空洞
+    png_bytep row = static_cast<png_bytep>(state->surface->pixels) + static_cast<size_t>(rowNumber) * state->surface->pitch;
+    png_progressive_combine_row(png, row, newRow);
+}
+
+void PngEnd(png_structp png, png_infop) {
+    static_cast<PngState*>(png_get_progressive_ptr(png))->finished = true;
+}
+#endif
+
+} // namespace
+
+ProgressiveDecoder::Format ProgressiveDecoder::Probe(const std::string& path, int* width, int* height) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return Format::None;
+    }
+    Format format = Format::None;
+    unsigned char header[33];
+    if (PreadFully(fd, header, 2, 0) && header[0] == 0xFF && header[1] == 0xD8) {
+        // 跳过SOF之前的标记段，SOF2（霍夫曼）和SOF10（算术编码）是渐进式
+        off_t offset = 2;
+        unsigned char marker[4];
+        while (PreadFully(fd, marker, sizeof(marker), offset) && marker[0] == 0xFF) {
+            if (marker[1] == 0xFF) {
+                ++offset;
+                continue;
+            }
+            if (marker[1] == 0xDA || marker[1] == 0xD9) {
+                break;
+            }
+            bool frame = marker[1] >= 0xC0 && marker[1] <= 0xCF && marker[1] != 0xC4 && marker[1] != 0xC8 && marker[1] != 0xCC;
+            if (frame) {
+                unsigned char sof[6];
+                // CMYK交给整图解码路径
+                if ((marker[1] == 0xC2 || marker[1] == 0xCA) && PreadFully(fd, sof, sizeof(sof), offset + 4) && sof[5] != 4) {
+                    *height = (sof[1] << 8) | sof[2];
+                    *width = (sof[3] << 8) | sof[4];
+                    format = Format::Jpeg;
+                }
+                break;
+            }
+            offset += 2 + ((marker[2] << 8) | marker[3]);
+        }
+    }
+#ifdef IMAGEVIEWER_HAVE_PNG
+    else if (PreadFully(fd, header, sizeof(header), 0) && png_sig_cmp(header, 0, 8) == 0 && std::memcmp(header + 12, "IHDR", 4) == 0) {
+        // IHDR最后一个字节是隔行方式，1为Adam7
+        if (header[28] == 1) {
+            *width = (header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19];
+            *height = (header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23];
+            format = Format::Png;
+        }
+    }
+#endif
+    close(fd);
+    if (format != Format::None && (*width <= 0 || *height <= 0)) {
+        return Format::None;
+    }
+    return format;
+}
+
+SDL_Surface* ProgressiveDecoder::Decode(const std::string& path, Format format, int scaleDenom, const PassFunc& onPass,
+                                        const CancelToken& cancel, Uint32 passIntervalMs) {
+    TRACE_SCOPE("ProgressiveDecoder::Decode");
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Unable to open image " << path << std::endl;
+        return nullptr;
+    }
+    // 从头到尾顺序读取，让内核加大预读
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    SDL_Surface* surface = nullptr;
+    if (format == Format::Jpeg) {
+        surface = DecodeJpeg(fd, scaleDenom, onPass, cancel, passIntervalMs);
+    } else if (format == Format::Png) {
+        surface = DecodePng(fd, onPass, cancel, passIntervalMs);
+    }
+    close(fd);
+    return surface;
+}
+
+SDL_Surface* ProgressiveDecoder::DecodeJpeg(int fd, int scaleDenom, const PassFunc& onPass, const CancelToken& cancel,
+                                            Uint32 passIntervalMs) {
+    // setjmp之后不再创建需要析构的对象；表面在setjmp之后赋值，需声明为volatile
+    SDL_Surface* volatile surface = nullptr;
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager error;
+    JpegStreamSource source;
+    cinfo.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = JpegErrorExit;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        SDL_FreeSurface(surface);
+        return nullptr;
+    }
+    jpeg_create_decompress(&cinfo);
+    source.pub.init_source = JpegInitSource;
+    source.pub.fill_input_buffer = JpegFillInputBuffer;
+    source.pub.skip_input_data = JpegSkipInputData;
+    source.pub.resync_to_restart = jpeg_resync_to_restart;
+    source.pub.term_source = JpegTermSource;
+    source.pub.next_input_byte = nullptr;
+    source.pub.bytes_in_buffer = 0;
+    source.fd = fd;
+    source.cancel = &cancel;
+    cinfo.src = &source.pub;
+    jpeg_read_header(&cinfo, TRUE);
+    // CMYK无法直接输出为BGRA
+    if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK) {
+        jpeg_destroy_decompress(&cinfo);
+        return nullptr;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = static_cast<unsigned int>(scaleDenom == 2 || scaleDenom == 4 || scaleDenom == 8 ? scaleDenom : 1);
+    cinfo.out_color_space = JCS_EXT_BGRA;
+    // 缓冲图像模式：系数保存在内存中，可以按已读到的扫描多次输出
+    cinfo.buffered_image = TRUE;
+    jpeg_start_decompress(&cinfo);
+    surface = SDL_CreateRGBSurfaceWithFormat(0, static_cast<int>(cinfo.output_width), static_cast<int>(cinfo.output_height),
+                                             32, SDL_PIXELFORMAT_ARGB8888);
+    if (!surface) {
+        jpeg_destroy_decompress(&cinfo);
+        return nullptr;
+    }
+    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    Uint32 lastOutput = SDL_GetTicks();
+    int pass = 0;
+    while (true) {
+        // 读完当前扫描和下一遍扫描的头部，数据源是阻塞的，不会返回JPEG_SUSPENDED
+        int status;
+        do {
+            status = jpeg_consume_input(&cinfo);
+        } while (status != JPEG_REACHED_SOS && status != JPEG_REACHED_EOI);
+        if (status == JPEG_REACHED_EOI) {
+            break;
+        }
+        if (SDL_GetTicks() - lastOutput < passIntervalMs) {
+            continue;
+        }
+        // 按已读完的扫描输出近似图
+        jpeg_start_output(&cinfo, cinfo.input_scan_number - 1);
+        ReadScanlines(&cinfo, surface);
+        jpeg_finish_output(&cinfo);
+        if (!onPass(surface, ++pass)) {
+            jpeg_destroy_decompress(&cinfo);
+            SDL_FreeSurface(surface);
+            return nullptr;
+        }
+        lastOutput = SDL_GetTicks();
+    }
+    jpeg_start_output(&cinfo, cinfo.input_scan_number);
+    ReadScanlines(&cinfo, surface);
+    jpeg_finish_output(&cinfo);
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return surface;
+}
+
+SDL_Surface* ProgressiveDecoder::DecodePng(int fd, const PassFunc& onPass, const CancelToken& cancel, Uint32 passIntervalMs) {
+#ifdef IMAGEVIEWER_HAVE_PNG
+    std::vector<unsigned char> buffer(kReadChunk);
+    PngState state;
+    state.onPass = &onPass;
+    state.passIntervalMs = passIntervalMs;
+    state.lastOutput = SDL_GetTicks();
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info = png ? png_create_info_struct(png) : nullptr;
+    if (!info) {
+        png_destroy_read_struct(&png, nullptr, nullptr);
+        return nullptr;
+    }
+    // libpng出错时跳回这里；state的地址已交给libpng，成员不会只留在寄存器中
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, nullptr);
+        SDL_FreeSurface(state.surface);
+        return nullptr;
+    }
+    png_set_progressive_read_fn(png, &state, PngInfo, PngRow, PngEnd);
+    while (!state.finished && !state.stopped && !cancel.IsCancelled()) {
+        ssize_t count = ReadSome(fd, buffer.data(), buffer.size());
+        if (count <= 0) {
+            std::cerr << "PNG error: file truncated" << std::endl;
+            break;
+        }
+        png_process_data(png, info, buffer.data(), static_cast<size_t>(count));
+    }
+    png_destroy_read_struct(&png, &info, nullptr);
+    if (!state.finished || state.stopped) {
+        SDL_FreeSurface(state.surface);
+        return nullptr;
+    }
+    return state.surface;
+#else
+    (void)fd;
+    (void)onPass;
+    (void)cancel;
+    (void)passIntervalMs;
+    return nullptr;
+#endif
+}
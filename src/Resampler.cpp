@@ -0,0 +1,470 @@
+#include "Resampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RESAMPLER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const int kPrecision = 14;  // 系数定点位数，权重1.0对应1 << 14
+const double kPi = 3.14159265358979323846;
+
+double BoxFilter(double x) {
+    return (x > -0.5 && x <= 0.5) ? 1.0 : 0.0;
+}
+
+double MitchellFilter(double x) {
+    const double b = 1.0 / 3.0;
+    const double c = 1.0 / 3.0;
+    x = std::fabs(x);
+    if (x < 1.0) {
+        return ((12.0 - 9.0 * b - 6.0 * c) * x * x * x + (-18.0 + 12.0 * b + 6.0 * c) * x * x + (6.0 - 2.0 * b)) / 6.0;
+    }
+    if (x < 2.0) {
+        return ((-b - 6.0 * c) * x * x * x + (6.0 * b + 30.0 * c) * x * x + (-12.0 * b - 48.0 * c) * x + (8.0 * b + 24.0 * c)) / 6.0;
+    }
+    return 0.0;
+}
+
+double Sinc(double x) {
+    if (x == 0.0) {
+        return 1.0;
+    }
+    x *= kPi;
+    return std::sin(x) / x;
+}
+
+double Lanczos3Filter(double x) {
+    return (x > -3.0 && x < 3.0) ? Sinc(x) * Sinc(x / 3.0) : 0.0;
+}
+
+// 每个输出像素对应的源区间和定点权重，权重按stride（taps向上取4的倍数，多出的为0）对齐存放
+struct Coefficients {
+    int inSize = 0;
+    int taps = 0;
+    int stride = 0;
+    std::vector<int> starts;
+    std::vector<int> counts;
+    std::vector<int16_t> weights;
+};
+
+Coefficients ComputeCoefficients(int inSize, int outSize, Resampler::Filter filter) {
+    double (*kernel)(double) = Lanczos3Filter;
+    double support = 3.0;
+    if (filter == Resampler::Filter::Box) {
+        kernel = BoxFilter;
+        support = 0.5;
+    } else if (filter == Resampler::Filter::Mitchell) {
+        kernel = MitchellFilter;
+        support = 2.0;
+    }
+
+    // 缩小时按比例展宽滤波器，放大时保持原宽度
+    double scale = static_cast<double>(inSize) / outSize;
+    double filterScale = std::max(1.0, scale);
+    support *= filterScale;
+
+    Coefficients coeffs;
+    coeffs.inSize = inSize;
+    coeffs.taps = static_cast<int>(std::ceil(support)) * 2 + 1;
+    coeffs.stride = (coeffs.taps + 3) & ~3;
+    coeffs.starts.resize(outSize);
+    coeffs.counts.resize(outSize);
+    coeffs.weights.assign(static_cast<size_t>(outSize) * coeffs.stride, 0);
+    std::vector<double> k(coeffs.taps);
+    for (int out = 0; out < outSize; ++out) {
+        double center = (out + 0.5) * scale;
+        int xmin = std::max(static_cast<int>(center - support + 0.5), 0);
+        int count = std::min(static_cast<int>(center + support + 0.5), inSize) - xmin;
+        count = std::max(1, std::min(count, coeffs.taps));
+        xmin = std::min(xmin, inSize - count);
+        double total = 0.0;
+        for (int i = 0; i < count; ++i) {
+            k[i] = kernel((i + xmin - center + 0.5) / filterScale);
+            total += k[i];
+        }
+        int16_t* weights = &coeffs.weights[static_cast<size_t>(out) * coeffs.stride];
+        for (int i = 0; i < count; ++i) {
+            double w = total != 0.0 ? k[i] / total : (i == 0 ? 1.0 : 0.0);
+            weights[i] = static_cast<int16_t>(std::lround(w * (1 << kPrecision)));
+        }
+        coeffs.starts[out] = xmin;
+        coeffs.counts[out] = count;
+    }
+    return coeffs;
+}
+
+inline Uint8 ClampToByte(int32_t sum) {
+    int32_t value = sum >> kPrecision;
+    return static_cast<Uint8>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// ---- 标量实现（参考实现，也用于SIMD的行尾） ----
+
+void HorizontalPixelsScalar(const Uint8* src, Uint8* dst, int begin, int end, const Coefficients& c) {
+    for (int out = begin; out < end; ++out) {
+        const Uint8* p = src + static_cast<size_t>(c.starts[out]) * 4;
+        const int16_t* w = &c.weights[static_cast<size_t>(out) * c.stride];
+        int32_t sum[4] = {1 << (kPrecision - 1), 1 << (kPrecision - 1), 1 << (kPrecision - 1), 1 << (kPrecision - 1)};
+        for (int i = 0; i < c.counts[out]; ++i) {
+            for (int ch = 0; ch < 4; ++ch) {
+                sum[ch] += p[i * 4 + ch] * w[i];
+            }
+        }
+        for (int ch = 0; ch < 4; ++ch) {
+            dst[out * 4 + ch] = ClampToByte(sum[ch]);
+        }
+    }
+}
+
+void HorizontalRowScalar(const Uint8* src, Uint8* dst, int width, const Coefficients& c) {
+    HorizontalPixelsScalar(src, dst, 0, width, c);
+}
+
+void VerticalPixelsScalar(const Uint8* const* rows, const int16_t* w, int count, Uint8* dst, int begin, int end) {
+    for (int x = begin * 4; x < end * 4; ++x) {
+        int32_t sum = 1 << (kPrecision - 1);
+        for (int i = 0; i < count; ++i) {
+            sum += rows[i][x] * w[i];
+        }
+        dst[x] = ClampToByte(sum);
+    }
+}
+
+void VerticalRowScalar(const Uint8* const* rows, const int16_t* w, int count, Uint8* dst, int width) {
+    VerticalPixelsScalar(rows, w, count, dst, 0, width);
+}
+
+#ifdef RESAMPLER_X86
+// 两个16位权重打包为一个32位数，配合_mm_madd_epi16一次完成两个源像素的乘加
+inline int32_t PackWeights(int16_t w0, int16_t w1) {
+    return static_cast<int32_t>(static_cast<uint16_t>(w0) | (static_cast<uint32_t>(static_cast<uint16_t>(w1)) << 16));
+}
+
+// ---- SSE4.1 ----
+
+// 从第k个权重开始处理剩余的源像素：每次4个、2个、1个
+__attribute__((target("sse4.1")))
+inline __m128i HorizontalTailSSE41(const Uint8* p, const int16_t* w, int k, int count, __m128i acc) {
+    const __m128i zero = _mm_setzero_si128();
+    // 把相邻两个像素的同一通道排在一起：b0 b1 g0 g1 r0 r1 a0 a1
+    const __m128i interleave = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+    for (; k + 4 <= count; k += 4) {
+        __m128i pixels = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + k * 4)), interleave);
+        __m128i weights = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(w + k));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_cvtepu8_epi16(pixels), _mm_shuffle_epi32(weights, 0x00)));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), _mm_shuffle_epi32(weights, 0x55)));
+    }
+    for (; k + 2 <= count; k += 2) {
+        __m128i pixels = _mm_shuffle_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + k * 4)), interleave);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_cvtepu8_epi16(pixels), _mm_set1_epi32(PackWeights(w[k], w[k + 1]))));
+    }
+    for (; k < count; ++k) {
+        int32_t pixel;
+        std::memcpy(&pixel, p + k * 4, 4);
+        acc = _mm_add_epi32(acc, _mm_mullo_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(pixel)), _mm_set1_epi32(w[k])));
+    }
+    return acc;
+}
+
+__attribute__((target("sse4.1")))
+inline void StorePixelSSE41(__m128i acc, Uint8* dst) {
+    acc = _mm_srai_epi32(acc, kPrecision);
+    acc = _mm_packs_epi32(acc, acc);
+    int32_t pixel = _mm_cvtsi128_si32(_mm_packus_epi16(acc, acc));
+    std::memcpy(dst, &pixel, 4);
+}
+
+__attribute__((target("sse4.1")))
+void HorizontalRowSSE41(const Uint8* src, Uint8* dst, int width, const Coefficients& c) {
+    for (int out = 0; out < width; ++out) {
+        const Uint8* p = src + static_cast<size_t>(c.starts[out]) * 4;
+        const int16_t* w = &c.weights[static_cast<size_t>(out) * c.stride];
+        __m128i acc = HorizontalTailSSE41(p, w, 0, c.counts[out], _mm_set1_epi32(1 << (kPrecision - 1)));
+        StorePixelSSE41(acc, dst + out * 4);
+    }
+}
+
+// 4个像素的一次乘加：a、b为相邻两个源行，结果累加到每个像素各自的累加器
+__attribute__((target("sse4.1")))
+inline void VerticalStepSSE41(__m128i a, __m128i b, __m128i weights, __m128i acc[4]) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_unpacklo_epi8(a, b);
+    __m128i hi = _mm_unpackhi_epi8(a, b);
+    acc[0] = _mm_add_epi32(acc[0], _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), weights));
+    acc[1] = _mm_add_epi32(acc[1], _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), weights));
+    acc[2] = _mm_add_epi32(acc[2], _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), weights));
+    acc[3] = _mm_add_epi32(acc[3], _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), weights));
+}
+
+__attribute__((target("sse4.1")))
+int VerticalPixelsSSE41(const Uint8* const* rows, const int16_t* w, int count, Uint8* dst, int begin, int width) {
+    const __m128i zero = _mm_setzero_si128();
+    int x = begin;
+    for (; x + 4 <= width; x += 4) {
+        __m128i acc[4];
+        for (__m128i& a : acc) {
+            a = _mm_set1_epi32(1 << (kPrecision - 1));
+        }
+        int k = 0;
+        for (; k + 2 <= count; k += 2) {
+            VerticalStepSSE41(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + x * 4)),
+                              _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k + 1] + x * 4)),
+                              _mm_set1_epi32(PackWeights(w[k], w[k + 1])), acc);
+        }
+        if (k < count) {
+            VerticalStepSSE41(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + x * 4)), zero,
+                              _mm_set1_epi32(PackWeights(w[k], 0)), acc);
+        }
+        __m128i p01 = _mm_packs_epi32(_mm_srai_epi32(acc[0], kPrecision), _mm_srai_epi32(acc[1], kPrecision));
+        __m128i p23 = _mm_packs_epi32(_mm_srai_epi32(acc[2], kPrecision), _mm_srai_epi32(acc[3], kPrecision));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(p01, p23));
+    }
+    return x;
+}
+
+__attribute__((target("sse4.1")))
+void VerticalRowSSE41(const Uint8* const* rows, const int16_t* w, int count, Uint8* dst, int width) {
+    int done = VerticalPixelsSSE41(rows, w, count, dst, 0, width);
+    VerticalPixelsScalar(rows, w, count, dst, done, width);
+}
+
+// ---- AVX2：每次处理8个像素，剩余部分交给SSE4.1 ----
+
+__attribute__((target("avx2")))
+inline void HorizontalPixelAVX2(const Uint8* src, Uint8* dst, int out, const Coefficients& c) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i interleave = _mm256_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15,
+                                                0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+    // 低128位用第0、1对权重，高128位用第2、3对
+    const __m256i lowPairs = _mm256_setr_epi32(0, 0, 0, 0, 2, 2, 2, 2);
+    const __m256i highPairs = _mm256_setr_epi32(1, 1, 1, 1, 3, 3, 3, 3);
+    const Uint8* p = src + static_cast<size_t>(c.starts[out]) * 4;
+    const int16_t* w = &c.weights[static_cast<size_t>(out) * c.stride];
+    int count = c.counts[out];
+    __m256i acc8 = _mm256_setzero_si256();
+    int k = 0;
+    for (; k + 8 <= count; k += 8) {
+        __m256i pixels = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + k * 4)), interleave);
+        __m256i weights = _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(w + k)));
+        acc8 = _mm256_add_epi32(acc8, _mm256_madd_epi16(_mm256_unpacklo_epi8(pixels, zero),
+                                                        _mm256_permutevar8x32_epi32(weights, lowPairs)));
+        acc8 = _mm256_add_epi32(acc8, _mm256_madd_epi16(_mm256_unpackhi_epi8(pixels, zero),
+                                                        _mm256_permutevar8x32_epi32(weights, highPairs)));
+    }
+    __m128i acc = _mm_add_epi32(_mm256_castsi256_si128(acc8), _mm256_extracti128_si256(acc8, 1));
+    acc = _mm_add_epi32(acc, _mm_set1_epi32(1 << (kPrecision - 1)));
+    acc = HorizontalTailSSE41(p, w, k, count, acc);
+    StorePixelSSE41(acc, dst + out * 4);
+}
+
+// 窄滤波器（如Box缩小）每个输出像素只有几个源像素：相邻两个输出像素各占一个128位通道，
+// 按4个源像素一步处理。权重补齐的0使多读的源像素不影响结果；读取会超出源行时返回false
+__attribute__((target("avx2")))
+inline bool HorizontalPairAVX2(const Uint8* src, Uint8* dst, int out, const Coefficients& c) {
+    int start0 = c.starts[out];
+    int start1 = c.starts[out + 1];
+    int span = (std::max(c.counts[out], c.counts[out + 1]) + 3) & ~3;
+    if (span > 8 || std::max(start0, start1) + span > c.inSize) {
+        return false;
+    }
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i interleave = _mm256_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15,
+                                                0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+    const Uint8* p0 = src + static_cast<size_t>(start0) * 4;
+    const Uint8* p1 = src + static_cast<size_t>(start1) * 4;
+    const int16_t* w0 = &c.weights[static_cast<size_t>(out) * c.stride];
+    const int16_t* w1 = w0 + c.stride;
+    __m256i acc = _mm256_set1_epi32(1 << (kPrecision - 1));
+    for (int k = 0; k < span; k += 4) {
+        __m256i pixels = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p0 + k * 4))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + k * 4)), 1);
+        pixels = _mm256_shuffle_epi8(pixels, interleave);
+        __m256i weights = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(w0 + k))),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(w1 + k)), 1);
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_unpacklo_epi8(pixels, zero), _mm256_shuffle_epi32(weights, 0x00)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_unpackhi_epi8(pixels, zero), _mm256_shuffle_epi32(weights, 0x55)));
+    }
+    acc = _mm256_srai_epi32(acc, kPrecision);
+    acc = _mm256_packs_epi32(acc, acc);
+    acc = _mm256_packus_epi16(acc, acc);
+    int32_t pixel0 = _mm_cvtsi128_si32(_mm256_castsi256_si128(acc));
+    int32_t pixel1 = _mm_cvtsi128_si32(_mm256_extracti128_si256(acc, 1));
+    std::memcpy(dst + out * 4, &pixel0, 4);
+    std::memcpy(dst + (out + 1) * 4, &pixel1, 4);
+    return true;
+}
+
+__attribute__((target("avx2")))
+void HorizontalRowAVX2(const Uint8* src, Uint8* dst, int width, const Coefficients& c) {
+    int out = 0;
+    while (out < width) {
+        if (out + 1 < width && HorizontalPairAVX2(src, dst, out, c)) {
+            out += 2;
+        } else {
+            HorizontalPixelAVX2(src, dst, out, c);
+            ++out;
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+inline void VerticalStepAVX2(__m256i a, __m256i b, __m256i weights, __m256i acc[4]) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = _mm256_unpacklo_epi8(a, b);
+    __m256i hi = _mm256_unpackhi_epi8(a, b);
+    acc[0] = _mm256_add_epi32(acc[0], _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), weights));
+    acc[1] = _mm256_add_epi32(acc[1], _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), weights));
+    acc[2] = _mm256_add_epi32(acc[2], _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), weights));
+    acc[3] = _mm256_add_epi32(acc[3], _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), weights));
+}
+
+__attribute__((target("avx2")))
+void VerticalRowAVX2(const Uint8* const* rows, const int16_t* w, int count, Uint8* dst, int width) {
+    const __m256i zero = _mm256_setzero_si256();
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i acc[4];
+        for (__m256i& a : acc) {
+            a = _mm256_set1_epi32(1 << (kPrecision - 1));
+        }
+        int k = 0;
+        for (; k + 2 <= count; k += 2) {
+            VerticalStepAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k] + x * 4)),
+                             _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k + 1] + x * 4)),
+                             _mm256_set1_epi32(PackWeights(w[k], w[k + 1])), acc);
+        }
+        if (k < count) {
+            VerticalStepAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k] + x * 4)), zero,
+                             _mm256_set1_epi32(PackWeights(w[k], 0)), acc);
+        }
+        // 打包按128位通道进行，与解包的顺序对应，结果仍是像素0~7
+        __m256i p01 = _mm256_packs_epi32(_mm256_srai_epi32(acc[0], kPrecision), _mm256_srai_epi32(acc[1], kPrecision));
+        __m256i p23 = _mm256_packs_epi32(_mm256_srai_epi32(acc[2], kPrecision), _mm256_srai_epi32(acc[3], kPrecision));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), _mm256_packus_epi16(p01, p23));
+    }
+    x = VerticalPixelsSSE41(rows, w, count, dst, x, width);
+    VerticalPixelsScalar(rows, w, count, dst, x, width);
+}
+#endif
+
+struct Kernels {
+    void (*horizontal)(const Uint8* src, Uint8* dst, int width, const Coefficients& c);
+    void (*vertical)(const Uint8* const* rows, const int16_t* w, int count, Uint8* dst, int width);
+};
+
+Kernels SelectKernels(Resampler::Isa isa) {
+#ifdef RESAMPLER_X86
+    if (isa == Resampler::Isa::AVX2) {
+        return {HorizontalRowAVX2, VerticalRowAVX2};
+    }
+    if (isa == Resampler::Isa::SSE41) {
+        return {HorizontalRowSSE41, VerticalRowSSE41};
+    }
+#endif
+    (void)isa;
+    return {HorizontalRowScalar, VerticalRowScalar};
+}
+
+} // namespace
+
+Resampler::Isa Resampler::DetectIsa() {
+#ifdef RESAMPLER_X86
+    static const Isa detected = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return Isa::AVX2;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+            return Isa::SSE41;
+        }
+        return Isa::Scalar;
+    }();
+    return detected;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+const char* Resampler::IsaName(Isa isa) {
+    switch (isa) {
+        case Isa::AVX2: return "AVX2";
+        case Isa::SSE41: return "SSE4.1";
+        default: return "scalar";
+    }
+}
+
+SDL_Surface* Resampler::Resize(SDL_Surface* source, int width, int height, Filter filter) {
+    return Resize(source, width, height, filter, DetectIsa());
+}
+
+SDL_Surface* Resampler::Resize(SDL_Surface* source, int width, int height, Filter filter, Isa isa) {
+    if (!source || source->format->BytesPerPixel != 4 || width <= 0 || height <= 0) {
+        return nullptr;
+    }
+    Kernels kernels = SelectKernels(std::min(isa, DetectIsa()));
+    int srcWidth = source->w;
+    int srcHeight = source->h;
+
+    SDL_Surface* dest = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, source->format->format);
+    if (!dest) {
+        return nullptr;
+    }
+    SDL_SetSurfaceBlendMode(dest, SDL_BLENDMODE_NONE);
+
+    if (SDL_MUSTLOCK(source)) {
+        SDL_LockSurface(source);
+    }
+    const Uint8* srcPixels = static_cast<const Uint8*>(source->pixels);
+    Coefficients vertical = ComputeCoefficients(srcHeight, height, filter);
+
+    // 水平一遍只处理垂直一遍用得到的源行
+    int firstRow = vertical.starts.front();
+    int lastRow = vertical.starts.back() + vertical.counts.back();
+    // 中间结果随即被全部写入，不需要清零
+    std::unique_ptr<Uint8[]> temp;
+    const Uint8* rowBase;
+    size_t rowPitch;
+    int rowOffset = 0;   // rowBase第0行对应的源行号
+    if (width == srcWidth) {
+        rowBase = srcPixels;
+        rowPitch = source->pitch;
+    } else {
+        Coefficients horizontal = ComputeCoefficients(srcWidth, width, filter);
+        rowPitch = static_cast<size_t>(width) * 4;
+        temp.reset(new Uint8[rowPitch * (lastRow - firstRow)]);
+        for (int y = firstRow; y < lastRow; ++y) {
+            kernels.horizontal(srcPixels + static_cast<size_t>(y) * source->pitch,
+                               &temp[(y - firstRow) * rowPitch], width, horizontal);
+        }
+        rowBase = temp.get();
+        rowOffset = firstRow;
+    }
+
+    std::vector<const Uint8*> rows(vertical.taps);
+    for (int y = 0; y < height; ++y) {
+        Uint8* dst = static_cast<Uint8*>(dest->pixels) + static_cast<size_t>(y) * dest->pitch;
+        if (height == srcHeight) {
+            std::memcpy(dst, rowBase + (y - rowOffset) * rowPitch, static_cast<size_t>(width) * 4);
+            continue;
+        }
+        int count = vertical.counts[y];
+        for (int i = 0; i < count; ++i) {
+            rows[i] = rowBase + (vertical.starts[y] + i - rowOffset) * rowPitch;
+        }
+        kernels.vertical(rows.data(), &vertical.weights[static_cast<size_t>(y) * vertical.stride], count, dst, width);
+    }
+
+    if (SDL_MUSTLOCK(source)) {
+        SDL_UnlockSurface(source);
+    }
+    return dest;
+}
@@ -0,0 +1,209 @@
+#include "SignatureStore.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "FileIo.h"
+
+// 文件中的定长记录
+struct SignatureStore::DiskRecord {
+    uint64_t hash;
+    uint64_t check;
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint64_t pHash;
+    uint64_t dHash;
+};
+
+namespace {
+
+const uint32_t kMagic = 0x47495350;    // "PSIG"
+const uint32_t kVersion = 2;            // 哈希算法或记录格式改变时递增，旧签名整体丢弃
+const size_t kMinRewriteRecords = 4096; // 过期记录少于此数时不值得重写
+const size_t kBatchRecords = 256;       // 积累这么多条再一次写入
+
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+uint64_t HashIdentity(const std::string& identity) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : identity) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// 与FNV无关的第二个哈希，两者同时冲突才会把别的文件的签名当作命中
+uint64_t CheckIdentity(const std::string& identity) {
+    uint64_t hash = identity.size();
+    for (unsigned char c : identity) {
+        hash = hash * 131 + c;
+    }
+    // splitmix64的收尾混合
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+    return hash ^ (hash >> 31);
+}
+
+} // namespace
+
+SignatureStore::SignatureStore() {
+}
+
+SignatureStore::~SignatureStore() {
+    Close();
+}
+
+bool SignatureStore::Open(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd >= 0 || directory.empty()) {
+        return fd >= 0;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    std::string path = directory + "/signatures.bin";
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Unable to open signature cache " << path << std::endl;
+        return false;
+    }
+    // 同时运行的其他实例已占用缓存时不使用
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        std::cerr << "Signature cache is in use by another instance" << std::endl;
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    struct stat st;
+    FileHeader header = {};
+    bool valid = fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(FileHeader) &&
+                 PreadFully(fd, &header, sizeof(header), 0) && header.magic == kMagic && header.version == kVersion;
+    size_t count = 0;
+    if (valid) {
+        // 末尾写了一半的记录丢弃
+        count = (static_cast<size_t>(st.st_size) - sizeof(FileHeader)) / sizeof(DiskRecord);
+        std::vector<DiskRecord> disk(count);
+        if (count > 0 && !PreadFully(fd, disk.data(), count * sizeof(DiskRecord), sizeof(FileHeader))) {
+            valid = false;
+        }
+        for (const DiskRecord& record : disk) {
+            records[record.hash] = {record.check, record.sourceSize, record.sourceMtime, {record.pHash, record.dHash}};
+        }
+    }
+    if (!valid) {
+        // 版本不符或损坏，整体重建
+        records.clear();
+        count = 0;
+        header = {kMagic, kVersion};
+        if (ftruncate(fd, 0) != 0 || !PwriteFully(fd, &header, sizeof(header), 0)) {
+            std::cerr << "Unable to initialize signature cache " << path << std::endl;
+            close(fd);
+            fd = -1;
+            return false;
+        }
+    }
+    fileSize = sizeof(FileHeader) + count * sizeof(DiskRecord);
+    if (ftruncate(fd, static_cast<off_t>(fileSize)) != 0) {
+        std::cerr << "Unable to truncate signature cache " << path << std::endl;
+    }
+    // 被覆盖的记录超过一半时重写
+    if (count > records.size() * 2 + kMinRewriteRecords) {
+        RewriteLocked(path);
+    }
+    std::cout << "Signature cache: " << records.size() << " entries in " << directory << std::endl;
+    return true;
+}
+
+void SignatureStore::Close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    FlushLocked();
+    if (fd >= 0) {
+        // 关闭时释放flock
+        close(fd);
+        fd = -1;
+    }
+    records.clear();
+    pending.clear();
+    fileSize = 0;
+}
+
+void SignatureStore::Flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    FlushLocked();
+}
+
+bool SignatureStore::FlushLocked() {
+    if (fd < 0 || pending.empty()) {
+        return fd >= 0;
+    }
+    bool ok = PwriteFully(fd, pending.data(), pending.size() * sizeof(DiskRecord), static_cast<int64_t>(fileSize));
+    if (ok) {
+        fileSize += pending.size() * sizeof(DiskRecord);
+    }
+    // 写入失败时丢弃，内存中的签名本次运行仍然有效
+    pending.clear();
+    return ok;
+}
+
+bool SignatureStore::RewriteLocked(const std::string& path) {
+    std::string tempPath = path + ".tmp";
+    int tempFd = open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (tempFd < 0) {
+        std::cerr << "Unable to compact signature cache" << std::endl;
+        return false;
+    }
+    std::vector<unsigned char> buffer(sizeof(FileHeader) + records.size() * sizeof(DiskRecord));
+    FileHeader header = {kMagic, kVersion};
+    std::copy(reinterpret_cast<const unsigned char*>(&header), reinterpret_cast<const unsigned char*>(&header + 1), buffer.begin());
+    DiskRecord* disk = reinterpret_cast<DiskRecord*>(buffer.data() + sizeof(FileHeader));
+    for (const auto& entry : records) {
+        *disk++ = {entry.first, entry.second.check, entry.second.sourceSize, entry.second.sourceMtime,
+                   entry.second.signature.pHash, entry.second.signature.dHash};
+    }
+    if (flock(tempFd, LOCK_EX | LOCK_NB) != 0 || !PwriteFully(tempFd, buffer.data(), buffer.size(), 0) ||
+        rename(tempPath.c_str(), path.c_str()) != 0) {
+        close(tempFd);
+        unlink(tempPath.c_str());
+        return false;
+    }
+    close(fd);
+    fd = tempFd;
+    fileSize = buffer.size();
+    // 重写的内容已包含尚未写入的记录
+    pending.clear();
+    return true;
+}
+
+bool SignatureStore::Get(const ThumbnailStore::Key& key, PerceptualHash::Signature* signature) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = records.find(HashIdentity(key.identity));
+    if (it == records.end() || it->second.check != CheckIdentity(key.identity) ||
+        it->second.sourceSize != key.sourceSize || it->second.sourceMtime != key.sourceMtime) {
+        ++missCount;
+        return false;
+    }
+    *signature = it->second.signature;
+    ++hitCount;
+    return true;
+}
+
+bool SignatureStore::Put(const ThumbnailStore::Key& key, const PerceptualHash::Signature& signature) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd < 0) {
+        return false;
+    }
+    uint64_t hash = HashIdentity(key.identity);
+    uint64_t check = CheckIdentity(key.identity);
+    records[hash] = {check, key.sourceSize, key.sourceMtime, signature};
+    pending.push_back({hash, check, key.sourceSize, key.sourceMtime, signature.pHash, signature.dHash});
+    return pending.size() < kBatchRecords || FlushLocked();
+}
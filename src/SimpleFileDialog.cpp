@@ -3,7 +3,6 @@
 #include <memory>
 #include <array>
 #include <cstdlib>
-#include <future>
 
 std::string SimpleFileDialog::OpenFile() {
     std::string result;
@@ -138,21 +137,3 @@ std::string SimpleFileDialog::OpenArchive() {
     
     return result;
 }
-
-std::future<std::string> SimpleFileDialog::OpenFileAsync() {
-    return std::async(std::launch::async, []() {
-        return OpenFile();
-    });
-}
-
-std::future<std::string> SimpleFileDialog::OpenFolderAsync() {
-    return std::async(std::launch::async, []() {
-        return OpenFolder();
-    });
-}
-
-std::future<std::string> SimpleFileDialog::OpenArchiveAsync() {
-    return std::async(std::launch::async, []() {
-        return OpenArchive();
-    });
-}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "TextureCache.h"
+#include <iostream>
+
+TextureCache::TextureCache() {
+}
+
+TextureCache::~TextureCache() {
+    // 纹理依赖渲染器，正常情况下应在销毁渲染器前调用Clear()
+    Clear();
+}
+
+void TextureCache::SetBudgetMB(size_t megabytes) {
+    budgetBytes = megabytes * 1024u * 1024u;
+    EvictToBudget();
+    std::cout << "Texture cache budget set to: " << megabytes << " MB" << std::endl;
+}
+
+SDL_Texture* TextureCache::Get(const std::string& key) {
+    auto it = index.find(key);
+    if (it == index.end()) {
+        return nullptr;
+    }
+    // 移到表头
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->texture;
+}
+
+void TextureCache::Put(const std::string& key, SDL_Texture* texture) {
+    if (!texture) {
+        return;
+    }
+    Remove(key);
+
+    Uint32 format = 0;
+    int width = 0;
+    int height = 0;
+    SDL_QueryTexture(texture, &format, nullptr, &width, &height);
+    size_t bytes = TextureBytes(width, height, format);
+
+    entries.push_front({key, texture, bytes});
+    index[key] = entries.begin();
+    usedBytes += bytes;
+
+    EvictToBudget();
+}
+
+void TextureCache::Remove(const std::string& key) {
+    auto it = index.find(key);
+    if (it == index.end()) {
+        return;
+    }
+    usedBytes -= it->second->bytes;
+    SDL_DestroyTexture(it->second->texture);
+    entries.erase(it->second);
+    index.erase(it);
+}
+
+void TextureCache::SetPinned(const std::vector<std::string>& keys, int group) {
+    std::unordered_set<std::string>& groupKeys = pinned[group];
+    groupKeys.clear();
+    groupKeys.insert(keys.begin(), keys.end());
+    EvictToBudget();
+}
+
+bool TextureCache::IsPinned(const std::string& key) const {
+    for (const auto& group : pinned) {
+        if (group.second.count(key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TextureCache::Clear() {
+    for (auto& entry : entries) {
+        SDL_DestroyTexture(entry.texture);
+    }
+    entries.clear();
+    index.clear();
+    pinned.clear();
+    usedBytes = 0;
+}
+
+size_t TextureCache::TextureBytes(int width, int height, Uint32 format) {
+    size_t pixels = static_cast<size_t>(width) * static_cast<size_t>(height);
+    if (SDL_ISPIXELFORMAT_FOURCC(format)) {
+        // YUV等平面格式按每像素1.5字节估算
+        return pixels * 3 / 2;
+    }
+    size_t bytesPerPixel = SDL_BYTESPERPIXEL(format);
+    return pixels * (bytesPerPixel ? bytesPerPixel : 4);
+}
+
+void TextureCache::EvictToBudget() {
+    // 从表尾（最久未使用）开始淘汰，跳过固定项；表头是正在使用的纹理，不淘汰
+    auto it = entries.end();
+    while (usedBytes > budgetBytes && it != entries.begin()) {
+        --it;
+        if (it == entries.begin()) {
+            break;
+        }
+        if (IsPinned(it->key)) {
+            continue;
+        }
+        usedBytes -= it->bytes;
+        SDL_DestroyTexture(it->texture);
+        index.erase(it->key);
+        it = entries.erase(it);
+        ++evictionCount;
+    }
+}
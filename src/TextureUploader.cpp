@@ -0,0 +1,181 @@
+#include "TextureUploader.h"
+#include <algorithm>
+#include <iostream>
+#include "Trace.h"
+
+TextureUploader::TextureUploader() {
+}
+
+TextureUploader::~TextureUploader() {
+    Clear();
+}
+
+bool TextureUploader::Enqueue(SDL_Renderer* target, const std::string& group, const std::string& key,
+                              std::shared_ptr<DecodedImage> owner, SDL_Surface* surface) {
+    renderer = target;
+    bool staged = false;
+    SDL_Texture* texture = AcquireTexture(surface->format->format, surface->w, surface->h, &staged);
+    if (!texture) {
+        return false;
+    }
+    // 与SDL_CreateTextureFromSurface一致：带透明通道的表面按混合模式绘制
+    SDL_SetTextureBlendMode(texture, SDL_ISPIXELFORMAT_ALPHA(surface->format->format) ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+    uploads.push_back({group, key, std::move(owner), surface, texture, staged, 0});
+    return true;
+}
+
+void TextureUploader::Prioritize(const std::string& group) {
+    std::stable_partition(uploads.begin(), uploads.end(), [&group](const Upload& upload) { return upload.group == group; });
+}
+
+void TextureUploader::Cancel(const std::string& group) {
+    for (auto it = uploads.begin(); it != uploads.end();) {
+        if (it->group == group) {
+            ReleaseTexture(it->texture);
+            it = uploads.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool TextureUploader::IsPending(const std::string& group) const {
+    return std::any_of(uploads.begin(), uploads.end(), [&group](const Upload& upload) { return upload.group == group; });
+}
+
+int TextureUploader::Pump(TextureCache& cache) {
+    if (uploads.empty()) {
+        return 0;
+    }
+    TRACE_SCOPE("TextureUploader::Pump");
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 budgetTicks = static_cast<Uint64>(budgetMs * SDL_GetPerformanceFrequency() / 1000.0);
+    int completed = 0;
+    // 至少上传一条，预算再小也能推进
+    do {
+        Upload& upload = uploads.front();
+        SDL_Surface* surface = upload.surface;
+        int rows = 0;
+        if (!UploadStrip(upload, &rows)) {
+            std::cerr << "Unable to update texture " << upload.key << "! SDL_Error: " << SDL_GetError() << std::endl;
+            SDL_DestroyTexture(upload.texture);
+            uploads.pop_front();
+            continue;
+        }
+        upload.nextRow += rows;
+        uploadedBytes += static_cast<uint64_t>(rows) * surface->pitch;
+        ++stripCount;
+        if (upload.nextRow >= surface->h) {
+            cache.Put(upload.key, upload.texture);
+            uploads.pop_front();
+            ++completed;
+        }
+    } while (!uploads.empty() && SDL_GetPerformanceCounter() - start < budgetTicks);
+    return completed;
+}
+
+bool TextureUploader::UploadStrip(Upload& upload, int* rows) {
+    SDL_Surface* surface = upload.surface;
+    const Uint8* pixels = static_cast<const Uint8*>(surface->pixels) + static_cast<size_t>(upload.nextRow) * surface->pitch;
+    int remaining = surface->h - upload.nextRow;
+    if (!upload.staged) {
+        *rows = std::min(std::max(1, static_cast<int>(kStripBytes / static_cast<size_t>(surface->pitch))), remaining);
+        SDL_Rect strip = {0, upload.nextRow, surface->w, *rows};
+        return SDL_UpdateTexture(upload.texture, &strip, pixels, surface->pitch) == 0;
+    }
+    const Staging* buffer = AcquireStaging(surface->format->format, surface->w);
+    if (!buffer) {
+        return false;
+    }
+    *rows = std::min(buffer->height, remaining);
+    SDL_Rect source = {0, 0, surface->w, *rows};
+    SDL_Rect strip = {0, upload.nextRow, surface->w, *rows};
+    if (SDL_UpdateTexture(buffer->texture, &source, pixels, surface->pitch) != 0) {
+        return false;
+    }
+    // 下一次写中转纹理之前SDL会先提交这次复制
+    SDL_Texture* previous = SDL_GetRenderTarget(renderer);
+    bool copied = SDL_SetRenderTarget(renderer, upload.texture) == 0 &&
+                  SDL_RenderCopy(renderer, buffer->texture, &source, &strip) == 0;
+    SDL_SetRenderTarget(renderer, previous);
+    return copied;
+}
+
+void TextureUploader::Clear() {
+    for (Upload& upload : uploads) {
+        SDL_DestroyTexture(upload.texture);
+    }
+    uploads.clear();
+    for (SDL_Texture* texture : spare) {
+        SDL_DestroyTexture(texture);
+    }
+    spare.clear();
+    for (Staging& buffer : staging) {
+        SDL_DestroyTexture(buffer.texture);
+    }
+    staging.clear();
+}
+
+SDL_Texture* TextureUploader::AcquireTexture(Uint32 format, int width, int height, bool* staged) {
+    for (auto it = spare.begin(); it != spare.end(); ++it) {
+        Uint32 spareFormat = 0;
+        int spareAccess = 0, spareWidth = 0, spareHeight = 0;
+        SDL_QueryTexture(*it, &spareFormat, &spareAccess, &spareWidth, &spareHeight);
+        if (spareFormat == format && spareWidth == width && spareHeight == height) {
+            SDL_Texture* texture = *it;
+            spare.erase(it);
+            *staged = spareAccess == SDL_TEXTUREACCESS_TARGET;
+            ++reusedCount;
+            return texture;
+        }
+    }
+    // 渲染目标纹理没有CPU端副本；格式不能作为渲染目标时退回流式纹理
+    SDL_Texture* texture = nullptr;
+    if (SDL_RenderTargetSupported(renderer)) {
+        texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_TARGET, width, height);
+    }
+    *staged = texture != nullptr;
+    if (!texture) {
+        texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, width, height);
+    }
+    if (!texture) {
+        std::cerr << "Unable to create streaming texture " << width << "x" << height << "! SDL_Error: " << SDL_GetError() << std::endl;
+    }
+    return texture;
+}
+
+const TextureUploader::Staging* TextureUploader::AcquireStaging(Uint32 format, int width) {
+    int stagingWidth = kMinStagingWidth;
+    while (stagingWidth < width) {
+        stagingWidth *= 2;
+    }
+    for (auto it = staging.begin(); it != staging.end(); ++it) {
+        if (it->format == format && it->width == stagingWidth) {
+            std::rotate(staging.begin(), it, it + 1);
+            return &staging.front();
+        }
+    }
+    int bytesPerPixel = std::max(1, static_cast<int>(SDL_BYTESPERPIXEL(format)));
+    int height = std::max(1, static_cast<int>(kStripBytes / (static_cast<size_t>(stagingWidth) * bytesPerPixel)));
+    SDL_Texture* texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, stagingWidth, height);
+    if (!texture) {
+        return nullptr;
+    }
+    // 原样复制像素（含透明通道），不与目标纹理混合
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+    staging.insert(staging.begin(), {format, stagingWidth, height, texture});
+    if (staging.size() > kMaxStaging) {
+        SDL_DestroyTexture(staging.back().texture);
+        staging.pop_back();
+    }
+    return &staging.front();
+}
+
+void TextureUploader::ReleaseTexture(SDL_Texture* texture) {
+    // 快速翻页时同尺寸的页面接连取消和排队，保留最近的几张
+    spare.insert(spare.begin(), texture);
+    if (spare.size() > kMaxSpare) {
+        SDL_DestroyTexture(spare.back());
+        spare.pop_back();
+    }
+}
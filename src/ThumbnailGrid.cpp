@@ -0,0 +1,463 @@
+#include "ThumbnailGrid.h"
+#include "Trace.h"
+#include <algorithm>
+#include <iostream>
+
+ThumbnailGrid::ThumbnailGrid() {
+}
+
+ThumbnailGrid::~ThumbnailGrid() {
+    Stop();
+}
+
+bool ThumbnailGrid::Start(int jobs, Uint32 wakeEvent, Uint32 pixelFormat) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (started) {
+        return true;
+    }
+    wakeEventType = wakeEvent;
+    atlasFormat = pixelFormat;
+    started = true;
+    stopping = false;
+    maxJobs = std::max(1, jobs);
+    queuedJobs = 0;
+    jobToken = CancelToken::Create();
+    std::cout << "Thumbnail grid started with up to " << maxJobs << " concurrent thumbnails" << std::endl;
+    return true;
+}
+
+void ThumbnailGrid::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        pending.clear();
+    }
+    JobScheduler::GetInstance().CancelAndWait(jobToken);
+    std::lock_guard<std::mutex> lock(mutex);
+    started = false;
+    queuedJobs = 0;
+    for (auto& entry : ready) {
+        SDL_FreeSurface(entry.second);
+    }
+    ready.clear();
+}
+
+void ThumbnailGrid::Reset(int count, ThumbnailFunc func) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++generation;
+        pending.clear();
+        for (auto& entry : ready) {
+            SDL_FreeSurface(entry.second);
+        }
+        ready.clear();
+        failed.clear();
+        thumbnailFunc = std::move(func);
+    }
+    imageCount = count;
+    scrollY = 0;
+    scrollDirection = 1;
+    selected = 0;
+    // 图集纹理保留，所有槽位重新可用
+    resident.clear();
+    freeSlots.clear();
+    for (int slot = (int)atlasPages.size() * kSlotsPerPage - 1; slot >= 0; --slot) {
+        freeSlots.push_back(slot);
+    }
+}
+
+void ThumbnailGrid::Remap(int count, const std::vector<int>& remap, ThumbnailFunc func) {
+    auto mapIndex = [&remap](int index) {
+        return index >= 0 && index < (int)remap.size() ? remap[index] : -1;
+    };
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // 正在生成的缩略图按旧序号提交，完成时作废，由下一帧重新请求
+        ++generation;
+        pending.clear();
+        std::map<int, SDL_Surface*> remappedReady;
+        for (auto& entry : ready) {
+            int index = mapIndex(entry.first);
+            if (index >= 0) {
+                remappedReady[index] = entry.second;
+            } else {
+                SDL_FreeSurface(entry.second);
+            }
+        }
+        ready.swap(remappedReady);
+        std::set<int> remappedFailed;
+        for (int index : failed) {
+            if (mapIndex(index) >= 0) {
+                remappedFailed.insert(mapIndex(index));
+            }
+        }
+        failed.swap(remappedFailed);
+        thumbnailFunc = std::move(func);
+    }
+    imageCount = count;
+    // 保留图集中未变的缩略图，删除或修改的图片让出槽位
+    std::unordered_map<int, Resident> remappedResident;
+    for (const auto& entry : resident) {
+        int index = mapIndex(entry.first);
+        if (index >= 0) {
+            remappedResident[index] = entry.second;
+        } else {
+            freeSlots.push_back(entry.second.slot);
+        }
+    }
+    resident.swap(remappedResident);
+    selected = std::max(0, std::min(mapIndex(selected), imageCount - 1));
+    ClampScroll();
+}
+
+void ThumbnailGrid::CancelRequests() {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.clear();
+}
+
+void ThumbnailGrid::SetViewport(const SDL_Rect& area) {
+    viewport = area;
+    ClampScroll();
+}
+
+int ThumbnailGrid::GetColumns() const {
+    return std::max(1, (viewport.w - kScrollbarWidth) / GetCellSize());
+}
+
+int ThumbnailGrid::GetVisibleRows() const {
+    return std::max(1, viewport.h / GetCellSize());
+}
+
+int ThumbnailGrid::GetMaxScroll() const {
+    int rows = (imageCount + GetColumns() - 1) / GetColumns();
+    return std::max(0, rows * GetCellSize() - viewport.h);
+}
+
+void ThumbnailGrid::ClampScroll() {
+    scrollY = std::max(0, std::min(scrollY, GetMaxScroll()));
+}
+
+SDL_Rect ThumbnailGrid::CellRect(int index) const {
+    int columns = GetColumns();
+    int cell = GetCellSize();
+    // 整行居中，右侧留出滚动条
+    int margin = (viewport.w - kScrollbarWidth - columns * cell) / 2;
+    return {viewport.x + margin + (index % columns) * cell, viewport.y + (index / columns) * cell - scrollY, cell, cell};
+}
+
+void ThumbnailGrid::SetSelected(int index) {
+    if (imageCount <= 0) {
+        return;
+    }
+    selected = std::max(0, std::min(index, imageCount - 1));
+    // 滚动到选中项整行可见
+    int top = (selected / GetColumns()) * GetCellSize();
+    if (top < scrollY) {
+        scrollDirection = -1;
+        scrollY = top;
+    } else if (top + GetCellSize() > scrollY + viewport.h) {
+        scrollDirection = 1;
+        scrollY = top + GetCellSize() - viewport.h;
+    }
+    ClampScroll();
+}
+
+void ThumbnailGrid::Scroll(int pixels) {
+    if (pixels != 0) {
+        scrollDirection = pixels > 0 ? 1 : -1;
+    }
+    scrollY += pixels;
+    ClampScroll();
+}
+
+void ThumbnailGrid::ScrollToFraction(float fraction) {
+    int target = static_cast<int>(std::max(0.0f, std::min(fraction, 1.0f)) * GetMaxScroll());
+    Scroll(target - scrollY);
+}
+
+bool ThumbnailGrid::HitScrollbar(int x, int y) const {
+    return x >= viewport.x + viewport.w - kScrollbarWidth && x < viewport.x + viewport.w &&
+           y >= viewport.y && y < viewport.y + viewport.h;
+}
+
+int ThumbnailGrid::HitTest(int x, int y) const {
+    if (imageCount <= 0 || y < viewport.y || y >= viewport.y + viewport.h) {
+        return -1;
+    }
+    SDL_Rect first = CellRect(0);
+    int cell = GetCellSize();
+    if (x < first.x || x >= first.x + GetColumns() * cell) {
+        return -1;
+    }
+    int column = (x - first.x) / cell;
+    int row = (y - first.y) / cell;
+    int index = row * GetColumns() + column;
+    return index < imageCount ? index : -1;
+}
+
+int ThumbnailGrid::AllocateSlot(SDL_Renderer* renderer) {
+    if (freeSlots.empty() && (int)atlasPages.size() < kMaxAtlasPages) {
+        SDL_Texture* page = SDL_CreateTexture(renderer, atlasFormat, SDL_TEXTUREACCESS_STATIC, kAtlasSize, kAtlasSize);
+        if (page) {
+            SDL_SetTextureBlendMode(page, SDL_BLENDMODE_BLEND);
+            int base = (int)atlasPages.size() * kSlotsPerPage;
+            atlasPages.push_back(page);
+            for (int slot = base + kSlotsPerPage - 1; slot >= base; --slot) {
+                freeSlots.push_back(slot);
+            }
+        } else {
+            std::cerr << "Unable to create thumbnail atlas! SDL_Error: " << SDL_GetError() << std::endl;
+        }
+    }
+    if (!freeSlots.empty()) {
+        int slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+    // 图集已满，淘汰最久未绘制的缩略图；本帧刚上传的不淘汰
+    auto victim = resident.end();
+    for (auto it = resident.begin(); it != resident.end(); ++it) {
+        if (it->second.lastUsed < frame && (victim == resident.end() || it->second.lastUsed < victim->second.lastUsed)) {
+            victim = it;
+        }
+    }
+    if (victim == resident.end()) {
+        return -1;
+    }
+    int slot = victim->second.slot;
+    resident.erase(victim);
+    return slot;
+}
+
+void ThumbnailGrid::UploadReady(SDL_Renderer* renderer) {
+    std::map<int, SDL_Surface*> uploads;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uploads.swap(ready);
+    }
+    for (auto& entry : uploads) {
+        SDL_Surface* surface = entry.second;
+        int slot = resident.count(entry.first) ? -1 : AllocateSlot(renderer);
+        if (slot >= 0) {
+            int page = slot / kSlotsPerPage;
+            int local = slot % kSlotsPerPage;
+            SDL_Rect rect = {(local % kSlotsPerRow) * kThumbSize, (local / kSlotsPerRow) * kThumbSize, surface->w, surface->h};
+            if (SDL_UpdateTexture(atlasPages[page], &rect, surface->pixels, surface->pitch) == 0) {
+                resident[entry.first] = {slot, surface->w, surface->h, frame};
+            } else {
+                freeSlots.push_back(slot);
+            }
+        }
+        SDL_FreeSurface(surface);
+    }
+}
+
+void ThumbnailGrid::Render(SDL_Renderer* renderer) {
+    ++frame;
+    UploadReady(renderer);
+    if (imageCount <= 0) {
+        return;
+    }
+
+    // 只遍历与视口相交的行
+    int columns = GetColumns();
+    int cell = GetCellSize();
+    int firstRow = scrollY / cell;
+    int lastRow = (scrollY + viewport.h - 1) / cell;
+    int first = firstRow * columns;
+    int last = std::min(imageCount - 1, (lastRow + 1) * columns - 1);
+
+    std::vector<SDL_Rect> placeholders;
+    std::vector<SDL_Rect> failedCells;
+    std::vector<std::vector<SDL_Vertex>> vertices(atlasPages.size());
+    std::vector<std::vector<int>> indices(atlasPages.size());
+    std::vector<int> failedVisible;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int index = first; index <= last; ++index) {
+            if (!resident.count(index) && failed.count(index)) {
+                failedVisible.push_back(index);
+            }
+        }
+    }
+
+    const SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+    const float texel = 1.0f / kAtlasSize;
+    size_t failedIndex = 0;
+    for (int index = first; index <= last; ++index) {
+        SDL_Rect rect = CellRect(index);
+        auto it = resident.find(index);
+        if (it == resident.end()) {
+            SDL_Rect box = {rect.x + kCellPadding, rect.y + kCellPadding, kThumbSize, kThumbSize};
+            if (failedIndex < failedVisible.size() && failedVisible[failedIndex] == index) {
+                failedCells.push_back(box);
+                ++failedIndex;
+            } else {
+                placeholders.push_back(box);
+            }
+            continue;
+        }
+        Resident& thumb = it->second;
+        thumb.lastUsed = frame;
+        int page = thumb.slot / kSlotsPerPage;
+        int local = thumb.slot % kSlotsPerPage;
+        float u0 = (local % kSlotsPerRow) * kThumbSize * texel;
+        float v0 = (local / kSlotsPerRow) * kThumbSize * texel;
+        float u1 = u0 + thumb.width * texel;
+        float v1 = v0 + thumb.height * texel;
+        // 在格子中居中
+        float x0 = static_cast<float>(rect.x + (cell - thumb.width) / 2);
+        float y0 = static_cast<float>(rect.y + (cell - thumb.height) / 2);
+        float x1 = x0 + thumb.width;
+        float y1 = y0 + thumb.height;
+        int base = (int)vertices[page].size();
+        vertices[page].push_back({{x0, y0}, white, {u0, v0}});
+        vertices[page].push_back({{x1, y0}, white, {u1, v0}});
+        vertices[page].push_back({{x1, y1}, white, {u1, v1}});
+        vertices[page].push_back({{x0, y1}, white, {u0, v1}});
+        for (int offset : {0, 1, 2, 0, 2, 3}) {
+            indices[page].push_back(base + offset);
+        }
+    }
+
+    if (!placeholders.empty()) {
+        SDL_SetRenderDrawColor(renderer, 0x30, 0x30, 0x30, 0xFF);
+        SDL_RenderFillRects(renderer, placeholders.data(), (int)placeholders.size());
+    }
+    if (!failedCells.empty()) {
+        SDL_SetRenderDrawColor(renderer, 0x50, 0x28, 0x28, 0xFF);
+        SDL_RenderFillRects(renderer, failedCells.data(), (int)failedCells.size());
+    }
+    // 每页图集一次绘制调用
+    for (size_t page = 0; page < atlasPages.size(); ++page) {
+        if (!vertices[page].empty()) {
+            SDL_RenderGeometry(renderer, atlasPages[page], vertices[page].data(), (int)vertices[page].size(),
+                               indices[page].data(), (int)indices[page].size());
+        }
+    }
+
+    // 选中框
+    if (selected >= first && selected <= last) {
+        SDL_Rect rect = CellRect(selected);
+        SDL_SetRenderDrawColor(renderer, 0x4A, 0x90, 0xE2, 0xFF);
+        for (int i = 0; i < 3; ++i) {
+            SDL_Rect frameRect = {rect.x + i, rect.y + i, rect.w - 2 * i, rect.h - 2 * i};
+            SDL_RenderDrawRect(renderer, &frameRect);
+        }
+    }
+
+    // 滚动条
+    int maxScroll = GetMaxScroll();
+    if (maxScroll > 0) {
+        int contentHeight = maxScroll + viewport.h;
+        int thumbHeight = std::max(20, static_cast<int>(static_cast<int64_t>(viewport.h) * viewport.h / contentHeight));
+        int thumbY = viewport.y + static_cast<int>(static_cast<int64_t>(viewport.h - thumbHeight) * scrollY / maxScroll);
+        SDL_Rect bar = {viewport.x + viewport.w - kScrollbarWidth, thumbY, kScrollbarWidth, thumbHeight};
+        SDL_SetRenderDrawColor(renderer, 0x80, 0x80, 0x80, 0xFF);
+        SDL_RenderFillRect(renderer, &bar);
+    }
+
+    RequestThumbnails(first, last);
+}
+
+void ThumbnailGrid::RequestThumbnails(int first, int last) {
+    // 可见格子按从上到下的顺序优先，然后沿滚动方向预取一屏，反方向半屏
+    int screen = last - first + 1;
+    std::vector<int> order;
+    for (int index = first; index <= last; ++index) {
+        order.push_back(index);
+    }
+    for (int i = 1; i <= screen; ++i) {
+        order.push_back(scrollDirection > 0 ? last + i : first - i);
+        if (i <= screen / 2) {
+            order.push_back(scrollDirection > 0 ? first - i : last + i);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // 滚动后旧的请求不再需要，整体替换
+    pending.clear();
+    for (int index : order) {
+        if (index < 0 || index >= imageCount || resident.count(index) || ready.count(index) ||
+            inFlight.count(index) || failed.count(index)) {
+            continue;
+        }
+        pending.push_back(index);
+    }
+    SubmitJobsLocked();
+}
+
+void ThumbnailGrid::SubmitJobsLocked() {
+    if (!started || stopping) {
+        return;
+    }
+    // 每个任务只生成一张，滚动后不再可见的格子不会被生成
+    while (queuedJobs + (int)inFlight.size() < maxJobs && queuedJobs < (int)pending.size()) {
+        if (!JobScheduler::GetInstance().Submit(JobScheduler::Priority::Thumbnail, [this]() { RunJob(); }, jobToken)) {
+            break;
+        }
+        ++queuedJobs;
+    }
+}
+
+void ThumbnailGrid::ReleaseTextures() {
+    for (SDL_Texture* page : atlasPages) {
+        SDL_DestroyTexture(page);
+    }
+    atlasPages.clear();
+    freeSlots.clear();
+    resident.clear();
+}
+
+void ThumbnailGrid::RunJob() {
+    TRACE_SCOPE("ThumbnailGrid::RunJob");
+    int index;
+    unsigned taskGeneration;
+    ThumbnailFunc func;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --queuedJobs;
+        if (stopping || pending.empty()) {
+            return;
+        }
+        index = pending.front();
+        pending.pop_front();
+        inFlight.insert(index);
+        taskGeneration = generation;
+        func = thumbnailFunc;
+    }
+
+    SDL_Surface* thumbnail = func ? func(index) : nullptr;
+    if (thumbnail && thumbnail->format->format != atlasFormat) {
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(thumbnail, atlasFormat, 0);
+        SDL_FreeSurface(thumbnail);
+        thumbnail = converted;
+    }
+    if (thumbnail && (thumbnail->w > kThumbSize || thumbnail->h > kThumbSize)) {
+        SDL_FreeSurface(thumbnail);
+        thumbnail = nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight.erase(index);
+        if (taskGeneration != generation) {
+            // 目录已切换，结果作废；仍需唤醒，让新目录重新请求该序号
+            SDL_FreeSurface(thumbnail);
+        } else if (thumbnail) {
+            ready[index] = thumbnail;
+            ++generatedCount;
+        } else {
+            failed.insert(index);
+        }
+        SubmitJobsLocked();
+    }
+
+    // 唤醒UI线程上传并重绘
+    if (wakeEventType != (Uint32)-1) {
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = wakeEventType;
+        SDL_PushEvent(&event);
+    }
+}
@@ -0,0 +1,700 @@
+#include "ThumbnailStore.h"
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "FileIo.h"
+#include "JobScheduler.h"
+#include "JpegError.h"
+
+// 索引文件：文件头之后是capacity个定长槽位，hash为0表示空槽，为1表示已删除
+struct ThumbnailStore::IndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;      // 2的幂
+    uint32_t count;         // 有效条目数
+    uint32_t tombstones;
+    uint32_t reserved;
+    uint64_t packSize;      // 包文件的有效长度，其后的内容是未完成的写入
+    uint64_t liveBytes;     // 有效条目占用的字节数
+};
+
+struct ThumbnailStore::IndexEntry {
+    uint64_t hash;
+    uint64_t offset;        // 记录在包文件中的偏移
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint32_t length;        // 记录总长度
+    uint32_t lastAccess;    // 最近命中的时间（秒），压缩时保留最近用过的
+};
+
+namespace {
+
+const uint32_t kIndexMagic = 0x58444954;   // "TIDX"
+const uint32_t kRecordMagic = 0x4B415054;  // "TPAK"
+const uint32_t kVersion = 1;
+const uint32_t kInitialCapacity = 4096;
+const uint64_t kEmptyHash = 0;
+const uint64_t kTombstoneHash = 1;
+const uint64_t kMinCompactBytes = 16ull << 20;   // 过期数据少于此值时不值得压缩
+
+enum Encoding : uint16_t {
+    kEncodingRaw = 0,       // ARGB8888原始像素，用于带透明度的缩略图
+    kEncodingJpeg = 1
+};
+
+// 包文件中每条记录的头，其后依次是键和像素数据
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t keyLength;
+    uint16_t width;
+    uint16_t height;
+    uint16_t encoding;
+    uint16_t reserved;
+    uint32_t dataLength;
+};
+
+uint64_t HashIdentity(const std::string& identity) {
+    // FNV-1a，避开空槽和删除标记
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : identity) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash <= kTombstoneHash ? hash + 2 : hash;
+}
+
+uint32_t Now() {
+    return static_cast<uint32_t>(std::time(nullptr));
+}
+
+// ARGB8888在小端序内存中为BGRA
+bool EncodeJpeg(SDL_Surface* surface, std::vector<unsigned char>* output) {
+    unsigned char* buffer = nullptr;
+    unsigned long size = 0;
+    jpeg_compress_struct cinfo;
+    JpegErrorManager error;
+    cinfo.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = JpegErrorExit;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        std::free(buffer);
+        return false;
+    }
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &buffer, &size);
+    cinfo.image_width = static_cast<JDIMENSION>(surface->w);
+    cinfo.image_height = static_cast<JDIMENSION>(surface->h);
+    cinfo.input_components = 4;
+    cinfo.in_color_space = JCS_EXT_BGRA;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 85, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = static_cast<JSAMPROW>(surface->pixels) + static_cast<size_t>(cinfo.next_scanline) * surface->pitch;
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    output->assign(buffer, buffer + size);
+    std::free(buffer);
+    return true;
+}
+
+SDL_Surface* DecodeJpeg(const unsigned char* data, size_t size, int width, int height) {
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!surface) {
+        return nullptr;
+    }
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager error;
+    cinfo.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = JpegErrorExit;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        SDL_FreeSurface(surface);
+        return nullptr;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, data, static_cast<unsigned long>(size));
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_EXT_BGRA;
+    jpeg_start_decompress(&cinfo);
+    if (static_cast<int>(cinfo.output_width) != width || static_cast<int>(cinfo.output_height) != height) {
+        jpeg_destroy_decompress(&cinfo);
+        SDL_FreeSurface(surface);
+        return nullptr;
+    }
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = static_cast<JSAMPROW>(surface->pixels) + static_cast<size_t>(cinfo.output_scanline) * surface->pitch;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    return surface;
+}
+
+bool IsOpaque(SDL_Surface* surface) {
+    for (int y = 0; y < surface->h; ++y) {
+        const Uint8* row = static_cast<const Uint8*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch;
+        for (int x = 0; x < surface->w; ++x) {
+            if (row[x * 4 + 3] != 0xFF) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+ThumbnailStore::ThumbnailStore() {
+}
+
+ThumbnailStore::~ThumbnailStore() {
+    Close();
+}
+
+std::string ThumbnailStore::DefaultDirectory() {
+    const char* cacheHome = std::getenv("XDG_CACHE_HOME");
+    if (cacheHome && cacheHome[0] == '/') {
+        return std::string(cacheHome) + "/image_viewer";
+    }
+    const char* home = std::getenv("HOME");
+    if (home && home[0] != '\0') {
+        return std::string(home) + "/.cache/image_viewer";
+    }
+    return "";
+}
+
+bool ThumbnailStore::MakeFileKey(const std::string& path, int thumbSize, Key* key) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    std::error_code ec;
+    std::filesystem::path absolute = std::filesystem::absolute(path, ec);
+    key->identity = std::to_string(thumbSize) + "|" + (ec ? path : absolute.string());
+    key->sourceSize = static_cast<uint64_t>(st.st_size);
+    key->sourceMtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+bool ThumbnailStore::MakeArchiveKey(const std::string& archivePath, const std::string& entryName, int thumbSize, Key* key) {
+    if (!MakeFileKey(archivePath, thumbSize, key)) {
+        return false;
+    }
+    // 条目随压缩包一起失效
+    key->identity.push_back('\0');
+    key->identity += entryName;
+    return true;
+}
+
+ThumbnailStore::IndexHeader* ThumbnailStore::Header() const {
+    return reinterpret_cast<IndexHeader*>(indexMap);
+}
+
+ThumbnailStore::IndexEntry* ThumbnailStore::Entries() const {
+    return reinterpret_cast<IndexEntry*>(indexMap + sizeof(IndexHeader));
+}
+
+bool ThumbnailStore::Open(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (indexMap || directory.empty()) {
+        return indexMap != nullptr;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    std::string indexPath = directory + "/thumbnails.idx";
+    packPath = directory + "/thumbnails.pack";
+
+    indexFd = open(indexPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (indexFd < 0) {
+        std::cerr << "Unable to open thumbnail cache " << indexPath << std::endl;
+        return false;
+    }
+    // 同时运行的其他实例已占用缓存时不使用
+    if (flock(indexFd, LOCK_EX | LOCK_NB) != 0) {
+        std::cerr << "Thumbnail cache is in use by another instance" << std::endl;
+        close(indexFd);
+        indexFd = -1;
+        return false;
+    }
+    packFd = open(packPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (packFd < 0) {
+        std::cerr << "Unable to open thumbnail cache " << packPath << std::endl;
+        close(indexFd);
+        indexFd = -1;
+        return false;
+    }
+
+    struct stat packStat;
+    bool valid = MapIndexLocked() && fstat(packFd, &packStat) == 0 &&
+                 Header()->packSize <= static_cast<uint64_t>(packStat.st_size);
+    if (!valid) {
+        // 索引损坏或版本不符，整体重建
+        UnmapIndexLocked();
+        if (ftruncate(packFd, 0) != 0 || !InitIndexLocked(kInitialCapacity)) {
+            std::cerr << "Unable to initialize thumbnail cache in " << directory << std::endl;
+            CloseLocked();
+            return false;
+        }
+    }
+    if (NeedsCompactionLocked(0)) {
+        ScheduleCompactionLocked();
+    }
+    std::cout << "Thumbnail cache: " << Header()->count << " entries, "
+              << (Header()->packSize >> 20) << " MB in " << directory << std::endl;
+    return true;
+}
+
+void ThumbnailStore::Close() {
+    // 先等后台压缩结束，它在锁外读取包文件
+    while (true) {
+        CancelToken token;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!compacting) {
+                CloseLocked();
+                return;
+            }
+            token = compactToken;
+            token.Cancel();
+        }
+        JobScheduler::GetInstance().CancelAndWait(token);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (compactToken.IsCancelled()) {
+            // 排队中被丢弃的压缩任务不会再清除标志
+            compacting = false;
+        }
+    }
+}
+
+void ThumbnailStore::CloseLocked() {
+    if (indexMap) {
+        msync(indexMap, indexMapSize, MS_ASYNC);
+    }
+    UnmapIndexLocked();
+    if (packFd >= 0) {
+        close(packFd);
+        packFd = -1;
+    }
+    if (indexFd >= 0) {
+        // 关闭时释放flock
+        close(indexFd);
+        indexFd = -1;
+    }
+}
+
+void ThumbnailStore::SetSizeLimit(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    sizeLimit = std::max<uint64_t>(bytes, 1ull << 20);
+}
+
+bool ThumbnailStore::MapIndexLocked() {
+    struct stat st;
+    if (fstat(indexFd, &st) != 0 || st.st_size < (off_t)sizeof(IndexHeader)) {
+        return false;
+    }
+    IndexHeader header;
+    if (!PreadFully(indexFd, &header, sizeof(header), 0) || header.magic != kIndexMagic || header.version != kVersion ||
+        header.capacity == 0 || (header.capacity & (header.capacity - 1)) != 0 ||
+        static_cast<uint64_t>(st.st_size) != sizeof(IndexHeader) + static_cast<uint64_t>(header.capacity) * sizeof(IndexEntry)) {
+        return false;
+    }
+    void* address = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, indexFd, 0);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    indexMap = static_cast<char*>(address);
+    indexMapSize = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void ThumbnailStore::UnmapIndexLocked() {
+    if (indexMap) {
+        munmap(indexMap, indexMapSize);
+        indexMap = nullptr;
+        indexMapSize = 0;
+    }
+}
+
+bool ThumbnailStore::InitIndexLocked(uint32_t capacity) {
+    UnmapIndexLocked();
+    off_t size = static_cast<off_t>(sizeof(IndexHeader) + static_cast<uint64_t>(capacity) * sizeof(IndexEntry));
+    // 先截断为0，新的槽位全部为空
+    if (ftruncate(indexFd, 0) != 0 || ftruncate(indexFd, size) != 0) {
+        return false;
+    }
+    IndexHeader header = {};
+    header.magic = kIndexMagic;
+    header.version = kVersion;
+    header.capacity = capacity;
+    if (!PwriteFully(indexFd, &header, sizeof(header), 0)) {
+        return false;
+    }
+    return MapIndexLocked();
+}
+
+ThumbnailStore::IndexEntry* ThumbnailStore::FindLocked(uint64_t hash) const {
+    uint32_t mask = Header()->capacity - 1;
+    IndexEntry* entries = Entries();
+    for (uint32_t probe = 0, i = static_cast<uint32_t>(hash) & mask; probe <= mask; ++probe, i = (i + 1) & mask) {
+        if (entries[i].hash == kEmptyHash) {
+            return nullptr;
+        }
+        if (entries[i].hash == hash) {
+            return &entries[i];
+        }
+    }
+    return nullptr;
+}
+
+bool ThumbnailStore::InsertLocked(const IndexEntry& entry) {
+    IndexHeader* header = Header();
+    // 负载（含删除标记）不超过一半，否则重建或扩容
+    if ((static_cast<uint64_t>(header->count) + header->tombstones + 1) * 2 > header->capacity) {
+        uint32_t capacity = header->capacity;
+        if ((static_cast<uint64_t>(header->count) + 1) * 4 > capacity) {
+            capacity *= 2;
+        }
+        if (!RehashLocked(capacity)) {
+            return false;
+        }
+        header = Header();
+    }
+    uint32_t mask = header->capacity - 1;
+    IndexEntry* entries = Entries();
+    IndexEntry* slot = nullptr;
+    for (uint32_t probe = 0, i = static_cast<uint32_t>(entry.hash) & mask; probe <= mask; ++probe, i = (i + 1) & mask) {
+        if (entries[i].hash == entry.hash) {
+            // 覆盖同键的旧记录
+            header->liveBytes -= entries[i].length;
+            entries[i] = entry;
+            header->liveBytes += entry.length;
+            return true;
+        }
+        if (entries[i].hash == kTombstoneHash && !slot) {
+            slot = &entries[i];
+        }
+        if (entries[i].hash == kEmptyHash) {
+            if (!slot) {
+                slot = &entries[i];
+            }
+            break;
+        }
+    }
+    if (!slot) {
+        return false;
+    }
+    if (slot->hash == kTombstoneHash) {
+        --header->tombstones;
+    }
+    *slot = entry;
+    ++header->count;
+    header->liveBytes += entry.length;
+    return true;
+}
+
+void ThumbnailStore::RemoveLocked(IndexEntry* entry) {
+    IndexHeader* header = Header();
+    header->liveBytes -= entry->length;
+    entry->hash = kTombstoneHash;
+    --header->count;
+    ++header->tombstones;
+}
+
+bool ThumbnailStore::RehashLocked(uint32_t capacity) {
+    IndexHeader old = *Header();
+    std::vector<IndexEntry> live;
+    live.reserve(old.count);
+    for (uint32_t i = 0; i < old.capacity; ++i) {
+        if (Entries()[i].hash > kTombstoneHash) {
+            live.push_back(Entries()[i]);
+        }
+    }
+    if (!InitIndexLocked(capacity)) {
+        return false;
+    }
+    Header()->packSize = old.packSize;
+    for (const IndexEntry& entry : live) {
+        InsertLocked(entry);
+    }
+    return true;
+}
+
+bool ThumbnailStore::NeedsCompactionLocked(uint64_t incoming) const {
+    const IndexHeader* header = Header();
+    if (header->packSize + incoming > sizeLimit) {
+        return true;
+    }
+    // 过期和被覆盖的记录超过一半
+    uint64_t dead = header->packSize - header->liveBytes;
+    return dead > kMinCompactBytes && dead > header->liveBytes;
+}
+
+void ThumbnailStore::ScheduleCompactionLocked() {
+    if (compacting) {
+        return;
+    }
+    compacting = true;
+    CancelToken token = CancelToken::Create();
+    compactToken = token;
+    // 复制记录不持锁，期间Get/Put照常进行；线程池未运行时在调用线程上进行
+    if (!JobScheduler::GetInstance().Submit(JobScheduler::Priority::Indexing, [this, token]() { Compact(token); }, token)) {
+        mutex.unlock();
+        Compact(token);
+        mutex.lock();
+    }
+}
+
+void ThumbnailStore::Compact(CancelToken token) {
+    // 记录live中各条目的旧偏移，复制期间被删除或覆盖的条目在换入时丢弃
+    std::vector<IndexEntry> live;
+    uint64_t before;
+    uint64_t targetBytes;
+    int sourceFd;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!indexMap || token.IsCancelled()) {
+            compacting = false;
+            return;
+        }
+        before = Header()->packSize;
+        targetBytes = sizeLimit * 3 / 4;
+        sourceFd = packFd;
+        for (uint32_t i = 0; i < Header()->capacity; ++i) {
+            if (Entries()[i].hash > kTombstoneHash) {
+                live.push_back(Entries()[i]);
+            }
+        }
+    }
+    // 最近用过的优先保留
+    std::sort(live.begin(), live.end(), [](const IndexEntry& a, const IndexEntry& b) {
+        return a.lastAccess > b.lastAccess;
+    });
+
+    // 包文件只追加，快照中的记录在复制期间不会被改写；packFd只在这里和Close中替换
+    std::string tempPath = packPath + ".tmp";
+    int tempFd = open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    std::vector<std::pair<IndexEntry, uint64_t>> copied;     // 新条目和旧偏移
+    std::vector<unsigned char> record;
+    uint64_t offset = 0;
+    bool ok = tempFd >= 0;
+    for (size_t i = 0; ok && i < live.size(); ++i) {
+        IndexEntry entry = live[i];
+        if (offset + entry.length > targetBytes) {
+            continue;
+        }
+        if (token.IsCancelled()) {
+            ok = false;
+            break;
+        }
+        record.resize(entry.length);
+        if (!PreadFully(sourceFd, record.data(), record.size(), static_cast<int64_t>(entry.offset)) ||
+            !PwriteFully(tempFd, record.data(), record.size(), static_cast<int64_t>(offset))) {
+            continue;
+        }
+        uint64_t oldOffset = entry.offset;
+        entry.offset = offset;
+        copied.push_back({entry, oldOffset});
+        offset += entry.length;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    compacting = false;
+    if (!ok || !indexMap || packFd != sourceFd) {
+        if (tempFd >= 0) {
+            close(tempFd);
+            unlink(tempPath.c_str());
+        } else {
+            std::cerr << "Unable to compact thumbnail cache" << std::endl;
+        }
+        return;
+    }
+    std::vector<IndexEntry> kept;
+    for (std::pair<IndexEntry, uint64_t>& item : copied) {
+        const IndexEntry* current = FindLocked(item.first.hash);
+        if (current && current->offset == item.second) {
+            item.first.lastAccess = current->lastAccess;
+            kept.push_back(item.first);
+        }
+    }
+    // 复制期间追加的记录很少，持锁接在后面
+    for (uint32_t i = 0; i < Header()->capacity; ++i) {
+        IndexEntry entry = Entries()[i];
+        if (entry.hash <= kTombstoneHash || entry.offset < before) {
+            continue;
+        }
+        record.resize(entry.length);
+        if (!PreadFully(packFd, record.data(), record.size(), static_cast<int64_t>(entry.offset)) ||
+            !PwriteFully(tempFd, record.data(), record.size(), static_cast<int64_t>(offset))) {
+            continue;
+        }
+        entry.offset = offset;
+        kept.push_back(entry);
+        offset += entry.length;
+    }
+    if (rename(tempPath.c_str(), packPath.c_str()) != 0) {
+        close(tempFd);
+        unlink(tempPath.c_str());
+        return;
+    }
+    close(packFd);
+    packFd = tempFd;
+
+    uint32_t capacity = kInitialCapacity;
+    while (static_cast<uint64_t>(capacity) < kept.size() * 4) {
+        capacity *= 2;
+    }
+    if (!InitIndexLocked(capacity)) {
+        return;
+    }
+    for (const IndexEntry& entry : kept) {
+        InsertLocked(entry);
+    }
+    Header()->packSize = offset;
+    std::cout << "Thumbnail cache compacted: " << (before >> 20) << " MB -> " << (offset >> 20) << " MB, "
+              << kept.size() << " entries kept" << std::endl;
+}
+
+SDL_Surface* ThumbnailStore::Get(const Key& key) {
+    std::vector<unsigned char> record;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!indexMap) {
+            return nullptr;
+        }
+        IndexEntry* entry = FindLocked(HashIdentity(key.identity));
+        if (!entry) {
+            ++missCount;
+            return nullptr;
+        }
+        if (entry->sourceSize != key.sourceSize || entry->sourceMtime != key.sourceMtime) {
+            // 来源已修改，旧缩略图作废
+            RemoveLocked(entry);
+            ++staleCount;
+            ++missCount;
+            return nullptr;
+        }
+        record.resize(entry->length);
+        const RecordHeader* header = reinterpret_cast<const RecordHeader*>(record.data());
+        bool valid = entry->length >= sizeof(RecordHeader) &&
+                     PreadFully(packFd, record.data(), record.size(), static_cast<int64_t>(entry->offset)) &&
+                     header->magic == kRecordMagic && header->keyLength == key.identity.size() &&
+                     sizeof(RecordHeader) + header->keyLength + static_cast<uint64_t>(header->dataLength) == entry->length &&
+                     std::memcmp(record.data() + sizeof(RecordHeader), key.identity.data(), header->keyLength) == 0;
+        if (!valid) {
+            // 哈希冲突或记录损坏
+            RemoveLocked(entry);
+            ++missCount;
+            return nullptr;
+        }
+        entry->lastAccess = Now();
+    }
+
+    const RecordHeader* header = reinterpret_cast<const RecordHeader*>(record.data());
+    const unsigned char* data = record.data() + sizeof(RecordHeader) + header->keyLength;
+    SDL_Surface* surface = nullptr;
+    if (header->encoding == kEncodingJpeg) {
+        surface = DecodeJpeg(data, header->dataLength, header->width, header->height);
+    } else if (header->encoding == kEncodingRaw && header->dataLength == static_cast<uint32_t>(header->width) * header->height * 4) {
+        surface = SDL_CreateRGBSurfaceWithFormat(0, header->width, header->height, 32, SDL_PIXELFORMAT_ARGB8888);
+        if (surface) {
+            for (int y = 0; y < header->height; ++y) {
+                std::memcpy(static_cast<Uint8*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch,
+                            data + static_cast<size_t>(y) * header->width * 4, static_cast<size_t>(header->width) * 4);
+            }
+        }
+    }
+    if (surface) {
+        ++hitCount;
+    } else {
+        ++missCount;
+    }
+    return surface;
+}
+
+bool ThumbnailStore::Put(const Key& key, SDL_Surface* thumbnail) {
+    if (!thumbnail || thumbnail->format->BytesPerPixel != 4 || thumbnail->w > 0xFFFF || thumbnail->h > 0xFFFF) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!indexMap) {
+            return false;
+        }
+    }
+
+    // 编码在锁外进行
+    SDL_Surface* surface = thumbnail;
+    if (thumbnail->format->format != SDL_PIXELFORMAT_ARGB8888) {
+        surface = SDL_ConvertSurfaceFormat(thumbnail, SDL_PIXELFORMAT_ARGB8888, 0);
+        if (!surface) {
+            return false;
+        }
+    }
+    RecordHeader header = {};
+    header.magic = kRecordMagic;
+    header.keyLength = static_cast<uint32_t>(key.identity.size());
+    header.width = static_cast<uint16_t>(surface->w);
+    header.height = static_cast<uint16_t>(surface->h);
+    std::vector<unsigned char> data;
+    if (IsOpaque(surface) && EncodeJpeg(surface, &data)) {
+        header.encoding = kEncodingJpeg;
+    } else {
+        header.encoding = kEncodingRaw;
+        data.resize(static_cast<size_t>(surface->w) * surface->h * 4);
+        for (int y = 0; y < surface->h; ++y) {
+            std::memcpy(data.data() + static_cast<size_t>(y) * surface->w * 4,
+                        static_cast<const Uint8*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch,
+                        static_cast<size_t>(surface->w) * 4);
+        }
+    }
+    if (surface != thumbnail) {
+        SDL_FreeSurface(surface);
+    }
+    header.dataLength = static_cast<uint32_t>(data.size());
+
+    std::vector<unsigned char> record(sizeof(RecordHeader) + key.identity.size() + data.size());
+    std::memcpy(record.data(), &header, sizeof(header));
+    std::memcpy(record.data() + sizeof(header), key.identity.data(), key.identity.size());
+    std::memcpy(record.data() + sizeof(header) + key.identity.size(), data.data(), data.size());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!indexMap) {
+        return false;
+    }
+    if (NeedsCompactionLocked(record.size())) {
+        ScheduleCompactionLocked();
+    }
+    // 压缩完成之前超出上限的缩略图不保存，下次再生成
+    if (!indexMap || Header()->packSize + record.size() > sizeLimit) {
+        return false;
+    }
+    // 先写记录再更新索引，中途退出时索引不会指向不完整的记录
+    uint64_t offset = Header()->packSize;
+    if (!PwriteFully(packFd, record.data(), record.size(), static_cast<int64_t>(offset))) {
+        return false;
+    }
+    Header()->packSize = offset + record.size();
+    IndexEntry entry = {};
+    entry.hash = HashIdentity(key.identity);
+    entry.offset = offset;
+    entry.sourceSize = key.sourceSize;
+    entry.sourceMtime = key.sourceMtime;
+    entry.length = static_cast<uint32_t>(record.size());
+    entry.lastAccess = Now();
+    return InsertLocked(entry);
+}
@@ -0,0 +1,506 @@
+#include "TileSource.h"
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <jpeglib.h>
+#ifdef IMAGEVIEWER_HAVE_TIFF
+#include <tiffio.h>
+#endif
+#include "ImagePyramid.h"
+#include "JpegError.h"
+
+namespace {
+
+// 区域解码每隔这么多行检查一次取消
+const JDIMENSION kCancelCheckRows = 64;
+
+// 把源像素（BGRA字节序，即小端ARGB8888）按factor x factor盒式平均写入目标表面。
+// 源行按顺序到达，只保留尚未完成的目标行的累加和
+class RegionAccumulator {
+public:
+    RegionAccumulator(SDL_Surface* dest, int factor) : dest(dest), factor(factor) {}
+
+    // 源行sy上从sx开始的count个像素，坐标相对区域左上角
+    void AddRun(int sx, int sy, const Uint8* pixels, int count) {
+        int outY = sy / factor;
+        if (outY >= dest->h) {
+            return;
+        }
+        if (factor == 1) {
+            int copy = std::min(count, dest->w - sx);
+            if (copy > 0) {
+                std::memcpy(RowPointer(outY) + sx * 4, pixels, static_cast<size_t>(copy) * 4);
+            }
+            return;
+        }
+        std::vector<uint32_t>& sums = rows[outY];
+        if (sums.empty()) {
+            sums.assign(static_cast<size_t>(dest->w) * 5, 0); // B, G, R, A, 像素数
+        }
+        for (int i = 0; i < count; ++i) {
+            int outX = (sx + i) / factor;
+            if (outX >= dest->w) {
+                break;
+            }
+            uint32_t* sum = &sums[static_cast<size_t>(outX) * 5];
+            const Uint8* p = pixels + i * 4;
+            sum[0] += p[0];
+            sum[1] += p[1];
+            sum[2] += p[2];
+            sum[3] += p[3];
+            sum[4] += 1;
+        }
+    }
+
+    // 源行[0, sy)已全部到达，写出已完整的目标行
+    void FlushBefore(int sy) {
+        while (!rows.empty() && (rows.begin()->first + 1) * factor <= sy) {
+            WriteRow(rows.begin()->first, rows.begin()->second);
+            rows.erase(rows.begin());
+        }
+    }
+
+    // 写出剩余的行（图片边缘不足factor行时按实际像素数平均）
+    void Finish() {
+        for (const auto& row : rows) {
+            WriteRow(row.first, row.second);
+        }
+        rows.clear();
+    }
+
+private:
+    Uint8* RowPointer(int y) const {
+        return static_cast<Uint8*>(dest->pixels) + static_cast<size_t>(y) * dest->pitch;
+    }
+
+    void WriteRow(int y, const std::vector<uint32_t>& sums) const {
+        Uint8* out = RowPointer(y);
+        for (int x = 0; x < dest->w; ++x) {
+            const uint32_t* sum = &sums[static_cast<size_t>(x) * 5];
+            uint32_t count = std::max<uint32_t>(1, sum[4]);
+            for (int c = 0; c < 4; ++c) {
+                out[x * 4 + c] = static_cast<Uint8>((sum[c] + count / 2) / count);
+            }
+        }
+    }
+
+    SDL_Surface* dest;
+    int factor;
+    std::map<int, std::vector<uint32_t>> rows;
+};
+
+// 把区域裁剪到层级范围内，完全在外时返回false
+bool ClipRegion(const TileSource& source, int level, const SDL_Rect& region, SDL_Rect* clipped) {
+    int levelWidth, levelHeight;
+    TileSource::LevelSize(source.GetWidth(), source.GetHeight(), level, &levelWidth, &levelHeight);
+    int x0 = std::max(0, region.x);
+    int y0 = std::max(0, region.y);
+    int x1 = std::min(levelWidth, region.x + region.w);
+    int y1 = std::min(levelHeight, region.y + region.h);
+    if (x0 >= x1 || y0 >= y1) {
+        return false;
+    }
+    *clipped = {x0, y0, x1 - x0, y1 - y0};
+    return true;
+}
+
+SDL_Surface* CreateRegionSurface(const SDL_Rect& region) {
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, region.w, region.h, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (surface) {
+        SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    }
+    return surface;
+}
+
+// 读取JPEG文件头，成功时返回尺寸和颜色空间
+bool ReadJpegHeader(const std::string& path, int* width, int* height, J_COLOR_SPACE* colorSpace) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager error;
+    cinfo.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = JpegErrorExit;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        std::fclose(file);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+    *width = static_cast<int>(cinfo.image_width);
+    *height = static_cast<int>(cinfo.image_height);
+    *colorSpace = cinfo.jpeg_color_space;
+    jpeg_destroy_decompress(&cinfo);
+    std::fclose(file);
+    return true;
+}
+
+// JPEG区域解码：层级0~3用libjpeg-turbo的缩放IDCT直接输出1/2^L，更粗的层级再做盒式平均；
+// 列方向用jpeg_crop_scanline只解码区域所在的iMCU列，行方向用jpeg_skip_scanlines跳过上方的行
+class JpegRegionSource : public TileSource {
+public:
+    static std::unique_ptr<TileSource> Open(const std::string& path) {
+        int w, h;
+        J_COLOR_SPACE colorSpace;
+        if (!ReadJpegHeader(path, &w, &h, &colorSpace)) {
+            return nullptr;
+        }
+        // CMYK无法直接输出为BGRA，交给SDL_image整图解码
+        if (colorSpace == JCS_CMYK || colorSpace == JCS_YCCK) {
+            return nullptr;
+        }
+        std::unique_ptr<JpegRegionSource> source(new JpegRegionSource());
+        source->path = path;
+        source->width = w;
+        source->height = h;
+        return source;
+    }
+
+    SDL_Surface* DecodeRegion(int level, const SDL_Rect& requested, const CancelToken& cancel) override {
+        SDL_Rect region;
+        if (!ClipRegion(*this, level, requested, &region)) {
+            return nullptr;
+        }
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            return nullptr;
+        }
+        SDL_Surface* surface = CreateRegionSurface(region);
+        if (!surface) {
+            std::fclose(file);
+            return nullptr;
+        }
+        int scaleShift = std::min(level, 3);
+        int factor = 1 << (level - scaleShift);
+        RegionAccumulator accumulator(surface, factor);
+        std::vector<Uint8> row;
+
+        // setjmp之后不再创建需要析构的对象
+        jpeg_decompress_struct cinfo;
+        JpegErrorManager error;
+        cinfo.err = jpeg_std_error(&error.pub);
+        error.pub.error_exit = JpegErrorExit;
+        if (setjmp(error.jump)) {
+            jpeg_destroy_decompress(&cinfo);
+            std::fclose(file);
+            SDL_FreeSurface(surface);
+            return nullptr;
+        }
+        jpeg_create_decompress(&cinfo);
+        jpeg_stdio_src(&cinfo, file);
+        jpeg_read_header(&cinfo, TRUE);
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = 1u << scaleShift;
+        cinfo.out_color_space = JCS_EXT_BGRA;
+        jpeg_start_decompress(&cinfo);
+
+        // 区域在缩放输出中的范围
+        JDIMENSION x0 = static_cast<JDIMENSION>(region.x * factor);
+        JDIMENSION x1 = std::min<JDIMENSION>(static_cast<JDIMENSION>((region.x + region.w) * factor), cinfo.output_width);
+        JDIMENSION y0 = static_cast<JDIMENSION>(region.y * factor);
+        JDIMENSION y1 = std::min<JDIMENSION>(static_cast<JDIMENSION>((region.y + region.h) * factor), cinfo.output_height);
+        if (x0 < x1 && y0 < y1) {
+            // 裁剪起点会向左对齐到iMCU边界；两侧各多留一个iMCU，
+            // 使色度上采样在图块边缘也有相邻像素，与整图解码结果一致
+            JDIMENSION margin = static_cast<JDIMENSION>(cinfo.max_h_samp_factor * cinfo.min_DCT_scaled_size);
+            JDIMENSION cropX = x0 > margin ? x0 - margin : 0;
+            JDIMENSION cropWidth = std::min(x1 + margin, cinfo.output_width) - cropX;
+            if (cropWidth < cinfo.output_width) {
+                jpeg_crop_scanline(&cinfo, &cropX, &cropWidth);
+            }
+            row.resize(static_cast<size_t>(cinfo.output_width) * 4);
+            if (y0 > 0) {
+                jpeg_skip_scanlines(&cinfo, y0);
+            }
+            // 每隔几行检查取消，离开超大图片时不必等整条图块解完
+            while (cinfo.output_scanline < y1) {
+                if ((cinfo.output_scanline - y0) % kCancelCheckRows == 0 && cancel.IsCancelled()) {
+                    jpeg_abort_decompress(&cinfo);
+                    jpeg_destroy_decompress(&cinfo);
+                    std::fclose(file);
+                    SDL_FreeSurface(surface);
+                    return nullptr;
+                }
+                int sy = static_cast<int>(cinfo.output_scanline - y0);
+                JSAMPROW rowPointer = row.data();
+                jpeg_read_scanlines(&cinfo, &rowPointer, 1);
+                accumulator.AddRun(0, sy, row.data() + static_cast<size_t>(x0 - cropX) * 4, static_cast<int>(x1 - x0));
+                accumulator.FlushBefore(sy + 1);
+            }
+            accumulator.Finish();
+        }
+        // 区域以下的行不需要，直接放弃剩余数据
+        jpeg_abort_decompress(&cinfo);
+        jpeg_destroy_decompress(&cinfo);
+        std::fclose(file);
+        return surface;
+    }
+
+private:
+    JpegRegionSource() = default;
+
+    std::string path;
+};
+
+#ifdef IMAGEVIEWER_HAVE_TIFF
+// TIFF区域解码：分块TIFF只读取与区域相交的块，条带TIFF只读取相交的条带。
+// libtiff句柄不是线程安全的，解码串行进行
+class TiffRegionSource : public TileSource {
+public:
+    static std::unique_ptr<TileSource> Open(const std::string& path) {
+        TIFF* tiff = TIFFOpen(path.c_str(), "r");
+        if (!tiff) {
+            return nullptr;
+        }
+        char message[1024];
+        uint32_t w = 0, h = 0;
+        if (!TIFFRGBAImageOK(tiff, message) ||
+            !TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &w) || !TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &h)) {
+            TIFFClose(tiff);
+            return nullptr;
+        }
+        std::unique_ptr<TiffRegionSource> source(new TiffRegionSource());
+        source->tiff = tiff;
+        source->width = static_cast<int>(w);
+        source->height = static_cast<int>(h);
+        source->tiled = TIFFIsTiled(tiff) != 0;
+        if (source->tiled) {
+            TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &source->blockWidth);
+            TIFFGetField(tiff, TIFFTAG_TILELENGTH, &source->blockHeight);
+        } else {
+            source->blockWidth = w;
+            TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &source->blockHeight);
+            source->blockHeight = std::min(source->blockHeight, h);
+        }
+        if (source->blockWidth == 0 || source->blockHeight == 0) {
+            return nullptr;
+        }
+        return source;
+    }
+
+    ~TiffRegionSource() override {
+        if (tiff) {
+            TIFFClose(tiff);
+        }
+    }
+
+    SDL_Surface* DecodeRegion(int level, const SDL_Rect& requested, const CancelToken& cancel) override {
+        SDL_Rect region;
+        if (!ClipRegion(*this, level, requested, &region)) {
+            return nullptr;
+        }
+        SDL_Surface* surface = CreateRegionSurface(region);
+        if (!surface) {
+            return nullptr;
+        }
+        int factor = 1 << level;
+        int x0 = region.x * factor;
+        int x1 = std::min((region.x + region.w) * factor, width);
+        int y0 = region.y * factor;
+        int y1 = std::min((region.y + region.h) * factor, height);
+        int bw = static_cast<int>(blockWidth);
+        int bh = static_cast<int>(blockHeight);
+
+        RegionAccumulator accumulator(surface, factor);
+        std::vector<uint32_t> raster(static_cast<size_t>(bw) * bh);
+        std::vector<Uint8> bgra(static_cast<size_t>(bw) * 4);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int by = y0 / bh * bh; by < y1; by += bh) {
+            int rowsInBlock = std::min(bh, height - by);
+            for (int bx = x0 / bw * bw; bx < x1; bx += bw) {
+                if (cancel.IsCancelled()) {
+                    SDL_FreeSurface(surface);
+                    return nullptr;
+                }
+                int ok = tiled ? TIFFReadRGBATile(tiff, bx, by, raster.data())
+                               : TIFFReadRGBAStrip(tiff, by, raster.data());
+                if (!ok) {
+                    SDL_FreeSurface(surface);
+                    return nullptr;
+                }
+                // RGBA接口的原点在左下角：分块按完整块高翻转，条带按实际行数翻转
+                int flipRows = tiled ? bh : rowsInBlock;
+                int colBegin = std::max(x0, bx);
+                int colEnd = std::min(x1, bx + bw);
+                for (int y = std::max(y0, by); y < std::min(y1, by + rowsInBlock); ++y) {
+                    const uint32_t* src = raster.data() + static_cast<size_t>(flipRows - 1 - (y - by)) * bw;
+                    for (int x = colBegin; x < colEnd; ++x) {
+                        uint32_t abgr = src[x - bx];
+                        Uint8* p = &bgra[static_cast<size_t>(x - colBegin) * 4];
+                        p[0] = static_cast<Uint8>(TIFFGetB(abgr));
+                        p[1] = static_cast<Uint8>(TIFFGetG(abgr));
+                        p[2] = static_cast<Uint8>(TIFFGetR(abgr));
+                        p[3] = static_cast<Uint8>(TIFFGetA(abgr));
+                    }
+                    accumulator.AddRun(colBegin - x0, y - y0, bgra.data(), colEnd - colBegin);
+                }
+            }
+            accumulator.FlushBefore(std::min(y1, by + rowsInBlock) - y0);
+        }
+        accumulator.Finish();
+        return surface;
+    }
+
+private:
+    TiffRegionSource() = default;
+
+    TIFF* tiff = nullptr;
+    std::mutex mutex;
+    bool tiled = false;
+    uint32_t blockWidth = 0;    // 块宽（条带为整行）
+    uint32_t blockHeight = 0;   // 块高或每条带行数
+};
+#endif
+
+bool ReadMagic(const std::string& path, unsigned char* bytes, size_t count) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    size_t read = std::fread(bytes, 1, count, file);
+    std::fclose(file);
+    return read == count;
+}
+
+bool IsJpegMagic(const unsigned char* b) {
+    return b[0] == 0xFF && b[1] == 0xD8 && b[2] == 0xFF;
+}
+
+bool IsTiffMagic(const unsigned char* b) {
+    return (b[0] == 'I' && b[1] == 'I' && b[2] == 42 && b[3] == 0) ||
+           (b[0] == 'M' && b[1] == 'M' && b[2] == 0 && b[3] == 42);
+}
+
+} // namespace
+
+void TileSource::LevelSize(int width, int height, int level, int* levelWidth, int* levelHeight) {
+    // 与ImagePyramid::Downsample2x的尺寸一致
+    int w = width;
+    int h = height;
+    for (int i = 0; i < level; ++i) {
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+    }
+    *levelWidth = w;
+    *levelHeight = h;
+}
+
+int TileSource::GetLevelCount(int tileSize) const {
+    int level = 0;
+    int w = width;
+    int h = height;
+    while (std::max(w, h) > tileSize && !(w == 1 && h == 1)) {
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+        ++level;
+    }
+    return level + 1;
+}
+
+std::unique_ptr<TileSource> TileSource::OpenFile(const std::string& path) {
+    unsigned char magic[4];
+    if (!ReadMagic(path, magic, sizeof(magic))) {
+        return nullptr;
+    }
+    if (IsJpegMagic(magic)) {
+        return JpegRegionSource::Open(path);
+    }
+#ifdef IMAGEVIEWER_HAVE_TIFF
+    if (IsTiffMagic(magic)) {
+        return TiffRegionSource::Open(path);
+    }
+#endif
+    return nullptr;
+}
+
+bool TileSource::ProbeSize(const std::string& path, int* width, int* height) {
+    unsigned char header[24];
+    if (!ReadMagic(path, header, sizeof(header))) {
+        return false;
+    }
+    static const unsigned char pngSignature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    if (std::memcmp(header, pngSignature, 8) == 0 && std::memcmp(header + 12, "IHDR", 4) == 0) {
+        // IHDR紧跟签名，宽高为大端32位
+        auto readBigEndian = [](const unsigned char* p) {
+            return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                   (static_cast<uint32_t>(p[2]) << 8) | p[3];
+        };
+        uint32_t w = readBigEndian(header + 16);
+        uint32_t h = readBigEndian(header + 20);
+        if (w == 0 || h == 0 || w > 0x7FFFFFFF || h > 0x7FFFFFFF) {
+            return false;
+        }
+        *width = static_cast<int>(w);
+        *height = static_cast<int>(h);
+        return true;
+    }
+    if (IsJpegMagic(header)) {
+        J_COLOR_SPACE colorSpace;
+        return ReadJpegHeader(path, width, height, &colorSpace);
+    }
+    if (IsTiffMagic(header)) {
+#ifdef IMAGEVIEWER_HAVE_TIFF
+        std::unique_ptr<TileSource> source = TiffRegionSource::Open(path);
+        if (source) {
+            *width = source->GetWidth();
+            *height = source->GetHeight();
+            return true;
+        }
+#endif
+        return false;
+    }
+    return false;
+}
+
+SurfaceTileSource::SurfaceTileSource(std::unique_ptr<DecodedImage> decoded, int tileSize)
+    : image(std::move(decoded)) {
+    if (!image || image->levels.empty()) {
+        return;
+    }
+    // 金字塔只支持每像素4字节，其他格式先转换
+    if (image->levels[0]->format->BytesPerPixel != 4) {
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(image->levels[0], SDL_PIXELFORMAT_ARGB8888, 0);
+        if (converted) {
+            for (SDL_Surface* surface : image->levels) {
+                SDL_FreeSurface(surface);
+            }
+            image->levels.assign(1, converted);
+        }
+    }
+    ImagePyramid::Build(*image, tileSize);
+    width = image->levels[0]->w;
+    height = image->levels[0]->h;
+}
+
+SDL_Surface* SurfaceTileSource::DecodeRegion(int level, const SDL_Rect& requested, const CancelToken&) {
+    SDL_Rect region;
+    if (!image || level < 0 || level >= (int)image->levels.size() || !ClipRegion(*this, level, requested, &region)) {
+        return nullptr;
+    }
+    SDL_Surface* source = image->levels[level];
+    if (source->format->BytesPerPixel != 4) {
+        return nullptr;
+    }
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, region.w, region.h, 32, source->format->format);
+    if (!surface) {
+        return nullptr;
+    }
+    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    // 直接拷贝行：SDL_BlitSurface会修改源表面的blit映射，不能在多个线程上同时使用
+    for (int y = 0; y < region.h; ++y) {
+        const Uint8* src = static_cast<const Uint8*>(source->pixels) +
+                           static_cast<size_t>(region.y + y) * source->pitch + static_cast<size_t>(region.x) * 4;
+        Uint8* dst = static_cast<Uint8*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch;
+        std::memcpy(dst, src, static_cast<size_t>(region.w) * 4);
+    }
+    return surface;
+}
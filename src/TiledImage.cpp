@@ -0,0 +1,289 @@
+#include "TiledImage.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "ImagePyramid.h"
+#include "Trace.h"
+
+namespace {
+
+// 一次区域解码最多合并的同行图块数
+const int kMaxBatch = 4;
+
+// 从条带表面中拷贝出一个图块
+SDL_Surface* CropSurface(SDL_Surface* strip, int x, int w, int h) {
+    SDL_Surface* tile = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, strip->format->format);
+    if (!tile) {
+        return nullptr;
+    }
+    SDL_SetSurfaceBlendMode(tile, SDL_BLENDMODE_NONE);
+    for (int y = 0; y < h; ++y) {
+        const Uint8* src = static_cast<const Uint8*>(strip->pixels) + static_cast<size_t>(y) * strip->pitch + static_cast<size_t>(x) * 4;
+        Uint8* dst = static_cast<Uint8*>(tile->pixels) + static_cast<size_t>(y) * tile->pitch;
+        std::memcpy(dst, src, static_cast<size_t>(w) * 4);
+    }
+    return tile;
+}
+
+} // namespace
+
+TiledImage::TiledImage(std::unique_ptr<TileSource> tileSource, const std::string& imageKey, Uint32 wakeEvent, int jobs)
+    : source(std::move(tileSource)), key(imageKey), wakeEventType(wakeEvent), jobToken(CancelToken::Create()),
+      maxJobs(std::max(1, jobs)) {
+    levelCount = source->GetLevelCount(kTileSize);
+}
+
+TiledImage::~TiledImage() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        pending.clear();
+    }
+    // 丢弃排队的图块，等待正在解码的完成
+    JobScheduler::GetInstance().CancelAndWait(jobToken);
+    for (auto& entry : ready) {
+        SDL_FreeSurface(entry.second);
+    }
+}
+
+std::string TiledImage::TileKey(const TileId& tile) const {
+    return key + "@" + std::to_string(tile.level) + "/" + std::to_string(tile.col) + "," + std::to_string(tile.row);
+}
+
+SDL_Rect TiledImage::TileRect(const TileId& tile) const {
+    int levelWidth, levelHeight;
+    TileSource::LevelSize(GetWidth(), GetHeight(), tile.level, &levelWidth, &levelHeight);
+    int x = tile.col * kTileSize;
+    int y = tile.row * kTileSize;
+    return {x, y, std::min(kTileSize, levelWidth - x), std::min(kTileSize, levelHeight - y)};
+}
+
+void TiledImage::UploadReady(SDL_Renderer* renderer, TextureCache& cache) {
+    std::map<std::string, SDL_Surface*> uploads;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uploads.swap(ready);
+    }
+    for (auto& entry : uploads) {
+        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, entry.second);
+        if (texture) {
+            cache.Put(entry.first, texture);
+        } else {
+            std::cerr << "Unable to create tile texture! SDL_Error: " << SDL_GetError() << std::endl;
+        }
+        SDL_FreeSurface(entry.second);
+    }
+}
+
+bool TiledImage::DrawFallback(SDL_Renderer* renderer, TextureCache& cache, const TileId& tile, const SDL_Rect& dest,
+                              std::vector<std::string>& pinnedKeys) {
+    SDL_Rect rect = TileRect(tile);
+    // 逐级向上查找已缓存的父图块，只绘制与该图块对应的部分
+    for (int level = tile.level + 1; level < levelCount; ++level) {
+        int shift = level - tile.level;
+        int x0 = rect.x >> shift;
+        int y0 = rect.y >> shift;
+        TileId parent = {level, x0 / kTileSize, y0 / kTileSize};
+        std::string parentKey = TileKey(parent);
+        if (!cache.Contains(parentKey)) {
+            continue;
+        }
+        SDL_Rect parentRect = TileRect(parent);
+        SDL_Rect src = {
+            x0 - parentRect.x,
+            y0 - parentRect.y,
+            std::max(1, std::min(rect.w >> shift, parentRect.w - (x0 - parentRect.x))),
+            std::max(1, std::min(rect.h >> shift, parentRect.h - (y0 - parentRect.y)))
+        };
+        SDL_RenderCopy(renderer, cache.Get(parentKey), &src, &dest);
+        pinnedKeys.push_back(parentKey);
+        return true;
+    }
+    return false;
+}
+
+void TiledImage::Render(SDL_Renderer* renderer, TextureCache& cache, float scale, int offsetX, int offsetY, const SDL_Rect& viewport) {
+    UploadReady(renderer, cache);
+
+    std::vector<std::string> pinnedKeys;
+    std::vector<TileId> wanted;
+    // 最粗层级只有一个图块，最先请求，作为任何缩放下的占位
+    wanted.push_back({levelCount - 1, 0, 0});
+
+    int level = ImagePyramid::SelectLevel(scale, levelCount);
+    int levelWidth, levelHeight;
+    TileSource::LevelSize(GetWidth(), GetHeight(), level, &levelWidth, &levelHeight);
+    // 层级像素到屏幕像素的比例按整图尺寸计算，各层级的边缘对齐
+    double pixelScaleX = static_cast<double>(GetWidth()) * scale / levelWidth;
+    double pixelScaleY = static_cast<double>(GetHeight()) * scale / levelHeight;
+
+    // 视口在层级坐标中的范围
+    int x0 = std::max(0, static_cast<int>(std::floor((viewport.x - offsetX) / pixelScaleX)));
+    int y0 = std::max(0, static_cast<int>(std::floor((viewport.y - offsetY) / pixelScaleY)));
+    int x1 = std::min(levelWidth, static_cast<int>(std::ceil((viewport.x + viewport.w - offsetX) / pixelScaleX)));
+    int y1 = std::min(levelHeight, static_cast<int>(std::ceil((viewport.y + viewport.h - offsetY) / pixelScaleY)));
+
+    if (x0 < x1 && y0 < y1) {
+        std::vector<TileId> visible;
+        for (int row = y0 / kTileSize; row <= (y1 - 1) / kTileSize; ++row) {
+            for (int col = x0 / kTileSize; col <= (x1 - 1) / kTileSize; ++col) {
+                visible.push_back({level, col, row});
+            }
+        }
+        // 离视口中心近的图块优先解码
+        double centerX = (viewport.x + viewport.w / 2.0 - offsetX) / pixelScaleX;
+        double centerY = (viewport.y + viewport.h / 2.0 - offsetY) / pixelScaleY;
+        auto distance = [centerX, centerY](const TileId& tile) {
+            double dx = (tile.col + 0.5) * kTileSize - centerX;
+            double dy = (tile.row + 0.5) * kTileSize - centerY;
+            return dx * dx + dy * dy;
+        };
+        std::sort(visible.begin(), visible.end(), [&distance](const TileId& a, const TileId& b) {
+            return distance(a) < distance(b);
+        });
+
+        for (const TileId& tile : visible) {
+            SDL_Rect rect = TileRect(tile);
+            // 两条边分别取整，相邻图块之间不留缝
+            int left = static_cast<int>(std::lround(offsetX + rect.x * pixelScaleX));
+            int top = static_cast<int>(std::lround(offsetY + rect.y * pixelScaleY));
+            int right = static_cast<int>(std::lround(offsetX + (rect.x + rect.w) * pixelScaleX));
+            int bottom = static_cast<int>(std::lround(offsetY + (rect.y + rect.h) * pixelScaleY));
+            SDL_Rect dest = {left, top, right - left, bottom - top};
+
+            std::string tileKey = TileKey(tile);
+            pinnedKeys.push_back(tileKey);
+            SDL_Texture* texture = cache.Get(tileKey);
+            if (texture) {
+                SDL_RenderCopy(renderer, texture, nullptr, &dest);
+            } else {
+                wanted.push_back(tile);
+                DrawFallback(renderer, cache, tile, dest, pinnedKeys);
+            }
+        }
+    }
+
+    cache.SetPinned(pinnedKeys, kPinGroup);
+    RequestTiles(wanted, cache);
+}
+
+void TiledImage::RequestTiles(const std::vector<TileId>& tiles, const TextureCache& cache) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // 视口变化后旧的请求不再需要，整体替换
+    pending.clear();
+    std::set<std::string> queued;
+    for (const TileId& tile : tiles) {
+        std::string tileKey = TileKey(tile);
+        if (cache.Contains(tileKey) || inFlight.count(tileKey) || ready.count(tileKey) ||
+            failed.count(tileKey) || !queued.insert(tileKey).second) {
+            continue;
+        }
+        pending.push_back(tile);
+    }
+    SubmitJobsLocked();
+}
+
+void TiledImage::SubmitJobsLocked() {
+    if (stopping) {
+        return;
+    }
+    while (queuedJobs < (int)pending.size() && queuedJobs + activeJobs < maxJobs) {
+        if (!JobScheduler::GetInstance().Submit(JobScheduler::Priority::Visible, [this]() { RunJob(); }, jobToken)) {
+            break;
+        }
+        ++queuedJobs;
+    }
+}
+
+void TiledImage::RunJob() {
+    TRACE_SCOPE("TiledImage::RunJob");
+    std::vector<TileId> batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --queuedJobs;
+        if (stopping || pending.empty()) {
+            return;
+        }
+        ++activeJobs;
+        TileId first = pending.front();
+        pending.pop_front();
+        batch.push_back(first);
+        // 合并同层级同一行的相邻请求，JPEG只需跳过一次上方的行
+        int minCol = first.col;
+        int maxCol = first.col;
+        for (auto it = pending.begin(); it != pending.end() && (int)batch.size() < kMaxBatch;) {
+            int newMin = std::min(minCol, it->col);
+            int newMax = std::max(maxCol, it->col);
+            if (it->level == first.level && it->row == first.row && newMax - newMin < kMaxBatch) {
+                minCol = newMin;
+                maxCol = newMax;
+                batch.push_back(*it);
+                it = pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (const TileId& tile : batch) {
+            inFlight.insert(TileKey(tile));
+        }
+    }
+
+    int minCol = batch[0].col;
+    int maxCol = batch[0].col;
+    for (const TileId& tile : batch) {
+        minCol = std::min(minCol, tile.col);
+        maxCol = std::max(maxCol, tile.col);
+    }
+    SDL_Rect first = TileRect({batch[0].level, minCol, batch[0].row});
+    SDL_Rect last = TileRect({batch[0].level, maxCol, batch[0].row});
+    SDL_Rect region = {first.x, first.y, last.x + last.w - first.x, first.h};
+    SDL_Surface* strip;
+    {
+        TRACE_SCOPE("TileSource::DecodeRegion");
+        strip = source->DecodeRegion(batch[0].level, region, jobToken);
+    }
+    if (jobToken.IsCancelled()) {
+        // 图片已关闭，析构函数在等待
+        SDL_FreeSurface(strip);
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const TileId& tile : batch) {
+            inFlight.erase(TileKey(tile));
+        }
+        --activeJobs;
+        return;
+    }
+    if (!strip) {
+        std::cerr << "Failed to decode tiles at level " << batch[0].level << ", row " << batch[0].row << std::endl;
+    }
+
+    std::vector<SDL_Surface*> surfaces;
+    for (const TileId& tile : batch) {
+        SDL_Rect rect = TileRect(tile);
+        surfaces.push_back(strip ? CropSurface(strip, rect.x - region.x, rect.w, rect.h) : nullptr);
+    }
+    SDL_FreeSurface(strip);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            std::string tileKey = TileKey(batch[i]);
+            inFlight.erase(tileKey);
+            if (surfaces[i]) {
+                ready[tileKey] = surfaces[i];
+            } else {
+                failed.insert(tileKey);
+            }
+        }
+        --activeJobs;
+        SubmitJobsLocked();
+    }
+
+    // 唤醒UI线程上传并重绘
+    if (wakeEventType != (Uint32)-1) {
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = wakeEventType;
+        SDL_PushEvent(&event);
+    }
+}
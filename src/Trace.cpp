@@ -0,0 +1,128 @@
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Trace::enabled{false};
+
+namespace {
+
+// 字段用relaxed原子变量，导出线程与写线程并发读写时没有数据竞争
+struct Event {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> startNs{0};
+    std::atomic<uint64_t> endNs{0};
+};
+
+// 每个线程一个环形缓冲区，只有所属线程写入；线程退出后保留到进程结束以便导出
+struct ThreadBuffer {
+    int tid = 0;
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> head{0};     // 已写入的事件总数
+    Event events[Trace::kCapacity];
+};
+
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> registry;
+
+thread_local std::shared_ptr<ThreadBuffer> threadBuffer;
+thread_local const char* threadName = nullptr;
+
+// 首次记录时才分配缓冲区，未开启追踪的线程没有开销
+ThreadBuffer* CurrentBuffer() {
+    if (!threadBuffer) {
+        threadBuffer = std::make_shared<ThreadBuffer>();
+        threadBuffer->name.store(threadName, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(registryMutex);
+        threadBuffer->tid = (int)registry.size() + 1;
+        registry.push_back(threadBuffer);
+    }
+    return threadBuffer.get();
+}
+
+} // namespace
+
+void Trace::SetEnabled(bool enable) {
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+void Trace::SetThreadName(const char* name) {
+    threadName = name;
+    if (threadBuffer) {
+        threadBuffer->name.store(name, std::memory_order_relaxed);
+    }
+}
+
+uint64_t Trace::NowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Trace::Record(const char* name, uint64_t startNs, uint64_t endNs) {
+    ThreadBuffer* buffer = CurrentBuffer();
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    Event& event = buffer->events[head % kCapacity];
+    event.name.store(name, std::memory_order_relaxed);
+    event.startNs.store(startNs, std::memory_order_relaxed);
+    event.endNs.store(endNs, std::memory_order_relaxed);
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+bool Trace::Export(const std::string& path) {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers = registry;
+    }
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Unable to write trace " << path << std::endl;
+        return false;
+    }
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    size_t count = 0;
+    for (const std::shared_ptr<ThreadBuffer>& buffer : buffers) {
+        const char* name = buffer->name.load(std::memory_order_relaxed);
+        if (name) {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"args\":{\"name\":\"" << name << "\"}}";
+            first = false;
+        }
+        // 复制期间写线程可能覆盖最旧的事件，复制后按新的写入位置丢弃这些事件
+        uint64_t end = buffer->head.load(std::memory_order_acquire);
+        uint64_t begin = end > kCapacity ? end - kCapacity : 0;
+        struct Copy {
+            const char* name;
+            uint64_t startNs, endNs;
+        };
+        std::vector<Copy> events;
+        events.reserve(static_cast<size_t>(end - begin));
+        for (uint64_t i = begin; i < end; ++i) {
+            const Event& event = buffer->events[i % kCapacity];
+            events.push_back({event.name.load(std::memory_order_relaxed), event.startNs.load(std::memory_order_relaxed),
+                              event.endNs.load(std::memory_order_relaxed)});
+        }
+        uint64_t after = buffer->head.load(std::memory_order_acquire);
+        uint64_t valid = after + 1 > kCapacity ? after + 1 - kCapacity : 0;
+        for (uint64_t i = std::max(begin, valid); i < end; ++i) {
+            const Copy& event = events[static_cast<size_t>(i - begin)];
+            out << (first ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << event.startNs / 1000 << "." << (event.startNs % 1000) / 100
+                << ",\"dur\":" << (event.endNs - event.startNs) / 1000 << "." << ((event.endNs - event.startNs) % 1000) / 100 << "}";
+            first = false;
+            ++count;
+        }
+    }
+    out << "\n]}\n";
+    if (!out) {
+        std::cerr << "Unable to write trace " << path << std::endl;
+        return false;
+    }
+    std::cout << "Trace written to " << path << " (" << count << " events from " << buffers.size() << " threads)" << std::endl;
+    return true;
+}
@@ -1,15 +1,51 @@
 #include "ImageViewer.h"
 #include <iostream>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
 
 int main(int argc, char* argv[]) {
     std::cout << "Image Viewer starting..." << std::endl;
     
     ImageViewer viewer;
-    
+
+    // 命令行参数：--prefetch-ahead=N --prefetch-behind=M --texture-cache-mb=MB --thumbnail-cache-mb=MB --read-queue-depth=N --upload-budget-ms=MS --trace=FILE
+    int prefetchAhead = 3;
+    int prefetchBehind = 1;
+    int textureCacheMB = 512;
+    int thumbnailCacheMB = 256;
+    int readQueueDepth = 8;
+    double uploadBudgetMs = 4.0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--prefetch-ahead=", 0) == 0) {
+            prefetchAhead = std::atoi(arg.c_str() + 17);
+        } else if (arg.rfind("--prefetch-behind=", 0) == 0) {
+            prefetchBehind = std::atoi(arg.c_str() + 18);
+        } else if (arg.rfind("--texture-cache-mb=", 0) == 0) {
+            textureCacheMB = std::max(1, std::atoi(arg.c_str() + 19));
+        } else if (arg.rfind("--thumbnail-cache-mb=", 0) == 0) {
+            thumbnailCacheMB = std::max(1, std::atoi(arg.c_str() + 21));
+        } else if (arg.rfind("--read-queue-depth=", 0) == 0) {
+            readQueueDepth = std::max(0, std::atoi(arg.c_str() + 19));
+        } else if (arg.rfind("--upload-budget-ms=", 0) == 0) {
+            uploadBudgetMs = std::max(0.0, std::atof(arg.c_str() + 19));
+        } else if (arg.rfind("--trace=", 0) == 0) {
+            // 从启动开始记录，退出时写出
+            viewer.SetTraceFile(arg.substr(8), true);
+        }
+    }
+
+    // 缓存在Initialize中打开，打开时按上限压缩，需先设置
+    viewer.SetThumbnailCacheLimit(thumbnailCacheMB);
     if (!viewer.Initialize()) {
         std::cerr << "Failed to initialize Image Viewer" << std::endl;
         return -1;
     }
+    viewer.SetPrefetchWindow(prefetchAhead, prefetchBehind);
+    viewer.SetTextureCacheBudget(textureCacheMB);
+    viewer.SetReadQueueDepth(readQueueDepth);
+    viewer.SetUploadBudget(uploadBudgetMs);
     
     viewer.Run();
     viewer.Cleanup();